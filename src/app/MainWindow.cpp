@@ -18,7 +18,9 @@
 #include <QAction>
 #include <QCheckBox>
 #include <QDialog>
+#include <QDir>
 #include <QComboBox>
+#include <QDoubleSpinBox>
 #include <QColor>
 #include <QEvent>
 #include <QFile>
@@ -33,8 +35,10 @@
 #include <QMessageBox>
 #include <QMetaObject>
 #include <QProgressBar>
+#include <QProgressDialog>
 #include <QPushButton>
 #include <QRadioButton>
+#include <QSignalBlocker>
 #include <QSpinBox>
 #include <QStatusBar>
 #include <QSplitter>
@@ -46,12 +50,14 @@
 #include <QVBoxLayout>
 
 #include "debug/SelectionTrace.h"
+#include "io/ExtentExporter.h"
 #include "io/FileEnumerator.h"
 #include "panel/BitmapViewPanel.h"
 #include "panel/CurrentByteInfoPanel.h"
 #include "panel/ResultsTablePanel.h"
 #include "panel/ScanControlsPanel.h"
 #include "panel/TextViewPanel.h"
+#include "scan/MatchUtils.h"
 #include "scan/ShiftTransform.h"
 #include "settings/AppSettings.h"
 #include "ui_AboutDialog.h"
@@ -59,15 +65,19 @@
 #include "ui_MainWindow.h"
 #include "ui_ViewControls.h"
 #include "view/BitmapViewWidget.h"
+#include "view/EntropyStripWidget.h"
 #include "view/TextViewWidget.h"
 
 namespace breco {
 
 namespace {
+constexpr qint64 kMaxSearchNeedleBytes = 64LL * 1024LL * 1024LL;
 constexpr quint64 kEvictedWindowRadiusBytes = 8ULL * 1024ULL * 1024ULL;
 constexpr quint64 kResultBufferCacheBudgetBytes = 2048ULL * 1024ULL * 1024ULL;
 constexpr quint64 kNotEmptyInitialBytes = 16ULL * 1024ULL * 1024ULL;
 constexpr quint64 kTextChunkExpandStepBytes = 8ULL * 1024ULL * 1024ULL;
+// Export progress counts MiB so multi-terabyte exports fit the dialog's int range.
+constexpr quint64 kExportProgressUnitBytes = 1024ULL * 1024ULL;
 constexpr int kTopPaneMinHeightPx = 180;
 constexpr int kAdvancedSnapHideThresholdPx = 190;
 constexpr int kAdvancedSnapShowThresholdPx = 260;
@@ -367,6 +377,9 @@ MainWindow::MainWindow(QWidget* parent)
 
     QTableView* resultsTable = m_resultsPanel->resultsTableView();
     resultsTable->setModel(&m_resultModel);
+    m_resultModel.setSearchTerms(&m_scanController.searchTerms());
+    m_resultModel.setTermMasks(&m_scanController.termMasks());
+    m_resultModel.setTermLabels(&m_scanController.termLabels());
     resultsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     resultsTable->setSelectionMode(QAbstractItemView::SingleSelection);
     resultsTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
@@ -396,9 +409,27 @@ MainWindow::MainWindow(QWidget* parent)
                m_scanControlsPanel->blockSizeUnitCombo()->count() - 1);
     m_scanControlsPanel->blockSizeSpin()->setValue(restoredBlockSizeValue);
     m_scanControlsPanel->blockSizeUnitCombo()->setCurrentIndex(restoredBlockSizeUnitIndex);
+    m_scanControlsPanel->alignmentCombo()->setCurrentIndex(
+        qBound(0, AppSettings::scanAlignmentIndex(),
+               m_scanControlsPanel->alignmentCombo()->count() - 1));
+    QSpinBox* matchLimitSpin = m_scanControlsPanel->matchLimitSpin();
+    QSpinBox* matchMemorySpin = m_scanControlsPanel->matchMemorySpin();
+    matchLimitSpin->setValue(qBound(matchLimitSpin->minimum(),
+                                    AppSettings::scanMatchLimit(matchLimitSpin->value()),
+                                    matchLimitSpin->maximum()));
+    matchMemorySpin->setValue(qBound(matchMemorySpin->minimum(),
+                                     AppSettings::scanMatchMemoryMiB(matchMemorySpin->value()),
+                                     matchMemorySpin->maximum()));
+    m_scanControlsPanel->entropyMapCheckBox()->setChecked(AppSettings::scanEntropyMapEnabled());
+    m_scanControlsPanel->entropySkipCheckBox()->setChecked(AppSettings::scanEntropySkipEnabled());
+    QDoubleSpinBox* entropySkipSpin = m_scanControlsPanel->entropySkipSpin();
+    entropySkipSpin->setValue(qBound(entropySkipSpin->minimum(),
+                                     AppSettings::scanEntropySkipBits(entropySkipSpin->value()),
+                                     entropySkipSpin->maximum()));
 
     m_textView = new TextViewWidget(m_textPanel->textViewContainer());
     m_bitmapView = new BitmapViewWidget(m_bitmapPanel->bitmapViewContainer());
+    m_entropyStrip = new EntropyStripWidget(m_bitmapPanel->bitmapViewContainer());
     m_textView->setMinimumHeight(220);
     m_bitmapView->setMinimumHeight(220);
     m_textView->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
@@ -411,10 +442,11 @@ MainWindow::MainWindow(QWidget* parent)
     textLayout->setSpacing(0);
     textLayout->addWidget(m_textView);
 
-    auto* bitmapLayout = new QVBoxLayout(m_bitmapPanel->bitmapViewContainer());
+    auto* bitmapLayout = new QHBoxLayout(m_bitmapPanel->bitmapViewContainer());
     bitmapLayout->setContentsMargins(0, 0, 0, 0);
-    bitmapLayout->setSpacing(0);
-    bitmapLayout->addWidget(m_bitmapView);
+    bitmapLayout->setSpacing(2);
+    bitmapLayout->addWidget(m_bitmapView, 1);
+    bitmapLayout->addWidget(m_entropyStrip);
 
     m_textPanel->textViewPanelLayout()->setStretch(1, 1);
     m_bitmapPanel->bitmapViewPanelLayout()->setStretch(1, 1);
@@ -429,6 +461,21 @@ MainWindow::MainWindow(QWidget* parent)
             &MainWindow::onStartScan);
     connect(m_scanControlsPanel->searchTermLineEdit(), &QLineEdit::returnPressed, this,
             &MainWindow::onStartScan);
+    connect(m_scanControlsPanel->nearTermLineEdit(), &QLineEdit::returnPressed, this,
+            &MainWindow::onStartScan);
+    connect(m_scanControlsPanel->loadTermsButton(), &QToolButton::clicked, this,
+            &MainWindow::onLoadSearchTerms);
+    connect(m_scanControlsPanel->loadNeedleButton(), &QToolButton::clicked, this,
+            &MainWindow::onLoadSearchNeedle);
+    connect(m_scanControlsPanel->searchTermLineEdit(), &QLineEdit::textEdited, this,
+            [this](const QString&) {
+                if (m_loadedSearchTerms.isEmpty()) {
+                    return;
+                }
+                m_loadedSearchTerms.clear();
+                m_loadedSearchTermsRaw = false;
+                m_scanControlsPanel->searchTermLineEdit()->setPlaceholderText(QString());
+            });
     connect(resultsTable->selectionModel(), &QItemSelectionModel::currentRowChanged, this,
             [this](const QModelIndex& current, const QModelIndex&) { onResultActivated(current); });
     connect(m_textPanel->textModeCombo(), qOverload<int>(&QComboBox::currentIndexChanged), this,
@@ -511,6 +558,19 @@ MainWindow::MainWindow(QWidget* parent)
                 AppSettings::setScanBlockSizeUnitIndex(index);
                 updateBlockSizeLabel();
             });
+    connect(m_scanControlsPanel->alignmentCombo(), qOverload<int>(&QComboBox::currentIndexChanged),
+            this, [](int index) { AppSettings::setScanAlignmentIndex(index); });
+    connect(m_scanControlsPanel->matchLimitSpin(), qOverload<int>(&QSpinBox::valueChanged), this,
+            [](int value) { AppSettings::setScanMatchLimit(value); });
+    connect(m_scanControlsPanel->matchMemorySpin(), qOverload<int>(&QSpinBox::valueChanged), this,
+            [](int value) { AppSettings::setScanMatchMemoryMiB(value); });
+    connect(m_scanControlsPanel->entropyMapCheckBox(), &QCheckBox::toggled, this,
+            [](bool checked) { AppSettings::setScanEntropyMapEnabled(checked); });
+    connect(m_scanControlsPanel->entropySkipCheckBox(), &QCheckBox::toggled, this,
+            [](bool checked) { AppSettings::setScanEntropySkipEnabled(checked); });
+    connect(m_scanControlsPanel->entropySkipSpin(),
+            qOverload<double>(&QDoubleSpinBox::valueChanged), this,
+            [](double value) { AppSettings::setScanEntropySkipBits(value); });
 
     if (m_shiftUnitCombo != nullptr && m_shiftValueSpin != nullptr) {
         connect(m_shiftUnitCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, [this](int idx) {
@@ -552,6 +612,14 @@ MainWindow::MainWindow(QWidget* parent)
                 }
                 m_bitmapView->setExternalSelectionRange(qMakePair(start, end));
             });
+    connect(m_textView, &TextViewWidget::selectionSearchRequested, this,
+            [this](const QByteArray& bytes) {
+                if (bytes.isEmpty()) {
+                    return;
+                }
+                setLoadedSearchTerms({bytes}, true,
+                                     QStringLiteral("%1 selected bytes").arg(bytes.size()));
+            });
     connect(m_textView, &TextViewWidget::backingScrollRequested, this,
             &MainWindow::onTextBackingScrollRequested);
     connect(m_textView, &TextViewWidget::verticalScrollDragStateChanged, this,
@@ -588,6 +656,8 @@ MainWindow::MainWindow(QWidget* parent)
     connect(m_bitmapView, &BitmapViewWidget::hoverAbsoluteOffsetChanged, this,
             &MainWindow::onBitmapHoverOffsetChanged);
     connect(m_bitmapView, &BitmapViewWidget::byteClicked, this, &MainWindow::onBitmapByteClicked);
+    connect(m_entropyStrip, &EntropyStripWidget::offsetClicked, this,
+            &MainWindow::onBitmapByteClicked);
     connect(m_bitmapView, &BitmapViewWidget::hoverLeft, this, &MainWindow::onHoverLeft);
     connect(m_currentByteInfoPanel->bigEndianCheckBox(), &QCheckBox::toggled, this, [this](bool checked) {
         AppSettings::setCurrentByteInfoBigEndianEnabled(checked);
@@ -624,6 +694,8 @@ MainWindow::MainWindow(QWidget* parent)
     };
     connect(m_ui->actionOpenFile, &QAction::triggered, this, [this]() { onOpenFile(); });
     connect(m_ui->actionOpenDirectory, &QAction::triggered, this, [this]() { onOpenDirectory(); });
+    connect(m_ui->actionExportCarvedFiles, &QAction::triggered, this,
+            [this]() { onExportCarvedFiles(); });
     connect(m_ui->actionQuit, &QAction::triggered, this, [this]() { close(); });
     connect(m_ui->actionViewScanLog, &QAction::triggered, this, [this, syncViewMenuChecks](bool checked) {
         if (checked) {
@@ -942,6 +1014,156 @@ void MainWindow::onOpenDirectory() {
     selectDirectorySource(dir);
 }
 
+void MainWindow::onExportCarvedFiles() {
+    if (m_scanController.isRunning() || !m_scanController.carvesFiles()) {
+        return;
+    }
+    QVector<MatchRecord> files;
+    quint64 totalBytes = 0;
+    const MatchStore& matches = m_resultModel.allMatches();
+    for (int row = 0; row < matches.size(); ++row) {
+        const MatchRecord match = matches.at(row);
+        if (match.matchLength > 0 && m_scanController.carveSignature(match.termIdx) != nullptr) {
+            files.push_back(match);
+            totalBytes += match.matchLength;
+        }
+    }
+    if (files.isEmpty()) {
+        QMessageBox::information(this, QStringLiteral("Breco"),
+                                 QStringLiteral("The last scan carved no files."));
+        return;
+    }
+    const QString dir = QFileDialog::getExistingDirectory(
+        this, QStringLiteral("Export carved files to"), AppSettings::lastDirectoryDialogPath());
+    if (dir.isEmpty()) {
+        return;
+    }
+
+    QProgressDialog progress(
+        QStringLiteral("Exporting %1 carved files...").arg(files.size()), QStringLiteral("Cancel"),
+        0, static_cast<int>(qMax<quint64>(1, totalBytes / kExportProgressUnitBytes)), this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(500);
+    const QVector<ScanTarget>& targets = m_scanController.scanTargets();
+    quint64 doneBytes = 0;
+    quint64 exportedBytes = 0;
+    int exported = 0;
+    QStringList failures;
+    for (const MatchRecord& file : files) {
+        const CarveSignature* signature = m_scanController.carveSignature(file.termIdx);
+        const QString& sourcePath = targets.at(file.scanTargetIdx).filePath;
+        const QString name = QStringLiteral("%1-0x%2.%3")
+                                 .arg(QFileInfo(sourcePath).fileName(),
+                                      QString::number(file.offset, 16).toUpper(),
+                                      signature->extension);
+        QString error;
+        const quint64 doneBefore = doneBytes;
+        const bool copied = ExtentExporter::copyExtent(
+            sourcePath, file.offset, file.matchLength, QDir(dir).filePath(name),
+            [&progress, doneBefore](quint64 copiedBytes) {
+                progress.setValue(
+                    static_cast<int>((doneBefore + copiedBytes) / kExportProgressUnitBytes));
+                return !progress.wasCanceled();
+            },
+            &error);
+        doneBytes += file.matchLength;
+        if (progress.wasCanceled()) {
+            break;
+        }
+        if (!copied) {
+            failures.push_back(error);
+            continue;
+        }
+        ++exported;
+        exportedBytes += file.matchLength;
+    }
+    progress.setValue(progress.maximum());
+
+    m_scanControlsPanel->appendLifecycleMessage(
+        QStringLiteral("Exported %1 of %2 carved files (%3) to %4")
+            .arg(exported)
+            .arg(files.size())
+            .arg(humanBytes(exportedBytes), dir));
+    if (!failures.isEmpty()) {
+        QMessageBox::warning(this, QStringLiteral("Breco"),
+                             QStringLiteral("%1 carved file(s) were not exported:\n%2")
+                                 .arg(failures.size())
+                                 .arg(failures.mid(0, 10).join(QLatin1Char('\n'))));
+    }
+}
+
+void MainWindow::onLoadSearchTerms() {
+    const QString filePath = QFileDialog::getOpenFileName(
+        this, QStringLiteral("Load search terms"), AppSettings::lastTermsFileDialogPath());
+    if (filePath.isEmpty()) {
+        return;
+    }
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QMessageBox::warning(this, QStringLiteral("Breco"),
+                             QStringLiteral("Could not read %1.").arg(filePath));
+        return;
+    }
+    AppSettings::setLastTermsFileDialogPath(QFileInfo(filePath).absolutePath());
+
+    QVector<QByteArray> terms;
+    for (QByteArray line : file.readAll().split('\n')) {
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+        if (!line.isEmpty()) {
+            terms.push_back(line);
+        }
+    }
+    if (terms.isEmpty()) {
+        QMessageBox::information(this, QStringLiteral("Breco"),
+                                 QStringLiteral("%1 contains no search terms.").arg(filePath));
+        return;
+    }
+
+    setLoadedSearchTerms(terms, false,
+                         QStringLiteral("%1 terms from %2")
+                             .arg(terms.size())
+                             .arg(QFileInfo(filePath).fileName()));
+}
+
+void MainWindow::onLoadSearchNeedle() {
+    const QString filePath = QFileDialog::getOpenFileName(
+        this, QStringLiteral("Load search needle"), AppSettings::lastTermsFileDialogPath());
+    if (filePath.isEmpty()) {
+        return;
+    }
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QMessageBox::warning(this, QStringLiteral("Breco"),
+                             QStringLiteral("Could not read %1.").arg(filePath));
+        return;
+    }
+    AppSettings::setLastTermsFileDialogPath(QFileInfo(filePath).absolutePath());
+    if (file.size() == 0 || file.size() > kMaxSearchNeedleBytes) {
+        QMessageBox::information(
+            this, QStringLiteral("Breco"),
+            QStringLiteral("A search needle must be 1 byte to %1.")
+                .arg(humanBytes(static_cast<quint64>(kMaxSearchNeedleBytes))));
+        return;
+    }
+
+    const QByteArray needle = file.readAll();
+    setLoadedSearchTerms({needle}, true,
+                         QStringLiteral("%1 (%2)")
+                             .arg(QFileInfo(filePath).fileName(),
+                                  humanBytes(static_cast<quint64>(needle.size()))));
+}
+
+void MainWindow::setLoadedSearchTerms(const QVector<QByteArray>& terms, bool raw,
+                                      const QString& description) {
+    m_loadedSearchTerms = terms;
+    m_loadedSearchTermsRaw = raw;
+    QLineEdit* termEdit = m_scanControlsPanel->searchTermLineEdit();
+    termEdit->clear();
+    termEdit->setPlaceholderText(description);
+}
+
 void MainWindow::onStartScan() {
     if (m_scanController.isRunning()) {
         onStopScan();
@@ -953,12 +1175,57 @@ void MainWindow::onStartScan() {
         return;
     }
 
-    const QByteArray term = m_scanControlsPanel->searchTermLineEdit()->text().toUtf8();
-    if (term.isEmpty()) {
+    // Carving scans search for the built-in signatures; the term fields are not read.
+    const bool carving = m_scanControlsPanel->carveCheckBox()->isChecked();
+    const QByteArray term =
+        carving ? QByteArray() : m_scanControlsPanel->searchTermLineEdit()->text().toUtf8();
+    QVector<QByteArray> terms = carving          ? QVector<QByteArray>()
+                                : term.isEmpty() ? m_loadedSearchTerms
+                                                 : QVector<QByteArray>{term};
+    if (terms.isEmpty() && !carving) {
         QMessageBox::information(this, QStringLiteral("Breco"),
                                  QStringLiteral("Enter a search term."));
         return;
     }
+    // A needle loaded from a file or selection is matched byte for byte: no option that folds,
+    // re-encodes or expands it applies.
+    const bool rawTerms = term.isEmpty() && m_loadedSearchTermsRaw;
+    const bool regex = !rawTerms && m_scanControlsPanel->regexCheckBox()->isChecked();
+    const bool numeric = !rawTerms && !regex && m_scanControlsPanel->numericCheckBox()->isChecked();
+    const bool hex = !regex && !numeric && m_scanControlsPanel->hexPatternCheckBox()->isChecked();
+    QVector<QByteArray> masks;
+    if (hex && !rawTerms) {
+        for (QByteArray& pattern : terms) {
+            QByteArray bytes;
+            QByteArray mask;
+            if (!MatchUtils::parseHexPattern(QString::fromUtf8(pattern), &bytes, &mask)) {
+                QMessageBox::information(
+                    this, QStringLiteral("Breco"),
+                    QStringLiteral("Invalid hex pattern: %1").arg(QString::fromUtf8(pattern)));
+                return;
+            }
+            pattern = bytes;
+            masks.push_back(mask);
+        }
+    }
+    QVector<QByteArray> nearTerms;
+    QVector<QByteArray> nearMasks;
+    const QString nearTerm = m_scanControlsPanel->nearTermLineEdit()->text();
+    if (!regex && !carving && !nearTerm.isEmpty()) {
+        if (hex) {
+            QByteArray bytes;
+            QByteArray mask;
+            if (!MatchUtils::parseHexPattern(nearTerm, &bytes, &mask)) {
+                QMessageBox::information(this, QStringLiteral("Breco"),
+                                         QStringLiteral("Invalid hex pattern: %1").arg(nearTerm));
+                return;
+            }
+            nearTerms.push_back(bytes);
+            nearMasks.push_back(mask);
+        } else {
+            nearTerms.push_back(nearTerm.toUtf8());
+        }
+    }
     const auto scanButtonPressedAt = std::chrono::steady_clock::now();
 
     m_resultModel.clear();
@@ -970,10 +1237,48 @@ void MainWindow::onStartScan() {
     updateBufferStatusLine();
 
     m_scanControlsPanel->scanProgressBar()->setValue(0);
-    m_scanController.startScan(m_scanTargets, term, effectiveBlockSizeBytes(), selectedWorkerCount(),
-                               selectedTextMode(),
-                               m_scanControlsPanel->ignoreCaseCheckBox()->isChecked(),
+    SearchQuery query;
+    query.terms = terms;
+    query.mode = selectedTextMode();
+    query.ignoreCase = !rawTerms && m_scanControlsPanel->ignoreCaseCheckBox()->isChecked();
+    query.masks = masks;
+    query.regex = regex;
+    query.numeric = numeric;
+    query.tolerance = m_scanControlsPanel->toleranceSpin()->value();
+    query.encodingVariants = !rawTerms && !regex && !numeric && masks.isEmpty() &&
+                             m_scanControlsPanel->utf16VariantsCheckBox()->isChecked();
+    query.encodedForms = !rawTerms && !regex && !numeric && masks.isEmpty() &&
+                         m_scanControlsPanel->encodedFormsCheckBox()->isChecked();
+    query.xorKeys =
+        !rawTerms && !regex && !numeric && m_scanControlsPanel->xorKeysCheckBox()->isChecked();
+    if (!rawTerms && !regex && !numeric && !query.xorKeys) {
+        query.approximate = static_cast<ApproximateMetric>(
+            m_scanControlsPanel->approximateCombo()->currentIndex());
+        query.maxDistance = m_scanControlsPanel->maxDistanceSpin()->value();
+    }
+    query.bitPhases = !rawTerms && !regex && !numeric && !query.xorKeys &&
+                      query.approximate == ApproximateMetric::None &&
+                      m_scanControlsPanel->bitPhasesCheckBox()->isChecked();
+    query.nearTerms = nearTerms;
+    query.nearMasks = nearMasks;
+    query.nearDistance = m_scanControlsPanel->nearDistanceSpin()->value();
+    m_scanController.setMatchLimits(
+        static_cast<quint64>(m_scanControlsPanel->matchLimitSpin()->value()),
+        static_cast<quint64>(m_scanControlsPanel->matchMemorySpin()->value()) * 1024ULL * 1024ULL);
+    // The strip points into the controller's maps, which the next scan replaces.
+    m_entropyStrip->setEntropyMap(nullptr);
+    m_scanController.setEntropyMapEnabled(m_scanControlsPanel->entropyMapCheckBox()->isChecked());
+    m_scanController.setEntropySkipThreshold(
+        m_scanControlsPanel->entropySkipCheckBox()->isChecked()
+            ? m_scanControlsPanel->entropySkipSpin()->value()
+            : 0.0);
+    m_scanController.setMatchAlignment(selectedMatchAlignment());
+    m_scanController.setCarvingEnabled(carving);
+    m_scanController.startScan(m_scanTargets, query, effectiveBlockSizeBytes(),
+                               selectedWorkerCount(),
                                m_scanControlsPanel->prefillOnMergeCheckBox()->isChecked(),
+                               static_cast<ScanReportMode>(
+                                   m_scanControlsPanel->reportModeCombo()->currentIndex()),
                                scanButtonPressedAt);
 }
 
@@ -993,8 +1298,8 @@ void MainWindow::onResultActivated(const QModelIndex& index) {
     }
 
     const int row = index.row();
-    const MatchRecord* match = m_resultModel.matchAt(row);
-    if (match == nullptr) {
+    const std::optional<MatchRecord> match = m_resultModel.matchAt(row);
+    if (!match.has_value()) {
         restoreDirtyBufferForRow(m_activePreviewRow);
         m_activePreviewRow = -1;
         BRECO_SELTRACE(QStringLiteral("onResultActivated: no match for row=%1, return").arg(row));
@@ -1032,7 +1337,7 @@ void MainWindow::onResultActivated(const QModelIndex& index) {
     BRECO_SELTRACE("onResultActivated: showMatchPreview end");
 }
 
-void MainWindow::onResultsBatchReady(const QVector<MatchRecord>& matches, int mergedTotal) {
+void MainWindow::onResultsBatchReady(const MatchStore& matches, int mergedTotal) {
     if (debug::selectionTraceEnabled()) {
         BRECO_SELTRACE(QStringLiteral("onResultsBatchReady: start matches=%1 mergedTotal=%2")
                            .arg(matches.size())
@@ -1077,10 +1382,11 @@ void MainWindow::onScanStarted(int fileCount, quint64 totalBytes) {
     AppSettings::setViewScanLogVisible(true);
     m_ui->actionViewScanLog->setChecked(true);
     m_scanControlsPanel->appendLifecycleMessage(QStringLiteral("Scanning..."));
+    m_ui->actionExportCarvedFiles->setEnabled(false);
     updateBufferStatusLine();
 }
 
-void MainWindow::onScanFinished(bool stoppedByUser, bool) {
+void MainWindow::onScanFinished(bool stoppedByUser, bool autoStoppedLimitExceeded) {
     if (debug::selectionTraceEnabled()) {
         BRECO_SELTRACE(QStringLiteral("onScanFinished: stoppedByUser=%1 rows=%2")
                            .arg(stoppedByUser ? QStringLiteral("true") : QStringLiteral("false"))
@@ -1090,8 +1396,20 @@ void MainWindow::onScanFinished(bool stoppedByUser, bool) {
     QString msg = QStringLiteral("Scan finished");
     if (stoppedByUser) {
         msg = QStringLiteral("Scan stopped by user");
+    } else if (autoStoppedLimitExceeded) {
+        msg = QStringLiteral("Scan stopped at the match limit (%1 matches kept)")
+                  .arg(m_resultModel.rowCount());
     }
     m_scanControlsPanel->appendLifecycleMessage(msg);
+    if (const quint64 skipped = m_scanController.entropySkippedBytes(); skipped > 0) {
+        m_scanControlsPanel->appendLifecycleMessage(
+            QStringLiteral("Skipped %1 of high-entropy data").arg(humanBytes(skipped)));
+    }
+    if (m_scanController.carvesFiles()) {
+        m_scanControlsPanel->appendLifecycleMessage(
+            QStringLiteral("Carved %1 file(s)").arg(m_resultModel.rowCount()));
+        m_ui->actionExportCarvedFiles->setEnabled(m_resultModel.rowCount() > 0);
+    }
     if (isSingleFileModeActive()) {
         insertSyntheticPreviewResultAtTop();
     }
@@ -1171,6 +1489,31 @@ quint64 MainWindow::effectiveBlockSizeBytes() const {
     }
 }
 
+quint32 MainWindow::selectedMatchAlignment() const {
+    switch (m_scanControlsPanel->alignmentCombo()->currentIndex()) {
+        case 1:
+            return 512;
+        case 2:
+            return 4096;
+        case 0:
+        default:
+            return 1;
+    }
+}
+
+// Bit-phase results are only visible with the matching bit shift, so selecting one sets the Shift
+// controls without re-triggering result activation.
+void MainWindow::showBitShift(int bitOffset) {
+    if (m_shiftUnitCombo == nullptr || m_shiftValueSpin == nullptr) {
+        return;
+    }
+    const QSignalBlocker unitBlocker(m_shiftUnitCombo);
+    const QSignalBlocker valueBlocker(m_shiftValueSpin);
+    m_shiftUnitCombo->setCurrentIndex(1);
+    m_shiftValueSpin->setRange(-127, 127);
+    m_shiftValueSpin->setValue(bitOffset);
+}
+
 ShiftSettings MainWindow::currentShiftSettings() const {
     ShiftSettings shift;
     shift.amount = (m_shiftValueSpin != nullptr) ? m_shiftValueSpin->value() : 0;
@@ -1380,8 +1723,8 @@ bool MainWindow::evictOneBufferLargestFirstLeastUsed(const QSet<int>& protectedB
     }
 
     const int firstRow = affectedRows.first();
-    const MatchRecord* firstMatch = m_resultModel.matchAt(firstRow);
-    if (firstMatch == nullptr) {
+    const std::optional<MatchRecord> firstMatch = m_resultModel.matchAt(firstRow);
+    if (!firstMatch.has_value()) {
         BRECO_SELTRACE("evictOneBufferLargestFirstLeastUsed: firstMatch missing, return false");
         return false;
     }
@@ -1395,8 +1738,8 @@ bool MainWindow::evictOneBufferLargestFirstLeastUsed(const QSet<int>& protectedB
 
     for (int i = 1; i < affectedRows.size(); ++i) {
         const int row = affectedRows.at(i);
-        const MatchRecord* match = m_resultModel.matchAt(row);
-        if (match == nullptr) {
+        const std::optional<MatchRecord> match = m_resultModel.matchAt(row);
+        if (!match.has_value()) {
             continue;
         }
         const int newIndex = m_resultBuffers.size();
@@ -1541,7 +1884,7 @@ ResultBuffer MainWindow::loadEvictedWindowForMatch(const MatchRecord& match) con
         return out;
     }
 
-    const quint64 termLen = static_cast<quint64>(m_scanController.searchTermLength());
+    const quint64 termLen = static_cast<quint64>(m_scanController.matchLength(match));
     const quint64 start =
         (match.offset > kEvictedWindowRadiusBytes) ? (match.offset - kEvictedWindowRadiusBytes) : 0;
     const quint64 end =
@@ -1655,8 +1998,9 @@ bool MainWindow::expandActivePreviewBuffer(int direction) {
     if (direction == 0 || m_activePreviewRow < 0 || m_activePreviewRow >= m_resultModel.rowCount()) {
         return false;
     }
-    const MatchRecord* match = m_resultModel.matchAt(m_activePreviewRow);
-    if (match == nullptr || match->scanTargetIdx < 0 || match->scanTargetIdx >= m_scanTargets.size()) {
+    const std::optional<MatchRecord> match = m_resultModel.matchAt(m_activePreviewRow);
+    if (!match.has_value() || match->scanTargetIdx < 0 ||
+        match->scanTargetIdx >= m_scanTargets.size()) {
         return false;
     }
     if (m_activePreviewRow < 0 || m_activePreviewRow >= m_matchBufferIndices.size()) {
@@ -1738,9 +2082,10 @@ void MainWindow::clearResultBufferCacheState() {
 
 void MainWindow::rebuildTargetMatchIntervals() {
     m_targetMatchIntervals.clear();
-    const quint64 termLen = static_cast<quint64>(m_scanController.searchTermLength());
-    const QVector<MatchRecord>& matches = m_resultModel.allMatches();
-    for (const MatchRecord& match : matches) {
+    const MatchStore& matches = m_resultModel.allMatches();
+    for (int row = 0; row < matches.size(); ++row) {
+        const MatchRecord match = matches.at(row);
+        const quint64 termLen = static_cast<quint64>(m_scanController.matchLength(match));
         const quint64 start = match.offset;
         const quint64 end = start + qMax<quint64>(1, termLen);
         m_targetMatchIntervals[match.scanTargetIdx].push_back(qMakePair(start, end));
@@ -1866,8 +2211,8 @@ void MainWindow::requestSharedCenterFromTextScrollPosition(int sliderValue, int
     if (m_activePreviewRow < 0 || m_activePreviewRow >= m_resultModel.rowCount()) {
         return;
     }
-    const MatchRecord* match = m_resultModel.matchAt(m_activePreviewRow);
-    if (match == nullptr) {
+    const std::optional<MatchRecord> match = m_resultModel.matchAt(m_activePreviewRow);
+    if (!match.has_value()) {
         return;
     }
     if (!ensureRowBufferLoaded(m_activePreviewRow, *match)) {
@@ -1934,8 +2279,8 @@ void MainWindow::updateSharedPreviewNow() {
         BRECO_SELTRACE("updateSharedPreviewNow: active row invalid, return");
         return;
     }
-    const MatchRecord* match = m_resultModel.matchAt(m_activePreviewRow);
-    if (match == nullptr) {
+    const std::optional<MatchRecord> match = m_resultModel.matchAt(m_activePreviewRow);
+    if (!match.has_value()) {
         BRECO_SELTRACE("updateSharedPreviewNow: match not found, return");
         return;
     }
@@ -2125,7 +2470,7 @@ void MainWindow::updateSharedPreviewNow() {
                            .arg(debug::selectionTraceElapsedUs() - sliceStartUs));
     }
 
-    const quint64 termLen = static_cast<quint64>(m_scanController.searchTermLength());
+    const quint64 termLen = static_cast<quint64>(m_scanController.matchLength(*match));
     const QString filePath = filePathForTarget(match->scanTargetIdx);
     const std::optional<unsigned char> previousTextByte =
         previousByteBeforeViewport(backing, textSpan.start);
@@ -2144,6 +2489,12 @@ void MainWindow::updateSharedPreviewNow() {
     m_bitmapView->setCenterAnchorOffset(center);
     m_bitmapView->setResultHighlight(match->offset, 0, static_cast<quint32>(termLen), 0,
                                      bitmapSpan.start);
+    const QVector<EntropyMap>& entropyMaps = m_scanController.entropyMaps();
+    m_entropyStrip->setEntropyMap(match->scanTargetIdx >= 0 &&
+                                          match->scanTargetIdx < entropyMaps.size()
+                                      ? &entropyMaps.at(match->scanTargetIdx)
+                                      : nullptr);
+    m_entropyStrip->setVisibleRange(bitmapSpan.start, static_cast<quint64>(bitmapBytes.size()));
     m_previewSyncInProgress = false;
     BRECO_SELTRACE("updateSharedPreviewNow: widget updates done");
 
@@ -2184,6 +2535,9 @@ void MainWindow::showMatchPreview(int row, const MatchRecord& match) {
                            .arg(bufferIndex));
         return;
     }
+    if (m_scanController.searchesBitPhases()) {
+        showBitShift(match.bitOffset);
+    }
     applyShiftToBufferIfEnabled(bufferIndex);
     if (m_activePreviewRow != row) {
         m_textExpandBeforeBytes = 0;
@@ -2308,17 +2662,14 @@ bool MainWindow::insertSyntheticPreviewResultAtTop() {
     synthetic.offset = 0;
     synthetic.searchTimeNs = 0;
 
-    QVector<MatchRecord> rebuiltMatches;
-    rebuiltMatches.reserve(m_resultModel.rowCount() + 1);
-    rebuiltMatches.push_back(synthetic);
-    const QVector<MatchRecord>& existingMatches = m_resultModel.allMatches();
+    MatchStore rebuiltMatches;
+    rebuiltMatches.appendRecords({synthetic});
+    const MatchStore& existingMatches = m_resultModel.allMatches();
     int oldStartRow = 0;
-    if (!existingMatches.isEmpty() && isSyntheticPreviewMatch(existingMatches.first())) {
+    if (!existingMatches.isEmpty() && isSyntheticPreviewMatch(existingMatches.at(0))) {
         oldStartRow = 1;
     }
-    for (int i = oldStartRow; i < existingMatches.size(); ++i) {
-        rebuiltMatches.push_back(existingMatches.at(i));
-    }
+    rebuiltMatches.appendStore(existingMatches, oldStartRow);
 
     QVector<ResultBuffer> oldBuffers = m_resultBuffers;
     QVector<int> oldIndices = m_matchBufferIndices;
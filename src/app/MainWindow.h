@@ -27,6 +27,7 @@ namespace breco {
 class BitmapViewWidget;
 class BitmapViewPanel;
 class CurrentByteInfoPanel;
+class EntropyStripWidget;
 class ResultsTablePanel;
 class ScanControlsPanel;
 class TextViewWidget;
@@ -46,10 +47,13 @@ protected:
 private slots:
     void onOpenFile();
     void onOpenDirectory();
+    void onExportCarvedFiles();
+    void onLoadSearchTerms();
+    void onLoadSearchNeedle();
     void onStartScan();
     void onStopScan();
     void onResultActivated(const QModelIndex& index);
-    void onResultsBatchReady(const QVector<MatchRecord>& matches, int mergedTotal);
+    void onResultsBatchReady(const MatchStore& matches, int mergedTotal);
     void onProgressUpdated(quint64 scanned, quint64 total);
     void onScanStarted(int fileCount, quint64 totalBytes);
     void onScanFinished(bool stoppedByUser, bool autoStoppedLimitExceeded);
@@ -83,12 +87,17 @@ private:
     };
 
     quint64 effectiveBlockSizeBytes() const;
+    quint32 selectedMatchAlignment() const;
     ShiftSettings currentShiftSettings() const;
+    void showBitShift(int bitOffset);
     TextInterpretationMode selectedTextMode() const;
     void setScanButtonMode(bool running);
     void updateBlockSizeLabel();
     int selectedWorkerCount() const;
     QString humanBytes(quint64 bytes) const;
+    // `raw` terms are searched byte for byte: Hex, Regex and Number do not apply to them.
+    void setLoadedSearchTerms(const QVector<QByteArray>& terms, bool raw,
+                              const QString& description);
     bool selectSingleFileSource(const QString& filePath);
     bool selectDirectorySource(const QString& dirPath);
     void refreshSourceSummary();
@@ -149,6 +158,8 @@ private:
 
     QVector<QString> m_sourceFiles;
     QVector<ScanTarget> m_scanTargets;
+    QVector<QByteArray> m_loadedSearchTerms;
+    bool m_loadedSearchTermsRaw = false;
     QVector<ResultBuffer> m_resultBuffers;
     QVector<int> m_matchBufferIndices;
 
@@ -159,6 +170,7 @@ private:
     BitmapViewPanel* m_bitmapPanel = nullptr;
     TextViewWidget* m_textView = nullptr;
     BitmapViewWidget* m_bitmapView = nullptr;
+    EntropyStripWidget* m_entropyStrip = nullptr;
     QSpinBox* m_shiftValueSpin = nullptr;
     QComboBox* m_shiftUnitCombo = nullptr;
 
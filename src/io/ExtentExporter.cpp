@@ -0,0 +1,176 @@
+#include "io/ExtentExporter.h"
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <QFile>
+
+namespace breco {
+
+namespace {
+constexpr quint64 kBufferBytes = 4ULL * 1024ULL * 1024ULL;
+
+void setError(QString* error, const QString& message) {
+    if (error != nullptr) {
+        *error = message;
+    }
+}
+
+#ifdef __linux__
+// copy_file_range() runs in chunks so progress updates and cancelling stay responsive.
+constexpr quint64 kChunkBytes = 64ULL * 1024ULL * 1024ULL;
+
+QString errnoMessage(int errorNumber) {
+    return QString::fromLocal8Bit(std::strerror(errorNumber));
+}
+
+// copy_file_range() refuses these sources and destinations rather than failing to copy them.
+bool needsBufferedCopy(int errorNumber) {
+    return errorNumber == EINVAL || errorNumber == EXDEV || errorNumber == ENOSYS ||
+           errorNumber == EOPNOTSUPP || errorNumber == EBADF;
+}
+
+// Returns the bytes copied, 0 at the end of the source, or -1 with errno set.
+ssize_t bufferedCopy(int source, quint64 sourceOffset, int destination,
+                     quint64 destinationOffset, quint64 size, std::vector<char>* buffer) {
+    buffer->resize(static_cast<size_t>(kBufferBytes));
+    const ssize_t read = ::pread(source, buffer->data(),
+                                 static_cast<size_t>(qMin(size, kBufferBytes)),
+                                 static_cast<off_t>(sourceOffset));
+    if (read <= 0) {
+        return read;
+    }
+    ssize_t written = 0;
+    while (written < read) {
+        const ssize_t rc =
+            ::pwrite(destination, buffer->data() + written, static_cast<size_t>(read - written),
+                     static_cast<off_t>(destinationOffset + static_cast<quint64>(written)));
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        written += rc;
+    }
+    return read;
+}
+#endif
+}  // namespace
+
+bool ExtentExporter::copyExtent(const QString& sourcePath, quint64 offset, quint64 size,
+                                const QString& destinationPath, const ProgressCallback& progress,
+                                QString* error) {
+#ifdef __linux__
+    const int source = ::open(QFile::encodeName(sourcePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (source < 0) {
+        setError(error, QStringLiteral("Cannot open %1: %2").arg(sourcePath, errnoMessage(errno)));
+        return false;
+    }
+    const QByteArray destinationName = QFile::encodeName(destinationPath);
+    const int destination =
+        ::open(destinationName.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (destination < 0) {
+        setError(error,
+                 QStringLiteral("Cannot create %1: %2").arg(destinationPath, errnoMessage(errno)));
+        ::close(source);
+        return false;
+    }
+
+    bool kernelCopy = true;
+    std::vector<char> buffer;
+    quint64 copied = 0;
+    QString failure;
+    while (copied < size) {
+        const quint64 chunk = qMin(size - copied, kChunkBytes);
+        ssize_t rc = 0;
+        if (kernelCopy) {
+            loff_t sourceOffset = static_cast<loff_t>(offset + copied);
+            loff_t destinationOffset = static_cast<loff_t>(copied);
+            rc = ::copy_file_range(source, &sourceOffset, destination, &destinationOffset,
+                                   static_cast<size_t>(chunk), 0);
+            if (rc < 0 && needsBufferedCopy(errno)) {
+                kernelCopy = false;
+                continue;
+            }
+        } else {
+            rc = bufferedCopy(source, offset + copied, destination, copied, chunk, &buffer);
+        }
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc < 0) {
+            failure = errnoMessage(errno);
+            break;
+        }
+        if (rc == 0) {
+            failure = QStringLiteral("source ends at offset %1").arg(offset + copied);
+            break;
+        }
+        copied += static_cast<quint64>(rc);
+        if (progress && !progress(copied)) {
+            failure = QStringLiteral("cancelled");
+            break;
+        }
+    }
+    ::close(source);
+    if (::close(destination) != 0 && failure.isEmpty()) {
+        failure = errnoMessage(errno);
+    }
+    if (!failure.isEmpty()) {
+        ::unlink(destinationName.constData());
+        setError(error, QStringLiteral("Cannot copy to %1: %2").arg(destinationPath, failure));
+        return false;
+    }
+    return true;
+#else
+    QFile sourceFile(sourcePath);
+    if (!sourceFile.open(QIODevice::ReadOnly) ||
+        !sourceFile.seek(static_cast<qint64>(offset))) {
+        setError(error, QStringLiteral("Cannot open %1: %2").arg(sourcePath,
+                                                                  sourceFile.errorString()));
+        return false;
+    }
+    QFile destinationFile(destinationPath);
+    if (!destinationFile.open(QIODevice::WriteOnly | QIODevice::NewOnly)) {
+        setError(error, QStringLiteral("Cannot create %1: %2")
+                            .arg(destinationPath, destinationFile.errorString()));
+        return false;
+    }
+    quint64 copied = 0;
+    QString failure;
+    while (copied < size) {
+        const QByteArray chunk =
+            sourceFile.read(static_cast<qint64>(qMin(size - copied, kBufferBytes)));
+        if (chunk.isEmpty()) {
+            failure = QStringLiteral("source ends at offset %1").arg(offset + copied);
+            break;
+        }
+        if (destinationFile.write(chunk) != chunk.size()) {
+            failure = destinationFile.errorString();
+            break;
+        }
+        copied += static_cast<quint64>(chunk.size());
+        if (progress && !progress(copied)) {
+            failure = QStringLiteral("cancelled");
+            break;
+        }
+    }
+    destinationFile.close();
+    if (!failure.isEmpty()) {
+        destinationFile.remove();
+        setError(error, QStringLiteral("Cannot copy to %1: %2").arg(destinationPath, failure));
+        return false;
+    }
+    return true;
+#endif
+}
+
+}  // namespace breco
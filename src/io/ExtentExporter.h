@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+#include <functional>
+
+namespace breco {
+
+class ExtentExporter {
+public:
+    // Called after each copied chunk with the bytes copied so far; returning false cancels.
+    using ProgressCallback = std::function<bool(quint64 copiedBytes)>;
+
+    // Copies the `size` bytes at `offset` of `sourcePath` (a file or block device) into the new
+    // file `destinationPath`, which must not exist yet. On Linux the kernel copies the bytes
+    // (copy_file_range, so filesystems that support it can share or clone the blocks); where it
+    // cannot, such as from block devices or across filesystems, the extent is read and written
+    // in chunks. A failed or cancelled copy removes the destination and sets `error`.
+    static bool copyExtent(const QString& sourcePath, quint64 offset, quint64 size,
+                           const QString& destinationPath, const ProgressCallback& progress,
+                           QString* error);
+};
+
+}  // namespace breco
@@ -1,8 +1,14 @@
 #include "model/ResultModel.h"
 
+#include "scan/MatchUtils.h"
+
 namespace breco {
 
 namespace {
+// Longer terms (loaded needles) show their first bytes in hex and their size.
+constexpr int kMaxTermLabelBytes = 64;
+constexpr int kLongTermPrefixBytes = 16;
+
 QString formatApproxOffset(quint64 bytes) {
     static const char* kUnits[] = {"B", "KiB", "MiB", "GiB", "TiB", "PiB"};
     long double scaled = static_cast<long double>(bytes);
@@ -40,7 +46,7 @@ int ResultModel::columnCount(const QModelIndex& parent) const {
     if (parent.isValid()) {
         return 0;
     }
-    return 4;
+    return 5;
 }
 
 QVariant ResultModel::data(const QModelIndex& index, int role) const {
@@ -48,7 +54,7 @@ QVariant ResultModel::data(const QModelIndex& index, int role) const {
         return {};
     }
 
-    const MatchRecord& match = m_matches.at(index.row());
+    const MatchRecord match = m_matches.at(index.row());
     if (role == Qt::DisplayRole) {
         switch (index.column()) {
             case 0:
@@ -56,26 +62,55 @@ QVariant ResultModel::data(const QModelIndex& index, int role) const {
             case 1:
                 return filePathForMatch(match);
             case 2:
+                if (match.bitOffset != 0) {
+                    return QStringLiteral("%1 +%2 bit")
+                        .arg(formatApproxOffset(match.offset))
+                        .arg(match.bitOffset);
+                }
                 return formatApproxOffset(match.offset);
             case 3:
                 return formatSearchTimeMs(match.searchTimeNs);
+            case 4:
+                return termForMatch(match);
             default:
                 return {};
         }
     }
 
     if (role == Qt::TextAlignmentRole) {
-        return (index.column() == 1) ? QVariant(Qt::AlignLeft | Qt::AlignVCenter)
+        return (index.column() == 1 || index.column() == 4) ? QVariant(Qt::AlignLeft | Qt::AlignVCenter)
                                      : QVariant(Qt::AlignRight | Qt::AlignVCenter);
     }
 
     if (role == Qt::ToolTipRole) {
         if (index.column() == 2) {
+            if (match.bitOffset != 0) {
+                return QStringLiteral("%1 B +%2 bit")
+                    .arg(QString::number(match.offset))
+                    .arg(match.bitOffset);
+            }
             return QStringLiteral("%1 B").arg(QString::number(match.offset));
         }
         if (index.column() == 3) {
             return QStringLiteral("%1 ns").arg(QString::number(match.searchTimeNs));
         }
+        if (index.column() == 4) {
+            if (const QString* label = termLabelForMatch(match)) {
+                return QStringLiteral("Carved %1 file, %2 B")
+                    .arg(*label, QString::number(match.matchLength));
+            }
+            if (match.matchCount > 0) {
+                return QStringLiteral("Term #%1 first; %2 match(es) of any term in the file")
+                    .arg(match.termIdx + 1)
+                    .arg(match.matchCount);
+            }
+            if (match.distance > 0) {
+                return QStringLiteral("Term #%1, %2 error(s)")
+                    .arg(match.termIdx + 1)
+                    .arg(match.distance);
+            }
+            return QStringLiteral("Term #%1").arg(match.termIdx + 1);
+        }
     }
 
     return {};
@@ -95,6 +130,8 @@ QVariant ResultModel::headerData(int section, Qt::Orientation orientation, int r
             return QStringLiteral("Offset");
         case 3:
             return QStringLiteral("Search time");
+        case 4:
+            return QStringLiteral("Term");
         default:
             return {};
     }
@@ -107,7 +144,28 @@ void ResultModel::setScanTargets(const QVector<ScanTarget>* scanTargets) {
     }
 }
 
-void ResultModel::appendBatch(const QVector<MatchRecord>& matches) {
+void ResultModel::setSearchTerms(const QVector<QByteArray>* searchTerms) {
+    m_searchTerms = searchTerms;
+    if (rowCount() > 0) {
+        emit dataChanged(index(0, 4), index(rowCount() - 1, 4));
+    }
+}
+
+void ResultModel::setTermMasks(const QVector<QByteArray>* termMasks) {
+    m_termMasks = termMasks;
+    if (rowCount() > 0) {
+        emit dataChanged(index(0, 4), index(rowCount() - 1, 4));
+    }
+}
+
+void ResultModel::setTermLabels(const QVector<QString>* termLabels) {
+    m_termLabels = termLabels;
+    if (rowCount() > 0) {
+        emit dataChanged(index(0, 4), index(rowCount() - 1, 4));
+    }
+}
+
+void ResultModel::appendBatch(const MatchStore& matches) {
     if (matches.isEmpty()) {
         return;
     }
@@ -115,26 +173,34 @@ void ResultModel::appendBatch(const QVector<MatchRecord>& matches) {
     const int start = m_matches.size();
     const int end = start + matches.size() - 1;
     beginInsertRows(QModelIndex(), start, end);
-    for (const MatchRecord& match : matches) {
-        m_matches.push_back(match);
+    if (m_matches.isEmpty()) {
+        m_matches = matches;
+    } else {
+        m_matches.appendStore(matches);
     }
     endInsertRows();
 }
 
+void ResultModel::appendBatch(const QVector<MatchRecord>& matches) {
+    MatchStore store;
+    store.appendRecords(matches);
+    appendBatch(store);
+}
+
 void ResultModel::clear() {
     beginResetModel();
     m_matches.clear();
     endResetModel();
 }
 
-const MatchRecord* ResultModel::matchAt(int row) const {
+std::optional<MatchRecord> ResultModel::matchAt(int row) const {
     if (row < 0 || row >= m_matches.size()) {
-        return nullptr;
+        return std::nullopt;
     }
-    return &m_matches.at(row);
+    return m_matches.at(row);
 }
 
-const QVector<MatchRecord>& ResultModel::allMatches() const { return m_matches; }
+const MatchStore& ResultModel::allMatches() const { return m_matches; }
 
 QString ResultModel::filePathForRow(int row) const {
     if (row < 0 || row >= m_matches.size()) {
@@ -151,4 +217,54 @@ QString ResultModel::filePathForMatch(const MatchRecord& match) const {
     return m_scanTargets->at(match.scanTargetIdx).filePath;
 }
 
+QString ResultModel::termForMatch(const MatchRecord& match) const {
+    if (const QString* label = termLabelForMatch(match)) {
+        return QStringLiteral("%1 (%2)").arg(*label, formatApproxOffset(match.matchLength));
+    }
+    if (m_searchTerms == nullptr || match.termIdx < 0 || match.termIdx >= m_searchTerms->size()) {
+        return QStringLiteral("-");
+    }
+    QString term;
+    const QByteArray& termBytes = m_searchTerms->at(match.termIdx);
+    const QByteArray termMask = m_termMasks != nullptr ? m_termMasks->value(match.termIdx)
+                                                       : QByteArray();
+    if (termBytes.size() > kMaxTermLabelBytes) {
+        term = QStringLiteral("%1 … (%2 B)")
+                   .arg(MatchUtils::formatHexPattern(termBytes.left(kLongTermPrefixBytes),
+                                                     termMask.left(kLongTermPrefixBytes)))
+                   .arg(termBytes.size());
+    } else if (m_termMasks != nullptr && match.termIdx < m_termMasks->size()) {
+        term = MatchUtils::formatHexPattern(termBytes, termMask);
+    } else {
+        term = QString::fromUtf8(termBytes);
+    }
+    if (match.encoding != TermEncoding::Utf8) {
+        term = QStringLiteral("%1 (%2)").arg(term, MatchUtils::encodingName(match.encoding));
+    }
+    if (match.numericFormat != NumericFormat::None) {
+        term = QStringLiteral("%1 (%2)").arg(term,
+                                             MatchUtils::numericFormatName(match.numericFormat));
+    }
+    if (match.xorKey >= 0) {
+        const QString key = QStringLiteral("%1").arg(match.xorKey, 2, 16, QChar('0')).toUpper();
+        term = QStringLiteral("%1 (XOR 0x%2)").arg(term, key);
+    }
+    if (match.distance > 0) {
+        term = QStringLiteral("%1 ~%2").arg(term).arg(match.distance);
+    }
+    if (match.matchCount > 0) {
+        term = QStringLiteral("%1 (%2 in file)").arg(term).arg(match.matchCount);
+    }
+    return term;
+}
+
+// Rows without a length (the single-file preview row) keep showing the term.
+const QString* ResultModel::termLabelForMatch(const MatchRecord& match) const {
+    if (m_termLabels == nullptr || match.matchLength == 0 || match.termIdx < 0 ||
+        match.termIdx >= m_termLabels->size()) {
+        return nullptr;
+    }
+    return &m_termLabels->at(match.termIdx);
+}
+
 }  // namespace breco
@@ -2,8 +2,10 @@
 
 #include <QAbstractTableModel>
 #include <QVector>
+#include <optional>
 
 #include "model/ResultTypes.h"
+#include "scan/MatchStore.h"
 
 namespace breco {
 
@@ -19,17 +21,31 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
 
     void setScanTargets(const QVector<ScanTarget>* scanTargets);
+    void setSearchTerms(const QVector<QByteArray>* searchTerms);
+    // Hex pattern masks parallel to the search terms; terms with a mask are shown as hex.
+    void setTermMasks(const QVector<QByteArray>* termMasks);
+    // Names shown instead of the term bytes (carving scans: signature names), each with the
+    // match's length as the size of the carved file; an empty list shows the terms.
+    void setTermLabels(const QVector<QString>* termLabels);
+    // Rows are rebuilt from the store when shown; a batch appended to an empty model shares the
+    // scan's store instead of copying it.
+    void appendBatch(const MatchStore& matches);
     void appendBatch(const QVector<MatchRecord>& matches);
     void clear();
-    const MatchRecord* matchAt(int row) const;
-    const QVector<MatchRecord>& allMatches() const;
+    std::optional<MatchRecord> matchAt(int row) const;
+    const MatchStore& allMatches() const;
     QString filePathForRow(int row) const;
 
 private:
     QString filePathForMatch(const MatchRecord& match) const;
+    QString termForMatch(const MatchRecord& match) const;
+    const QString* termLabelForMatch(const MatchRecord& match) const;
 
-    QVector<MatchRecord> m_matches;
+    MatchStore m_matches;
     const QVector<ScanTarget>* m_scanTargets = nullptr;
+    const QVector<QByteArray>* m_searchTerms = nullptr;
+    const QVector<QByteArray>* m_termMasks = nullptr;
+    const QVector<QString>* m_termLabels = nullptr;
 };
 
 }  // namespace breco
@@ -12,6 +12,43 @@ enum class TextInterpretationMode {
     Utf16
 };
 
+// Byte encoding a text term was matched in (encoding-variant and encoded-form scans). The Base64
+// forms are the term starting 0, 1 or 2 bytes into a 3-byte group, cut down to the characters
+// that depend on term bytes only; the other encoded forms apply to the term's UTF-8 bytes.
+enum class TermEncoding {
+    Utf8 = 0,
+    Utf16Le,
+    Utf16Be,
+    Base64,
+    Base64Shift1,
+    Base64Shift2,
+    HexLower,
+    HexUpper,
+    Percent
+};
+
+// Binary form a numeric term was matched in (numeric scans): unsigned or signed integer, or IEEE
+// float, of 16, 32 or 64 bits, little- or big-endian.
+enum class NumericFormat {
+    None = 0,
+    U16Le,
+    U16Be,
+    S16Le,
+    S16Be,
+    U32Le,
+    U32Be,
+    S32Le,
+    S32Be,
+    U64Le,
+    U64Be,
+    S64Le,
+    S64Be,
+    F32Le,
+    F32Be,
+    F64Le,
+    F64Be
+};
+
 enum class BitmapMode {
     Rgb24 = 0,
     Grey8,
@@ -41,6 +78,21 @@ struct MatchRecord {
     int threadId = 0;
     quint64 offset = 0;
     quint64 searchTimeNs = 0;
+    int termIdx = 0;
+    // Bits into the byte at `offset` where the match starts (Shift = Bits +bitOffset shows it).
+    int bitOffset = 0;
+    // Bytes covered by a regex or approximate match; 0 means the length of term `termIdx` in
+    // `encoding`.
+    quint64 matchLength = 0;
+    TermEncoding encoding = TermEncoding::Utf8;
+    // Errors (substitutions, or edits for edit distance) in an approximate match.
+    int distance = 0;
+    // Key the data is XORed with for an XOR-key match (0..255); -1 for other scans.
+    int xorKey = -1;
+    // Binary form of a numeric match; None for other scans.
+    NumericFormat numericFormat = NumericFormat::None;
+    // Count scans: matches in the whole target, this record being the first. 0 for other scans.
+    quint64 matchCount = 0;
 };
 
 struct ResultBuffer {
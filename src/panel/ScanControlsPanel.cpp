@@ -18,18 +18,60 @@ ScanControlsPanel::ScanControlsPanel(QWidget* parent)
          QStringLiteral("DejaVu Sans"), QStringLiteral("Arial Unicode MS")});
     m_ui->openFileButton->setFont(sourceButtonFont);
     m_ui->openDirButton->setFont(sourceButtonFont);
+    m_ui->loadTermsButton->setFont(sourceButtonFont);
+    m_ui->loadNeedleButton->setFont(sourceButtonFont);
 }
 
 ScanControlsPanel::~ScanControlsPanel() = default;
 
 QLineEdit* ScanControlsPanel::searchTermLineEdit() const { return m_ui->searchTermLineEdit; }
 
+QToolButton* ScanControlsPanel::loadTermsButton() const { return m_ui->loadTermsButton; }
+
+QToolButton* ScanControlsPanel::loadNeedleButton() const { return m_ui->loadNeedleButton; }
+
+QLineEdit* ScanControlsPanel::nearTermLineEdit() const { return m_ui->nearTermLineEdit; }
+
+QSpinBox* ScanControlsPanel::nearDistanceSpin() const { return m_ui->nearDistanceSpin; }
+
 QCheckBox* ScanControlsPanel::ignoreCaseCheckBox() const { return m_ui->ignoreCaseCheckBox; }
 
+QCheckBox* ScanControlsPanel::hexPatternCheckBox() const { return m_ui->hexPatternCheckBox; }
+
+QCheckBox* ScanControlsPanel::bitPhasesCheckBox() const { return m_ui->bitPhasesCheckBox; }
+
+QCheckBox* ScanControlsPanel::regexCheckBox() const { return m_ui->regexCheckBox; }
+
+QCheckBox* ScanControlsPanel::utf16VariantsCheckBox() const { return m_ui->utf16VariantsCheckBox; }
+
+QCheckBox* ScanControlsPanel::encodedFormsCheckBox() const {
+    return m_ui->encodedFormsCheckBox;
+}
+
+QCheckBox* ScanControlsPanel::numericCheckBox() const { return m_ui->numericCheckBox; }
+
+QDoubleSpinBox* ScanControlsPanel::toleranceSpin() const { return m_ui->toleranceSpin; }
+
+QCheckBox* ScanControlsPanel::xorKeysCheckBox() const { return m_ui->xorKeysCheckBox; }
+
+QComboBox* ScanControlsPanel::approximateCombo() const { return m_ui->approximateCombo; }
+
+QSpinBox* ScanControlsPanel::maxDistanceSpin() const { return m_ui->maxDistanceSpin; }
+
+QCheckBox* ScanControlsPanel::carveCheckBox() const { return m_ui->carveCheckBox; }
+
+QComboBox* ScanControlsPanel::reportModeCombo() const { return m_ui->reportModeCombo; }
+
 QCheckBox* ScanControlsPanel::prefillOnMergeCheckBox() const {
     return m_ui->prefillOnMergeCheckBox;
 }
 
+QCheckBox* ScanControlsPanel::entropyMapCheckBox() const { return m_ui->entropyMapCheckBox; }
+
+QCheckBox* ScanControlsPanel::entropySkipCheckBox() const { return m_ui->entropySkipCheckBox; }
+
+QDoubleSpinBox* ScanControlsPanel::entropySkipSpin() const { return m_ui->entropySkipSpin; }
+
 QSpinBox* ScanControlsPanel::shiftValueSpin() const {
     return findChild<QSpinBox*>(QStringLiteral("shiftValueSpin"));
 }
@@ -50,8 +92,14 @@ QSpinBox* ScanControlsPanel::blockSizeSpin() const { return m_ui->blockSizeSpin;
 
 QComboBox* ScanControlsPanel::blockSizeUnitCombo() const { return m_ui->blockSizeUnitCombo; }
 
+QComboBox* ScanControlsPanel::alignmentCombo() const { return m_ui->alignmentCombo; }
+
 QComboBox* ScanControlsPanel::workerCountCombo() const { return m_ui->workerCountCombo; }
 
+QSpinBox* ScanControlsPanel::matchLimitSpin() const { return m_ui->matchLimitSpin; }
+
+QSpinBox* ScanControlsPanel::matchMemorySpin() const { return m_ui->matchMemorySpin; }
+
 QLabel* ScanControlsPanel::filesCountValueLabel() const { return m_ui->filesCountValueLabel; }
 
 QLabel* ScanControlsPanel::searchSpaceValueLabel() const { return m_ui->searchSpaceValueLabel; }
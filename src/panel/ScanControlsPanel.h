@@ -8,6 +8,7 @@
 QT_BEGIN_NAMESPACE
 class QCheckBox;
 class QComboBox;
+class QDoubleSpinBox;
 class QLabel;
 class QLineEdit;
 class QProgressBar;
@@ -30,8 +31,27 @@ public:
     ~ScanControlsPanel() override;
 
     QLineEdit* searchTermLineEdit() const;
+    QToolButton* loadTermsButton() const;
+    QToolButton* loadNeedleButton() const;
+    QLineEdit* nearTermLineEdit() const;
+    QSpinBox* nearDistanceSpin() const;
     QCheckBox* ignoreCaseCheckBox() const;
+    QCheckBox* hexPatternCheckBox() const;
+    QCheckBox* bitPhasesCheckBox() const;
+    QCheckBox* regexCheckBox() const;
+    QCheckBox* utf16VariantsCheckBox() const;
+    QCheckBox* encodedFormsCheckBox() const;
+    QCheckBox* numericCheckBox() const;
+    QDoubleSpinBox* toleranceSpin() const;
+    QCheckBox* xorKeysCheckBox() const;
+    QComboBox* approximateCombo() const;
+    QSpinBox* maxDistanceSpin() const;
+    QCheckBox* carveCheckBox() const;
+    QComboBox* reportModeCombo() const;
     QCheckBox* prefillOnMergeCheckBox() const;
+    QCheckBox* entropyMapCheckBox() const;
+    QCheckBox* entropySkipCheckBox() const;
+    QDoubleSpinBox* entropySkipSpin() const;
     QSpinBox* shiftValueSpin() const;
     QComboBox* shiftUnitCombo() const;
     QPushButton* startScanButton() const;
@@ -40,7 +60,10 @@ public:
     QLabel* blockSizeLabel() const;
     QSpinBox* blockSizeSpin() const;
     QComboBox* blockSizeUnitCombo() const;
+    QComboBox* alignmentCombo() const;
     QComboBox* workerCountCombo() const;
+    QSpinBox* matchLimitSpin() const;
+    QSpinBox* matchMemorySpin() const;
     QLabel* filesCountValueLabel() const;
     QLabel* searchSpaceValueLabel() const;
     QLabel* scannedValueLabel() const;
@@ -0,0 +1,239 @@
+#include "scan/ApproximateSearch.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "scan/ByteSearch.h"
+
+namespace breco {
+
+ApproximateSearch::ApproximateSearch(const QVector<QByteArray>& patterns,
+                                     const QVector<QByteArray>& masks, bool foldCase,
+                                     ApproximateMetric metric, int maxDistance)
+    : m_metric(metric), m_maxDistance(qBound(0, maxDistance, kMaxDistance)) {
+    m_patterns.resize(static_cast<size_t>(patterns.size()));
+    for (int patternIdx = 0; patternIdx < patterns.size(); ++patternIdx) {
+        const QByteArray& bytes = patterns.at(patternIdx);
+        const QByteArray mask = masks.value(patternIdx);
+        Pattern& pattern = m_patterns[static_cast<size_t>(patternIdx)];
+        pattern.size = qMin(static_cast<int>(bytes.size()), kMaxPatternSize);
+        m_maxPatternSize = qMax(m_maxPatternSize, pattern.size);
+        for (int i = 0; i < pattern.size; ++i) {
+            const auto expected = static_cast<unsigned char>(bytes.at(i));
+            const auto byteMask =
+                static_cast<unsigned char>(i < mask.size() ? mask.at(i) : static_cast<char>(0xFF));
+            for (int value = 0; value < 256; ++value) {
+                const auto byte = static_cast<unsigned char>(value);
+                const bool matches =
+                    byteMask != 0xFF ? (byte & byteMask) == (expected & byteMask)
+                    : foldCase ? ByteSearch::asciiLower(byte) == ByteSearch::asciiLower(expected)
+                               : byte == expected;
+                if (matches) {
+                    pattern.matchBits[value] |= quint64{1} << i;
+                    pattern.reversedBits[value] |= quint64{1} << (pattern.size - 1 - i);
+                }
+            }
+        }
+    }
+}
+
+const char* ApproximateSearch::metricName(ApproximateMetric metric) {
+    switch (metric) {
+        case ApproximateMetric::Hamming:
+            return "hamming";
+        case ApproximateMetric::Edit:
+            return "edit";
+        case ApproximateMetric::None:
+        default:
+            return "off";
+    }
+}
+
+ApproximateMetric ApproximateSearch::metric() const { return m_metric; }
+
+int ApproximateSearch::maxDistance() const { return m_maxDistance; }
+
+int ApproximateSearch::maxMatchSpan() const {
+    return m_metric == ApproximateMetric::Edit ? m_maxPatternSize + m_maxDistance
+                                               : m_maxPatternSize;
+}
+
+void ApproximateSearch::findAll(const char* haystack, int haystackSize, int startLimit,
+                                QVector<ApproximateHit>* hits) const {
+    hits->clear();
+    if (haystack == nullptr || haystackSize <= 0) {
+        return;
+    }
+    const int limit = qMin(startLimit, haystackSize);
+    const auto* bytes = reinterpret_cast<const unsigned char*>(haystack);
+    for (int patternIdx = 0; patternIdx < static_cast<int>(m_patterns.size()); ++patternIdx) {
+        const Pattern& pattern = m_patterns[static_cast<size_t>(patternIdx)];
+        if (pattern.size == 0) {
+            continue;
+        }
+        if (m_metric == ApproximateMetric::Edit) {
+            editFindAll(pattern, patternIdx, bytes, haystackSize, limit, hits);
+        } else {
+            hammingFindAll(pattern, patternIdx, bytes, haystackSize, limit, hits);
+        }
+    }
+    if (m_patterns.size() > 1) {
+        std::sort(hits->begin(), hits->end(), [](const ApproximateHit& a, const ApproximateHit& b) {
+            return a.offset != b.offset ? a.offset < b.offset : a.patternIdx < b.patternIdx;
+        });
+    }
+}
+
+namespace {
+// Shift-Or with errors: bit i of state[j] is 0 while pattern[0..i] ends at the current byte with
+// at most j substitutions. A substitution moves a prefix from level j-1 one byte on regardless
+// of the byte. Level kErrors accepts everything a lower level accepts. The error count is a
+// template argument so the state words stay in registers.
+template <int kErrors>
+void shiftOrFindAll(const std::array<quint64, 256>& matchBits, int m, int patternIdx,
+                    const unsigned char* haystack, int end, QVector<ApproximateHit>* hits) {
+    const quint64 lastBit = quint64{1} << (m - 1);
+    std::array<quint64, kErrors + 1> state;
+    state.fill(~quint64{0});
+    for (int pos = 0; pos < end; ++pos) {
+        const quint64 mismatch = ~matchBits[haystack[pos]];
+        quint64 previous = state[0];
+        state[0] = (state[0] << 1) | mismatch;
+        for (int j = 1; j <= kErrors; ++j) {
+            const quint64 current = state[j];
+            state[j] = ((current << 1) | mismatch) & (previous << 1);
+            previous = current;
+        }
+        if ((state[kErrors] & lastBit) != 0 || pos < m - 1) {
+            continue;
+        }
+        int distance = 0;
+        while ((state[distance] & lastBit) != 0) {
+            ++distance;
+        }
+        hits->push_back(ApproximateHit{pos - m + 1, patternIdx, distance, m});
+    }
+}
+
+template <int... kErrors>
+void shiftOrDispatch(int errors, const std::array<quint64, 256>& matchBits, int m,
+                     int patternIdx, const unsigned char* haystack, int end,
+                     QVector<ApproximateHit>* hits, std::integer_sequence<int, kErrors...>) {
+    ((errors == kErrors ? shiftOrFindAll<kErrors>(matchBits, m, patternIdx, haystack, end, hits)
+                        : void()),
+     ...);
+}
+}  // namespace
+
+void ApproximateSearch::hammingFindAll(const Pattern& pattern, int patternIdx,
+                                       const unsigned char* haystack, int haystackSize,
+                                       int startLimit, QVector<ApproximateHit>* hits) const {
+    const int end = qMin(haystackSize, startLimit + pattern.size - 1);
+    shiftOrDispatch(m_maxDistance, pattern.matchBits, pattern.size, patternIdx, haystack, end,
+                    hits, std::make_integer_sequence<int, kMaxDistance + 1>());
+}
+
+// Myers' bit-vector edit distance over the reversed pattern and the haystack read backwards:
+// after byte `pos`, `score` is the smallest edit distance between the pattern and any byte run
+// starting at `pos`. Runs longer than m + maxDistance cannot score within range, so the pass
+// starts that far past the last reportable start.
+void ApproximateSearch::editFindAll(const Pattern& pattern, int patternIdx,
+                                    const unsigned char* haystack, int haystackSize,
+                                    int startLimit, QVector<ApproximateHit>* hits) const {
+    const int m = pattern.size;
+    const quint64 lastBit = quint64{1} << (m - 1);
+    const int end = qMin(haystackSize, startLimit - 1 + m + m_maxDistance);
+    quint64 positive = ~quint64{0};
+    quint64 negative = 0;
+    int score = m;
+    const int firstHit = hits->size();
+    for (int pos = end - 1; pos >= 0; --pos) {
+        const quint64 eq = pattern.reversedBits[haystack[pos]];
+        const quint64 xv = eq | negative;
+        const quint64 xh = (((eq & positive) + positive) ^ positive) | eq;
+        quint64 ph = negative | ~(xh | positive);
+        quint64 mh = positive & xh;
+        // Branch-free: on random data the score moves up and down unpredictably.
+        score += static_cast<int>((ph & lastBit) != 0) - static_cast<int>((mh & lastBit) != 0);
+        ph <<= 1;
+        mh <<= 1;
+        positive = mh | ~(xv | ph);
+        negative = ph & xv;
+        if (score <= m_maxDistance && pos < startLimit) {
+            hits->push_back(ApproximateHit{pos, patternIdx, score, 0});
+        }
+    }
+    std::reverse(hits->begin() + firstHit, hits->end());
+    for (int i = firstHit; i < hits->size(); ++i) {
+        ApproximateHit& hit = (*hits)[i];
+        hit.length = editMatchLength(pattern, haystack, haystackSize, hit.offset, hit.distance);
+    }
+}
+
+// Plain dynamic programming from one start; only runs for reported matches.
+int ApproximateSearch::editMatchLength(const Pattern& pattern, const unsigned char* haystack,
+                                       int haystackSize, int start, int distance) const {
+    const int m = pattern.size;
+    const int maxLength = qMin(m + m_maxDistance, haystackSize - start);
+    std::array<int, kMaxPatternSize + 1> column;
+    for (int i = 0; i <= m; ++i) {
+        column[i] = i;
+    }
+    for (int length = 1; length <= maxLength; ++length) {
+        const quint64 matchBits = pattern.matchBits[haystack[start + length - 1]];
+        int diagonal = column[0];
+        column[0] = length;
+        for (int i = 1; i <= m; ++i) {
+            const int above = column[i];
+            const int cost = ((matchBits >> (i - 1)) & 1U) != 0 ? 0 : 1;
+            column[i] = std::min({diagonal + cost, above + 1, column[i - 1] + 1});
+            diagonal = above;
+        }
+        if (column[m] <= distance) {
+            return length;
+        }
+    }
+    return maxLength;
+}
+
+void ApproximateSearch::dropShadowedMatches(int maxDistance, QVector<MatchRecord>* matches) {
+    const int count = matches->size();
+    QVector<bool> shadowed(count, false);
+    auto shadows = [maxDistance](const MatchRecord& other, const MatchRecord& match) {
+        return other.scanTargetIdx == match.scanTargetIdx && other.termIdx == match.termIdx &&
+               other.encoding == match.encoding &&
+               (other.offset > match.offset ? other.offset - match.offset
+                                            : match.offset - other.offset) <=
+                   static_cast<quint64>(maxDistance) &&
+               (other.distance < match.distance ||
+                (other.distance == match.distance && other.offset < match.offset));
+    };
+    for (int i = 0; i < count; ++i) {
+        const MatchRecord& match = matches->at(i);
+        for (int j = i - 1; j >= 0 && !shadowed[i]; --j) {
+            const MatchRecord& other = matches->at(j);
+            if (other.scanTargetIdx != match.scanTargetIdx ||
+                match.offset - other.offset > static_cast<quint64>(maxDistance)) {
+                break;
+            }
+            shadowed[i] = shadows(other, match);
+        }
+        for (int j = i + 1; j < count && !shadowed[i]; ++j) {
+            const MatchRecord& other = matches->at(j);
+            if (other.scanTargetIdx != match.scanTargetIdx ||
+                other.offset - match.offset > static_cast<quint64>(maxDistance)) {
+                break;
+            }
+            shadowed[i] = shadows(other, match);
+        }
+    }
+    int kept = 0;
+    for (int i = 0; i < count; ++i) {
+        if (!shadowed[i]) {
+            (*matches)[kept++] = matches->at(i);
+        }
+    }
+    matches->resize(kept);
+}
+
+}  // namespace breco
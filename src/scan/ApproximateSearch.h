@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+#include <array>
+#include <vector>
+
+#include "model/ResultTypes.h"
+
+namespace breco {
+
+enum class ApproximateMetric {
+    None = 0,
+    Hamming,
+    Edit
+};
+
+struct ApproximateHit {
+    int offset = 0;
+    int patternIdx = 0;
+    int distance = 0;
+    int length = 0;
+};
+
+// Finds every start where a pattern matches with at most `maxDistance` errors in one bit-parallel
+// pass per pattern; a pattern fits one 64-bit state word. Hamming distance counts substituted
+// bytes and runs Shift-Or with one state word per error count. Edit distance also counts inserted
+// and deleted bytes and runs Myers' algorithm backwards over the haystack, so the score at each
+// position is the best distance of a match starting there. Either way a start depends only on the
+// bytes after it, and scan jobs need no more than their usual overlap.
+class ApproximateSearch {
+public:
+    static constexpr int kMaxPatternSize = 64;
+    static constexpr int kMaxDistance = 8;
+
+    // `masks` work as for hex patterns (empty, or one per pattern); `foldCase` folds ASCII letters.
+    ApproximateSearch(const QVector<QByteArray>& patterns, const QVector<QByteArray>& masks,
+                      bool foldCase, ApproximateMetric metric, int maxDistance);
+
+    static const char* metricName(ApproximateMetric metric);
+
+    ApproximateMetric metric() const;
+    int maxDistance() const;
+    // Longest byte span of a match: the longest pattern, plus maxDistance for edit distance.
+    int maxMatchSpan() const;
+
+    // Replaces `hits` with every (start, pattern) before `startLimit` whose best match has at most
+    // maxDistance errors, ordered by offset and then by pattern index. `length` is the pattern size
+    // for Hamming distance and the shortest match with the best distance for edit distance.
+    void findAll(const char* haystack, int haystackSize, int startLimit,
+                 QVector<ApproximateHit>* hits) const;
+
+    // An edit-distance occurrence usually also matches, with more edits, at the starts around it.
+    // Drops every match that has a match of the same term and encoding starting at most
+    // `maxDistance` bytes away with fewer errors, or with as many errors and an earlier start.
+    // `matches` must be ordered by target and offset.
+    static void dropShadowedMatches(int maxDistance, QVector<MatchRecord>* matches);
+
+private:
+    struct Pattern {
+        int size = 0;
+        // Bit i of matchBits[b]: byte b matches pattern byte i; reversedBits uses bit size-1-i.
+        std::array<quint64, 256> matchBits{};
+        std::array<quint64, 256> reversedBits{};
+    };
+
+    void hammingFindAll(const Pattern& pattern, int patternIdx, const unsigned char* haystack,
+                        int haystackSize, int startLimit, QVector<ApproximateHit>* hits) const;
+    void editFindAll(const Pattern& pattern, int patternIdx, const unsigned char* haystack,
+                     int haystackSize, int startLimit, QVector<ApproximateHit>* hits) const;
+    int editMatchLength(const Pattern& pattern, const unsigned char* haystack, int haystackSize,
+                        int start, int distance) const;
+
+    std::vector<Pattern> m_patterns;
+    ApproximateMetric m_metric = ApproximateMetric::Hamming;
+    int m_maxDistance = 0;
+    int m_maxPatternSize = 0;
+};
+
+}  // namespace breco
@@ -0,0 +1,1011 @@
+#include "scan/ByteRegex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <utility>
+
+namespace breco {
+
+namespace {
+
+constexpr int kMaxRepeat = 1000;
+constexpr int kMaxNfaStates = 200000;
+
+struct Node {
+    enum class Kind {
+        ByteSet = 0,
+        Concat,
+        Alternation,
+        Repeat
+    };
+
+    Kind kind = Kind::Concat;
+    int byteSet = -1;
+    std::vector<int> children;
+    int min = 0;
+    int max = -1;
+};
+
+bool isAsciiLetter(unsigned char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+
+bool isAsciiAlnum(unsigned char c) { return isAsciiLetter(c) || (c >= '0' && c <= '9'); }
+
+void foldSet(std::bitset<256>* set) {
+    for (int c = 'a'; c <= 'z'; ++c) {
+        const int upper = c - ('a' - 'A');
+        if ((*set)[c] || (*set)[upper]) {
+            set->set(c);
+            set->set(upper);
+        }
+    }
+}
+
+std::bitset<256> rangeSet(int first, int last) {
+    std::bitset<256> set;
+    for (int c = first; c <= last; ++c) {
+        set.set(c);
+    }
+    return set;
+}
+
+std::bitset<256> digitSet() { return rangeSet('0', '9'); }
+
+std::bitset<256> wordSet() {
+    return rangeSet('0', '9') | rangeSet('A', 'Z') | rangeSet('a', 'z') | rangeSet('_', '_');
+}
+
+std::bitset<256> spaceSet() {
+    std::bitset<256> set;
+    for (const char c : {' ', '\t', '\n', '\r', '\f', '\v'}) {
+        set.set(static_cast<unsigned char>(c));
+    }
+    return set;
+}
+
+int hexDigitValue(unsigned char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Recursive-descent parser producing a small AST; counted repetition is expanded when the AST is
+// turned into NFA states.
+class Parser {
+public:
+    Parser(const QByteArray& pattern, bool foldCase, std::vector<std::bitset<256>>* byteSets,
+           std::vector<Node>* nodes)
+        : m_pattern(pattern), m_foldCase(foldCase), m_byteSets(byteSets), m_nodes(nodes) {}
+
+    int parse(QString* error) {
+        const int root = parseAlternation();
+        if (root >= 0 && !atEnd()) {
+            fail(QStringLiteral("unmatched ')'"));
+        }
+        if (!m_error.isEmpty()) {
+            *error = m_error;
+            return -1;
+        }
+        return root;
+    }
+
+private:
+    bool atEnd() const { return m_pos >= m_pattern.size(); }
+
+    unsigned char peek() const { return static_cast<unsigned char>(m_pattern.at(m_pos)); }
+
+    unsigned char take() { return static_cast<unsigned char>(m_pattern.at(m_pos++)); }
+
+    int fail(const QString& message) {
+        if (m_error.isEmpty()) {
+            m_error = QStringLiteral("%1 at position %2").arg(message).arg(m_pos);
+        }
+        return -1;
+    }
+
+    int addNode(Node node) {
+        m_nodes->push_back(std::move(node));
+        return static_cast<int>(m_nodes->size()) - 1;
+    }
+
+    int addSet(std::bitset<256> set) {
+        if (m_foldCase) {
+            foldSet(&set);
+        }
+        m_byteSets->push_back(set);
+        Node node;
+        node.kind = Node::Kind::ByteSet;
+        node.byteSet = static_cast<int>(m_byteSets->size()) - 1;
+        return addNode(std::move(node));
+    }
+
+    int parseAlternation() {
+        Node node;
+        node.kind = Node::Kind::Alternation;
+        for (;;) {
+            const int branch = parseConcat();
+            if (branch < 0) {
+                return -1;
+            }
+            node.children.push_back(branch);
+            if (atEnd() || peek() != '|') {
+                break;
+            }
+            take();
+        }
+        if (node.children.size() == 1) {
+            return node.children.front();
+        }
+        return addNode(std::move(node));
+    }
+
+    int parseConcat() {
+        Node node;
+        node.kind = Node::Kind::Concat;
+        while (!atEnd() && peek() != '|' && peek() != ')') {
+            const int item = parseRepeat();
+            if (item < 0) {
+                return -1;
+            }
+            node.children.push_back(item);
+        }
+        if (node.children.size() == 1) {
+            return node.children.front();
+        }
+        return addNode(std::move(node));
+    }
+
+    int parseRepeat() {
+        const unsigned char lead = peek();
+        if (lead == '*' || lead == '+' || lead == '?' || lead == '{') {
+            return fail(QStringLiteral("nothing to repeat"));
+        }
+        int item = parseAtom();
+        while (item >= 0 && !atEnd()) {
+            int min = 0;
+            int max = -1;
+            const unsigned char c = peek();
+            if (c == '*') {
+                take();
+            } else if (c == '+') {
+                take();
+                min = 1;
+            } else if (c == '?') {
+                take();
+                max = 1;
+            } else if (c == '{') {
+                take();
+                if (!parseCounts(&min, &max)) {
+                    return -1;
+                }
+            } else {
+                break;
+            }
+            // Matches are always the shortest, so a lazy "?" suffix changes nothing.
+            if (!atEnd() && peek() == '?') {
+                take();
+            }
+            Node node;
+            node.kind = Node::Kind::Repeat;
+            node.children.push_back(item);
+            node.min = min;
+            node.max = max;
+            item = addNode(std::move(node));
+        }
+        return item;
+    }
+
+    bool parseNumber(int* value) {
+        if (atEnd() || peek() < '0' || peek() > '9') {
+            return false;
+        }
+        int number = 0;
+        while (!atEnd() && peek() >= '0' && peek() <= '9') {
+            number = number * 10 + (take() - '0');
+            if (number > kMaxRepeat) {
+                return false;
+            }
+        }
+        *value = number;
+        return true;
+    }
+
+    bool parseCounts(int* min, int* max) {
+        if (!parseNumber(min)) {
+            fail(QStringLiteral("invalid repetition count (0..%1)").arg(kMaxRepeat));
+            return false;
+        }
+        *max = *min;
+        if (!atEnd() && peek() == ',') {
+            take();
+            *max = -1;
+            if (!atEnd() && peek() != '}' && !parseNumber(max)) {
+                fail(QStringLiteral("invalid repetition count (0..%1)").arg(kMaxRepeat));
+                return false;
+            }
+        }
+        if (atEnd() || take() != '}') {
+            fail(QStringLiteral("missing '}'"));
+            return false;
+        }
+        if (*max >= 0 && *max < *min) {
+            fail(QStringLiteral("repetition range out of order"));
+            return false;
+        }
+        return true;
+    }
+
+    int parseAtom() {
+        const unsigned char c = take();
+        switch (c) {
+            case '(': {
+                if (m_pos + 1 < m_pattern.size() && peek() == '?' &&
+                    m_pattern.at(m_pos + 1) == ':') {
+                    m_pos += 2;
+                }
+                const int inner = parseAlternation();
+                if (inner < 0) {
+                    return -1;
+                }
+                if (atEnd() || take() != ')') {
+                    return fail(QStringLiteral("missing ')'"));
+                }
+                return inner;
+            }
+            case '[': {
+                std::bitset<256> set;
+                if (!parseClass(&set)) {
+                    return -1;
+                }
+                return addSet(set);
+            }
+            case '.':
+                return addSet(std::bitset<256>().set());
+            case '^':
+            case '$':
+                return fail(QStringLiteral("anchors are not supported"));
+            case '\\': {
+                std::bitset<256> set;
+                if (!parseEscape(&set, nullptr)) {
+                    return -1;
+                }
+                return addSet(set);
+            }
+            default: {
+                std::bitset<256> set;
+                set.set(c);
+                return addSet(set);
+            }
+        }
+    }
+
+    // Parses the escape after a backslash. `singleByte` receives the byte when the escape denotes
+    // exactly one (range endpoints inside classes), or -1 for \d-style sets.
+    bool parseEscape(std::bitset<256>* set, int* singleByte) {
+        if (atEnd()) {
+            fail(QStringLiteral("trailing backslash"));
+            return false;
+        }
+        const unsigned char c = take();
+        int byte = -1;
+        switch (c) {
+            case 'd':
+                *set = digitSet();
+                break;
+            case 'D':
+                *set = ~digitSet();
+                break;
+            case 'w':
+                *set = wordSet();
+                break;
+            case 'W':
+                *set = ~wordSet();
+                break;
+            case 's':
+                *set = spaceSet();
+                break;
+            case 'S':
+                *set = ~spaceSet();
+                break;
+            case 'n':
+                byte = '\n';
+                break;
+            case 'r':
+                byte = '\r';
+                break;
+            case 't':
+                byte = '\t';
+                break;
+            case 'f':
+                byte = '\f';
+                break;
+            case 'v':
+                byte = '\v';
+                break;
+            case '0':
+                byte = 0;
+                break;
+            case 'x': {
+                const int high = atEnd() ? -1 : hexDigitValue(take());
+                const int low = atEnd() ? -1 : hexDigitValue(take());
+                if (high < 0 || low < 0) {
+                    fail(QStringLiteral("\\x needs two hex digits"));
+                    return false;
+                }
+                byte = high * 16 + low;
+                break;
+            }
+            default:
+                if (isAsciiAlnum(c)) {
+                    fail(QStringLiteral("unknown escape \\%1").arg(QChar(c)));
+                    return false;
+                }
+                byte = c;
+                break;
+        }
+        if (byte >= 0) {
+            set->reset();
+            set->set(static_cast<size_t>(byte));
+        }
+        if (singleByte != nullptr) {
+            *singleByte = byte;
+        }
+        return true;
+    }
+
+    bool parseClassItem(std::bitset<256>* set, int* singleByte) {
+        const unsigned char c = take();
+        if (c == '\\') {
+            return parseEscape(set, singleByte);
+        }
+        set->reset();
+        set->set(c);
+        *singleByte = c;
+        return true;
+    }
+
+    bool parseClass(std::bitset<256>* set) {
+        bool negate = false;
+        if (!atEnd() && peek() == '^') {
+            take();
+            negate = true;
+        }
+        bool first = true;
+        for (;;) {
+            if (atEnd()) {
+                fail(QStringLiteral("missing ']'"));
+                return false;
+            }
+            if (peek() == ']' && !first) {
+                take();
+                break;
+            }
+            first = false;
+
+            std::bitset<256> item;
+            int low = -1;
+            if (!parseClassItem(&item, &low)) {
+                return false;
+            }
+            if (low >= 0 && m_pos + 1 < m_pattern.size() && peek() == '-' &&
+                m_pattern.at(m_pos + 1) != ']') {
+                take();
+                int high = -1;
+                if (!parseClassItem(&item, &high)) {
+                    return false;
+                }
+                if (high < 0 || high < low) {
+                    fail(QStringLiteral("invalid class range"));
+                    return false;
+                }
+                item = rangeSet(low, high);
+            }
+            *set |= item;
+        }
+        if (m_foldCase) {
+            foldSet(set);
+        }
+        if (negate) {
+            set->flip();
+        }
+        return true;
+    }
+
+    const QByteArray& m_pattern;
+    bool m_foldCase = false;
+    std::vector<std::bitset<256>>* m_byteSets = nullptr;
+    std::vector<Node>* m_nodes = nullptr;
+    int m_pos = 0;
+    QString m_error;
+};
+
+}  // namespace
+
+// Thompson construction. A fragment is a start state plus the dangling exits still to be patched
+// (state index, whether it is the second exit of a split).
+class ByteRegex::Builder {
+public:
+    using State = ByteRegex::State;
+    using StateKind = ByteRegex::StateKind;
+
+    struct Fragment {
+        int start = -1;
+        std::vector<std::pair<int, bool>> exits;
+    };
+
+    Builder(const std::vector<Node>& nodes, std::vector<State>* states)
+        : m_nodes(nodes), m_states(states) {}
+
+    bool build(int nodeIdx, Fragment* fragment) {
+        const Node& node = m_nodes.at(static_cast<size_t>(nodeIdx));
+        switch (node.kind) {
+            case Node::Kind::ByteSet: {
+                State state;
+                state.kind = StateKind::Bytes;
+                state.byteSet = node.byteSet;
+                const int idx = add(state);
+                if (idx < 0) {
+                    return false;
+                }
+                *fragment = Fragment{idx, {{idx, false}}};
+                return true;
+            }
+            case Node::Kind::Concat: {
+                if (!epsilon(fragment)) {
+                    return false;
+                }
+                for (const int child : node.children) {
+                    Fragment next;
+                    if (!build(child, &next)) {
+                        return false;
+                    }
+                    append(fragment, std::move(next));
+                }
+                return true;
+            }
+            case Node::Kind::Alternation: {
+                Fragment result;
+                for (int i = static_cast<int>(node.children.size()) - 1; i >= 0; --i) {
+                    Fragment branch;
+                    if (!build(node.children.at(static_cast<size_t>(i)), &branch)) {
+                        return false;
+                    }
+                    if (result.start < 0) {
+                        result = std::move(branch);
+                        continue;
+                    }
+                    State split;
+                    split.out = branch.start;
+                    split.out1 = result.start;
+                    const int idx = add(split);
+                    if (idx < 0) {
+                        return false;
+                    }
+                    result.start = idx;
+                    result.exits.insert(result.exits.end(), branch.exits.begin(),
+                                        branch.exits.end());
+                }
+                *fragment = std::move(result);
+                return true;
+            }
+            case Node::Kind::Repeat:
+                return buildRepeat(node, fragment);
+        }
+        return false;
+    }
+
+    void patch(const std::vector<std::pair<int, bool>>& exits, int target) {
+        for (const auto& [stateIdx, second] : exits) {
+            State& state = (*m_states)[static_cast<size_t>(stateIdx)];
+            (second ? state.out1 : state.out) = target;
+        }
+    }
+
+    int add(const State& state) {
+        if (m_states->size() >= static_cast<size_t>(kMaxNfaStates)) {
+            return -1;
+        }
+        m_states->push_back(state);
+        return static_cast<int>(m_states->size()) - 1;
+    }
+
+private:
+    bool epsilon(Fragment* fragment) {
+        const int idx = add(State{});
+        if (idx < 0) {
+            return false;
+        }
+        *fragment = Fragment{idx, {{idx, false}}};
+        return true;
+    }
+
+    void append(Fragment* fragment, Fragment next) {
+        patch(fragment->exits, next.start);
+        fragment->exits = std::move(next.exits);
+    }
+
+    bool buildRepeat(const Node& node, Fragment* fragment) {
+        const int child = node.children.front();
+        if (!epsilon(fragment)) {
+            return false;
+        }
+        for (int i = 0; i < node.min; ++i) {
+            Fragment copy;
+            if (!build(child, &copy)) {
+                return false;
+            }
+            append(fragment, std::move(copy));
+        }
+
+        if (node.max < 0) {
+            const int loop = add(State{});
+            Fragment body;
+            if (loop < 0 || !build(child, &body)) {
+                return false;
+            }
+            (*m_states)[static_cast<size_t>(loop)].out = body.start;
+            patch(body.exits, loop);
+            append(fragment, Fragment{loop, {{loop, true}}});
+            return true;
+        }
+
+        // x{0,k} as nested optionals: (x(x(x)?)?)?, so each copy can skip the rest.
+        std::vector<std::pair<int, bool>> skips;
+        for (int i = node.min; i < node.max; ++i) {
+            const int split = add(State{});
+            Fragment body;
+            if (split < 0 || !build(child, &body)) {
+                return false;
+            }
+            patch(fragment->exits, split);
+            (*m_states)[static_cast<size_t>(split)].out = body.start;
+            skips.push_back({split, true});
+            fragment->exits = std::move(body.exits);
+        }
+        fragment->exits.insert(fragment->exits.end(), skips.begin(), skips.end());
+        return true;
+    }
+
+    const std::vector<Node>& m_nodes;
+    std::vector<State>* m_states = nullptr;
+};
+
+std::vector<int> ByteRegex::closureOf(const std::vector<State>& states, int start) {
+    std::vector<int> result;
+    std::vector<bool> seen(states.size(), false);
+    std::vector<int> stack{start};
+    while (!stack.empty()) {
+        const int idx = stack.back();
+        stack.pop_back();
+        if (idx < 0 || seen[static_cast<size_t>(idx)]) {
+            continue;
+        }
+        seen[static_cast<size_t>(idx)] = true;
+        const State& state = states.at(static_cast<size_t>(idx));
+        if (state.kind == StateKind::Split) {
+            stack.push_back(state.out1);
+            stack.push_back(state.out);
+        } else {
+            result.push_back(idx);
+        }
+    }
+    return result;
+}
+
+std::shared_ptr<const ByteRegex> ByteRegex::compile(const QVector<QByteArray>& patterns,
+                                                    bool foldCase, QString* error) {
+    QString localError;
+    QString* errorOut = error != nullptr ? error : &localError;
+    if (patterns.isEmpty()) {
+        *errorOut = QStringLiteral("no pattern");
+        return nullptr;
+    }
+
+    std::shared_ptr<ByteRegex> regex(new ByteRegex());
+    regex->m_patternCount = patterns.size();
+    regex->m_foldCase = foldCase;
+
+    std::vector<int> patternStarts;
+    for (int patternIdx = 0; patternIdx < patterns.size(); ++patternIdx) {
+        const QByteArray& pattern = patterns.at(patternIdx);
+        std::vector<Node> nodes;
+        Parser parser(pattern, foldCase, &regex->m_byteSets, &nodes);
+        QString parseError;
+        const int root = parser.parse(&parseError);
+        const QString prefix =
+            patterns.size() > 1 ? QStringLiteral("pattern %1: ").arg(patternIdx + 1) : QString();
+        if (root < 0) {
+            *errorOut = prefix + parseError;
+            return nullptr;
+        }
+
+        Builder builder(nodes, &regex->m_states);
+        Builder::Fragment fragment;
+        State match;
+        match.kind = StateKind::Match;
+        match.patternIdx = patternIdx;
+        const bool built = builder.build(root, &fragment);
+        const int matchIdx = built ? builder.add(match) : -1;
+        if (matchIdx < 0) {
+            *errorOut = prefix + QStringLiteral("pattern too large");
+            return nullptr;
+        }
+        builder.patch(fragment.exits, matchIdx);
+        regex->m_statePattern.resize(regex->m_states.size(), patternIdx);
+
+        for (const int idx : closureOf(regex->m_states, fragment.start)) {
+            if (regex->m_states.at(static_cast<size_t>(idx)).kind == StateKind::Match) {
+                *errorOut = prefix + QStringLiteral("pattern matches the empty string");
+                return nullptr;
+            }
+        }
+        patternStarts.push_back(fragment.start);
+    }
+
+    regex->m_start = patternStarts.back();
+    for (int i = static_cast<int>(patternStarts.size()) - 2; i >= 0; --i) {
+        State split;
+        split.out = patternStarts.at(static_cast<size_t>(i));
+        split.out1 = regex->m_start;
+        regex->m_states.push_back(split);
+        regex->m_statePattern.push_back(-1);
+        regex->m_start = static_cast<int>(regex->m_states.size()) - 1;
+    }
+
+    for (const int idx : closureOf(regex->m_states, regex->m_start)) {
+        const State& state = regex->m_states.at(static_cast<size_t>(idx));
+        if (state.kind != StateKind::Bytes) {
+            continue;
+        }
+        const std::bitset<256>& set = regex->m_byteSets.at(static_cast<size_t>(state.byteSet));
+        for (int b = 0; b < 256; ++b) {
+            regex->m_firstBytes[static_cast<size_t>(b)] =
+                regex->m_firstBytes[static_cast<size_t>(b)] || set[static_cast<size_t>(b)];
+        }
+    }
+
+    // Bytes that no byte set tells apart share a class, so DFA rows stay short.
+    std::map<std::vector<bool>, int> classBySignature;
+    for (int b = 0; b < 256; ++b) {
+        std::vector<bool> signature(regex->m_byteSets.size());
+        for (size_t s = 0; s < regex->m_byteSets.size(); ++s) {
+            signature[s] = regex->m_byteSets[s][static_cast<size_t>(b)];
+        }
+        const int nextClass = static_cast<int>(classBySignature.size());
+        auto [it, inserted] = classBySignature.emplace(std::move(signature), nextClass);
+        if (inserted) {
+            regex->m_classByte.push_back(static_cast<unsigned char>(b));
+        }
+        regex->m_byteClass[static_cast<size_t>(b)] = static_cast<unsigned char>(it->second);
+    }
+    return regex;
+}
+
+int ByteRegex::patternCount() const { return m_patternCount; }
+
+bool ByteRegex::foldsCase() const { return m_foldCase; }
+
+const std::array<bool, 256>& ByteRegex::firstBytes() const { return m_firstBytes; }
+
+size_t ByteRegexScanner::StateSetHash::operator()(const std::vector<int>& states) const {
+    size_t hash = states.size();
+    for (const int state : states) {
+        hash ^= static_cast<size_t>(state) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+ByteRegexScanner::ByteRegexScanner(std::shared_ptr<const ByteRegex> regex)
+    : m_regex(std::move(regex)) {
+    m_classCount = static_cast<int>(m_regex->m_classByte.size());
+    m_visitMark.assign(m_regex->m_states.size(), 0);
+    int firstByteCount = 0;
+    for (int b = 0; b < 256; ++b) {
+        if (m_regex->m_firstBytes[static_cast<size_t>(b)]) {
+            ++firstByteCount;
+            m_singleFirstByte = b;
+        }
+    }
+    if (firstByteCount != 1) {
+        m_singleFirstByte = -1;
+    }
+    ++m_visitGeneration;
+    addClosure(m_regex->m_start, &m_startStates);
+    std::sort(m_startStates.begin(), m_startStates.end());
+    resetCache();
+}
+
+const std::shared_ptr<const ByteRegex>& ByteRegexScanner::regex() const { return m_regex; }
+
+int ByteRegexScanner::cachedStateCount() const { return static_cast<int>(m_states.size()); }
+
+void ByteRegexScanner::resetCache() {
+    std::array<std::vector<int>, 2> liveKeys;
+    for (size_t i = 0; i < m_liveRuns.size(); ++i) {
+        if (m_liveRuns[i] != nullptr) {
+            liveKeys[i] = m_states[static_cast<size_t>(m_liveRuns[i]->state)].key;
+        }
+    }
+    m_states.clear();
+    m_transitions.clear();
+    m_transitionList.clear();
+    m_stateIndex.clear();
+    stateFor({});
+    for (size_t i = 0; i < m_liveRuns.size(); ++i) {
+        if (m_liveRuns[i] != nullptr) {
+            m_liveRuns[i]->state = stateFor(std::move(liveKeys[i]));
+        }
+    }
+}
+
+int ByteRegexScanner::stateFor(std::vector<int> key) {
+    const auto found = m_stateIndex.find(key);
+    if (found != m_stateIndex.end()) {
+        return found->second;
+    }
+    DfaState state;
+    state.startCount =
+        key.empty() ? 0 : 1 + static_cast<int>(std::count(key.begin(), key.end(), -1));
+    const int id = static_cast<int>(m_states.size());
+    m_stateIndex.emplace(key, id);
+    state.key = std::move(key);
+    m_states.push_back(std::move(state));
+    m_transitions.resize(m_transitions.size() + static_cast<size_t>(m_classCount) * 2, -1);
+    return id;
+}
+
+void ByteRegexScanner::addClosure(int nfaState, std::vector<int>* states) {
+    m_stack.clear();
+    m_stack.push_back(nfaState);
+    while (!m_stack.empty()) {
+        const int idx = m_stack.back();
+        m_stack.pop_back();
+        if (idx < 0) {
+            continue;
+        }
+        const ByteRegex::State& state = m_regex->m_states[static_cast<size_t>(idx)];
+        // Every start reaching a match state reports it; only byte states are shared.
+        if (state.kind == ByteRegex::StateKind::Match) {
+            if (std::find(states->begin(), states->end(), idx) == states->end()) {
+                states->push_back(idx);
+            }
+            continue;
+        }
+        if (m_visitMark[static_cast<size_t>(idx)] == m_visitGeneration) {
+            continue;
+        }
+        m_visitMark[static_cast<size_t>(idx)] = m_visitGeneration;
+        m_visited.push_back(idx);
+        if (state.kind == ByteRegex::StateKind::Split) {
+            m_stack.push_back(state.out1);
+            m_stack.push_back(state.out);
+        } else {
+            states->push_back(idx);
+        }
+    }
+}
+
+ByteRegexScanner::Transition ByteRegexScanner::buildTransition(int state, unsigned char byte,
+                                                               bool startsHere) {
+    const std::vector<int> source = m_states[static_cast<size_t>(state)].key;
+    const int sourceStarts = m_states[static_cast<size_t>(state)].startCount;
+    const size_t representative = m_regex->m_classByte[m_regex->m_byteClass[byte]];
+    Transition transition;
+    std::vector<int> key;
+    std::vector<int> next;
+    ++m_visitGeneration;
+    auto advanceStart = [&](const int* states, size_t count, int sourceStart) {
+        next.clear();
+        m_visited.clear();
+        for (size_t i = 0; i < count; ++i) {
+            const ByteRegex::State& nfaState = m_regex->m_states[static_cast<size_t>(states[i])];
+            if (nfaState.kind == ByteRegex::StateKind::Bytes &&
+                m_regex->m_byteSets[static_cast<size_t>(nfaState.byteSet)][representative]) {
+                addClosure(nfaState.out, &next);
+            }
+        }
+        // A start reports each pattern's shortest match once and stops following that pattern.
+        for (const int idx : next) {
+            const ByteRegex::State& nfaState = m_regex->m_states[static_cast<size_t>(idx)];
+            if (nfaState.kind == ByteRegex::StateKind::Match) {
+                transition.matches.push_back({nfaState.patternIdx, sourceStart});
+            }
+        }
+        if (!transition.matches.empty() && transition.matches.back().second == sourceStart) {
+            auto matched = [&](int idx) {
+                const int pattern = m_regex->m_statePattern[static_cast<size_t>(idx)];
+                return std::any_of(transition.matches.begin(), transition.matches.end(),
+                                   [&](const std::pair<int, int>& match) {
+                                       return match.second == sourceStart &&
+                                              match.first == pattern;
+                                   });
+            };
+            next.erase(std::remove_if(next.begin(), next.end(), matched), next.end());
+            // Younger starts may still reach the states this start gave up.
+            for (const int idx : m_visited) {
+                if (matched(idx)) {
+                    m_visitMark[static_cast<size_t>(idx)] = 0;
+                }
+            }
+        }
+        if (next.empty() || transition.sources.size() >= static_cast<size_t>(kMaxLiveStarts)) {
+            return;
+        }
+        std::sort(next.begin(), next.end());
+        if (!key.empty()) {
+            key.push_back(-1);
+        }
+        key.insert(key.end(), next.begin(), next.end());
+        transition.sources.push_back(sourceStart);
+    };
+
+    size_t begin = 0;
+    for (int start = 0; start < sourceStarts; ++start) {
+        size_t end = begin;
+        while (end < source.size() && source[end] >= 0) {
+            ++end;
+        }
+        advanceStart(source.data() + begin, end - begin, start);
+        begin = end + 1;
+    }
+    if (startsHere) {
+        advanceStart(m_startStates.data(), m_startStates.size(), sourceStarts);
+    }
+
+    const int targetStarts = static_cast<int>(transition.sources.size());
+    bool identity = true;
+    for (int i = 0; identity && i < targetStarts; ++i) {
+        identity = transition.sources[static_cast<size_t>(i)] == i;
+    }
+    transition.keepsStarts = identity && targetStarts == sourceStarts;
+    transition.addsStart = identity && targetStarts == sourceStarts + 1;
+    transition.target = stateFor(std::move(key));
+    return transition;
+}
+
+int ByteRegexScanner::transitionFor(Run* run, unsigned char byte, bool startsHere) {
+    if (m_states.size() > static_cast<size_t>(kMaxCachedStates)) {
+        resetCache();
+    }
+    Transition transition = buildTransition(run->state, byte, startsHere);
+    const size_t slot = (static_cast<size_t>(run->state) * static_cast<size_t>(m_classCount) +
+                         m_regex->m_byteClass[byte]) * 2 + (startsHere ? 1 : 0);
+    m_transitionList.push_back(std::move(transition));
+    m_transitions[slot] = static_cast<int>(m_transitionList.size()) - 1;
+    return m_transitions[slot];
+}
+
+void ByteRegexScanner::step(Run* run, unsigned char byte, quint64 offset, bool startsHere,
+                            QVector<RegexMatch>* matches) {
+    const size_t slot = (static_cast<size_t>(run->state) * static_cast<size_t>(m_classCount) +
+                         m_regex->m_byteClass[byte]) * 2 + (startsHere ? 1 : 0);
+    int index = m_transitions[slot];
+    if (index < 0) {
+        index = transitionFor(run, byte, startsHere);
+    }
+    const Transition& transition = m_transitionList[static_cast<size_t>(index)];
+    const size_t sourceStarts = run->starts.size();
+    if (matches != nullptr) {
+        for (const auto& [patternIdx, source] : transition.matches) {
+            const size_t sourceIdx = static_cast<size_t>(source);
+            const quint64 start = sourceIdx < sourceStarts ? run->starts[sourceIdx] : offset;
+            matches->push_back(RegexMatch{start, offset + 1 - start, patternIdx});
+        }
+    }
+    if (transition.addsStart) {
+        run->starts.push_back(offset);
+    } else if (!transition.keepsStarts) {
+        // Sources keep their order, so the surviving starts compact in place; only the last one
+        // can be new.
+        size_t kept = 0;
+        for (const int source : transition.sources) {
+            if (static_cast<size_t>(source) < sourceStarts) {
+                run->starts[kept++] = run->starts[static_cast<size_t>(source)];
+            }
+        }
+        run->starts.resize(kept);
+        if (kept < transition.sources.size()) {
+            run->starts.push_back(offset);
+        }
+    }
+    run->state = transition.target;
+}
+
+void ByteRegexScanner::advance(Run* run, const unsigned char* data, int size, int startLimit,
+                               quint64 baseOffset, QVector<RegexMatch>* matches) {
+    const std::array<bool, 256>& firstBytes = m_regex->m_firstBytes;
+    for (int i = 0; i < size; ++i) {
+        if (run->state == kDeadState) {
+            // With no start alive, only a byte that can begin a match changes the state.
+            if (i >= startLimit) {
+                break;
+            }
+            if (m_singleFirstByte >= 0) {
+                const void* next = std::memchr(data + i, m_singleFirstByte,
+                                               static_cast<size_t>(startLimit - i));
+                if (next == nullptr) {
+                    break;
+                }
+                i = static_cast<int>(static_cast<const unsigned char*>(next) - data);
+            } else {
+                while (i < startLimit && !firstBytes[data[i]]) {
+                    ++i;
+                }
+                if (i == startLimit) {
+                    break;
+                }
+            }
+        }
+        step(run, data[i], baseOffset + static_cast<quint64>(i), i < startLimit, matches);
+    }
+}
+
+RegexRun ByteRegexScanner::runState(const Run& run) const {
+    return RegexRun{m_states[static_cast<size_t>(run.state)].key, run.starts};
+}
+
+void ByteRegexScanner::scan(const char* data, int size, int startLimit, quint64 baseOffset,
+                            QVector<RegexMatch>* matches, RegexRun* endRun) {
+    Run run;
+    if (data != nullptr && size > 0) {
+        m_liveRuns = {&run, nullptr};
+        advance(&run, reinterpret_cast<const unsigned char*>(data), size, qMin(startLimit, size),
+                baseOffset, matches);
+        m_liveRuns = {};
+    }
+    *endRun = runState(run);
+}
+
+void ByteRegexScanner::resume(const RegexRun& carried, const char* data, int size,
+                              int startLimit, quint64 baseOffset, QVector<RegexMatch>* matches,
+                              RegexRun* endRun) {
+    if (carried.isEmpty()) {
+        return;
+    }
+    if (data == nullptr || size <= 0) {
+        *endRun = carried;
+        return;
+    }
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    const int limit = qMin(startLimit, size);
+    Run resumed;
+    resumed.state = stateFor(carried.states);
+    resumed.starts = carried.starts;
+    Run fresh;
+    m_liveRuns = {&resumed, &fresh};
+    m_resumeMatches.clear();
+    // The two runs differ only by the carried starts and what those shadow; once they are in the
+    // same state the scan() results hold for the rest of the data.
+    int met = -1;
+    for (int i = 0; i < size; ++i) {
+        const quint64 offset = baseOffset + static_cast<quint64>(i);
+        step(&resumed, bytes[i], offset, i < limit, &m_resumeMatches);
+        step(&fresh, bytes[i], offset, i < limit, nullptr);
+        if (resumed.state == fresh.state && resumed.starts == fresh.starts) {
+            met = i + 1;
+            break;
+        }
+    }
+    m_liveRuns = {};
+
+    const quint64 replacedEnd = baseOffset + static_cast<quint64>(met >= 0 ? met : size);
+    matches->erase(std::remove_if(matches->begin(), matches->end(),
+                                  [baseOffset, replacedEnd](const RegexMatch& match) {
+                                      const quint64 end = match.start + match.length;
+                                      return end > baseOffset && end <= replacedEnd;
+                                  }),
+                   matches->end());
+    matches->append(m_resumeMatches);
+    if (met < 0) {
+        *endRun = runState(resumed);
+    }
+}
+
+}  // namespace breco
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <array>
+#include <bitset>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "scan/ScanTypes.h"
+
+namespace breco {
+
+// Regular expressions over raw bytes, compiled once per scan into a Thompson NFA that every worker
+// shares read-only. Supported syntax: literal bytes, ".", classes ("[a-f0-9]", "[^\x00]"), groups,
+// "|", "*", "+", "?", "{m}", "{m,}", "{m,n}", and the escapes \xHH \d \w \s \D \W \S \n \r \t \f
+// \v \0 plus escaped metacharacters; a lazy "?" suffix is accepted. There are no anchors: a match
+// may start at any byte. Patterns that can match the empty string are rejected.
+class ByteRegex {
+public:
+    // Several patterns are matched together; matches carry the index of the pattern. Returns
+    // nullptr and sets `error` when a pattern does not parse or grows too large.
+    static std::shared_ptr<const ByteRegex> compile(const QVector<QByteArray>& patterns,
+                                                    bool foldCase, QString* error);
+
+    int patternCount() const;
+    bool foldsCase() const;
+    // Bytes a match can start with.
+    const std::array<bool, 256>& firstBytes() const;
+
+private:
+    friend class ByteRegexScanner;
+    class Builder;
+
+    enum class StateKind {
+        Bytes = 0,
+        Split,
+        Match
+    };
+
+    struct State {
+        StateKind kind = StateKind::Split;
+        int byteSet = -1;
+        int out = -1;
+        int out1 = -1;
+        int patternIdx = -1;
+    };
+
+    ByteRegex() = default;
+
+    // States reachable from `start` through splits only, keeping byte and match states.
+    static std::vector<int> closureOf(const std::vector<State>& states, int start);
+
+    std::vector<State> m_states;
+    // Pattern of each NFA state; -1 for the splits joining the patterns.
+    std::vector<int> m_statePattern;
+    std::vector<std::bitset<256>> m_byteSets;
+    int m_start = -1;
+    int m_patternCount = 0;
+    bool m_foldCase = false;
+    std::array<bool, 256> m_firstBytes{};
+    std::array<unsigned char, 256> m_byteClass{};
+    std::vector<unsigned char> m_classByte;
+};
+
+// Per-worker matcher for a ByteRegex: a DFA built lazily over the NFA, one transition row per
+// reached state and byte class. One unanchored pass enters the start state at every byte. A DFA
+// state lists the NFA states of each live start, oldest first; an NFA state reached by an older
+// start is not tracked again for a younger one, whose match would end at the same byte. Each start
+// reports the shortest match of each pattern once. The state at the end of the data is handed
+// back as a RegexRun so the next block can continue from it instead of re-reading an overlap.
+class ByteRegexScanner {
+public:
+    // Starts tracked at once; younger ones are dropped (only long gaps like ".{1000}x" get near).
+    static constexpr int kMaxLiveStarts = 1024;
+
+    explicit ByteRegexScanner(std::shared_ptr<const ByteRegex> regex);
+
+    // Scans `data` from the empty state; matches start before `startLimit`. Offsets are
+    // `baseOffset` + index into `data`. Matches are appended in the order they end; the state at
+    // the end of the data goes to `endRun`.
+    void scan(const char* data, int size, int startLimit, quint64 baseOffset,
+              QVector<RegexMatch>* matches, RegexRun* endRun);
+    // Corrects a scan() of the same data for the state `carried` from the preceding data: runs
+    // the data from `carried` beside a run from the empty state until both are in the same state,
+    // and replaces the matches in `matches` that end before that point. When they never meet, all
+    // matches ending in the data and `endRun` are replaced.
+    void resume(const RegexRun& carried, const char* data, int size, int startLimit,
+                quint64 baseOffset, QVector<RegexMatch>* matches, RegexRun* endRun);
+
+    const std::shared_ptr<const ByteRegex>& regex() const;
+    int cachedStateCount() const;
+
+private:
+    static constexpr int kDeadState = 0;
+    static constexpr int kMaxCachedStates = 4096;
+
+    struct StateSetHash {
+        size_t operator()(const std::vector<int>& states) const;
+    };
+
+    struct DfaState {
+        // NFA byte states of each live start, oldest start first, separated by -1.
+        std::vector<int> key;
+        int startCount = 0;
+    };
+
+    struct Transition {
+        int target = kDeadState;
+        // Per start of the target: its start in the source state, or the source's start count
+        // for a start at this byte.
+        std::vector<int> sources;
+        // (pattern, source start) of every match ending at this byte.
+        std::vector<std::pair<int, int>> matches;
+        // `sources` is 0..n-1 (starts unchanged) or 0..n (one start added at this byte).
+        bool keepsStarts = false;
+        bool addsStart = false;
+    };
+
+    struct Run {
+        int state = kDeadState;
+        std::vector<quint64> starts;
+    };
+
+    void resetCache();
+    int stateFor(std::vector<int> key);
+    int transitionFor(Run* run, unsigned char byte, bool startsHere);
+    Transition buildTransition(int state, unsigned char byte, bool startsHere);
+    void addClosure(int nfaState, std::vector<int>* states);
+    void step(Run* run, unsigned char byte, quint64 offset, bool startsHere,
+              QVector<RegexMatch>* matches);
+    void advance(Run* run, const unsigned char* data, int size, int startLimit,
+                 quint64 baseOffset, QVector<RegexMatch>* matches);
+    RegexRun runState(const Run& run) const;
+
+    std::shared_ptr<const ByteRegex> m_regex;
+    int m_classCount = 1;
+    std::vector<int> m_startStates;
+    std::vector<DfaState> m_states;
+    // Per (state, byte class, whether a match may start here): index into m_transitionList.
+    std::vector<int> m_transitions;
+    std::vector<Transition> m_transitionList;
+    std::unordered_map<std::vector<int>, int, StateSetHash> m_stateIndex;
+    // Runs whose states survive a cache flush.
+    std::array<Run*, 2> m_liveRuns{};
+    std::vector<unsigned int> m_visitMark;
+    unsigned int m_visitGeneration = 0;
+    std::vector<int> m_stack;
+    // States addClosure() marked since the last clear.
+    std::vector<int> m_visited;
+    QVector<RegexMatch> m_resumeMatches;
+    int m_singleFirstByte = -1;
+};
+
+}  // namespace breco
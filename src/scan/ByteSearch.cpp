@@ -0,0 +1,723 @@
+#include "scan/ByteSearch.h"
+
+#include <array>
+#include <cstring>
+#include <utility>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BRECO_X86_SEARCH_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace breco {
+
+namespace {
+// Fixed-width kernels append every start to `starts` and return -1; the others return the first
+// start and ignore `starts`.
+using KernelFn = int (*)(const unsigned char* haystack, int haystackSize,
+                         const unsigned char* needle, int needleSize, int from,
+                         QVector<int>* starts);
+
+// Byte positions inside a masked needle whose lanes are compared before full verification.
+struct MaskedAnchors {
+    int first = 0;
+    int last = 0;
+};
+
+using MaskedKernelFn = int (*)(const unsigned char* haystack, int haystackSize,
+                               const unsigned char* needle, const unsigned char* mask,
+                               int needleSize, int from, MaskedAnchors anchors);
+
+// True when data[from..size) all equal data[0].
+using ConstantKernelFn = bool (*)(const unsigned char* data, int size, int from);
+
+constexpr std::array<unsigned char, 256> makeAsciiLowerTable() {
+    std::array<unsigned char, 256> table{};
+    for (int i = 0; i < 256; ++i) {
+        table[i] = static_cast<unsigned char>((i >= 'A' && i <= 'Z') ? i + ('a' - 'A') : i);
+    }
+    return table;
+}
+
+constexpr std::array<unsigned char, 256> kAsciiLower = makeAsciiLowerTable();
+
+// Lane compares OR 0x20 into haystack bytes only where the needle byte is a letter; for letters
+// that OR is an exact case fold, for everything else the compare stays byte-exact.
+inline unsigned char caseBitFor(unsigned char foldedByte) {
+    return (foldedByte >= 'a' && foldedByte <= 'z') ? 0x20 : 0x00;
+}
+
+// Candidates already agree on the first and last byte; only the bytes in between need checking.
+// Fixed-width kernels pass a constant needleSize, so the compare below is unrolled.
+template <bool kFoldCase>
+inline bool innerBytesMatch(const unsigned char* candidate, const unsigned char* needle,
+                            int needleSize) {
+    if constexpr (!kFoldCase) {
+        return needleSize <= 2 ||
+               std::memcmp(candidate + 1, needle + 1, static_cast<size_t>(needleSize - 2)) == 0;
+    } else {
+        for (int j = 1; j < needleSize - 1; ++j) {
+            if (kAsciiLower[candidate[j]] != needle[j]) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+// kFixedSize > 0 instantiates a kernel for that needle size only (needleSize is then ignored)
+// that collects every start instead of returning the first.
+template <bool kFoldCase, int kFixedSize = 0>
+int scalarSearch(const unsigned char* haystack, int haystackSize, const unsigned char* needle,
+                 int needleSize, int from, QVector<int>* starts) {
+    if constexpr (kFixedSize > 0) {
+        needleSize = kFixedSize;
+    }
+    const int lastStart = haystackSize - needleSize;
+    const unsigned char lastByte = needle[needleSize - 1];
+    int i = from;
+    if constexpr (!kFoldCase) {
+        while (i <= lastStart) {
+            const void* hit =
+                std::memchr(haystack + i, needle[0], static_cast<size_t>(lastStart - i + 1));
+            if (hit == nullptr) {
+                return -1;
+            }
+            i = static_cast<int>(static_cast<const unsigned char*>(hit) - haystack);
+            if (haystack[i + needleSize - 1] == lastByte &&
+                innerBytesMatch<false>(haystack + i, needle, needleSize)) {
+                if constexpr (kFixedSize == 0) {
+                    return i;
+                }
+                starts->push_back(i);
+            }
+            ++i;
+        }
+    } else {
+        for (; i <= lastStart; ++i) {
+            if (kAsciiLower[haystack[i]] == needle[0] &&
+                kAsciiLower[haystack[i + needleSize - 1]] == lastByte &&
+                innerBytesMatch<true>(haystack + i, needle, needleSize)) {
+                if constexpr (kFixedSize == 0) {
+                    return i;
+                }
+                starts->push_back(i);
+            }
+        }
+    }
+    return -1;
+}
+
+inline bool maskedBytesMatch(const unsigned char* candidate, const unsigned char* needle,
+                             const unsigned char* mask, int needleSize) {
+    for (int j = 0; j < needleSize; ++j) {
+        if ((candidate[j] & mask[j]) != needle[j]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+MaskedAnchors chooseMaskedAnchors(const unsigned char* mask, int needleSize) {
+    MaskedAnchors anchors;
+    int runStart = 0;
+    int bestSize = 0;
+    for (int j = 0; j <= needleSize; ++j) {
+        if (j < needleSize && mask[j] == 0xFF) {
+            continue;
+        }
+        if (j - runStart > bestSize) {
+            bestSize = j - runStart;
+            anchors.first = runStart;
+            anchors.last = j - 1;
+        }
+        runStart = j + 1;
+    }
+    if (bestSize >= 2) {
+        return anchors;
+    }
+    anchors.first = 0;
+    anchors.last = needleSize - 1;
+    while (anchors.first < anchors.last && mask[anchors.first] == 0) {
+        ++anchors.first;
+    }
+    while (anchors.last > anchors.first && mask[anchors.last] == 0) {
+        --anchors.last;
+    }
+    return anchors;
+}
+
+int scalarMaskedSearch(const unsigned char* haystack, int haystackSize, const unsigned char* needle,
+                       const unsigned char* mask, int needleSize, int from,
+                       MaskedAnchors anchors) {
+    const int lastStart = haystackSize - needleSize;
+    const unsigned char firstMask = mask[anchors.first];
+    const unsigned char firstByte = needle[anchors.first];
+    const unsigned char lastMask = mask[anchors.last];
+    const unsigned char lastByte = needle[anchors.last];
+    for (int i = from; i <= lastStart; ++i) {
+        if ((haystack[i + anchors.first] & firstMask) == firstByte &&
+            (haystack[i + anchors.last] & lastMask) == lastByte &&
+            maskedBytesMatch(haystack + i, needle, mask, needleSize)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool scalarIsConstant(const unsigned char* data, int size, int from) {
+    const quint64 value = 0x0101010101010101ULL * data[0];
+    int i = from;
+    for (; i + 8 <= size; i += 8) {
+        quint64 word;
+        std::memcpy(&word, data + i, sizeof(word));
+        if (word != value) {
+            return false;
+        }
+    }
+    for (; i < size; ++i) {
+        if (data[i] != data[0]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef BRECO_X86_SEARCH_KERNELS
+template <bool kFoldCase, int kFixedSize = 0>
+__attribute__((target("sse2"))) int sse2Search(const unsigned char* haystack, int haystackSize,
+                                               const unsigned char* needle, int needleSize,
+                                               int from, QVector<int>* starts) {
+    if constexpr (kFixedSize > 0) {
+        needleSize = kFixedSize;
+    }
+    const int lastIdx = needleSize - 1;
+    const __m128i first = _mm_set1_epi8(static_cast<char>(needle[0]));
+    const __m128i last = _mm_set1_epi8(static_cast<char>(needle[lastIdx]));
+    const __m128i firstCaseBit = _mm_set1_epi8(static_cast<char>(caseBitFor(needle[0])));
+    const __m128i lastCaseBit = _mm_set1_epi8(static_cast<char>(caseBitFor(needle[lastIdx])));
+    const int lastLaneStart = haystackSize - lastIdx - 16;
+    int i = from;
+    for (; i <= lastLaneStart; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+        __m128i blockLast =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + lastIdx));
+        if constexpr (kFoldCase) {
+            blockFirst = _mm_or_si128(blockFirst, firstCaseBit);
+            blockLast = _mm_or_si128(blockLast, lastCaseBit);
+        }
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last))));
+        while (mask != 0) {
+            const int bit = __builtin_ctz(mask);
+            // Verified matches are rare; keeping them off the hot path keeps the lane
+            // constants in registers across the push_back call of collecting kernels.
+            if (innerBytesMatch<kFoldCase>(haystack + i + bit, needle, needleSize)) [[unlikely]] {
+                if constexpr (kFixedSize == 0) {
+                    return i + bit;
+                }
+                starts->push_back(i + bit);
+            }
+            mask &= mask - 1;
+        }
+    }
+    return scalarSearch<kFoldCase, kFixedSize>(haystack, haystackSize, needle, needleSize, i,
+                                               starts);
+}
+
+template <bool kFoldCase, int kFixedSize = 0>
+__attribute__((target("avx2"))) int avx2Search(const unsigned char* haystack, int haystackSize,
+                                               const unsigned char* needle, int needleSize,
+                                               int from, QVector<int>* starts) {
+    if constexpr (kFixedSize > 0) {
+        needleSize = kFixedSize;
+    }
+    const int lastIdx = needleSize - 1;
+    const __m256i first = _mm256_set1_epi8(static_cast<char>(needle[0]));
+    const __m256i last = _mm256_set1_epi8(static_cast<char>(needle[lastIdx]));
+    const __m256i firstCaseBit = _mm256_set1_epi8(static_cast<char>(caseBitFor(needle[0])));
+    const __m256i lastCaseBit = _mm256_set1_epi8(static_cast<char>(caseBitFor(needle[lastIdx])));
+    const int lastLaneStart = haystackSize - lastIdx - 32;
+    int i = from;
+    for (; i <= lastLaneStart; i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+        __m256i blockLast =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + lastIdx));
+        if constexpr (kFoldCase) {
+            blockFirst = _mm256_or_si256(blockFirst, firstCaseBit);
+            blockLast = _mm256_or_si256(blockLast, lastCaseBit);
+        }
+        unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last))));
+        while (mask != 0) {
+            const int bit = __builtin_ctz(mask);
+            if (innerBytesMatch<kFoldCase>(haystack + i + bit, needle, needleSize)) [[unlikely]] {
+                if constexpr (kFixedSize == 0) {
+                    return i + bit;
+                }
+                starts->push_back(i + bit);
+            }
+            mask &= mask - 1;
+        }
+    }
+    return scalarSearch<kFoldCase, kFixedSize>(haystack, haystackSize, needle, needleSize, i,
+                                               starts);
+}
+
+template <bool kFoldCase, int kFixedSize = 0>
+__attribute__((target("avx512f,avx512bw"))) int avx512Search(const unsigned char* haystack,
+                                                             int haystackSize,
+                                                             const unsigned char* needle,
+                                                             int needleSize, int from,
+                                                             QVector<int>* starts) {
+    if constexpr (kFixedSize > 0) {
+        needleSize = kFixedSize;
+    }
+    const int lastIdx = needleSize - 1;
+    const __m512i first = _mm512_set1_epi8(static_cast<char>(needle[0]));
+    const __m512i last = _mm512_set1_epi8(static_cast<char>(needle[lastIdx]));
+    const __m512i firstCaseBit = _mm512_set1_epi8(static_cast<char>(caseBitFor(needle[0])));
+    const __m512i lastCaseBit = _mm512_set1_epi8(static_cast<char>(caseBitFor(needle[lastIdx])));
+    const int lastLaneStart = haystackSize - lastIdx - 64;
+    int i = from;
+    for (; i <= lastLaneStart; i += 64) {
+        __m512i blockFirst = _mm512_loadu_si512(haystack + i);
+        __m512i blockLast = _mm512_loadu_si512(haystack + i + lastIdx);
+        if constexpr (kFoldCase) {
+            blockFirst = _mm512_or_si512(blockFirst, firstCaseBit);
+            blockLast = _mm512_or_si512(blockLast, lastCaseBit);
+        }
+        unsigned long long mask = _mm512_cmpeq_epi8_mask(blockFirst, first) &
+                                  _mm512_cmpeq_epi8_mask(blockLast, last);
+        while (mask != 0) {
+            const int bit = __builtin_ctzll(mask);
+            if (innerBytesMatch<kFoldCase>(haystack + i + bit, needle, needleSize)) [[unlikely]] {
+                if constexpr (kFixedSize == 0) {
+                    return i + bit;
+                }
+                starts->push_back(i + bit);
+            }
+            mask &= mask - 1;
+        }
+    }
+    return scalarSearch<kFoldCase, kFixedSize>(haystack, haystackSize, needle, needleSize, i,
+                                               starts);
+}
+
+__attribute__((target("sse2"))) int sse2MaskedSearch(const unsigned char* haystack,
+                                                     int haystackSize, const unsigned char* needle,
+                                                     const unsigned char* mask, int needleSize,
+                                                     int from, MaskedAnchors anchors) {
+    const __m128i firstMask = _mm_set1_epi8(static_cast<char>(mask[anchors.first]));
+    const __m128i first = _mm_set1_epi8(static_cast<char>(needle[anchors.first]));
+    const __m128i lastMask = _mm_set1_epi8(static_cast<char>(mask[anchors.last]));
+    const __m128i last = _mm_set1_epi8(static_cast<char>(needle[anchors.last]));
+    const int lastLaneStart = haystackSize - needleSize - 15;
+    int i = from;
+    for (; i <= lastLaneStart; i += 16) {
+        const __m128i blockFirst =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + anchors.first));
+        const __m128i blockLast =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + anchors.last));
+        unsigned int lanes = static_cast<unsigned int>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(blockFirst, firstMask), first),
+                          _mm_cmpeq_epi8(_mm_and_si128(blockLast, lastMask), last))));
+        while (lanes != 0) {
+            const int bit = __builtin_ctz(lanes);
+            if (maskedBytesMatch(haystack + i + bit, needle, mask, needleSize)) {
+                return i + bit;
+            }
+            lanes &= lanes - 1;
+        }
+    }
+    return scalarMaskedSearch(haystack, haystackSize, needle, mask, needleSize, i, anchors);
+}
+
+__attribute__((target("avx2"))) int avx2MaskedSearch(const unsigned char* haystack,
+                                                     int haystackSize, const unsigned char* needle,
+                                                     const unsigned char* mask, int needleSize,
+                                                     int from, MaskedAnchors anchors) {
+    const __m256i firstMask = _mm256_set1_epi8(static_cast<char>(mask[anchors.first]));
+    const __m256i first = _mm256_set1_epi8(static_cast<char>(needle[anchors.first]));
+    const __m256i lastMask = _mm256_set1_epi8(static_cast<char>(mask[anchors.last]));
+    const __m256i last = _mm256_set1_epi8(static_cast<char>(needle[anchors.last]));
+    const int lastLaneStart = haystackSize - needleSize - 31;
+    int i = from;
+    for (; i <= lastLaneStart; i += 32) {
+        const __m256i blockFirst =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + anchors.first));
+        const __m256i blockLast =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + anchors.last));
+        unsigned int lanes = static_cast<unsigned int>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(blockFirst, firstMask), first),
+                             _mm256_cmpeq_epi8(_mm256_and_si256(blockLast, lastMask), last))));
+        while (lanes != 0) {
+            const int bit = __builtin_ctz(lanes);
+            if (maskedBytesMatch(haystack + i + bit, needle, mask, needleSize)) {
+                return i + bit;
+            }
+            lanes &= lanes - 1;
+        }
+    }
+    return scalarMaskedSearch(haystack, haystackSize, needle, mask, needleSize, i, anchors);
+}
+
+__attribute__((target("avx512f,avx512bw"))) int avx512MaskedSearch(
+    const unsigned char* haystack, int haystackSize, const unsigned char* needle,
+    const unsigned char* mask, int needleSize, int from, MaskedAnchors anchors) {
+    const __m512i firstMask = _mm512_set1_epi8(static_cast<char>(mask[anchors.first]));
+    const __m512i first = _mm512_set1_epi8(static_cast<char>(needle[anchors.first]));
+    const __m512i lastMask = _mm512_set1_epi8(static_cast<char>(mask[anchors.last]));
+    const __m512i last = _mm512_set1_epi8(static_cast<char>(needle[anchors.last]));
+    const int lastLaneStart = haystackSize - needleSize - 63;
+    int i = from;
+    for (; i <= lastLaneStart; i += 64) {
+        const __m512i blockFirst = _mm512_loadu_si512(haystack + i + anchors.first);
+        const __m512i blockLast = _mm512_loadu_si512(haystack + i + anchors.last);
+        unsigned long long lanes =
+            _mm512_cmpeq_epi8_mask(_mm512_and_si512(blockFirst, firstMask), first) &
+            _mm512_cmpeq_epi8_mask(_mm512_and_si512(blockLast, lastMask), last);
+        while (lanes != 0) {
+            const int bit = __builtin_ctzll(lanes);
+            if (maskedBytesMatch(haystack + i + bit, needle, mask, needleSize)) {
+                return i + bit;
+            }
+            lanes &= lanes - 1;
+        }
+    }
+    return scalarMaskedSearch(haystack, haystackSize, needle, mask, needleSize, i, anchors);
+}
+
+// XOR every lane with the first byte and OR the differences together; 64 bytes per check.
+__attribute__((target("sse2"))) bool sse2IsConstant(const unsigned char* data, int size,
+                                                    int from) {
+    const __m128i value = _mm_set1_epi8(static_cast<char>(data[0]));
+    int i = from;
+    for (; i + 64 <= size; i += 64) {
+        const auto* lanes = reinterpret_cast<const __m128i*>(data + i);
+        const __m128i diff =
+            _mm_or_si128(_mm_or_si128(_mm_xor_si128(_mm_loadu_si128(lanes), value),
+                                      _mm_xor_si128(_mm_loadu_si128(lanes + 1), value)),
+                         _mm_or_si128(_mm_xor_si128(_mm_loadu_si128(lanes + 2), value),
+                                      _mm_xor_si128(_mm_loadu_si128(lanes + 3), value)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF) {
+            return false;
+        }
+    }
+    return scalarIsConstant(data, size, i);
+}
+
+__attribute__((target("avx2"))) bool avx2IsConstant(const unsigned char* data, int size,
+                                                    int from) {
+    const __m256i value = _mm256_set1_epi8(static_cast<char>(data[0]));
+    int i = from;
+    for (; i + 128 <= size; i += 128) {
+        const auto* lanes = reinterpret_cast<const __m256i*>(data + i);
+        const __m256i diff = _mm256_or_si256(
+            _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(lanes), value),
+                            _mm256_xor_si256(_mm256_loadu_si256(lanes + 1), value)),
+            _mm256_or_si256(_mm256_xor_si256(_mm256_loadu_si256(lanes + 2), value),
+                            _mm256_xor_si256(_mm256_loadu_si256(lanes + 3), value)));
+        if (!_mm256_testz_si256(diff, diff)) {
+            return false;
+        }
+    }
+    return scalarIsConstant(data, size, i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) bool avx512IsConstant(const unsigned char* data,
+                                                                  int size, int from) {
+    const __m512i value = _mm512_set1_epi8(static_cast<char>(data[0]));
+    int i = from;
+    for (; i + 256 <= size; i += 256) {
+        const __m512i diff = _mm512_or_si512(
+            _mm512_or_si512(_mm512_xor_si512(_mm512_loadu_si512(data + i), value),
+                            _mm512_xor_si512(_mm512_loadu_si512(data + i + 64), value)),
+            _mm512_or_si512(_mm512_xor_si512(_mm512_loadu_si512(data + i + 128), value),
+                            _mm512_xor_si512(_mm512_loadu_si512(data + i + 192), value)));
+        if (_mm512_test_epi8_mask(diff, diff) != 0) {
+            return false;
+        }
+    }
+    return scalarIsConstant(data, size, i);
+}
+#endif
+
+SearchKernel detectBestKernel() {
+#ifdef BRECO_X86_SEARCH_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return SearchKernel::Avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SearchKernel::Avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SearchKernel::Sse2;
+    }
+#endif
+    return SearchKernel::Scalar;
+}
+
+template <bool kFoldCase>
+KernelFn kernelFunction(SearchKernel kernel) {
+    switch (kernel) {
+#ifdef BRECO_X86_SEARCH_KERNELS
+        case SearchKernel::Sse2:
+            return sse2Search<kFoldCase>;
+        case SearchKernel::Avx2:
+            return avx2Search<kFoldCase>;
+        case SearchKernel::Avx512:
+            return avx512Search<kFoldCase>;
+#endif
+        case SearchKernel::Scalar:
+        default:
+            return scalarSearch<kFoldCase>;
+    }
+}
+
+template <bool kFoldCase, int kFixedSize, SearchKernel kKernel>
+constexpr KernelFn fixedKernel() {
+#ifdef BRECO_X86_SEARCH_KERNELS
+    if constexpr (kKernel == SearchKernel::Sse2) {
+        return sse2Search<kFoldCase, kFixedSize>;
+    } else if constexpr (kKernel == SearchKernel::Avx2) {
+        return avx2Search<kFoldCase, kFixedSize>;
+    } else if constexpr (kKernel == SearchKernel::Avx512) {
+        return avx512Search<kFoldCase, kFixedSize>;
+    }
+#endif
+    return scalarSearch<kFoldCase, kFixedSize>;
+}
+
+// One pass per job: the kernel and needle size are template arguments, so nothing is looked up
+// or re-checked between candidates.
+template <KernelFn kKernel, int kSize>
+void fixedFindAll(const char* haystack, int haystackSize, int startLimit, const char* needle,
+                  QVector<int>* starts) {
+    if (haystack == nullptr || startLimit <= 0) {
+        return;
+    }
+    // Matches starting at or past startLimit are not wanted; stop the lanes before them.
+    const int end = static_cast<int>(
+        qMin<qint64>(haystackSize, static_cast<qint64>(startLimit) + kSize - 1));
+    if (end >= kSize) {
+        kKernel(reinterpret_cast<const unsigned char*>(haystack), end,
+                reinterpret_cast<const unsigned char*>(needle), kSize, 0, starts);
+    }
+}
+
+template <bool kFoldCase, SearchKernel kKernel, int... kSizes>
+constexpr std::array<ByteSearch::FindAllFn, sizeof...(kSizes)> fixedFindAllTable(
+    std::integer_sequence<int, kSizes...>) {
+    return {fixedFindAll<fixedKernel<kFoldCase, kSizes + 1, kKernel>(), kSizes + 1>...};
+}
+
+template <SearchKernel kKernel>
+ByteSearch::FindAllFn fixedFindAllFunction(int needleSize, bool foldCase) {
+    static constexpr auto kExact = fixedFindAllTable<false, kKernel>(
+        std::make_integer_sequence<int, ByteSearch::kMaxFixedNeedleSize>());
+    static constexpr auto kFolded = fixedFindAllTable<true, kKernel>(
+        std::make_integer_sequence<int, ByteSearch::kMaxFixedNeedleSize>());
+    return (foldCase ? kFolded : kExact)[static_cast<size_t>(needleSize - 1)];
+}
+
+MaskedKernelFn maskedKernelFunction(SearchKernel kernel) {
+    switch (kernel) {
+#ifdef BRECO_X86_SEARCH_KERNELS
+        case SearchKernel::Sse2:
+            return sse2MaskedSearch;
+        case SearchKernel::Avx2:
+            return avx2MaskedSearch;
+        case SearchKernel::Avx512:
+            return avx512MaskedSearch;
+#endif
+        case SearchKernel::Scalar:
+        default:
+            return scalarMaskedSearch;
+    }
+}
+
+ConstantKernelFn constantKernelFunction(SearchKernel kernel) {
+    switch (kernel) {
+#ifdef BRECO_X86_SEARCH_KERNELS
+        case SearchKernel::Sse2:
+            return sse2IsConstant;
+        case SearchKernel::Avx2:
+            return avx2IsConstant;
+        case SearchKernel::Avx512:
+            return avx512IsConstant;
+#endif
+        case SearchKernel::Scalar:
+        default:
+            return scalarIsConstant;
+    }
+}
+
+bool validSearchRange(const char* haystack, int haystackSize, const char* needle, int needleSize,
+                      int start) {
+    return haystack != nullptr && needle != nullptr && needleSize > 0 &&
+           needleSize <= haystackSize - start;
+}
+}  // namespace
+
+SearchKernel ByteSearch::bestKernel() {
+    static const SearchKernel kernel = detectBestKernel();
+    return kernel;
+}
+
+bool ByteSearch::kernelSupported(SearchKernel kernel) {
+    switch (kernel) {
+        case SearchKernel::Scalar:
+            return true;
+#ifdef BRECO_X86_SEARCH_KERNELS
+        case SearchKernel::Sse2:
+            return __builtin_cpu_supports("sse2");
+        case SearchKernel::Avx2:
+            return __builtin_cpu_supports("avx2");
+        case SearchKernel::Avx512:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* ByteSearch::kernelName(SearchKernel kernel) {
+    switch (kernel) {
+        case SearchKernel::Sse2:
+            return "sse2";
+        case SearchKernel::Avx2:
+            return "avx2";
+        case SearchKernel::Avx512:
+            return "avx512";
+        case SearchKernel::Scalar:
+        default:
+            return "scalar";
+    }
+}
+
+unsigned char ByteSearch::asciiLower(unsigned char c) { return kAsciiLower[c]; }
+
+int ByteSearch::indexOf(const char* haystack, int haystackSize, const char* needle, int needleSize,
+                        int from) {
+    static const KernelFn bestFn = kernelFunction<false>(bestKernel());
+    const int start = qMax(0, from);
+    if (!validSearchRange(haystack, haystackSize, needle, needleSize, start)) {
+        return -1;
+    }
+    return bestFn(reinterpret_cast<const unsigned char*>(haystack), haystackSize,
+                  reinterpret_cast<const unsigned char*>(needle), needleSize, start, nullptr);
+}
+
+int ByteSearch::indexOf(const char* haystack, int haystackSize, const char* needle, int needleSize,
+                        int from, SearchKernel kernel) {
+    const int start = qMax(0, from);
+    if (!validSearchRange(haystack, haystackSize, needle, needleSize, start) ||
+        !kernelSupported(kernel)) {
+        return -1;
+    }
+    return kernelFunction<false>(kernel)(reinterpret_cast<const unsigned char*>(haystack),
+                                         haystackSize,
+                                         reinterpret_cast<const unsigned char*>(needle),
+                                         needleSize, start, nullptr);
+}
+
+int ByteSearch::indexOfFolded(const char* haystack, int haystackSize, const char* foldedNeedle,
+                              int needleSize, int from) {
+    static const KernelFn bestFn = kernelFunction<true>(bestKernel());
+    const int start = qMax(0, from);
+    if (!validSearchRange(haystack, haystackSize, foldedNeedle, needleSize, start)) {
+        return -1;
+    }
+    return bestFn(reinterpret_cast<const unsigned char*>(haystack), haystackSize,
+                  reinterpret_cast<const unsigned char*>(foldedNeedle), needleSize, start,
+                  nullptr);
+}
+
+int ByteSearch::indexOfFolded(const char* haystack, int haystackSize, const char* foldedNeedle,
+                              int needleSize, int from, SearchKernel kernel) {
+    const int start = qMax(0, from);
+    if (!validSearchRange(haystack, haystackSize, foldedNeedle, needleSize, start) ||
+        !kernelSupported(kernel)) {
+        return -1;
+    }
+    return kernelFunction<true>(kernel)(reinterpret_cast<const unsigned char*>(haystack),
+                                        haystackSize,
+                                        reinterpret_cast<const unsigned char*>(foldedNeedle),
+                                        needleSize, start, nullptr);
+}
+
+ByteSearch::FindAllFn ByteSearch::findAllFunction(int needleSize, bool foldCase) {
+    return findAllFunction(needleSize, foldCase, bestKernel());
+}
+
+ByteSearch::FindAllFn ByteSearch::findAllFunction(int needleSize, bool foldCase,
+                                                  SearchKernel kernel) {
+    if (needleSize < 1 || needleSize > kMaxFixedNeedleSize || !kernelSupported(kernel)) {
+        return nullptr;
+    }
+    switch (kernel) {
+#ifdef BRECO_X86_SEARCH_KERNELS
+        case SearchKernel::Sse2:
+            return fixedFindAllFunction<SearchKernel::Sse2>(needleSize, foldCase);
+        case SearchKernel::Avx2:
+            return fixedFindAllFunction<SearchKernel::Avx2>(needleSize, foldCase);
+        case SearchKernel::Avx512:
+            return fixedFindAllFunction<SearchKernel::Avx512>(needleSize, foldCase);
+#endif
+        case SearchKernel::Scalar:
+        default:
+            return fixedFindAllFunction<SearchKernel::Scalar>(needleSize, foldCase);
+    }
+}
+
+int ByteSearch::indexOfMasked(const char* haystack, int haystackSize, const char* needle,
+                              const char* mask, int needleSize, int from) {
+    static const MaskedKernelFn bestFn = maskedKernelFunction(bestKernel());
+    const int start = qMax(0, from);
+    if (mask == nullptr || !validSearchRange(haystack, haystackSize, needle, needleSize, start)) {
+        return -1;
+    }
+    const auto* maskBytes = reinterpret_cast<const unsigned char*>(mask);
+    return bestFn(reinterpret_cast<const unsigned char*>(haystack), haystackSize,
+                  reinterpret_cast<const unsigned char*>(needle), maskBytes, needleSize, start,
+                  chooseMaskedAnchors(maskBytes, needleSize));
+}
+
+int ByteSearch::indexOfMasked(const char* haystack, int haystackSize, const char* needle,
+                              const char* mask, int needleSize, int from, SearchKernel kernel) {
+    const int start = qMax(0, from);
+    if (mask == nullptr || !validSearchRange(haystack, haystackSize, needle, needleSize, start) ||
+        !kernelSupported(kernel)) {
+        return -1;
+    }
+    const auto* maskBytes = reinterpret_cast<const unsigned char*>(mask);
+    return maskedKernelFunction(kernel)(reinterpret_cast<const unsigned char*>(haystack),
+                                        haystackSize,
+                                        reinterpret_cast<const unsigned char*>(needle), maskBytes,
+                                        needleSize, start,
+                                        chooseMaskedAnchors(maskBytes, needleSize));
+}
+
+bool ByteSearch::isConstant(const char* data, int size) {
+    static const ConstantKernelFn bestFn = constantKernelFunction(bestKernel());
+    return data != nullptr && size > 0 &&
+           bestFn(reinterpret_cast<const unsigned char*>(data), size, 1);
+}
+
+bool ByteSearch::isConstant(const char* data, int size, SearchKernel kernel) {
+    return data != nullptr && size > 0 && kernelSupported(kernel) &&
+           constantKernelFunction(kernel)(reinterpret_cast<const unsigned char*>(data), size, 1);
+}
+
+void ByteSearch::xorAdjacent(const char* data, int size, char* out) {
+    // Plain loop on purpose: it has no dependencies between iterations and auto-vectorizes.
+    const auto* in = reinterpret_cast<const unsigned char*>(data);
+    auto* diff = reinterpret_cast<unsigned char*>(out);
+    for (int i = 0; i + 1 < size; ++i) {
+        diff[i] = static_cast<unsigned char>(in[i] ^ in[i + 1]);
+    }
+}
+
+}  // namespace breco
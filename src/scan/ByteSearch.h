@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QVector>
+#include <QtGlobal>
+
+namespace breco {
+
+enum class SearchKernel {
+    Scalar = 0,
+    Sse2,
+    Avx2,
+    Avx512
+};
+
+// Substring search over raw bytes. Candidate positions are filtered by comparing the first and
+// last needle bytes across a full SIMD lane, then verified. The widest kernel the CPU supports is
+// picked once (cpuid) and reused for every call.
+class ByteSearch {
+public:
+    static constexpr int kMaxFixedNeedleSize = 16;
+
+    // Appends every start before `startLimit` to `starts`, in order. `needle` must be folded
+    // with asciiLower() for case-insensitive functions.
+    using FindAllFn = void (*)(const char* haystack, int haystackSize, int startLimit,
+                               const char* needle, QVector<int>* starts);
+
+    static SearchKernel bestKernel();
+    static bool kernelSupported(SearchKernel kernel);
+    static const char* kernelName(SearchKernel kernel);
+    static unsigned char asciiLower(unsigned char c);
+
+    static int indexOf(const char* haystack, int haystackSize, const char* needle, int needleSize,
+                       int from);
+    static int indexOf(const char* haystack, int haystackSize, const char* needle, int needleSize,
+                       int from, SearchKernel kernel);
+
+    // ASCII case-insensitive search. `foldedNeedle` must already be lowercased with asciiLower();
+    // haystack bytes are folded in-lane, so the needle is folded once per term, not per call.
+    static int indexOfFolded(const char* haystack, int haystackSize, const char* foldedNeedle,
+                             int needleSize, int from);
+    static int indexOfFolded(const char* haystack, int haystackSize, const char* foldedNeedle,
+                             int needleSize, int from, SearchKernel kernel);
+
+    // The first/last-byte search instantiated for one needle size (1..kMaxFixedNeedleSize) and
+    // case mode, so candidates are verified with a fixed-width compare. nullptr for other sizes.
+    static FindAllFn findAllFunction(int needleSize, bool foldCase);
+    static FindAllFn findAllFunction(int needleSize, bool foldCase, SearchKernel kernel);
+
+    // Search under a per-byte mask: matches where (haystack[i + j] & mask[j]) == needle[j] for
+    // every j. `needle` must already be ANDed with `mask`. Lanes are filtered on the ends of the
+    // longest fully fixed run (or the outermost constrained bytes when there is no such run).
+    static int indexOfMasked(const char* haystack, int haystackSize, const char* needle,
+                             const char* mask, int needleSize, int from);
+    static int indexOfMasked(const char* haystack, int haystackSize, const char* needle,
+                             const char* mask, int needleSize, int from, SearchKernel kernel);
+
+    // True when all `size` bytes of `data` equal its first byte (a zero-filled or erased
+    // sector): every lane is XORed with that byte and the differences ORed, one test per 64 bytes
+    // (SSE2), 128 (AVX2) or 256 (AVX-512). False when `size` is 0.
+    static bool isConstant(const char* data, int size);
+    static bool isConstant(const char* data, int size, SearchKernel kernel);
+
+    // out[i] = data[i] ^ data[i + 1] for i < size - 1: the single-byte-XOR invariant view of
+    // `data` that XOR-key scans search.
+    static void xorAdjacent(const char* data, int size, char* out);
+};
+
+}  // namespace breco
@@ -0,0 +1,103 @@
+#include "scan/EntropyMap.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace breco {
+
+namespace {
+constexpr int kSubHistograms = 4;
+}
+
+EntropyMap::EntropyMap(quint64 fileSize)
+    : m_fileSize(fileSize),
+      m_levels(static_cast<size_t>((fileSize + kBlockBytes - 1) / kBlockBytes), kUnmeasured) {}
+
+quint64 EntropyMap::fileSize() const { return m_fileSize; }
+
+int EntropyMap::blockCount() const { return static_cast<int>(m_levels.size()); }
+
+quint8 EntropyMap::level(int block) const {
+    return block >= 0 && block < blockCount() ? m_levels[static_cast<size_t>(block)] : kUnmeasured;
+}
+
+bool EntropyMap::isEmpty() const { return m_levels.empty(); }
+
+void EntropyMap::measure(const char* data, quint64 dataStart, quint64 dataSize, quint64 from,
+                         quint64 to) {
+    if (data == nullptr || m_levels.empty()) {
+        return;
+    }
+    const quint64 dataEnd = dataStart + dataSize;
+    for (quint64 block = (from + kBlockBytes - 1) / kBlockBytes;
+         block < m_levels.size() && block * kBlockBytes < to; ++block) {
+        const quint64 blockStart = block * kBlockBytes;
+        const quint64 blockEnd = qMin(qMin(blockStart + kBlockBytes, m_fileSize), dataEnd);
+        if (blockStart < dataStart || blockEnd <= blockStart) {
+            continue;
+        }
+        m_levels[static_cast<size_t>(block)] = levelFor(entropyBits(
+            data + (blockStart - dataStart), static_cast<int>(blockEnd - blockStart)));
+    }
+}
+
+// Bytes go round-robin into four histograms: in runs of one value (zero fill, padding) each
+// increment would otherwise wait for the store of the previous one to the same counter.
+double EntropyMap::entropyBits(const char* data, int size) {
+    if (data == nullptr || size <= 0) {
+        return 0.0;
+    }
+    std::array<std::array<quint32, 256>, kSubHistograms> counts{};
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    int i = 0;
+    for (; i + 8 <= size; i += 8) {
+        quint64 word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        ++counts[0][word & 0xFF];
+        ++counts[1][(word >> 8) & 0xFF];
+        ++counts[2][(word >> 16) & 0xFF];
+        ++counts[3][(word >> 24) & 0xFF];
+        ++counts[0][(word >> 32) & 0xFF];
+        ++counts[1][(word >> 40) & 0xFF];
+        ++counts[2][(word >> 48) & 0xFF];
+        ++counts[3][word >> 56];
+    }
+    for (; i < size; ++i) {
+        ++counts[0][bytes[i]];
+    }
+    double sum = 0.0;
+    for (int value = 0; value < 256; ++value) {
+        quint32 count = 0;
+        for (const auto& histogram : counts) {
+            count += histogram[value];
+        }
+        if (count != 0) {
+            sum += count * std::log2(static_cast<double>(count));
+        }
+    }
+    return qMax(0.0, std::log2(static_cast<double>(size)) - sum / size);
+}
+
+double EntropyMap::sampledEntropyBits(const char* data, int size) {
+    constexpr int kSampleBytes = kSampleSlices * kSliceBytes;
+    if (size <= kSampleBytes) {
+        return entropyBits(data, size);
+    }
+    std::array<char, kSampleBytes> sample;
+    const qint64 stride = (static_cast<qint64>(size) - kSliceBytes) / (kSampleSlices - 1);
+    for (int slice = 0; slice < kSampleSlices; ++slice) {
+        std::memcpy(sample.data() + slice * kSliceBytes, data + slice * stride, kSliceBytes);
+    }
+    return entropyBits(sample.data(), kSampleBytes);
+}
+
+quint8 EntropyMap::levelFor(double bits) {
+    return static_cast<quint8>(qBound(0L, std::lround(bits * kLevelsPerBit), 8L * kLevelsPerBit));
+}
+
+double EntropyMap::bitsForLevel(quint8 level) {
+    return static_cast<double>(level) / kLevelsPerBit;
+}
+
+}  // namespace breco
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QtGlobal>
+#include <vector>
+
+namespace breco {
+
+// Shannon entropy of one scan target in blocks of kBlockBytes, measured by the workers from the
+// bytes they already hold (entropy map scans), so triage needs no second read. Each level is the
+// block's entropy in 1/kLevelsPerBit bits per byte (0..240); blocks no job measured (stopped
+// scans, the unread rest of targets decided by existence scans) stay kUnmeasured.
+class EntropyMap {
+public:
+    static constexpr quint64 kBlockBytes = 64 * 1024;
+    static constexpr int kLevelsPerBit = 30;
+    static constexpr quint8 kUnmeasured = 255;
+    // sampledEntropyBits() histograms kSampleSlices evenly spaced runs of kSliceBytes.
+    static constexpr int kSampleSlices = 16;
+    static constexpr int kSliceBytes = 256;
+
+    EntropyMap() = default;
+    explicit EntropyMap(quint64 fileSize);
+
+    quint64 fileSize() const;
+    int blockCount() const;
+    quint8 level(int block) const;
+    bool isEmpty() const;
+
+    // Measures the blocks whose first byte is in [from, to) from `data`, the file bytes starting
+    // at `dataStart`. A block running past the end of `data` (a read block that is not a multiple
+    // of kBlockBytes) is measured on the bytes `data` has. Jobs own disjoint ranges, so workers
+    // can measure one map concurrently.
+    void measure(const char* data, quint64 dataStart, quint64 dataSize, quint64 from, quint64 to);
+
+    // Bits per byte (0..8) of the byte distribution of `data`.
+    static double entropyBits(const char* data, int size);
+    // Estimate of entropyBits() from a 4 KiB sample; exact for `size` up to the sample size. On
+    // random data it reads about 7.95 bits.
+    static double sampledEntropyBits(const char* data, int size);
+    static quint8 levelFor(double bits);
+    static double bitsForLevel(quint8 level);
+
+private:
+    quint64 m_fileSize = 0;
+    std::vector<quint8> m_levels;
+};
+
+}  // namespace breco
@@ -0,0 +1,340 @@
+#include "scan/FileCarver.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace breco {
+
+namespace {
+constexpr quint64 kMiB = 1024ULL * 1024ULL;
+constexpr quint64 kGiB = 1024ULL * kMiB;
+
+// Literals keep their embedded NUL bytes.
+template <int N>
+QByteArray bytes(const char (&text)[N]) {
+    return QByteArray(text, N - 1);
+}
+
+quint64 readLittleEndian(const QByteArray& head, int at, int size) {
+    quint64 value = 0;
+    for (int i = size - 1; i >= 0; --i) {
+        value = (value << 8) | static_cast<unsigned char>(head.at(at + i));
+    }
+    return value;
+}
+
+quint64 readBigEndian(const QByteArray& head, int at, int size) {
+    quint64 value = 0;
+    for (int i = 0; i < size; ++i) {
+        value = (value << 8) | static_cast<unsigned char>(head.at(at + i));
+    }
+    return value;
+}
+
+// Signature header: the next header's offset (after the 32 header bytes) and size.
+quint64 sevenZipSize(const QByteArray& head) {
+    const quint64 nextHeaderOffset = readLittleEndian(head, 12, 8);
+    const quint64 nextHeaderSize = readLittleEndian(head, 20, 8);
+    if (nextHeaderOffset > (1ULL << 48) || nextHeaderSize > (1ULL << 48)) {
+        return 0;
+    }
+    return 32 + nextHeaderOffset + nextHeaderSize;
+}
+
+// Page size times the in-header page count, which is only valid while the change counter at 24
+// equals the version-valid-for number at 92.
+quint64 sqliteSize(const QByteArray& head) {
+    quint64 pageSize = readBigEndian(head, 16, 2);
+    if (pageSize == 1) {
+        pageSize = 65536;
+    }
+    if (pageSize < 512 || (pageSize & (pageSize - 1)) != 0 ||
+        readBigEndian(head, 24, 4) != readBigEndian(head, 92, 4)) {
+        return 0;
+    }
+    return pageSize * readBigEndian(head, 28, 4);
+}
+
+// The RIFF chunk size counts the bytes after itself.
+quint64 riffSize(const QByteArray& head) {
+    const quint64 chunkSize = readLittleEndian(head, 4, 4);
+    return chunkSize < 4 ? 0 : chunkSize + 8;
+}
+
+CarveSignature footerSignature(const QString& name, const QString& extension,
+                               const QByteArray& header, const QByteArray& footer,
+                               quint64 maxSize) {
+    CarveSignature signature;
+    signature.name = name;
+    signature.extension = extension;
+    signature.header = header;
+    signature.footer = footer;
+    signature.maxSize = maxSize;
+    return signature;
+}
+
+CarveSignature sizeFieldSignature(const QString& name, const QString& extension,
+                                  const QByteArray& header, const QByteArray& headerMask,
+                                  int sizeFieldBytes, quint64 (*sizeOf)(const QByteArray&),
+                                  quint64 maxSize) {
+    CarveSignature signature;
+    signature.name = name;
+    signature.extension = extension;
+    signature.header = header;
+    signature.headerMask = headerMask;
+    signature.end = CarveEnd::SizeField;
+    signature.sizeFieldBytes = sizeFieldBytes;
+    signature.sizeOf = sizeOf;
+    signature.maxSize = maxSize;
+    return signature;
+}
+}  // namespace
+
+FileCarver::FileCarver(QVector<CarveSignature> signatures) : m_signatures(std::move(signatures)) {
+    for (int signatureIdx = 0; signatureIdx < m_signatures.size(); ++signatureIdx) {
+        CarveSignature& signature = m_signatures[signatureIdx];
+        if (signature.headerMask.size() != signature.header.size()) {
+            signature.headerMask = QByteArray(signature.header.size(), static_cast<char>(0xFF));
+        }
+        m_query.terms.push_back(signature.header);
+        m_query.masks.push_back(signature.headerMask);
+        m_termRoles.push_back(TermRole{signatureIdx, false});
+        m_termLabels.push_back(signature.name);
+    }
+    for (int signatureIdx = 0; signatureIdx < m_signatures.size(); ++signatureIdx) {
+        const CarveSignature& signature = m_signatures.at(signatureIdx);
+        if (signature.end == CarveEnd::SizeField || signature.footer.isEmpty()) {
+            continue;
+        }
+        m_query.terms.push_back(signature.footer);
+        m_query.masks.push_back(QByteArray(signature.footer.size(), static_cast<char>(0xFF)));
+        m_termRoles.push_back(TermRole{signatureIdx, true});
+        m_termLabels.push_back(QStringLiteral("%1 footer").arg(signature.name));
+    }
+}
+
+QVector<CarveSignature> FileCarver::builtInSignatures() {
+    QVector<CarveSignature> signatures;
+
+    CarveSignature jpeg = footerSignature(QStringLiteral("JPEG"), QStringLiteral("jpg"),
+                                          bytes("\xFF\xD8\xFF"), bytes("\xFF\xD9"), 128 * kMiB);
+    jpeg.repeat = CarveRepeat::NestedFile;
+    jpeg.nestBytes = 64 * 1024;
+    signatures.push_back(jpeg);
+
+    signatures.push_back(footerSignature(QStringLiteral("PNG"), QStringLiteral("png"),
+                                         bytes("\x89PNG\r\n\x1A\n"),
+                                         bytes("IEND\xAE\x42\x60\x82"), 256 * kMiB));
+
+    CarveSignature gif = footerSignature(QStringLiteral("GIF"), QStringLiteral("gif"),
+                                         bytes("GIF8\0a"), bytes("\0\x3B"), 64 * kMiB);
+    gif.headerMask = bytes("\xFF\xFF\xFF\xFF\0\xFF");
+    signatures.push_back(gif);
+
+    CarveSignature pdf = footerSignature(QStringLiteral("PDF"), QStringLiteral("pdf"),
+                                         bytes("%PDF-"), bytes("%%EOF"), kGiB);
+    pdf.end = CarveEnd::LastFooter;
+    signatures.push_back(pdf);
+
+    // The end of central directory record is 22 bytes plus a comment, which is usually empty.
+    CarveSignature zip = footerSignature(QStringLiteral("ZIP"), QStringLiteral("zip"),
+                                         bytes("PK\x03\x04"), bytes("PK\x05\x06"), 4 * kGiB);
+    zip.footerTail = 18;
+    zip.repeat = CarveRepeat::InsideFile;
+    signatures.push_back(zip);
+
+    signatures.push_back(sizeFieldSignature(QStringLiteral("7z"), QStringLiteral("7z"),
+                                            bytes("7z\xBC\xAF\x27\x1C"), QByteArray(), 32,
+                                            sevenZipSize, 64 * kGiB));
+    signatures.push_back(sizeFieldSignature(QStringLiteral("SQLite"), QStringLiteral("sqlite"),
+                                            bytes("SQLite format 3\0"), QByteArray(), 100,
+                                            sqliteSize, 64 * kGiB));
+
+    const QByteArray riffMask = bytes("\xFF\xFF\xFF\xFF\0\0\0\0\xFF\xFF\xFF\xFF");
+    signatures.push_back(sizeFieldSignature(QStringLiteral("WAV"), QStringLiteral("wav"),
+                                            bytes("RIFF\0\0\0\0WAVE"), riffMask, 8, riffSize,
+                                            4 * kGiB + 8));
+    signatures.push_back(sizeFieldSignature(QStringLiteral("AVI"), QStringLiteral("avi"),
+                                            bytes("RIFF\0\0\0\0AVI "), riffMask, 8, riffSize,
+                                            4 * kGiB + 8));
+    signatures.push_back(sizeFieldSignature(QStringLiteral("WebP"), QStringLiteral("webp"),
+                                            bytes("RIFF\0\0\0\0WEBP"), riffMask, 8, riffSize,
+                                            4 * kGiB + 8));
+    return signatures;
+}
+
+const QVector<CarveSignature>& FileCarver::signatures() const { return m_signatures; }
+
+const SearchQuery& FileCarver::searchQuery() const { return m_query; }
+
+const CarveSignature* FileCarver::signatureForTerm(int termIdx) const {
+    const TermRole* role = roleForTerm(termIdx);
+    return role != nullptr ? &m_signatures.at(role->signatureIdx) : nullptr;
+}
+
+const QVector<QString>& FileCarver::termLabels() const { return m_termLabels; }
+
+// Footers are only kept, never dropped, retroactively: the last footer before a header is known
+// once the header is reached.
+void FileCarver::thinFooterHits(QVector<SearchHit>* hits) const {
+    thread_local std::vector<int> footersSinceHeader;
+    thread_local std::vector<int> lastFooter;
+    thread_local std::vector<char> keep;
+    footersSinceHeader.assign(static_cast<size_t>(m_signatures.size()), 0);
+    lastFooter.assign(static_cast<size_t>(m_signatures.size()), -1);
+    keep.assign(static_cast<size_t>(hits->size()), 0);
+    for (int i = 0; i < hits->size(); ++i) {
+        const TermRole* role = roleForTerm(hits->at(i).termIdx);
+        if (role == nullptr) {
+            keep[i] = 1;
+            continue;
+        }
+        const auto signatureIdx = static_cast<size_t>(role->signatureIdx);
+        if (!role->footer) {
+            keep[i] = 1;
+            if (lastFooter[signatureIdx] >= 0) {
+                keep[lastFooter[signatureIdx]] = 1;
+            }
+            footersSinceHeader[signatureIdx] = 0;
+            lastFooter[signatureIdx] = -1;
+            continue;
+        }
+        if (footersSinceHeader[signatureIdx] < kKeptFooters) {
+            keep[i] = 1;
+        }
+        ++footersSinceHeader[signatureIdx];
+        lastFooter[signatureIdx] = i;
+    }
+    for (const int footerIdx : lastFooter) {
+        if (footerIdx >= 0) {
+            keep[footerIdx] = 1;
+        }
+    }
+    int kept = 0;
+    for (int i = 0; i < hits->size(); ++i) {
+        if (keep[i] != 0) {
+            (*hits)[kept++] = hits->at(i);
+        }
+    }
+    hits->resize(kept);
+}
+
+QVector<MatchRecord> FileCarver::carve(const QVector<MatchRecord>& matches,
+                                       const QVector<quint64>& targetSizes,
+                                       quint32 headerAlignment, const ReadFunction& read) const {
+    struct OpenFile {
+        bool open = false;
+        MatchRecord header;
+        // Embedded files (CarveRepeat::NestedFile) whose footers come first.
+        int nested = 0;
+        // LastFooter: end of the last footer so far; 0 for none.
+        quint64 end = 0;
+    };
+
+    QVector<MatchRecord> files;
+    const auto addFile = [&files, &targetSizes](const MatchRecord& header, quint64 end) {
+        const quint64 fileEnd = qMin(end, targetSizes.value(header.scanTargetIdx, end));
+        if (fileEnd <= header.offset) {
+            return;
+        }
+        MatchRecord file = header;
+        file.matchLength = fileEnd - header.offset;
+        files.push_back(file);
+    };
+    // Files closed without a footer are dropped, except LastFooter files that had one.
+    const auto closeFile = [&addFile](OpenFile* file) {
+        if (file->open && file->end > 0) {
+            addFile(file->header, file->end);
+        }
+        *file = OpenFile{};
+    };
+
+    const quint32 alignment = qMax<quint32>(1, headerAlignment);
+    QVector<OpenFile> openFiles(m_signatures.size());
+    int scanTargetIdx = -1;
+    for (const MatchRecord& match : matches) {
+        if (match.scanTargetIdx != scanTargetIdx) {
+            for (OpenFile& file : openFiles) {
+                closeFile(&file);
+            }
+            scanTargetIdx = match.scanTargetIdx;
+        }
+        const TermRole* role = roleForTerm(match.termIdx);
+        if (role == nullptr) {
+            continue;
+        }
+        const CarveSignature& signature = m_signatures.at(role->signatureIdx);
+        OpenFile& file = openFiles[role->signatureIdx];
+        if (file.open && match.offset - file.header.offset > signature.maxSize) {
+            closeFile(&file);
+        }
+
+        if (role->footer) {
+            if (!file.open) {
+                continue;
+            }
+            const quint64 end = match.offset + static_cast<quint64>(signature.footer.size()) +
+                                static_cast<quint64>(signature.footerTail);
+            if (signature.end == CarveEnd::LastFooter) {
+                file.end = end;
+            } else if (file.nested > 0) {
+                --file.nested;
+            } else {
+                addFile(file.header, end);
+                file = OpenFile{};
+            }
+            continue;
+        }
+
+        if (match.offset % alignment != 0) {
+            continue;
+        }
+        if (signature.end == CarveEnd::SizeField) {
+            if (signature.sizeOf == nullptr || !read) {
+                continue;
+            }
+            const QByteArray head = read(match.scanTargetIdx, match.offset,
+                                         static_cast<quint64>(signature.sizeFieldBytes));
+            const quint64 size =
+                head.size() >= signature.sizeFieldBytes ? signature.sizeOf(head) : 0;
+            if (size > 0 && size <= signature.maxSize) {
+                addFile(match, match.offset + size);
+            }
+            continue;
+        }
+        if (file.open) {
+            if (signature.repeat == CarveRepeat::InsideFile) {
+                continue;
+            }
+            if (signature.repeat == CarveRepeat::NestedFile &&
+                match.offset - file.header.offset <= signature.nestBytes) {
+                ++file.nested;
+                continue;
+            }
+            closeFile(&file);
+        }
+        file.open = true;
+        file.header = match;
+    }
+    for (OpenFile& file : openFiles) {
+        closeFile(&file);
+    }
+
+    std::sort(files.begin(), files.end(), [](const MatchRecord& lhs, const MatchRecord& rhs) {
+        if (lhs.scanTargetIdx != rhs.scanTargetIdx) {
+            return lhs.scanTargetIdx < rhs.scanTargetIdx;
+        }
+        if (lhs.offset != rhs.offset) {
+            return lhs.offset < rhs.offset;
+        }
+        return lhs.termIdx < rhs.termIdx;
+    });
+    return files;
+}
+
+const FileCarver::TermRole* FileCarver::roleForTerm(int termIdx) const {
+    return termIdx >= 0 && termIdx < m_termRoles.size() ? &m_termRoles.at(termIdx) : nullptr;
+}
+
+}  // namespace breco
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+#include "model/ResultTypes.h"
+#include "scan/SearchPlan.h"
+
+namespace breco {
+
+// How a carved file's end is found.
+enum class CarveEnd {
+    // The first footer after the header that does not close an embedded file.
+    Footer,
+    // The last footer before the signature's next header or `maxSize` (PDF incremental updates
+    // append sections that each end in a footer).
+    LastFooter,
+    // A length read from the bytes at the header.
+    SizeField
+};
+
+// What a header of a signature seen while one of its files is still open means.
+enum class CarveRepeat {
+    // The open file has no footer (it was overwritten or truncated); the header starts a new one.
+    StartsNewFile,
+    // Headers repeat inside a file (ZIP local file headers, one per member).
+    InsideFile,
+    // Within `nestBytes` of the open file's start the header starts an embedded file that takes
+    // the next footer (JPEG EXIF thumbnails); further on it starts a new file.
+    NestedFile
+};
+
+struct CarveSignature {
+    QString name;
+    // File name extension of exported files, without the dot.
+    QString extension;
+    QByteArray header;
+    // One entry per header byte: 0xFF fixed, 0x00 any.
+    QByteArray headerMask;
+    QByteArray footer;
+    // Bytes after the footer that belong to the file (fixed-size trailer records).
+    int footerTail = 0;
+    CarveEnd end = CarveEnd::Footer;
+    CarveRepeat repeat = CarveRepeat::StartsNewFile;
+    quint64 nestBytes = 0;
+    // SizeField: `sizeOf` gets the `sizeFieldBytes` bytes at the header and returns the file size,
+    // or 0 when they are not a valid header.
+    int sizeFieldBytes = 0;
+    quint64 (*sizeOf)(const QByteArray& head) = nullptr;
+    // Files are never larger: an open file without an end this far from its header is dropped.
+    quint64 maxSize = 0;
+};
+
+// Signature-based file carving on top of one multi-pattern scan. searchQuery() holds every
+// header and footer of the table as one hex-pattern query; carve() then pairs the merged matches
+// of each target into file extents, so carving needs no second pass over the targets. Only the
+// few header bytes of size-field signatures are read again.
+class FileCarver {
+public:
+    using ReadFunction =
+        std::function<QByteArray(int scanTargetIdx, quint64 offset, quint64 size)>;
+
+    // Workers keep at most this many footers of a signature after each of its headers (and after
+    // the start of each searched range); see thinFooterHits().
+    static constexpr int kKeptFooters = 4;
+
+    explicit FileCarver(QVector<CarveSignature> signatures = builtInSignatures());
+
+    // JPEG, PNG, GIF, PDF, ZIP, 7z, SQLite, WAV, AVI and WebP.
+    static QVector<CarveSignature> builtInSignatures();
+
+    const QVector<CarveSignature>& signatures() const;
+    // Headers first (term i is the header of signature i), then the footers.
+    const SearchQuery& searchQuery() const;
+    // The signature whose header or footer term `termIdx` is; nullptr for other indices.
+    const CarveSignature* signatureForTerm(int termIdx) const;
+    // Signature names per term, footer terms suffixed " footer".
+    const QVector<QString>& termLabels() const;
+
+    // Drops the footers of one searched range (hits ordered by offset) that carve() cannot use:
+    // between two headers of a signature only its first kKeptFooters footers and its last one
+    // can end a file. Keeps random-looking data, where a two-byte footer turns up every 64 KiB,
+    // from filling the match store.
+    void thinFooterHits(QVector<SearchHit>* hits) const;
+
+    // Turns `matches` (ordered by target and offset) into one record per carved file: the
+    // header's match with `matchLength` set to the file size, clipped to the end of the target
+    // (`targetSizes`). Headers not at a multiple of `headerAlignment` are ignored. `read` loads
+    // the header bytes of size-field signatures. The result is ordered by target and offset.
+    QVector<MatchRecord> carve(const QVector<MatchRecord>& matches,
+                               const QVector<quint64>& targetSizes, quint32 headerAlignment,
+                               const ReadFunction& read) const;
+
+private:
+    struct TermRole {
+        int signatureIdx = -1;
+        bool footer = false;
+    };
+
+    const TermRole* roleForTerm(int termIdx) const;
+
+    QVector<CarveSignature> m_signatures;
+    QVector<TermRole> m_termRoles;
+    QVector<QString> m_termLabels;
+    SearchQuery m_query;
+};
+
+}  // namespace breco
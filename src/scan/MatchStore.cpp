@@ -0,0 +1,223 @@
+#include "scan/MatchStore.h"
+
+#include <limits>
+#include <map>
+#include <utility>
+
+namespace breco {
+
+namespace {
+constexpr int kBitOffsetShift = 0;
+constexpr int kEncodingShift = 3;
+constexpr int kDistanceShift = 7;
+constexpr int kXorKeyShift = 15;
+constexpr int kNumericFormatShift = 24;
+
+constexpr quint32 kBitOffsetMask = 0x7;
+constexpr quint32 kEncodingMask = 0xF;
+constexpr quint32 kDistanceMask = 0xFF;
+constexpr quint32 kXorKeyMask = 0x1FF;
+constexpr quint32 kNumericFormatMask = 0x1F;
+
+quint32 packDetails(const MatchRecord& match) {
+    return (static_cast<quint32>(match.bitOffset) & kBitOffsetMask) << kBitOffsetShift |
+           (static_cast<quint32>(match.encoding) & kEncodingMask) << kEncodingShift |
+           (static_cast<quint32>(match.distance) & kDistanceMask) << kDistanceShift |
+           (static_cast<quint32>(match.xorKey + 1) & kXorKeyMask) << kXorKeyShift |
+           (static_cast<quint32>(match.numericFormat) & kNumericFormatMask) << kNumericFormatShift;
+}
+
+void unpackDetails(quint32 details, MatchRecord* match) {
+    match->bitOffset = static_cast<int>((details >> kBitOffsetShift) & kBitOffsetMask);
+    match->encoding = static_cast<TermEncoding>((details >> kEncodingShift) & kEncodingMask);
+    match->distance = static_cast<int>((details >> kDistanceShift) & kDistanceMask);
+    match->xorKey = static_cast<int>((details >> kXorKeyShift) & kXorKeyMask) - 1;
+    match->numericFormat =
+        static_cast<NumericFormat>((details >> kNumericFormatShift) & kNumericFormatMask);
+}
+}  // namespace
+
+MatchStore::MatchStore(int threadId) : m_threadId(threadId) {}
+
+int MatchStore::size() const { return m_size; }
+
+bool MatchStore::isEmpty() const { return m_size == 0; }
+
+void MatchStore::beginBatch(quint64 searchTimeNs) { beginBatch(searchTimeNs, m_threadId); }
+
+void MatchStore::beginBatch(quint64 searchTimeNs, int threadId) {
+    m_batchTimes.push_back(searchTimeNs);
+    m_batchThreads.push_back(threadId);
+}
+
+void MatchStore::append(const MatchRecord& match) {
+    if (m_batchTimes.isEmpty()) {
+        beginBatch(0);
+    }
+    appendToBatch(match, static_cast<quint32>(m_batchTimes.size() - 1));
+}
+
+// Merged records alternate between workers and jobs, so each (thread, time) pair gets one batch.
+void MatchStore::appendRecords(const QVector<MatchRecord>& records) {
+    std::map<std::pair<int, quint64>, quint32> batches;
+    for (const MatchRecord& match : records) {
+        const auto [batch, added] =
+            batches.try_emplace({match.threadId, match.searchTimeNs},
+                                static_cast<quint32>(m_batchTimes.size()));
+        if (added) {
+            beginBatch(match.searchTimeNs, match.threadId);
+        }
+        appendToBatch(match, batch->second);
+    }
+}
+
+int MatchStore::adoptBatches(const MatchStore& source) {
+    const int base = m_batchTimes.size();
+    m_batchTimes.append(source.m_batchTimes);
+    m_batchThreads.append(source.m_batchThreads);
+    return base;
+}
+
+void MatchStore::appendFrom(const MatchStore& source, int idx, int batchBase) {
+    appendWideColumns(source.lengthAt(idx), source.countAt(idx));
+    const Chunk& from = source.chunkFor(idx);
+    const int i = idx & (kChunkRecords - 1);
+    Chunk& chunk = chunkForAppend();
+    chunk.offsets.push_back(from.offsets.at(i));
+    chunk.scanTargets.push_back(from.scanTargets.at(i));
+    chunk.terms.push_back(from.terms.at(i));
+    chunk.lengths.push_back(from.lengths.at(i));
+    chunk.details.push_back(from.details.at(i));
+    chunk.batches.push_back(static_cast<quint32>(batchBase) + from.batches.at(i));
+    ++m_size;
+}
+
+void MatchStore::appendStore(const MatchStore& source, int first) {
+    const int batchBase = adoptBatches(source);
+    for (int idx = qMax(0, first); idx < source.size(); ++idx) {
+        appendFrom(source, idx, batchBase);
+    }
+}
+
+MatchStore::Chunk& MatchStore::chunkForAppend() {
+    if (m_size >> kChunkBits == static_cast<int>(m_chunks.size())) {
+        m_chunks.emplace_back();
+    }
+    return m_chunks[static_cast<size_t>(m_size >> kChunkBits)];
+}
+
+void MatchStore::appendToBatch(const MatchRecord& match, quint32 batch) {
+    appendWideColumns(match.matchLength, match.matchCount);
+    Chunk& chunk = chunkForAppend();
+    chunk.offsets.push_back(match.offset);
+    chunk.scanTargets.push_back(match.scanTargetIdx);
+    chunk.terms.push_back(match.termIdx);
+    chunk.lengths.push_back(static_cast<quint32>(
+        qMin<quint64>(match.matchLength, std::numeric_limits<quint32>::max())));
+    chunk.details.push_back(packDetails(match));
+    chunk.batches.push_back(batch);
+    ++m_size;
+}
+
+void MatchStore::appendWideColumns(quint64 length, quint64 count) {
+    if (m_wideLengths.isEmpty() && length >= std::numeric_limits<quint32>::max()) {
+        m_wideLengths.reserve(m_size + 1);
+        for (int idx = 0; idx < m_size; ++idx) {
+            m_wideLengths.push_back(chunkFor(idx).lengths.at(idx & (kChunkRecords - 1)));
+        }
+    }
+    if (!m_wideLengths.isEmpty()) {
+        m_wideLengths.push_back(length);
+    }
+    if (m_matchCounts.isEmpty() && count != 0) {
+        m_matchCounts.fill(0, m_size);
+    }
+    if (!m_matchCounts.isEmpty() || count != 0) {
+        m_matchCounts.push_back(count);
+    }
+}
+
+void MatchStore::truncate(int size) {
+    if (size >= m_size) {
+        return;
+    }
+    m_size = qMax(0, size);
+    m_chunks.resize(static_cast<size_t>((m_size + kChunkRecords - 1) >> kChunkBits));
+    const int lastSize = m_size & (kChunkRecords - 1);
+    if (lastSize != 0) {
+        Chunk& chunk = m_chunks.back();
+        chunk.offsets.resize(lastSize);
+        chunk.scanTargets.resize(lastSize);
+        chunk.terms.resize(lastSize);
+        chunk.lengths.resize(lastSize);
+        chunk.details.resize(lastSize);
+        chunk.batches.resize(lastSize);
+    }
+    if (!m_wideLengths.isEmpty()) {
+        m_wideLengths.resize(m_size);
+    }
+    if (!m_matchCounts.isEmpty()) {
+        m_matchCounts.resize(m_size);
+    }
+}
+
+void MatchStore::clear() {
+    m_size = 0;
+    std::vector<Chunk>().swap(m_chunks);
+    m_batchTimes = QVector<quint64>();
+    m_batchThreads = QVector<qint32>();
+    m_wideLengths = QVector<quint64>();
+    m_matchCounts = QVector<quint64>();
+}
+
+const MatchStore::Chunk& MatchStore::chunkFor(int idx) const {
+    return m_chunks[static_cast<size_t>(idx >> kChunkBits)];
+}
+
+quint32 MatchStore::batchAt(int idx) const {
+    return chunkFor(idx).batches.at(idx & (kChunkRecords - 1));
+}
+
+int MatchStore::scanTargetIdx(int idx) const {
+    return chunkFor(idx).scanTargets.at(idx & (kChunkRecords - 1));
+}
+
+quint64 MatchStore::offset(int idx) const {
+    return chunkFor(idx).offsets.at(idx & (kChunkRecords - 1));
+}
+
+quint64 MatchStore::lengthAt(int idx) const {
+    return m_wideLengths.isEmpty() ? chunkFor(idx).lengths.at(idx & (kChunkRecords - 1))
+                                   : m_wideLengths.at(idx);
+}
+
+quint64 MatchStore::countAt(int idx) const {
+    return m_matchCounts.isEmpty() ? 0 : m_matchCounts.at(idx);
+}
+
+MatchRecord MatchStore::at(int idx) const {
+    const Chunk& chunk = chunkFor(idx);
+    const int i = idx & (kChunkRecords - 1);
+    const int batch = static_cast<int>(chunk.batches.at(i));
+    MatchRecord match;
+    match.scanTargetIdx = chunk.scanTargets.at(i);
+    match.threadId = m_batchThreads.at(batch);
+    match.offset = chunk.offsets.at(i);
+    match.searchTimeNs = m_batchTimes.at(batch);
+    match.termIdx = chunk.terms.at(i);
+    match.matchLength = lengthAt(idx);
+    unpackDetails(chunk.details.at(i), &match);
+    match.matchCount = countAt(idx);
+    return match;
+}
+
+QVector<MatchRecord> MatchStore::toRecords() const {
+    QVector<MatchRecord> records;
+    records.reserve(m_size);
+    for (int idx = 0; idx < m_size; ++idx) {
+        records.push_back(at(idx));
+    }
+    return records;
+}
+
+}  // namespace breco
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <QVector>
+#include <QtGlobal>
+#include <vector>
+
+#include "model/ResultTypes.h"
+
+namespace breco {
+
+// All-matches records of a worker, or the merged results of a scan, kept column by column in
+// chunks of kChunkRecords: 28 bytes a match instead of sizeof(MatchRecord), and growing never
+// copies more than one chunk. The search time and worker id are stored once per batch (one batch
+// per job); at() rebuilds the MatchRecord. Counts and lengths of 4 GiB or more (count rows and
+// carved files, which are few) move the store to 64-bit columns for them, one value per record.
+// Copies share the chunks until either side changes them.
+class MatchStore {
+public:
+    static constexpr int kChunkBits = 16;
+    static constexpr int kChunkRecords = 1 << kChunkBits;
+    // Bytes a stored match takes: offset, target, term, length, details and batch.
+    static constexpr quint64 kRecordBytes = sizeof(quint64) + 5 * sizeof(quint32);
+
+    explicit MatchStore(int threadId = 0);
+
+    int size() const;
+    bool isEmpty() const;
+    // Records appended from now on report `searchTimeNs` and `threadId` (the store's own by
+    // default).
+    void beginBatch(quint64 searchTimeNs);
+    void beginBatch(quint64 searchTimeNs, int threadId);
+    // Ignores match.threadId and match.searchTimeNs.
+    void append(const MatchRecord& match);
+    // Appends `records` with their own search times and thread ids.
+    void appendRecords(const QVector<MatchRecord>& records);
+    // Copies the batches of `source`; appendFrom() with the base returned then copies its records
+    // column by column, keeping their search times and thread ids.
+    int adoptBatches(const MatchStore& source);
+    void appendFrom(const MatchStore& source, int idx, int batchBase);
+    // Appends the records of `source` from `first` on.
+    void appendStore(const MatchStore& source, int first = 0);
+    // Appends `records`, sorted by `less` and from the current batch, into the sorted store:
+    // carried regex runs can report matches that sort before ones already stored. Records moved
+    // to make room keep their batch.
+    template <typename Less>
+    void mergeSorted(const QVector<MatchRecord>& records, Less less);
+    // Keeps the first `size` records.
+    void truncate(int size);
+    // Drops every record and frees the chunks.
+    void clear();
+
+    int scanTargetIdx(int idx) const;
+    quint64 offset(int idx) const;
+    MatchRecord at(int idx) const;
+    QVector<MatchRecord> toRecords() const;
+
+private:
+    struct Chunk {
+        QVector<quint64> offsets;
+        QVector<qint32> scanTargets;
+        QVector<qint32> terms;
+        QVector<quint32> lengths;
+        // bitOffset, encoding, distance, xorKey + 1 and numericFormat, packed by packDetails().
+        QVector<quint32> details;
+        QVector<quint32> batches;
+    };
+
+    const Chunk& chunkFor(int idx) const;
+    Chunk& chunkForAppend();
+    quint32 batchAt(int idx) const;
+    quint64 lengthAt(int idx) const;
+    quint64 countAt(int idx) const;
+    void appendToBatch(const MatchRecord& match, quint32 batch);
+    // Call before the record's columns are pushed.
+    void appendWideColumns(quint64 length, quint64 count);
+
+    int m_threadId = 0;
+    int m_size = 0;
+    std::vector<Chunk> m_chunks;
+    QVector<quint64> m_batchTimes;
+    QVector<qint32> m_batchThreads;
+    // Empty until a record needs them, then one value per record.
+    QVector<quint64> m_wideLengths;
+    QVector<quint64> m_matchCounts;
+};
+
+template <typename Less>
+void MatchStore::mergeSorted(const QVector<MatchRecord>& records, Less less) {
+    if (records.isEmpty()) {
+        return;
+    }
+    int firstDisplaced = m_size;
+    for (int low = 0; low < firstDisplaced;) {
+        const int mid = low + (firstDisplaced - low) / 2;
+        if (less(records.first(), at(mid))) {
+            firstDisplaced = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    QVector<MatchRecord> displaced;
+    QVector<quint32> displacedBatches;
+    for (int idx = firstDisplaced; idx < m_size; ++idx) {
+        displaced.push_back(at(idx));
+        displacedBatches.push_back(batchAt(idx));
+    }
+    truncate(firstDisplaced);
+    if (m_batchTimes.isEmpty()) {
+        beginBatch(0);
+    }
+    const auto batch = static_cast<quint32>(m_batchTimes.size() - 1);
+    int next = 0;
+    for (const MatchRecord& record : records) {
+        for (; next < displaced.size() && !less(record, displaced.at(next)); ++next) {
+            appendToBatch(displaced.at(next), displacedBatches.at(next));
+        }
+        appendToBatch(record, batch);
+    }
+    for (; next < displaced.size(); ++next) {
+        appendToBatch(displaced.at(next), displacedBatches.at(next));
+    }
+}
+
+}  // namespace breco
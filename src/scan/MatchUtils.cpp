@@ -1,41 +1,536 @@
 #include "scan/MatchUtils.h"
 
+#include <QChar>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#include "scan/ByteSearch.h"
+
 namespace breco {
 
 namespace {
-unsigned char asciiLower(unsigned char c) {
-    if (c >= 'A' && c <= 'Z') {
-        return static_cast<unsigned char>(c + ('a' - 'A'));
+int hexDigitValue(QChar ch) {
+    const char16_t c = ch.unicode();
+    if (c >= u'0' && c <= u'9') {
+        return c - u'0';
+    }
+    if (c >= u'a' && c <= u'f') {
+        return c - u'a' + 10;
+    }
+    if (c >= u'A' && c <= u'F') {
+        return c - u'A' + 10;
+    }
+    return -1;
+}
+
+constexpr char32_t kInvalidCodePoint = 0xFFFFFFFF;
+constexpr char32_t kReplacementCharacter = 0xFFFD;
+
+// Characters sharing a simple case fold, keyed by the fold; only folds with more than one member.
+// Built once from Qt's case tables on first use.
+const std::unordered_map<char32_t, QVector<char32_t>>& caseFoldClasses() {
+    static const std::unordered_map<char32_t, QVector<char32_t>> classes = [] {
+        std::unordered_map<char32_t, QVector<char32_t>> byFold;
+        for (char32_t cp = 0; cp <= 0x10FFFF; ++cp) {
+            if (cp >= 0xD800 && cp <= 0xDFFF) {
+                continue;
+            }
+            const char32_t fold = QChar::toCaseFolded(cp);
+            if (fold == cp) {
+                continue;
+            }
+            QVector<char32_t>& members = byFold[fold];
+            if (members.isEmpty()) {
+                members.push_back(fold);
+            }
+            members.push_back(cp);
+        }
+        for (auto& entry : byFold) {
+            std::sort(entry.second.begin(), entry.second.end());
+        }
+        return byFold;
+    }();
+    return classes;
+}
+
+// Decodes one UTF-8 character at `pos`; returns kInvalidCodePoint and a length of 1 for a byte
+// that does not start a valid sequence.
+char32_t decodeUtf8(const QByteArray& bytes, int pos, int* length) {
+    const auto lead = static_cast<unsigned char>(bytes.at(pos));
+    *length = 1;
+    if (lead < 0x80) {
+        return lead;
+    }
+    int count = 0;
+    char32_t cp = 0;
+    char32_t minimum = 0;
+    if ((lead & 0xE0) == 0xC0) {
+        count = 2;
+        cp = lead & 0x1F;
+        minimum = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+        count = 3;
+        cp = lead & 0x0F;
+        minimum = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+        count = 4;
+        cp = lead & 0x07;
+        minimum = 0x10000;
+    } else {
+        return kInvalidCodePoint;
+    }
+    if (pos + count > bytes.size()) {
+        return kInvalidCodePoint;
+    }
+    for (int i = 1; i < count; ++i) {
+        const auto next = static_cast<unsigned char>(bytes.at(pos + i));
+        if ((next & 0xC0) != 0x80) {
+            return kInvalidCodePoint;
+        }
+        cp = (cp << 6) | (next & 0x3F);
+    }
+    if (cp < minimum || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        return kInvalidCodePoint;
+    }
+    *length = count;
+    return cp;
+}
+
+QByteArray encodeCodePoint(char32_t cp, TermEncoding encoding) {
+    QByteArray out;
+    if (encoding == TermEncoding::Utf8) {
+        if (cp < 0x80) {
+            out.append(static_cast<char>(cp));
+        } else if (cp < 0x800) {
+            out.append(static_cast<char>(0xC0 | (cp >> 6)));
+            out.append(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            out.append(static_cast<char>(0xE0 | (cp >> 12)));
+            out.append(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.append(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else {
+            out.append(static_cast<char>(0xF0 | (cp >> 18)));
+            out.append(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            out.append(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.append(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        return out;
+    }
+    const bool littleEndian = encoding == TermEncoding::Utf16Le;
+    auto appendUnit = [&out, littleEndian](char32_t unit) {
+        const auto low = static_cast<char>(unit & 0xFF);
+        const auto high = static_cast<char>((unit >> 8) & 0xFF);
+        out.append(littleEndian ? low : high);
+        out.append(littleEndian ? high : low);
+    };
+    if (cp < 0x10000) {
+        appendUnit(cp);
+    } else {
+        appendUnit(0xD800 + ((cp - 0x10000) >> 10));
+        appendUnit(0xDC00 + ((cp - 0x10000) & 0x3FF));
+    }
+    return out;
+}
+
+void appendEscapedBytes(const QByteArray& bytes, QByteArray* pattern) {
+    static const char kDigits[] = "0123456789abcdef";
+    for (const char ch : bytes) {
+        const auto value = static_cast<unsigned char>(ch);
+        pattern->append("\\x");
+        pattern->append(kDigits[value >> 4]);
+        pattern->append(kDigits[value & 0x0F]);
+    }
+}
+
+// Base64 of `bytes` placed `shift` bytes into a 3-byte group, without the characters that also
+// depend on the bytes before or after it.
+QByteArray base64Run(const QByteArray& bytes, int shift) {
+    const QByteArray grouped = QByteArray(shift, '\0') + bytes;
+    const int first = (8 * shift + 5) / 6;
+    const int last = static_cast<int>(8 * grouped.size() / 6);
+    return last > first ? grouped.toBase64().mid(first, last - first) : QByteArray();
+}
+
+// Percent-encodes every byte outside the RFC 3986 unreserved set, with upper-case hex digits.
+QByteArray percentEncode(const QByteArray& bytes) {
+    static const char kDigits[] = "0123456789ABCDEF";
+    QByteArray out;
+    for (const char ch : bytes) {
+        const auto value = static_cast<unsigned char>(ch);
+        const bool unreserved = (value >= 'A' && value <= 'Z') || (value >= 'a' && value <= 'z') ||
+                                (value >= '0' && value <= '9') || value == '-' || value == '.' ||
+                                value == '_' || value == '~';
+        if (unreserved) {
+            out.append(ch);
+        } else {
+            out.append('%');
+            out.append(kDigits[value >> 4]);
+            out.append(kDigits[value & 0x0F]);
+        }
     }
-    return c;
+    return out;
+}
+
+// NumericFormat lists LE/BE pairs of u16, s16, u32, s32, u64, s64, f32 and f64.
+struct NumericLayout {
+    char kind = 'u';
+    int width = 0;
+    bool bigEndian = false;
+};
+
+NumericLayout numericLayout(NumericFormat format) {
+    static constexpr char kKinds[] = {'u', 's', 'u', 's', 'u', 's', 'f', 'f'};
+    static constexpr int kWidths[] = {2, 2, 4, 4, 8, 8, 4, 8};
+    const int index = static_cast<int>(format) - 1;
+    if (index < 0 || index >= 16) {
+        return {};
+    }
+    return NumericLayout{kKinds[index / 2], kWidths[index / 2], (index % 2) != 0};
+}
+
+void addNumericVariant(NumericFormat format, quint64 low, quint64 high,
+                       QVector<NumericVariant>* variants) {
+    const NumericLayout layout = numericLayout(format);
+    NumericVariant variant;
+    variant.format = format;
+    variant.low = low;
+    variant.high = high;
+    variant.bytes.resize(layout.width);
+    variant.mask.resize(layout.width);
+    for (int significance = 0; significance < layout.width; ++significance) {
+        const int pos = layout.bigEndian ? layout.width - 1 - significance : significance;
+        const bool fixed = ((low ^ high) >> (8 * significance)) == 0;
+        const auto byteMask = static_cast<char>(fixed ? 0xFF : 0x00);
+        variant.mask[pos] = byteMask;
+        variant.bytes[pos] = static_cast<char>((low >> (8 * significance)) & 0xFF) & byteMask;
+    }
+    // A single value whose bytes read the same in both byte orders is already listed.
+    for (const NumericVariant& other : *variants) {
+        if (low == high && other.low == low && other.high == high &&
+            numericLayout(other.format).kind == layout.kind && other.bytes == variant.bytes) {
+            return;
+        }
+    }
+    variants->push_back(variant);
+}
+
+// The floats within [value - tolerance, value + tolerance], or the one nearest `value` when the
+// band holds none. Bit patterns grow with the magnitude on either side of zero, so negative and
+// positive values are two separate ranges.
+template <typename Float, typename Bits>
+void addFloatVariants(double value, double tolerance, NumericFormat littleEndian,
+                      QVector<NumericVariant>* variants) {
+    const double maxValue = static_cast<double>(std::numeric_limits<Float>::max());
+    if (std::abs(value) > maxValue) {
+        return;
+    }
+    const double lowBound = qBound(-maxValue, value - tolerance, maxValue);
+    const double highBound = qBound(-maxValue, value + tolerance, maxValue);
+    auto low = static_cast<Float>(lowBound);
+    if (static_cast<double>(low) < lowBound) {
+        low = std::nextafter(low, std::numeric_limits<Float>::infinity());
+    }
+    auto high = static_cast<Float>(highBound);
+    if (static_cast<double>(high) > highBound) {
+        high = std::nextafter(high, -std::numeric_limits<Float>::infinity());
+    }
+    if (low > high) {
+        low = static_cast<Float>(value);
+        high = low;
+    }
+    auto bits = [](Float f) {
+        Bits raw = 0;
+        std::memcpy(&raw, &f, sizeof(raw));
+        return static_cast<quint64>(raw);
+    };
+    const auto bigEndian = static_cast<NumericFormat>(static_cast<int>(littleEndian) + 1);
+    for (const NumericFormat format : {littleEndian, bigEndian}) {
+        if (low < 0) {
+            addNumericVariant(format, bits(high < 0 ? high : static_cast<Float>(-0.0)), bits(low),
+                              variants);
+        }
+        if (high >= 0) {
+            addNumericVariant(format, bits(low > 0 ? low : static_cast<Float>(0.0)), bits(high),
+                              variants);
+        }
+    }
+}
+
+bool hasAsciiUpper(const QByteArray& bytes) {
+    for (const char ch : bytes) {
+        if (ch >= 'A' && ch <= 'Z') {
+            return true;
+        }
+    }
+    return false;
 }
 }  // namespace
 
 int MatchUtils::indexOf(const QByteArray& haystack, const QByteArray& needle, int from,
                         TextInterpretationMode mode, bool ignoreCase) {
     if (!ignoreCase || mode == TextInterpretationMode::Utf16) {
-        return haystack.indexOf(needle, from);
+        if (needle.isEmpty()) {
+            return haystack.indexOf(needle, from);
+        }
+        return ByteSearch::indexOf(haystack.constData(), haystack.size(), needle.constData(),
+                                   needle.size(), from);
     }
     if (needle.isEmpty()) {
         return -1;
     }
-    const int start = qMax(0, from);
-    const int last = haystack.size() - needle.size();
-    for (int i = start; i <= last; ++i) {
-        bool matched = true;
-        for (int j = 0; j < needle.size(); ++j) {
-            const unsigned char h = asciiLower(static_cast<unsigned char>(haystack.at(i + j)));
-            const unsigned char n = asciiLower(static_cast<unsigned char>(needle.at(j)));
-            if (h != n) {
-                matched = false;
-                break;
+    if (!hasAsciiUpper(needle)) {
+        return indexOfFolded(haystack, needle, from);
+    }
+    return indexOfFolded(haystack, foldAsciiCase(needle), from);
+}
+
+int MatchUtils::indexOfFolded(const QByteArray& haystack, const QByteArray& foldedNeedle,
+                              int from) {
+    return ByteSearch::indexOfFolded(haystack.constData(), haystack.size(),
+                                     foldedNeedle.constData(), foldedNeedle.size(), from);
+}
+
+QByteArray MatchUtils::foldAsciiCase(const QByteArray& bytes) {
+    QByteArray folded = bytes;
+    for (char& ch : folded) {
+        ch = static_cast<char>(ByteSearch::asciiLower(static_cast<unsigned char>(ch)));
+    }
+    return folded;
+}
+
+bool MatchUtils::parseHexPattern(const QString& text, QByteArray* bytes, QByteArray* mask) {
+    QByteArray parsedBytes;
+    QByteArray parsedMask;
+    int nibbleCount = 0;
+    bool hasFixedNibble = false;
+    for (const QChar ch : text) {
+        if (ch.isSpace()) {
+            continue;
+        }
+        int value = 0;
+        int valueMask = 0xF;
+        if (ch == QLatin1Char('?')) {
+            valueMask = 0;
+        } else {
+            value = hexDigitValue(ch);
+            if (value < 0) {
+                return false;
             }
+            hasFixedNibble = true;
         }
-        if (matched) {
-            return i;
+        if (nibbleCount % 2 == 0) {
+            parsedBytes.append(static_cast<char>(value << 4));
+            parsedMask.append(static_cast<char>(valueMask << 4));
+        } else {
+            parsedBytes.back() = static_cast<char>(parsedBytes.back() | value);
+            parsedMask.back() = static_cast<char>(parsedMask.back() | valueMask);
         }
+        ++nibbleCount;
     }
-    return -1;
+    if (nibbleCount == 0 || nibbleCount % 2 != 0 || !hasFixedNibble) {
+        return false;
+    }
+    *bytes = parsedBytes;
+    *mask = parsedMask;
+    return true;
+}
+
+QString MatchUtils::formatHexPattern(const QByteArray& bytes, const QByteArray& mask) {
+    static const char kDigits[] = "0123456789ABCDEF";
+    QString out;
+    for (int i = 0; i < bytes.size(); ++i) {
+        const auto value = static_cast<unsigned char>(bytes.at(i));
+        const unsigned char valueMask =
+            i < mask.size() ? static_cast<unsigned char>(mask.at(i)) : 0xFF;
+        if (i > 0) {
+            out.append(QLatin1Char(' '));
+        }
+        out.append(QLatin1Char((valueMask & 0xF0) != 0 ? kDigits[value >> 4] : '?'));
+        out.append(QLatin1Char((valueMask & 0x0F) != 0 ? kDigits[value & 0x0F] : '?'));
+    }
+    return out;
+}
+
+QByteArray MatchUtils::encodeTerm(const QByteArray& utf8Term, TermEncoding encoding) {
+    switch (encoding) {
+        case TermEncoding::Utf8:
+            return utf8Term;
+        case TermEncoding::Base64:
+        case TermEncoding::Base64Shift1:
+        case TermEncoding::Base64Shift2:
+            return base64Run(utf8Term, static_cast<int>(encoding) -
+                                           static_cast<int>(TermEncoding::Base64));
+        case TermEncoding::HexLower:
+            return utf8Term.toHex();
+        case TermEncoding::HexUpper:
+            return utf8Term.toHex().toUpper();
+        case TermEncoding::Percent:
+            return percentEncode(utf8Term);
+        case TermEncoding::Utf16Le:
+        case TermEncoding::Utf16Be:
+        default:
+            break;
+    }
+    const bool littleEndian = encoding == TermEncoding::Utf16Le;
+    const QString text = QString::fromUtf8(utf8Term);
+    QByteArray out;
+    out.reserve(text.size() * 2);
+    for (const QChar ch : text) {
+        const char16_t unit = ch.unicode();
+        const auto low = static_cast<char>(unit & 0xFF);
+        const auto high = static_cast<char>(unit >> 8);
+        out.append(littleEndian ? low : high);
+        out.append(littleEndian ? high : low);
+    }
+    return out;
+}
+
+QByteArray MatchUtils::caseFoldPattern(const QByteArray& utf8Term, TermEncoding encoding) {
+    QByteArray pattern;
+    if (!isUnicodeEncoding(encoding)) {
+        // Encoded forms spell out the exact term bytes; folding their characters would not fold
+        // the term.
+        appendEscapedBytes(encodeTerm(utf8Term, encoding), &pattern);
+        return pattern;
+    }
+    const auto& classes = caseFoldClasses();
+    int pos = 0;
+    while (pos < utf8Term.size()) {
+        int length = 1;
+        const char32_t cp = decodeUtf8(utf8Term, pos, &length);
+        if (cp == kInvalidCodePoint) {
+            appendEscapedBytes(encoding == TermEncoding::Utf8
+                                   ? utf8Term.mid(pos, 1)
+                                   : encodeCodePoint(kReplacementCharacter, encoding),
+                               &pattern);
+            ++pos;
+            continue;
+        }
+        pos += length;
+        const auto it = classes.find(QChar::toCaseFolded(cp));
+        if (it == classes.end()) {
+            appendEscapedBytes(encodeCodePoint(cp, encoding), &pattern);
+            continue;
+        }
+        QVector<QByteArray> forms;
+        bool singleBytes = true;
+        for (const char32_t member : it->second) {
+            forms.push_back(encodeCodePoint(member, encoding));
+            singleBytes = singleBytes && forms.back().size() == 1;
+        }
+        pattern.append(singleBytes ? '[' : '(');
+        for (int i = 0; i < forms.size(); ++i) {
+            if (i > 0 && !singleBytes) {
+                pattern.append('|');
+            }
+            appendEscapedBytes(forms.at(i), &pattern);
+        }
+        pattern.append(singleBytes ? ']' : ')');
+    }
+    return pattern;
+}
+
+bool MatchUtils::isAscii(const QByteArray& bytes) {
+    return std::all_of(bytes.cbegin(), bytes.cend(),
+                       [](char ch) { return static_cast<unsigned char>(ch) < 0x80; });
+}
+
+bool MatchUtils::isUnicodeEncoding(TermEncoding encoding) {
+    return encoding == TermEncoding::Utf8 || encoding == TermEncoding::Utf16Le ||
+           encoding == TermEncoding::Utf16Be;
+}
+
+QString MatchUtils::encodingName(TermEncoding encoding) {
+    switch (encoding) {
+        case TermEncoding::Utf16Le:
+            return QStringLiteral("UTF-16LE");
+        case TermEncoding::Utf16Be:
+            return QStringLiteral("UTF-16BE");
+        case TermEncoding::Base64:
+        case TermEncoding::Base64Shift1:
+        case TermEncoding::Base64Shift2:
+            return QStringLiteral("Base64");
+        case TermEncoding::HexLower:
+        case TermEncoding::HexUpper:
+            return QStringLiteral("hex");
+        case TermEncoding::Percent:
+            return QStringLiteral("URL");
+        case TermEncoding::Utf8:
+        default:
+            return QStringLiteral("UTF-8");
+    }
+}
+
+bool MatchUtils::numericVariants(const QByteArray& text, double tolerance,
+                                 QVector<NumericVariant>* variants) {
+    variants->clear();
+    const QString trimmed = QString::fromUtf8(text).trimmed();
+    const bool negative = trimmed.startsWith(QLatin1Char('-'));
+    const QString digits = negative ? trimmed.mid(1) : trimmed;
+    const bool hex = digits.startsWith(QStringLiteral("0x"), Qt::CaseInsensitive);
+    bool isInteger = false;
+    const quint64 magnitude = digits.mid(hex ? 2 : 0).toULongLong(&isInteger, hex ? 16 : 10);
+    isInteger = isInteger && (!negative || magnitude <= quint64{1} << 63);
+    double value = 0.0;
+    if (isInteger) {
+        value = negative ? -static_cast<double>(magnitude) : static_cast<double>(magnitude);
+    } else {
+        bool ok = false;
+        value = trimmed.toDouble(&ok);
+        if (!ok || !std::isfinite(value)) {
+            return false;
+        }
+    }
+
+    if (isInteger) {
+        static constexpr NumericFormat kUnsigned[] = {NumericFormat::U16Le, NumericFormat::U32Le,
+                                                      NumericFormat::U64Le};
+        static constexpr NumericFormat kSigned[] = {NumericFormat::S16Le, NumericFormat::S32Le,
+                                                    NumericFormat::S64Le};
+        static constexpr int kBits[] = {16, 32, 64};
+        for (int i = 0; i < 3; ++i) {
+            const quint64 widthMask = kBits[i] == 64 ? ~quint64{0} : (quint64{1} << kBits[i]) - 1;
+            const bool fits = negative ? magnitude <= quint64{1} << (kBits[i] - 1)
+                                       : magnitude <= widthMask;
+            if (!fits) {
+                continue;
+            }
+            const quint64 bits = (negative ? ~magnitude + 1 : magnitude) & widthMask;
+            const NumericFormat littleEndian = negative ? kSigned[i] : kUnsigned[i];
+            addNumericVariant(littleEndian, bits, bits, variants);
+            addNumericVariant(static_cast<NumericFormat>(static_cast<int>(littleEndian) + 1), bits,
+                              bits, variants);
+        }
+    }
+    tolerance = std::isfinite(tolerance) ? qMax(0.0, tolerance) : 0.0;
+    addFloatVariants<float, quint32>(value, tolerance, NumericFormat::F32Le, variants);
+    addFloatVariants<double, quint64>(value, tolerance, NumericFormat::F64Le, variants);
+    return true;
+}
+
+bool MatchUtils::matchesNumeric(const NumericVariant& variant, const unsigned char* bytes) {
+    const NumericLayout layout = numericLayout(variant.format);
+    quint64 value = 0;
+    for (int i = 0; i < layout.width; ++i) {
+        const int pos = layout.bigEndian ? i : layout.width - 1 - i;
+        value = (value << 8) | bytes[pos];
+    }
+    return value >= variant.low && value <= variant.high;
+}
+
+QString MatchUtils::numericFormatName(NumericFormat format) {
+    const NumericLayout layout = numericLayout(format);
+    if (layout.width == 0) {
+        return QStringLiteral("-");
+    }
+    return QStringLiteral("%1%2 %3")
+        .arg(QChar::fromLatin1(layout.kind))
+        .arg(layout.width * 8)
+        .arg(layout.bigEndian ? QStringLiteral("BE") : QStringLiteral("LE"));
 }
 
 }  // namespace breco
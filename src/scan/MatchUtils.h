@@ -1,15 +1,61 @@
 #pragma once
 
 #include <QByteArray>
+#include <QString>
+#include <QVector>
 
 #include "model/ResultTypes.h"
 
 namespace breco {
 
+// One binary form of a numeric term. It matches where the value read from `bytes.size()` bytes in
+// the format's byte order lies in [low, high] (IEEE bit patterns for floats); `mask` fixes the
+// bytes every value in that range shares, and `bytes` is already ANDed with it.
+struct NumericVariant {
+    NumericFormat format = NumericFormat::None;
+    QByteArray bytes;
+    QByteArray mask;
+    quint64 low = 0;
+    quint64 high = 0;
+};
+
 class MatchUtils {
 public:
+    // With `ignoreCase`, a needle with uppercase ASCII letters is folded on every call; loops
+    // should fold it once with foldAsciiCase() and call indexOfFolded().
     static int indexOf(const QByteArray& haystack, const QByteArray& needle, int from,
                        TextInterpretationMode mode, bool ignoreCase);
+    static int indexOfFolded(const QByteArray& haystack, const QByteArray& foldedNeedle, int from);
+    static QByteArray foldAsciiCase(const QByteArray& bytes);
+
+    // Parses a hex byte pattern such as "4D 5A ?? ?0": whitespace is ignored and "?" is a wildcard
+    // nibble. Fails on other characters, an odd nibble count or a pattern with no fixed nibble.
+    // `bytes` comes back already ANDed with `mask`.
+    static bool parseHexPattern(const QString& text, QByteArray* bytes, QByteArray* mask);
+    static QString formatHexPattern(const QByteArray& bytes, const QByteArray& mask);
+
+    // The bytes of a UTF-8 search term in `encoding` (UTF-16 without a byte order mark). A
+    // Base64 form of a term too short to fix any character of it is empty.
+    static QByteArray encodeTerm(const QByteArray& utf8Term, TermEncoding encoding);
+    static QString encodingName(TermEncoding encoding);
+    // UTF-8 and UTF-16 are Unicode encodings; the Base64, hex-ASCII and URL forms are not.
+    static bool isUnicodeEncoding(TermEncoding encoding);
+    // A ByteRegex pattern matching `utf8Term` in `encoding` under Unicode simple case folding:
+    // every character becomes the alternation of all characters with the same case fold. Bytes
+    // that are not valid UTF-8 stay literal (U+FFFD in UTF-16). Encoded forms stay literal.
+    static QByteArray caseFoldPattern(const QByteArray& utf8Term, TermEncoding encoding);
+    static bool isAscii(const QByteArray& bytes);
+
+    // Expands a number ("1234", "-7", "0x4D5A", "3.25") into its binary forms: 16/32/64-bit
+    // integers it fits in and float/double values within `tolerance` of it (or the nearest value
+    // when none is), each little- and big-endian. A form whose bytes read the same in both byte
+    // orders is listed once. Fails on text that is not a finite number.
+    static bool numericVariants(const QByteArray& text, double tolerance,
+                                QVector<NumericVariant>* variants);
+    // Whether the `variant.bytes.size()` bytes at `bytes` hold a value in the variant's range.
+    static bool matchesNumeric(const NumericVariant& variant, const unsigned char* bytes);
+    // Short name as in the Current Byte panel, e.g. "u32 LE" or "f64 BE".
+    static QString numericFormatName(NumericFormat format);
 };
 
 }  // namespace breco
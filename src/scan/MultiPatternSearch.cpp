@@ -0,0 +1,394 @@
+#include "scan/MultiPatternSearch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <numeric>
+
+#include "scan/ByteSearch.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BRECO_X86_SEARCH_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace breco {
+
+namespace {
+constexpr int kTeddyMaxPatterns = 32;
+constexpr int kTeddyMinPatternSize = 3;
+
+using NibbleTable = std::array<std::array<unsigned char, 16>, 3>;
+
+bool isLowerAsciiLetter(unsigned char b) { return b >= 'a' && b <= 'z'; }
+
+bool patternMatchesAt(const unsigned char* candidate, const QByteArray& pattern, bool foldCase) {
+    const auto* p = reinterpret_cast<const unsigned char*>(pattern.constData());
+    const int size = static_cast<int>(pattern.size());
+    if (!foldCase) {
+        return std::memcmp(candidate, p, static_cast<size_t>(size)) == 0;
+    }
+    for (int i = 0; i < size; ++i) {
+        if (ByteSearch::asciiLower(candidate[i]) != p[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool teddySimdAvailable() {
+#ifdef BRECO_X86_SEARCH_KERNELS
+    static const bool available = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3") != 0;
+    }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+#ifdef BRECO_X86_SEARCH_KERNELS
+// Both kernels return the first start position they did not examine; the caller finishes the tail
+// with the scalar nibble lookup. `verify` receives a start position and its bucket bits.
+template <typename Verify>
+__attribute__((target("ssse3"))) int teddySsse3(const NibbleTable& lowNibbles,
+                                                const NibbleTable& highNibbles, int fingerprint,
+                                                const unsigned char* haystack, int haystackSize,
+                                                int lastStart, Verify&& verify) {
+    const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i low[3];
+    __m128i high[3];
+    for (int j = 0; j < fingerprint; ++j) {
+        low[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lowNibbles[j].data()));
+        high[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(highNibbles[j].data()));
+    }
+
+    int i = 0;
+    while (i < lastStart && i + 16 + fingerprint - 1 <= haystackSize) {
+        __m128i candidates = _mm_set1_epi8(static_cast<char>(0xFF));
+        for (int j = 0; j < fingerprint; ++j) {
+            const __m128i block =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + j));
+            const __m128i lo = _mm_shuffle_epi8(low[j], _mm_and_si128(block, nibbleMask));
+            const __m128i hi = _mm_shuffle_epi8(
+                high[j], _mm_and_si128(_mm_srli_epi16(block, 4), nibbleMask));
+            candidates = _mm_and_si128(candidates, _mm_and_si128(lo, hi));
+        }
+        unsigned int mask =
+            ~static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(candidates, zero))) &
+            0xFFFFU;
+        if (mask != 0) {
+            alignas(16) unsigned char buckets[16];
+            _mm_store_si128(reinterpret_cast<__m128i*>(buckets), candidates);
+            while (mask != 0) {
+                const int lane = __builtin_ctz(mask);
+                if (i + lane < lastStart) {
+                    verify(i + lane, buckets[lane]);
+                }
+                mask &= mask - 1;
+            }
+        }
+        i += 16;
+    }
+    return i;
+}
+
+template <typename Verify>
+__attribute__((target("avx2"))) int teddyAvx2(const NibbleTable& lowNibbles,
+                                              const NibbleTable& highNibbles, int fingerprint,
+                                              const unsigned char* haystack, int haystackSize,
+                                              int lastStart, Verify&& verify) {
+    const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i low[3];
+    __m256i high[3];
+    for (int j = 0; j < fingerprint; ++j) {
+        low[j] = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(lowNibbles[j].data())));
+        high[j] = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(highNibbles[j].data())));
+    }
+
+    int i = 0;
+    while (i < lastStart && i + 32 + fingerprint - 1 <= haystackSize) {
+        __m256i candidates = _mm256_set1_epi8(static_cast<char>(0xFF));
+        for (int j = 0; j < fingerprint; ++j) {
+            const __m256i block =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + j));
+            const __m256i lo = _mm256_shuffle_epi8(low[j], _mm256_and_si256(block, nibbleMask));
+            const __m256i hi = _mm256_shuffle_epi8(
+                high[j], _mm256_and_si256(_mm256_srli_epi16(block, 4), nibbleMask));
+            candidates = _mm256_and_si256(candidates, _mm256_and_si256(lo, hi));
+        }
+        unsigned int mask = ~static_cast<unsigned int>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(candidates, zero)));
+        if (mask != 0) {
+            alignas(32) unsigned char buckets[32];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(buckets), candidates);
+            while (mask != 0) {
+                const int lane = __builtin_ctz(mask);
+                if (i + lane < lastStart) {
+                    verify(i + lane, buckets[lane]);
+                }
+                mask &= mask - 1;
+            }
+        }
+        i += 32;
+    }
+    return i;
+}
+#endif
+}  // namespace
+
+MultiPatternSearch::MultiPatternSearch(const QVector<QByteArray>& patterns, bool foldCase)
+    : MultiPatternSearch(patterns, foldCase, chooseEngine(patterns)) {}
+
+MultiPatternSearch::MultiPatternSearch(const QVector<QByteArray>& patterns, bool foldCase,
+                                       MultiPatternEngine engine)
+    : m_patterns(patterns), m_foldCase(foldCase), m_engine(engine) {
+    if (!m_patterns.isEmpty()) {
+        m_minPatternSize = static_cast<int>(m_patterns.first().size());
+    }
+    for (const QByteArray& pattern : m_patterns) {
+        m_minPatternSize = qMin(m_minPatternSize, static_cast<int>(pattern.size()));
+        m_maxPatternSize = qMax(m_maxPatternSize, static_cast<int>(pattern.size()));
+    }
+
+    if (m_engine == MultiPatternEngine::Teddy) {
+        prepareTeddy();
+    } else {
+        prepareAhoCorasick();
+    }
+}
+
+MultiPatternEngine MultiPatternSearch::chooseEngine(const QVector<QByteArray>& patterns) {
+    if (patterns.size() > kTeddyMaxPatterns || !teddySimdAvailable()) {
+        return MultiPatternEngine::AhoCorasick;
+    }
+    for (const QByteArray& pattern : patterns) {
+        if (pattern.size() < kTeddyMinPatternSize) {
+            return MultiPatternEngine::AhoCorasick;
+        }
+    }
+    return MultiPatternEngine::Teddy;
+}
+
+const char* MultiPatternSearch::engineName(MultiPatternEngine engine) {
+    return engine == MultiPatternEngine::Teddy ? "teddy" : "aho-corasick";
+}
+
+MultiPatternEngine MultiPatternSearch::engine() const { return m_engine; }
+
+int MultiPatternSearch::patternCount() const { return m_patterns.size(); }
+
+void MultiPatternSearch::findAll(const char* haystack, int haystackSize, int startLimit,
+                                 QVector<PatternHit>* hits) const {
+    hits->clear();
+    const int limit = qMin(startLimit, haystackSize);
+    if (haystack == nullptr || limit <= 0 || m_minPatternSize <= 0) {
+        return;
+    }
+
+    const auto* bytes = reinterpret_cast<const unsigned char*>(haystack);
+    if (m_engine == MultiPatternEngine::Teddy) {
+        teddyFindAll(bytes, haystackSize, limit, hits);
+    } else {
+        ahoCorasickFindAll(bytes, haystackSize, limit, hits);
+    }
+    std::sort(hits->begin(), hits->end(), [](const PatternHit& lhs, const PatternHit& rhs) {
+        if (lhs.offset != rhs.offset) {
+            return lhs.offset < rhs.offset;
+        }
+        return lhs.patternIdx < rhs.patternIdx;
+    });
+}
+
+void MultiPatternSearch::prepareTeddy() {
+    m_teddyFingerprint = qMin(kTeddyMaxFingerprint, m_minPatternSize);
+    for (auto& bucket : m_teddyBuckets) {
+        bucket.clear();
+    }
+    for (int j = 0; j < kTeddyMaxFingerprint; ++j) {
+        m_teddyLowNibbles[j].fill(0);
+        m_teddyHighNibbles[j].fill(0);
+    }
+    if (m_teddyFingerprint <= 0) {
+        return;
+    }
+
+    // Patterns with similar prefixes share a bucket so their fingerprints do not pollute others.
+    std::vector<int> order(static_cast<size_t>(m_patterns.size()));
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](int lhs, int rhs) {
+        return m_patterns.at(lhs).left(m_teddyFingerprint) <
+               m_patterns.at(rhs).left(m_teddyFingerprint);
+    });
+
+    const int patternCount = m_patterns.size();
+    for (int rank = 0; rank < patternCount; ++rank) {
+        const int patternIdx = order[static_cast<size_t>(rank)];
+        const int bucket = static_cast<int>((static_cast<qint64>(rank) * kTeddyBuckets) /
+                                            patternCount);
+        m_teddyBuckets[bucket].push_back(patternIdx);
+
+        const auto* p =
+            reinterpret_cast<const unsigned char*>(m_patterns.at(patternIdx).constData());
+        const unsigned char bucketBit = static_cast<unsigned char>(1U << bucket);
+        for (int j = 0; j < m_teddyFingerprint; ++j) {
+            m_teddyLowNibbles[j][p[j] & 0x0F] |= bucketBit;
+            m_teddyHighNibbles[j][p[j] >> 4] |= bucketBit;
+            if (m_foldCase && isLowerAsciiLetter(p[j])) {
+                const unsigned char upper = static_cast<unsigned char>(p[j] - ('a' - 'A'));
+                m_teddyLowNibbles[j][upper & 0x0F] |= bucketBit;
+                m_teddyHighNibbles[j][upper >> 4] |= bucketBit;
+            }
+        }
+    }
+}
+
+void MultiPatternSearch::prepareAhoCorasick() {
+    m_byteClass.fill(0);
+    m_classCount = 1;
+    for (const QByteArray& pattern : m_patterns) {
+        for (const char ch : pattern) {
+            const auto b = static_cast<unsigned char>(ch);
+            if (m_byteClass[b] != 0) {
+                continue;
+            }
+            m_byteClass[b] = static_cast<quint16>(m_classCount);
+            if (m_foldCase && isLowerAsciiLetter(b)) {
+                m_byteClass[b - ('a' - 'A')] = static_cast<quint16>(m_classCount);
+            }
+            ++m_classCount;
+        }
+    }
+
+    const size_t classes = static_cast<size_t>(m_classCount);
+    m_transitions.assign(classes, -1);
+    m_stateOutputs.assign(1, {});
+    for (int patternIdx = 0; patternIdx < m_patterns.size(); ++patternIdx) {
+        int state = 0;
+        for (const char ch : m_patterns.at(patternIdx)) {
+            const size_t slot =
+                static_cast<size_t>(state) * classes + m_byteClass[static_cast<unsigned char>(ch)];
+            if (m_transitions[slot] < 0) {
+                m_transitions[slot] = static_cast<int>(m_stateOutputs.size());
+                m_stateOutputs.emplace_back();
+                m_transitions.resize(m_transitions.size() + classes, -1);
+            }
+            state = m_transitions[slot];
+        }
+        m_stateOutputs[static_cast<size_t>(state)].push_back(patternIdx);
+    }
+
+    // Breadth-first pass turns the trie into a full DFA and links each state to the nearest
+    // suffix state that reports matches.
+    const size_t stateCount = m_stateOutputs.size();
+    std::vector<int> fail(stateCount, 0);
+    m_firstOutputState.assign(stateCount, -1);
+    m_nextOutputState.assign(stateCount, -1);
+    std::deque<int> queue;
+    for (size_t c = 0; c < classes; ++c) {
+        int& next = m_transitions[c];
+        if (next < 0) {
+            next = 0;
+        } else {
+            fail[static_cast<size_t>(next)] = 0;
+            queue.push_back(next);
+        }
+    }
+    while (!queue.empty()) {
+        const int state = queue.front();
+        queue.pop_front();
+        const size_t s = static_cast<size_t>(state);
+        const int suffixOutput = m_firstOutputState[static_cast<size_t>(fail[s])];
+        m_firstOutputState[s] = m_stateOutputs[s].empty() ? suffixOutput : state;
+        m_nextOutputState[s] = suffixOutput;
+
+        for (size_t c = 0; c < classes; ++c) {
+            int& next = m_transitions[s * classes + c];
+            const int fallback = m_transitions[static_cast<size_t>(fail[s]) * classes + c];
+            if (next < 0) {
+                next = fallback;
+            } else {
+                fail[static_cast<size_t>(next)] = fallback;
+                queue.push_back(next);
+            }
+        }
+    }
+}
+
+void MultiPatternSearch::teddyFindAll(const unsigned char* haystack, int haystackSize,
+                                      int startLimit, QVector<PatternHit>* hits) const {
+    const int lastStart = qMin(startLimit, haystackSize - m_minPatternSize + 1);
+    if (lastStart <= 0 || m_teddyFingerprint <= 0) {
+        return;
+    }
+
+    int pos = 0;
+#ifdef BRECO_X86_SEARCH_KERNELS
+    if (teddySimdAvailable()) {
+        auto verify = [this, haystack, haystackSize, hits](int start, unsigned int bucketBits) {
+            teddyVerify(haystack, haystackSize, start, bucketBits, hits);
+        };
+        if (ByteSearch::kernelSupported(SearchKernel::Avx2)) {
+            pos = teddyAvx2(m_teddyLowNibbles, m_teddyHighNibbles, m_teddyFingerprint, haystack,
+                            haystackSize, lastStart, verify);
+        } else {
+            pos = teddySsse3(m_teddyLowNibbles, m_teddyHighNibbles, m_teddyFingerprint, haystack,
+                             haystackSize, lastStart, verify);
+        }
+    }
+#endif
+
+    for (; pos < lastStart; ++pos) {
+        unsigned int bucketBits = 0xFF;
+        for (int j = 0; j < m_teddyFingerprint; ++j) {
+            const unsigned char b = haystack[pos + j];
+            bucketBits &= m_teddyLowNibbles[j][b & 0x0F] & m_teddyHighNibbles[j][b >> 4];
+        }
+        if (bucketBits != 0) {
+            teddyVerify(haystack, haystackSize, pos, bucketBits, hits);
+        }
+    }
+}
+
+void MultiPatternSearch::teddyVerify(const unsigned char* haystack, int haystackSize, int start,
+                                     unsigned int bucketBits, QVector<PatternHit>* hits) const {
+    for (int bucket = 0; bucket < kTeddyBuckets; ++bucket) {
+        if ((bucketBits & (1U << bucket)) == 0) {
+            continue;
+        }
+        for (const int patternIdx : m_teddyBuckets[bucket]) {
+            const QByteArray& pattern = m_patterns.at(patternIdx);
+            if (start + pattern.size() <= haystackSize &&
+                patternMatchesAt(haystack + start, pattern, m_foldCase)) {
+                hits->push_back(PatternHit{start, patternIdx});
+            }
+        }
+    }
+}
+
+void MultiPatternSearch::ahoCorasickFindAll(const unsigned char* haystack, int haystackSize,
+                                            int startLimit, QVector<PatternHit>* hits) const {
+    const int scanEnd = qMin(haystackSize, startLimit + m_maxPatternSize - 1);
+    const size_t classes = static_cast<size_t>(m_classCount);
+    const int* transitions = m_transitions.data();
+    int state = 0;
+    for (int i = 0; i < scanEnd; ++i) {
+        state = transitions[static_cast<size_t>(state) * classes + m_byteClass[haystack[i]]];
+        for (int out = m_firstOutputState[static_cast<size_t>(state)]; out >= 0;
+             out = m_nextOutputState[static_cast<size_t>(out)]) {
+            for (const int patternIdx : m_stateOutputs[static_cast<size_t>(out)]) {
+                const int start = i - static_cast<int>(m_patterns.at(patternIdx).size()) + 1;
+                if (start < startLimit) {
+                    hits->push_back(PatternHit{start, patternIdx});
+                }
+            }
+        }
+    }
+}
+
+}  // namespace breco
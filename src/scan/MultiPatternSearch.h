@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+#include <array>
+#include <vector>
+
+namespace breco {
+
+enum class MultiPatternEngine {
+    Teddy = 0,
+    AhoCorasick
+};
+
+struct PatternHit {
+    int offset = 0;
+    int patternIdx = 0;
+};
+
+// Finds every occurrence of a set of byte patterns in a single pass over the haystack. Small sets
+// use Teddy (SIMD nibble fingerprints of the first pattern bytes, then verification per bucket);
+// larger sets, or sets with very short patterns, use an Aho-Corasick DFA over byte classes.
+class MultiPatternSearch {
+public:
+    // When `foldCase` is set the patterns must already be folded with MatchUtils::foldAsciiCase.
+    MultiPatternSearch(const QVector<QByteArray>& patterns, bool foldCase);
+    MultiPatternSearch(const QVector<QByteArray>& patterns, bool foldCase,
+                       MultiPatternEngine engine);
+
+    static MultiPatternEngine chooseEngine(const QVector<QByteArray>& patterns);
+    static const char* engineName(MultiPatternEngine engine);
+
+    MultiPatternEngine engine() const;
+    int patternCount() const;
+
+    // Replaces `hits` with every match that starts before `startLimit`, ordered by offset and then
+    // by pattern index. Matches may extend past `startLimit` up to `haystackSize`.
+    void findAll(const char* haystack, int haystackSize, int startLimit,
+                 QVector<PatternHit>* hits) const;
+
+private:
+    static constexpr int kTeddyBuckets = 8;
+    static constexpr int kTeddyMaxFingerprint = 3;
+
+    void prepareTeddy();
+    void prepareAhoCorasick();
+    void teddyFindAll(const unsigned char* haystack, int haystackSize, int startLimit,
+                      QVector<PatternHit>* hits) const;
+    void teddyVerify(const unsigned char* haystack, int haystackSize, int start,
+                     unsigned int bucketBits, QVector<PatternHit>* hits) const;
+    void ahoCorasickFindAll(const unsigned char* haystack, int haystackSize, int startLimit,
+                            QVector<PatternHit>* hits) const;
+
+    QVector<QByteArray> m_patterns;
+    bool m_foldCase = false;
+    MultiPatternEngine m_engine = MultiPatternEngine::AhoCorasick;
+    int m_minPatternSize = 0;
+    int m_maxPatternSize = 0;
+
+    int m_teddyFingerprint = 0;
+    std::array<std::array<unsigned char, 16>, kTeddyMaxFingerprint> m_teddyLowNibbles{};
+    std::array<std::array<unsigned char, 16>, kTeddyMaxFingerprint> m_teddyHighNibbles{};
+    std::array<std::vector<int>, kTeddyBuckets> m_teddyBuckets;
+
+    // Class 0 holds the bytes no pattern uses, so a set using every byte value needs 257.
+    std::array<quint16, 256> m_byteClass{};
+    int m_classCount = 1;
+    std::vector<int> m_transitions;
+    std::vector<int> m_firstOutputState;
+    std::vector<int> m_nextOutputState;
+    std::vector<std::vector<int>> m_stateOutputs;
+};
+
+}  // namespace breco
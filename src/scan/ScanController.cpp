@@ -1,6 +1,7 @@
 #include "scan/ScanController.h"
 
 #include <algorithm>
+#include <bitset>
 #include <iostream>
 #include <limits>
 #include <queue>
@@ -10,6 +11,8 @@
 
 #include "io/OpenFilePool.h"
 #include "io/ShiftedWindowLoader.h"
+#include "scan/ByteSearch.h"
+#include "scan/MatchUtils.h"
 
 namespace breco {
 
@@ -17,6 +20,41 @@ namespace {
 constexpr quint64 kMergeGapBytes = 16ULL * 1024ULL * 1024ULL;
 constexpr quint64 kResultPaddingBytes = 8ULL * 1024ULL * 1024ULL;
 constexpr quint64 kMaxResultBufferBytes = 128ULL * 1024ULL * 1024ULL;
+
+bool matchLess(const MatchRecord& lhs, const MatchRecord& rhs) {
+    if (lhs.scanTargetIdx != rhs.scanTargetIdx) {
+        return lhs.scanTargetIdx < rhs.scanTargetIdx;
+    }
+    if (lhs.offset != rhs.offset) {
+        return lhs.offset < rhs.offset;
+    }
+    if (lhs.threadId != rhs.threadId) {
+        return lhs.threadId < rhs.threadId;
+    }
+    if (lhs.termIdx != rhs.termIdx) {
+        return lhs.termIdx < rhs.termIdx;
+    }
+    if (lhs.bitOffset != rhs.bitOffset) {
+        return lhs.bitOffset < rhs.bitOffset;
+    }
+    return lhs.encoding < rhs.encoding;
+}
+
+// matchLess on stored records: targets and offsets are compared on their columns, and only
+// records at the same offset of the same target are rebuilt.
+bool storedMatchLess(const MatchStore& lhsStore, int lhs, const MatchStore& rhsStore, int rhs) {
+    const int lhsTarget = lhsStore.scanTargetIdx(lhs);
+    const int rhsTarget = rhsStore.scanTargetIdx(rhs);
+    if (lhsTarget != rhsTarget) {
+        return lhsTarget < rhsTarget;
+    }
+    const quint64 lhsOffset = lhsStore.offset(lhs);
+    const quint64 rhsOffset = rhsStore.offset(rhs);
+    if (lhsOffset != rhsOffset) {
+        return lhsOffset < rhsOffset;
+    }
+    return matchLess(lhsStore.at(lhs), rhsStore.at(rhs));
+}
 }
 
 ScanController::ScanController(OpenFilePool* filePool, QObject* parent) : QObject(parent) {
@@ -36,15 +74,18 @@ ScanController::~ScanController() {
     joinReaderAndWorkers();
 }
 
-void ScanController::startScan(const QVector<ScanTarget>& targets, const QByteArray& searchTerm,
-                               quint32 blockSize, int workerCount, TextInterpretationMode mode,
-                               bool ignoreCase, bool prefillOnMerge,
+void ScanController::startScan(const QVector<ScanTarget>& targets, const SearchQuery& query,
+                               quint32 blockSize, int workerCount, bool prefillOnMerge,
+                               ScanReportMode reportMode,
                                std::chrono::steady_clock::time_point scanButtonPressTime) {
     if (m_running) {
         emit scanError(QStringLiteral("Scan already running"));
         return;
     }
-    if (searchTerm.isEmpty()) {
+    const SearchQuery& scanQuery = m_carvingEnabled ? m_carver.searchQuery() : query;
+    if (scanQuery.terms.isEmpty() ||
+        std::any_of(scanQuery.terms.cbegin(), scanQuery.terms.cend(),
+                    [](const QByteArray& term) { return term.isEmpty(); })) {
         emit scanError(QStringLiteral("Search term must not be empty"));
         return;
     }
@@ -66,11 +107,41 @@ void ScanController::startScan(const QVector<ScanTarget>& targets, const QByteAr
         return;
     }
 
-    m_searchTerm = searchTerm;
+    m_carving = m_carvingEnabled;
+    m_termLabels = m_carving ? m_carver.termLabels() : QVector<QString>();
+    m_query = scanQuery;
     m_blockSize = qMax<quint32>(1, blockSize);
-    m_textMode = mode;
-    m_ignoreCase = ignoreCase;
+    QString planError;
+    m_searchPlan = SearchPlan::compile(m_query, &planError);
+    if (m_searchPlan == nullptr) {
+        emit scanError(m_query.regex ? QStringLiteral("Invalid regex: %1").arg(planError)
+                                     : planError);
+        return;
+    }
     m_prefillOnMerge = prefillOnMerge;
+    // Carving pairs headers with footers, so it needs every match.
+    m_reportMode = m_carving ? ScanReportMode::Matches : reportMode;
+    m_targetMatched = std::make_unique<std::atomic<bool>[]>(static_cast<size_t>(m_targets.size()));
+    if (m_entropyMapEnabled) {
+        m_entropyMaps.reserve(m_targets.size());
+        for (const ScanTarget& target : m_targets) {
+            m_entropyMaps.push_back(EntropyMap(target.fileSize));
+        }
+    }
+    // Runs of regex and streamed-needle scans cross jobs; a skipped window would cut them.
+    // Carved files end in footers inside compressed data, which the gate would skip.
+    m_entropyGated = m_entropySkipBits > 0.0 && m_searchPlan->regex() == nullptr &&
+                     !m_searchPlan->streamsNeedle() && !m_carving;
+    m_entropyGate.maxBits = m_entropySkipBits;
+    // Probes the plan 256 times: once for the reader and every worker.
+    m_constantRunMatches = m_searchPlan->constantRunMatches();
+    m_entropyGate.skippedBytes.store(0, std::memory_order_relaxed);
+    m_matchBudget.maxRecords = qMax<quint64>(
+        1, qMin<quint64>(m_maxMatches, m_matchMemoryBytes / MatchStore::kRecordBytes));
+    m_matchBudget.claimed.store(0, std::memory_order_relaxed);
+    m_matchBudget.exceeded.store(false, std::memory_order_relaxed);
+    m_matchBudget.cutoffTarget = std::numeric_limits<int>::max();
+    m_matchBudget.cutoffOffset = 0;
     m_totalScanned.store(0, std::memory_order_release);
     m_stopRequested.store(false, std::memory_order_release);
     m_readerDone.store(false, std::memory_order_release);
@@ -130,12 +201,17 @@ void ScanController::startScan(const QVector<ScanTarget>& targets, const QByteAr
         m_pendingCv.notify_all();
     };
 
+    EntropyMap* entropyMaps = m_entropyMaps.isEmpty() ? nullptr : m_entropyMaps.data();
+    EntropyGate* entropyGate = m_entropyGated ? &m_entropyGate : nullptr;
+    // Footers end files wherever they are; carveFiles() applies the alignment to the headers.
+    const quint32 workerAlignment = m_carving ? 1 : m_matchAlignment;
+    const FileCarver* carver = m_carving ? &m_carver : nullptr;
     m_workers.reserve(m_workerCount);
     for (int i = 0; i < m_workerCount; ++i) {
-        m_workers.push_back(std::make_unique<ScanWorker>(i, m_searchTerm, m_textMode, m_ignoreCase,
-                                                         &m_totalScanned,
-                                                         m_scanStartTime,
-                                                         onJobComplete));
+        m_workers.push_back(std::make_unique<ScanWorker>(
+            i, m_searchPlan, &m_totalScanned, m_scanStartTime, onJobComplete, m_reportMode,
+            m_targetMatched.get(), &m_matchBudget, entropyMaps, entropyGate, workerAlignment,
+            carver, m_constantRunMatches));
     }
     for (const auto& worker : m_workers) {
         worker->start();
@@ -145,12 +221,54 @@ void ScanController::startScan(const QVector<ScanTarget>& targets, const QByteAr
 
     m_running = true;
     m_tickTimer.start();
+    const ApproximateSearch* approximate = m_searchPlan->approximate();
     std::cout << "[scan] started: files=" << m_fileCount << " totalBytes=" << m_totalBytes
               << " workers=" << m_workerCount << " blockSize=" << m_blockSize
-              << " prefillOnMerge=" << (m_prefillOnMerge ? "true" : "false") << std::endl;
+              << " prefillOnMerge=" << (m_prefillOnMerge ? "true" : "false")
+              << " terms=" << m_query.terms.size()
+              << " bitPhases=" << (m_query.bitPhases ? "true" : "false")
+              << " regex=" << (m_query.regex ? "true" : "false")
+              << " encodings=" << (m_query.encodingVariants ? "utf8+utf16le+utf16be" : "utf8")
+              << " encodedForms=" << (m_query.encodedForms ? "base64+hex+url" : "off")
+              << " xorKeys=" << (m_query.xorKeys ? "true" : "false")
+              << " numeric=" << (m_query.numeric ? "true" : "false")
+              << " tolerance=" << (m_query.numeric ? m_query.tolerance : 0.0)
+              << " nearTerms=" << m_query.nearTerms.size()
+              << " nearDistance=" << m_searchPlan->lookBehind() << " report="
+              << (m_reportMode == ScanReportMode::Count       ? "count"
+                  : m_reportMode == ScanReportMode::Existence ? "exists"
+                                                              : "matches")
+              << " maxMatchRecords=" << m_matchBudget.maxRecords << " approximate="
+              << ApproximateSearch::metricName(approximate != nullptr ? approximate->metric()
+                                                                      : ApproximateMetric::None)
+              << " maxDistance=" << (approximate != nullptr ? approximate->maxDistance() : 0)
+              << " algorithm=" << SearchPlan::algorithmName(m_searchPlan->algorithm())
+              << " streamsNeedle=" << (m_searchPlan->streamsNeedle() ? "true" : "false")
+              << " entropyMap=" << (m_entropyMaps.isEmpty() ? "false" : "true")
+              << " entropySkipBits=" << (m_entropyGated ? m_entropyGate.maxBits : 0.0)
+              << " matchAlignment=" << m_matchAlignment
+              << " carving=" << (m_carving ? "true" : "false")
+              << " kernel=" << ByteSearch::kernelName(ByteSearch::bestKernel()) << std::endl;
     emit scanStarted(m_fileCount, m_totalBytes);
 }
 
+void ScanController::setMatchLimits(quint64 maxMatches, quint64 memoryBudgetBytes) {
+    m_maxMatches = maxMatches;
+    m_matchMemoryBytes = memoryBudgetBytes;
+}
+
+void ScanController::setEntropyMapEnabled(bool enabled) { m_entropyMapEnabled = enabled; }
+
+void ScanController::setEntropySkipThreshold(double maxBits) {
+    m_entropySkipBits = qMax(0.0, maxBits);
+}
+
+void ScanController::setMatchAlignment(quint32 alignment) {
+    m_matchAlignment = qMax<quint32>(1, alignment);
+}
+
+void ScanController::setCarvingEnabled(bool enabled) { m_carvingEnabled = enabled; }
+
 void ScanController::requestStop() {
     if (!m_running) {
         return;
@@ -170,8 +288,55 @@ const QVector<ResultBuffer>& ScanController::resultBuffers() const { return m_re
 
 const QVector<int>& ScanController::matchBufferIndices() const { return m_matchBufferIndices; }
 
+const QVector<EntropyMap>& ScanController::entropyMaps() const { return m_entropyMaps; }
+
+quint64 ScanController::entropySkippedBytes() const {
+    return m_entropyGate.skippedBytes.load(std::memory_order_relaxed);
+}
+
+const QVector<QByteArray>& ScanController::searchTerms() const { return m_query.terms; }
+
+const QVector<QByteArray>& ScanController::termMasks() const { return m_query.masks; }
+
+bool ScanController::carvesFiles() const { return m_carving; }
+
+const CarveSignature* ScanController::carveSignature(int termIdx) const {
+    return m_carving ? m_carver.signatureForTerm(termIdx) : nullptr;
+}
+
+const QVector<QString>& ScanController::termLabels() const { return m_termLabels; }
+
+bool ScanController::searchesBitPhases() const { return m_query.bitPhases; }
+
 quint32 ScanController::searchTermLength() const {
-    return static_cast<quint32>(qMax(1, m_searchTerm.size()));
+    int longest = 1;
+    for (const QByteArray& term : m_query.terms) {
+        longest = qMax(longest, static_cast<int>(term.size()));
+    }
+    return static_cast<quint32>(longest);
+}
+
+quint32 ScanController::termLength(int termIdx) const {
+    if (termIdx < 0 || termIdx >= m_query.terms.size()) {
+        return searchTermLength();
+    }
+    return static_cast<quint32>(qMax(1, static_cast<int>(m_query.terms.at(termIdx).size())));
+}
+
+quint32 ScanController::matchLength(const MatchRecord& match) const {
+    if (m_carving) {
+        return termLength(match.termIdx);
+    }
+    if (match.matchLength > 0) {
+        return static_cast<quint32>(
+            qMin<quint64>(match.matchLength, std::numeric_limits<quint32>::max()));
+    }
+    if (match.encoding != TermEncoding::Utf8 && match.termIdx >= 0 &&
+        match.termIdx < m_query.terms.size()) {
+        return static_cast<quint32>(
+            MatchUtils::encodeTerm(m_query.terms.at(match.termIdx), match.encoding).size());
+    }
+    return termLength(match.termIdx);
 }
 
 void ScanController::onTick() {
@@ -193,12 +358,15 @@ void ScanController::onTick() {
               << " buffers=" << m_resultBuffers.size() << std::endl;
 
     m_running = false;
+    const bool matchLimitExceeded = m_matchBudget.exceeded.load(std::memory_order_acquire);
     emitProgress();
     emit resultsBatchReady(m_finalMatches, m_finalMatches.size());
     std::cout << "[scan] finished: stoppedByUser=" << (m_userStopped ? "true" : "false")
               << " scannedBytes=" << m_totalScanned.load(std::memory_order_relaxed)
-              << " totalBytes=" << m_totalBytes << std::endl;
-    emit scanFinished(m_userStopped, false);
+              << " totalBytes=" << m_totalBytes
+              << " entropySkippedBytes=" << entropySkippedBytes() << " matchLimitExceeded="
+              << (matchLimitExceeded ? "true" : "false") << std::endl;
+    emit scanFinished(m_userStopped, matchLimitExceeded);
 }
 
 void ScanController::clearRuntimeState() {
@@ -222,6 +390,9 @@ void ScanController::clearRuntimeState() {
     m_finalMatches.clear();
     m_resultBuffers.clear();
     m_matchBufferIndices.clear();
+    m_entropyMaps.clear();
+    m_entropyGated = false;
+    m_entropyGate.skippedBytes.store(0, std::memory_order_relaxed);
     {
         std::lock_guard<std::mutex> lock(m_trackerMutex);
         m_bufferJobsRemaining.clear();
@@ -260,8 +431,10 @@ void ScanController::joinReaderAndWorkers() {
 }
 
 void ScanController::readerLoop() {
-    const quint32 overlap =
-        static_cast<quint32>(m_searchTerm.size() > 0 ? m_searchTerm.size() - 1 : 0);
+    const int longestMatch = m_searchPlan != nullptr ? m_searchPlan->maxMatchSpan() : 0;
+    const quint32 overlap = static_cast<quint32>(longestMatch > 0 ? longestMatch - 1 : 0);
+    const quint64 lookBehind =
+        m_searchPlan != nullptr ? static_cast<quint64>(m_searchPlan->lookBehind()) : 0;
     const int maxPendingBuffers = qMax(1, m_workerCount * 2);
 
     for (int targetIdx = 0; targetIdx < m_targets.size(); ++targetIdx) {
@@ -274,6 +447,12 @@ void ScanController::readerLoop() {
             continue;
         }
 
+        // Regex and streamed-needle jobs pass their undecided runs down this chain instead of
+        // reading an overlap.
+        const bool carriesRegexRuns =
+            m_searchPlan != nullptr &&
+            (m_searchPlan->regex() != nullptr || m_searchPlan->streamsNeedle());
+        std::shared_ptr<RegexCarry> regexCarry;
         quint64 fileOffset = 0;
         while (fileOffset < target.fileSize) {
             {
@@ -284,9 +463,18 @@ void ScanController::readerLoop() {
                 });
             }
 
+            if (m_matchBudget.exceeded.load(std::memory_order_acquire)) {
+                stopInternal(false);
+            }
             if (m_stopRequested.load(std::memory_order_acquire)) {
                 break;
             }
+            if (m_reportMode == ScanReportMode::Existence &&
+                m_targetMatched[targetIdx].load(std::memory_order_relaxed)) {
+                // The rest of a matched target is never read; count it as scanned for progress.
+                m_totalScanned.fetch_add(target.fileSize - fileOffset, std::memory_order_relaxed);
+                break;
+            }
 
             const quint64 primarySize = qMin<quint64>(m_blockSize, target.fileSize - fileOffset);
             quint64 outputSize = primarySize;
@@ -296,8 +484,11 @@ void ScanController::readerLoop() {
 
             const quint64 chunkId = m_chunkCounter.fetch_add(1, std::memory_order_acq_rel) + 1;
 
-            auto rawWindow = m_windowLoader->loadRawWindow(
-                target.filePath, target.fileSize, fileOffset, outputSize, ShiftSettings{});
+            // Jobs keep their offsets; the bytes read before the block only feed lookBehind().
+            const quint64 readBehind = qMin(lookBehind, fileOffset);
+            auto rawWindow = m_windowLoader->loadRawWindow(target.filePath, target.fileSize,
+                                                           fileOffset - readBehind,
+                                                           outputSize + readBehind, ShiftSettings{});
             if (!rawWindow.has_value()) {
                 std::cerr << "[scan][warn] read failed: targetIdx=" << targetIdx
                           << " offset=" << fileOffset
@@ -305,6 +496,24 @@ void ScanController::readerLoop() {
                 break;
             }
 
+            // A block of one byte value, look-behind and overlap included, holds no match unless
+            // the plan matches runs of that value, so it needs no jobs (e.g. zero-filled space on
+            // a disk image). Regex plans report every value: their carry chain must not break.
+            const QByteArray& rawBytes = rawWindow->bytes;
+            if (!rawBytes.isEmpty() &&
+                !m_constantRunMatches[static_cast<unsigned char>(rawBytes.at(0))] &&
+                ByteSearch::isConstant(rawBytes.constData(), rawBytes.size())) {
+                if (!m_entropyMaps.isEmpty()) {
+                    m_entropyMaps[targetIdx].measure(rawBytes.constData(),
+                                                     rawWindow->plan.readStart,
+                                                     static_cast<quint64>(rawBytes.size()),
+                                                     fileOffset, fileOffset + primarySize);
+                }
+                m_totalScanned.fetch_add(primarySize, std::memory_order_relaxed);
+                fileOffset += primarySize;
+                continue;
+            }
+
             auto buffer = std::make_shared<ReadBuffer>();
             buffer->scanTargetIdx = targetIdx;
             buffer->fileSize = target.fileSize;
@@ -345,6 +554,11 @@ void ScanController::readerLoop() {
                 job.reportLimit = static_cast<quint32>(
                     qMin<quint64>(jobPrimary, std::numeric_limits<quint32>::max()));
                 if (job.size > 0 && job.reportLimit > 0) {
+                    if (carriesRegexRuns) {
+                        job.carryIn = regexCarry;
+                        job.carryOut = std::make_shared<RegexCarry>();
+                        regexCarry = job.carryOut;
+                    }
                     jobs.push_back(job);
                 }
 
@@ -472,61 +686,94 @@ void ScanController::markJobTokenCompleted(quint64 bufferToken) {
 
 void ScanController::buildFinalResults() {
     m_finalMatches.clear();
-    auto matchLess = [](const MatchRecord& lhs, const MatchRecord& rhs) {
-        if (lhs.scanTargetIdx != rhs.scanTargetIdx) {
-            return lhs.scanTargetIdx < rhs.scanTargetIdx;
+    if (m_reportMode == ScanReportMode::Matches) {
+        mergeWorkerMatches();
+        if (m_matchBudget.exceeded.load(std::memory_order_acquire)) {
+            // Keep the matches before the first one the budget dropped, the lowest ones.
+            int kept = 0;
+            for (int count = m_finalMatches.size(); count > 0;) {
+                const int half = count / 2;
+                const int mid = kept + half;
+                const int target = m_finalMatches.scanTargetIdx(mid);
+                if (target != m_matchBudget.cutoffTarget
+                        ? target < m_matchBudget.cutoffTarget
+                        : m_finalMatches.offset(mid) < m_matchBudget.cutoffOffset) {
+                    kept = mid + 1;
+                    count -= half + 1;
+                } else {
+                    count = half;
+                }
+            }
+            m_finalMatches.truncate(kept);
         }
-        if (lhs.offset != rhs.offset) {
-            return lhs.offset < rhs.offset;
+    } else {
+        QVector<MatchRecord> targetMatches;
+        for (const auto& worker : m_workers) {
+            targetMatches.append(worker->targetMatches());
         }
-        return lhs.threadId < rhs.threadId;
-    };
+        std::sort(targetMatches.begin(), targetMatches.end(), matchLess);
+        foldTargetMatches(&targetMatches);
+        m_finalMatches.appendRecords(targetMatches);
+    }
+    for (const auto& worker : m_workers) {
+        worker->releaseMatches();
+    }
+    dropShadowedApproximateMatches();
+    carveFiles();
+    buildResultBuffers();
+}
 
+// Worker stores are each sorted, so a k-way merge copies their columns into the final store in
+// order; records are only rebuilt to order ties at one offset.
+void ScanController::mergeWorkerMatches() {
     struct MergeCursor {
         int workerIdx = 0;
         int matchIdx = 0;
     };
 
-    quint64 totalMatches = 0;
     bool workerStreamsSorted = true;
+    QVector<int> batchBases;
     for (int workerIdx = 0; workerIdx < static_cast<int>(m_workers.size()); ++workerIdx) {
-        const QVector<MatchRecord>& workerMatches = m_workers[workerIdx]->matches();
-        totalMatches += static_cast<quint64>(workerMatches.size());
-        for (int i = 1; i < workerMatches.size(); ++i) {
-            if (matchLess(workerMatches.at(i), workerMatches.at(i - 1))) {
-                workerStreamsSorted = false;
-                break;
-            }
-        }
-        if (!workerStreamsSorted) {
-            break;
+        const MatchStore& workerMatches = m_workers[workerIdx]->matches();
+        for (int i = 1; i < workerMatches.size() && workerStreamsSorted; ++i) {
+            workerStreamsSorted = !storedMatchLess(workerMatches, i, workerMatches, i - 1);
         }
+        batchBases.push_back(m_finalMatches.adoptBatches(workerMatches));
     }
 
-    m_finalMatches.reserve(static_cast<int>(qMin<quint64>(
-        totalMatches, static_cast<quint64>(std::numeric_limits<int>::max()))));
     if (!workerStreamsSorted) {
         std::cerr << "[scan][warn] worker match stream order invalid, falling back to global sort"
                   << std::endl;
+        std::vector<MergeCursor> order;
         for (int workerIdx = 0; workerIdx < static_cast<int>(m_workers.size()); ++workerIdx) {
-            const QVector<MatchRecord>& workerMatches = m_workers[workerIdx]->matches();
-            for (const MatchRecord& match : workerMatches) {
-                m_finalMatches.push_back(match);
+            for (int i = 0; i < m_workers[workerIdx]->matches().size(); ++i) {
+                order.push_back(MergeCursor{workerIdx, i});
             }
         }
-        std::sort(m_finalMatches.begin(), m_finalMatches.end(), matchLess);
-        buildResultBuffers();
+        std::sort(order.begin(), order.end(),
+                  [this](const MergeCursor& lhs, const MergeCursor& rhs) {
+                      return storedMatchLess(m_workers[lhs.workerIdx]->matches(), lhs.matchIdx,
+                                             m_workers[rhs.workerIdx]->matches(), rhs.matchIdx);
+                  });
+        for (const MergeCursor& cursor : order) {
+            m_finalMatches.appendFrom(m_workers[cursor.workerIdx]->matches(), cursor.matchIdx,
+                                      batchBases.at(cursor.workerIdx));
+        }
         return;
     }
 
     auto cursorIsLowerPriority = [this](const MergeCursor& lhs, const MergeCursor& rhs) {
-        const MatchRecord& left = m_workers[lhs.workerIdx]->matches().at(lhs.matchIdx);
-        const MatchRecord& right = m_workers[rhs.workerIdx]->matches().at(rhs.matchIdx);
-        if (left.scanTargetIdx != right.scanTargetIdx) {
-            return left.scanTargetIdx > right.scanTargetIdx;
+        const MatchStore& left = m_workers[lhs.workerIdx]->matches();
+        const MatchStore& right = m_workers[rhs.workerIdx]->matches();
+        const int leftTarget = left.scanTargetIdx(lhs.matchIdx);
+        const int rightTarget = right.scanTargetIdx(rhs.matchIdx);
+        if (leftTarget != rightTarget) {
+            return leftTarget > rightTarget;
         }
-        if (left.offset != right.offset) {
-            return left.offset > right.offset;
+        const quint64 leftOffset = left.offset(lhs.matchIdx);
+        const quint64 rightOffset = right.offset(rhs.matchIdx);
+        if (leftOffset != rightOffset) {
+            return leftOffset > rightOffset;
         }
         return lhs.workerIdx > rhs.workerIdx;
     };
@@ -545,16 +792,66 @@ void ScanController::buildFinalResults() {
         const MergeCursor cursor = mergeHeap.top();
         mergeHeap.pop();
 
-        const QVector<MatchRecord>& matches = m_workers[cursor.workerIdx]->matches();
-        m_finalMatches.push_back(matches.at(cursor.matchIdx));
+        const MatchStore& matches = m_workers[cursor.workerIdx]->matches();
+        m_finalMatches.appendFrom(matches, cursor.matchIdx, batchBases.at(cursor.workerIdx));
 
         const int nextMatchIdx = cursor.matchIdx + 1;
         if (nextMatchIdx < matches.size()) {
             mergeHeap.push(MergeCursor{cursor.workerIdx, nextMatchIdx});
         }
     }
+}
 
-    buildResultBuffers();
+// Count and existence workers each keep one record per target; the merged list has them side by
+// side, earliest first.
+void ScanController::foldTargetMatches(QVector<MatchRecord>* matches) const {
+    int kept = 0;
+    for (int i = 0; i < matches->size(); ++i) {
+        const MatchRecord& match = matches->at(i);
+        if (kept > 0 && matches->at(kept - 1).scanTargetIdx == match.scanTargetIdx) {
+            (*matches)[kept - 1].matchCount += match.matchCount;
+            continue;
+        }
+        (*matches)[kept++] = match;
+    }
+    matches->resize(kept);
+}
+
+// Size-field signatures read their header bytes here; everything else comes from the matches.
+void ScanController::carveFiles() {
+    if (!m_carving) {
+        return;
+    }
+    QVector<quint64> targetSizes;
+    targetSizes.reserve(m_targets.size());
+    for (const ScanTarget& target : m_targets) {
+        targetSizes.push_back(target.fileSize);
+    }
+    const int headerAndFooterMatches = m_finalMatches.size();
+    const QVector<MatchRecord> files = m_carver.carve(
+        m_finalMatches.toRecords(), targetSizes, m_matchAlignment,
+        [this](int scanTargetIdx, quint64 offset, quint64 size) {
+            return loadRawWindow(scanTargetIdx, offset, size);
+        });
+    m_finalMatches.clear();
+    m_finalMatches.appendRecords(files);
+    std::cout << "[scan] carved: files=" << m_finalMatches.size()
+              << " headerAndFooterMatches=" << headerAndFooterMatches << std::endl;
+}
+
+// Edit-distance jobs report every start within range; only the whole result list shows which
+// of them are the best start of an occurrence.
+void ScanController::dropShadowedApproximateMatches() {
+    const ApproximateSearch* approximate =
+        m_searchPlan != nullptr ? m_searchPlan->approximate() : nullptr;
+    if (approximate == nullptr || approximate->metric() != ApproximateMetric::Edit ||
+        m_reportMode != ScanReportMode::Matches) {
+        return;
+    }
+    QVector<MatchRecord> matches = m_finalMatches.toRecords();
+    ApproximateSearch::dropShadowedMatches(approximate->maxDistance(), &matches);
+    m_finalMatches.clear();
+    m_finalMatches.appendRecords(matches);
 }
 
 void ScanController::buildResultBuffers() {
@@ -567,10 +864,9 @@ void ScanController::buildResultBuffers() {
     if (!m_prefillOnMerge) {
         m_resultBuffers.reserve(m_finalMatches.size());
         for (int i = 0; i < m_finalMatches.size(); ++i) {
-            const MatchRecord& match = m_finalMatches.at(i);
             ResultBuffer resultBuffer;
-            resultBuffer.scanTargetIdx = match.scanTargetIdx;
-            resultBuffer.fileOffset = match.offset;
+            resultBuffer.scanTargetIdx = m_finalMatches.scanTargetIdx(i);
+            resultBuffer.fileOffset = m_finalMatches.offset(i);
             resultBuffer.bytes.clear();
             resultBuffer.dirty = false;
             const int bufferIndex = m_resultBuffers.size();
@@ -582,11 +878,9 @@ void ScanController::buildResultBuffers() {
         return;
     }
 
-    const quint64 termLen = static_cast<quint64>(searchTermLength());
-
     int startIdx = 0;
     while (startIdx < m_finalMatches.size()) {
-        const int targetIdx = m_finalMatches.at(startIdx).scanTargetIdx;
+        const int targetIdx = m_finalMatches.scanTargetIdx(startIdx);
         const quint64 targetSize = fileSizeForTarget(targetIdx);
         if (targetIdx < 0 || targetSize == 0) {
             ++startIdx;
@@ -594,17 +888,20 @@ void ScanController::buildResultBuffers() {
         }
 
         int endIdx = startIdx + 1;
-        quint64 clusterFirst = m_finalMatches.at(startIdx).offset;
-        quint64 clusterLast = m_finalMatches.at(startIdx).offset;
-
-        while (endIdx < m_finalMatches.size() && m_finalMatches.at(endIdx).scanTargetIdx == targetIdx) {
-            const quint64 nextOffset = m_finalMatches.at(endIdx).offset;
+        quint64 clusterFirst = m_finalMatches.offset(startIdx);
+        quint64 clusterLast = m_finalMatches.offset(startIdx);
+        quint64 clusterEnd = clusterFirst + matchLength(m_finalMatches.at(startIdx));
+
+        while (endIdx < m_finalMatches.size() &&
+               m_finalMatches.scanTargetIdx(endIdx) == targetIdx) {
+            const quint64 nextOffset = m_finalMatches.offset(endIdx);
+            const quint64 nextEnd =
+                qMax(clusterEnd, nextOffset + matchLength(m_finalMatches.at(endIdx)));
             const bool nearEnough = nextOffset <= (clusterLast + kMergeGapBytes);
 
             const quint64 rangeStart =
                 (clusterFirst > kResultPaddingBytes) ? (clusterFirst - kResultPaddingBytes) : 0;
-            const quint64 rangeEnd =
-                qMin(targetSize, nextOffset + termLen + kResultPaddingBytes);
+            const quint64 rangeEnd = qMin(targetSize, nextEnd + kResultPaddingBytes);
             const quint64 rangeSize = (rangeEnd > rangeStart) ? (rangeEnd - rangeStart) : 0;
             const bool fitsMax = rangeSize <= kMaxResultBufferBytes;
 
@@ -613,12 +910,13 @@ void ScanController::buildResultBuffers() {
             }
 
             clusterLast = nextOffset;
+            clusterEnd = nextEnd;
             ++endIdx;
         }
 
         const quint64 bufferStart =
             (clusterFirst > kResultPaddingBytes) ? (clusterFirst - kResultPaddingBytes) : 0;
-        quint64 bufferEnd = qMin(targetSize, clusterLast + termLen + kResultPaddingBytes);
+        quint64 bufferEnd = qMin(targetSize, clusterEnd + kResultPaddingBytes);
         if (bufferEnd < bufferStart) {
             bufferEnd = bufferStart;
         }
@@ -5,6 +5,7 @@
 #include <QTimer>
 #include <QVector>
 #include <atomic>
+#include <bitset>
 #include <chrono>
 #include <condition_variable>
 #include <cstddef>
@@ -15,7 +16,11 @@
 #include <unordered_map>
 
 #include "model/ResultTypes.h"
+#include "scan/EntropyMap.h"
+#include "scan/FileCarver.h"
+#include "scan/MatchStore.h"
 #include "scan/ScanWorker.h"
+#include "scan/SearchPlan.h"
 
 namespace breco {
 
@@ -26,14 +31,36 @@ class ScanController : public QObject {
     Q_OBJECT
 
 public:
+    static constexpr quint64 kDefaultMaxMatches = 10000000ULL;
+    static constexpr quint64 kDefaultMatchMemoryBytes = 1024ULL * 1024ULL * 1024ULL;
+
     explicit ScanController(OpenFilePool* filePool = nullptr, QObject* parent = nullptr);
     ~ScanController() override;
 
-    void startScan(const QVector<ScanTarget>& targets, const QByteArray& searchTerm, quint32 blockSize,
-                   int workerCount, TextInterpretationMode mode, bool ignoreCase,
-                   bool prefillOnMerge,
+    void startScan(const QVector<ScanTarget>& targets, const SearchQuery& query,
+                   quint32 blockSize, int workerCount, bool prefillOnMerge,
+                   ScanReportMode reportMode,
                    std::chrono::steady_clock::time_point scanButtonPressTime =
                        std::chrono::steady_clock::time_point{});
+    // Caps the match records an all-matches scan keeps, by count and by memory; applies from the
+    // next startScan(). A scan that reaches the cap stops and reports autoStoppedLimitExceeded.
+    void setMatchLimits(quint64 maxMatches, quint64 memoryBudgetBytes);
+    // Makes the workers measure an EntropyMap of every target while they scan; applies from the
+    // next startScan().
+    void setEntropyMapEnabled(bool enabled);
+    // Makes the workers skip the windows whose sampled entropy is above `maxBits` (0 turns the
+    // gate off); applies from the next startScan(). Regex and streamed-needle scans are not gated.
+    void setEntropySkipThreshold(double maxBits);
+    // Only reports matches starting at file offsets that are multiples of `alignment` (e.g. 512
+    // or 4096 for headers at sector starts; 0 and 1 report every offset); applies from the next
+    // startScan(). Exact and hex searches then compare the terms once per aligned offset
+    // instead of searching every byte.
+    void setMatchAlignment(quint32 alignment);
+    // Searches for the built-in FileCarver signatures instead of the query's terms and reports
+    // one match per carved file (the header's match, `matchLength` the file size) instead of
+    // the header and footer matches; applies from the next startScan(). Carving scans report
+    // all matches, are not entropy-gated, and apply the match alignment to headers only.
+    void setCarvingEnabled(bool enabled);
     void requestStop();
     bool isRunning() const;
     quint64 totalPlannedBytes() const;
@@ -41,12 +68,31 @@ public:
     const QVector<ScanTarget>& scanTargets() const;
     const QVector<ResultBuffer>& resultBuffers() const;
     const QVector<int>& matchBufferIndices() const;
+    // One map per scan target, complete once the scan finished; empty when the scan did not
+    // measure entropy.
+    const QVector<EntropyMap>& entropyMaps() const;
+    // Bytes the last or running scan counted as scanned without searching them (entropy gate).
+    quint64 entropySkippedBytes() const;
+    const QVector<QByteArray>& searchTerms() const;
+    const QVector<QByteArray>& termMasks() const;
+    // Whether the last or running scan carves files.
+    bool carvesFiles() const;
+    // Carving scans: the signature of term `termIdx`; nullptr for other scans.
+    const CarveSignature* carveSignature(int termIdx) const;
+    // Carving scans: one name per search term; empty for other scans.
+    const QVector<QString>& termLabels() const;
+    bool searchesBitPhases() const;
     quint32 searchTermLength() const;
+    quint32 termLength(int termIdx) const;
+    // Bytes covered by `match`: its own length for regex matches, otherwise its term's length in
+    // the encoding it matched in. Carved files cover their header only, so previews and result
+    // buffers do not load whole files.
+    quint32 matchLength(const MatchRecord& match) const;
 
 signals:
     void scanStarted(int fileCount, quint64 totalBytes);
     void progressUpdated(quint64 scannedBytes, quint64 totalBytes);
-    void resultsBatchReady(const QVector<MatchRecord>& matches, int mergedTotal);
+    void resultsBatchReady(const MatchStore& matches, int mergedTotal);
     void scanFinished(bool stoppedByUser, bool autoStoppedLimitExceeded);
     void scanError(const QString& message);
 
@@ -60,6 +106,11 @@ private:
     bool dispatchJob(const ScanJob& job);
     void markJobTokenCompleted(quint64 bufferToken);
     void buildFinalResults();
+    void mergeWorkerMatches();
+    void dropShadowedApproximateMatches();
+    void foldTargetMatches(QVector<MatchRecord>* matches) const;
+    // Carving scans: replaces the merged header and footer matches with the carved files.
+    void carveFiles();
     void buildResultBuffers();
     QByteArray loadRawWindow(int scanTargetIdx, quint64 start, quint64 size) const;
     quint64 fileSizeForTarget(int scanTargetIdx) const;
@@ -67,11 +118,29 @@ private:
     void emitProgress();
 
     QVector<ScanTarget> m_targets;
-    QByteArray m_searchTerm;
+    SearchQuery m_query;
     quint32 m_blockSize = 4096;
-    TextInterpretationMode m_textMode = TextInterpretationMode::Ascii;
-    bool m_ignoreCase = false;
+    std::shared_ptr<const SearchPlan> m_searchPlan;
     bool m_prefillOnMerge = true;
+    ScanReportMode m_reportMode = ScanReportMode::Matches;
+    // Existence scans: set once a target has a match, so the reader and workers skip the rest.
+    std::unique_ptr<std::atomic<bool>[]> m_targetMatched;
+    quint64 m_maxMatches = kDefaultMaxMatches;
+    quint64 m_matchMemoryBytes = kDefaultMatchMemoryBytes;
+    MatchBudget m_matchBudget;
+    bool m_entropyMapEnabled = false;
+    // Sized before the workers start and written by them in place (disjoint blocks).
+    QVector<EntropyMap> m_entropyMaps;
+    double m_entropySkipBits = 0.0;
+    EntropyGate m_entropyGate;
+    bool m_entropyGated = false;
+    // SearchPlan::constantRunMatches() of the scan's plan, shared by the reader and the workers.
+    std::bitset<256> m_constantRunMatches;
+    quint32 m_matchAlignment = 1;
+    bool m_carvingEnabled = false;
+    bool m_carving = false;
+    FileCarver m_carver;
+    QVector<QString> m_termLabels;
     std::chrono::steady_clock::time_point m_scanStartTime{};
     std::atomic<quint64> m_chunkCounter{0};
     std::atomic<quint64> m_totalScanned{0};
@@ -100,7 +169,7 @@ private:
     bool m_userStopped = false;
     quint64 m_totalBytes = 0;
     int m_fileCount = 0;
-    QVector<MatchRecord> m_finalMatches;
+    MatchStore m_finalMatches;
     QVector<ResultBuffer> m_resultBuffers;
     QVector<int> m_matchBufferIndices;
     OpenFilePool* m_filePool = nullptr;
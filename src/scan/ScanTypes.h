@@ -2,10 +2,44 @@
 
 #include <QByteArray>
 #include <QtGlobal>
+#include <QVector>
+#include <atomic>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace breco {
 
+// What a scan keeps of the matches it finds. Count and existence scans keep one MatchRecord per
+// target (its first match) instead of every match; existence scans also stop reading a target
+// after its first match.
+enum class ScanReportMode {
+    Matches = 0,
+    Count,
+    Existence
+};
+
+// Room for match records shared by the workers of a scan (all-matches scans). Workers claim room
+// before recording; a claim that does not fit in full sets `exceeded`, and the scan stops.
+// Workers race for the room, so every match they drop or job they skip lowers the cutoff
+// (target, offset); the results keep only the matches before it, the lowest ones.
+struct MatchBudget {
+    std::atomic<quint64> claimed{0};
+    quint64 maxRecords = 0;
+    std::atomic<bool> exceeded{false};
+    std::mutex cutoffMutex;
+    int cutoffTarget = std::numeric_limits<int>::max();
+    quint64 cutoffOffset = 0;
+};
+
+// Entropy-gated scans: workers search no window (one EntropyMap block, cut at job edges) whose
+// sampled entropy is above `maxBits`; the skipped bytes still count as scanned.
+struct EntropyGate {
+    double maxBits = 8.0;
+    std::atomic<quint64> skippedBytes{0};
+};
+
 struct ReadBuffer {
     int scanTargetIdx = -1;
     quint64 fileSize = 0;
@@ -15,6 +49,52 @@ struct ReadBuffer {
     QByteArray rawBytes;
 };
 
+struct RegexCarry;
+
+struct RegexMatch {
+    quint64 start = 0;
+    quint64 length = 0;
+    int patternIdx = 0;
+};
+
+// The state of a regex or streamed-needle scan at the end of a job's data, carried into the next
+// job of the target instead of an overlap. Regex scans keep their DFA state: the NFA states of
+// each live start, oldest first, separated by -1, and the offset of each start. Streamed-needle
+// plans keep at most one state, the number of needle bytes the longest open prefix matched.
+struct RegexRun {
+    std::vector<int> states;
+    std::vector<quint64> starts;
+
+    bool isEmpty() const { return starts.empty(); }
+};
+
+// The rest of a regex or streamed-needle job that finished its own region before its predecessor
+// published the state it has to continue from: the job's data, the matches and end state of its
+// own scan.
+struct RegexContinuation {
+    std::shared_ptr<ReadBuffer> buffer;
+    int scanTargetIdx = -1;
+    const char* data = nullptr;
+    int size = 0;
+    int startLimit = 0;
+    quint64 fileOffset = 0;
+    QVector<RegexMatch> matches;
+    RegexRun endRun;
+    std::shared_ptr<RegexCarry> carryOut;
+};
+
+// Hand-off between two consecutive regex jobs of one target, replacing the read overlap. Whichever
+// side arrives second does the remaining work: the consumer parks its continuation when the state
+// is not published yet, and the producer's worker continues it itself. Nobody waits, so a job
+// still sitting in the FIFO queue cannot deadlock the workers.
+struct RegexCarry {
+    std::mutex mutex;
+    bool published = false;
+    RegexRun run;
+    bool parked = false;
+    RegexContinuation continuation;
+};
+
 struct ScanJob {
     std::shared_ptr<ReadBuffer> buffer;
     quint64 bufferToken = 0;
@@ -22,6 +102,10 @@ struct ScanJob {
     quint64 offset = 0;
     quint32 size = 0;
     quint32 reportLimit = 0;
+    // Regex and streamed-needle scans only: the state carried in from the previous job and out to
+    // the next one.
+    std::shared_ptr<RegexCarry> carryIn;
+    std::shared_ptr<RegexCarry> carryOut;
 };
 
 }  // namespace breco
@@ -1,22 +1,46 @@
 #include "scan/ScanWorker.h"
 
+#include <algorithm>
 #include <chrono>
 
-#include "scan/MatchUtils.h"
-
 namespace breco {
 
-ScanWorker::ScanWorker(int workerId, QByteArray searchTerm, TextInterpretationMode mode,
-                       bool ignoreCase, std::atomic<quint64>* totalBytesScanned,
+namespace {
+// Constant runs are found sector by sector; a run is a string of constant sectors of one value.
+constexpr quint64 kConstantSectorBytes = 4096;
+}
+
+ScanWorker::ScanWorker(int workerId, std::shared_ptr<const SearchPlan> searchPlan,
+                       std::atomic<quint64>* totalBytesScanned,
                        std::chrono::steady_clock::time_point scanStartTime,
-                       JobCompleteCallback onJobComplete)
+                       JobCompleteCallback onJobComplete, ScanReportMode reportMode,
+                       std::atomic<bool>* targetMatched, MatchBudget* matchBudget,
+                       EntropyMap* entropyMaps, EntropyGate* entropyGate,
+                       quint32 matchAlignment, const FileCarver* carver,
+                       const std::bitset<256>& constantRunMatches)
     : m_workerId(workerId),
       m_totalBytesScanned(totalBytesScanned),
-      m_searchTerm(std::move(searchTerm)),
-      m_mode(mode),
-      m_ignoreCase(ignoreCase),
+      m_searchPlan(std::move(searchPlan)),
       m_scanStartTime(scanStartTime),
-      m_onJobComplete(std::move(onJobComplete)) {}
+      m_onJobComplete(std::move(onJobComplete)),
+      m_reportMode(reportMode),
+      m_targetMatched(targetMatched),
+      m_matchBudget(matchBudget),
+      m_entropyMaps(entropyMaps),
+      m_entropyGate(entropyGate),
+      m_matchAlignment(qMax<quint32>(1, matchAlignment)),
+      m_carver(carver),
+      m_constantRunMatches(constantRunMatches),
+      m_matches(workerId) {
+    if (m_searchPlan != nullptr && m_searchPlan->regex() != nullptr) {
+        m_regexScanner = std::make_unique<ByteRegexScanner>(m_searchPlan->regex());
+    }
+    m_streamsNeedle = m_searchPlan != nullptr && m_searchPlan->streamsNeedle();
+    // Aligned searches read a few bytes per sector, less than finding the constant runs would.
+    m_skipsConstantRuns = m_searchPlan != nullptr && m_regexScanner == nullptr &&
+                          !m_streamsNeedle && m_matchAlignment == 1 &&
+                          !m_constantRunMatches.all();
+}
 
 ScanWorker::~ScanWorker() {
     requestStop();
@@ -48,7 +72,14 @@ void ScanWorker::wakeForStop() { m_workProvided.release(); }
 
 bool ScanWorker::isBusy() const { return m_busy.load(std::memory_order_acquire); }
 
-const QVector<MatchRecord>& ScanWorker::matches() const { return m_matches; }
+const MatchStore& ScanWorker::matches() const { return m_matches; }
+
+const QVector<MatchRecord>& ScanWorker::targetMatches() const { return m_targetMatches; }
+
+void ScanWorker::releaseMatches() {
+    m_matches.clear();
+    m_targetMatches = QVector<MatchRecord>();
+}
 
 void ScanWorker::runLoop() {
     for (;;) {
@@ -83,21 +114,45 @@ void ScanWorker::runLoop() {
 
 void ScanWorker::processJob(const ScanJob& job) {
     const std::shared_ptr<ReadBuffer>& buffer = job.buffer;
-    if (buffer == nullptr || job.size == 0 || job.reportLimit == 0 || m_searchTerm.isEmpty()) {
+    measureEntropy(job);
+    if (m_regexScanner != nullptr || m_streamsNeedle) {
+        const char* data = nullptr;
+        if (buffer != nullptr && job.fileOffset >= buffer->rawStart &&
+            job.fileOffset - buffer->rawStart + job.size <=
+                static_cast<quint64>(buffer->rawBytes.size())) {
+            data = buffer->rawBytes.constData() + (job.fileOffset - buffer->rawStart);
+        }
+        processRegexJob(job, data);
+        if (m_totalBytesScanned != nullptr) {
+            m_totalBytesScanned->fetch_add(job.reportLimit, std::memory_order_relaxed);
+        }
+        return;
+    }
+    // Existence scans skip jobs of targets another job has already matched; every scan skips the
+    // jobs still queued once the match budget is spent.
+    const bool targetDecided = m_reportMode == ScanReportMode::Existence &&
+                               m_targetMatched != nullptr && buffer != nullptr &&
+                               m_targetMatched[buffer->scanTargetIdx].load(
+                                   std::memory_order_relaxed);
+    const bool budgetSpent =
+        m_matchBudget != nullptr && m_matchBudget->exceeded.load(std::memory_order_relaxed);
+    if (budgetSpent && buffer != nullptr) {
+        dropMatchesFrom(buffer->scanTargetIdx, job.fileOffset);
+    }
+    if (buffer == nullptr || job.size == 0 || job.reportLimit == 0 || m_searchPlan == nullptr ||
+        m_searchPlan->maxNeedleSize() == 0 || targetDecided || budgetSpent) {
         if (m_totalBytesScanned != nullptr) {
             m_totalBytesScanned->fetch_add(job.reportLimit, std::memory_order_relaxed);
         }
         return;
     }
 
-    QByteArray transformed;
+    const char* data = nullptr;
     const qint64 localStart =
         static_cast<qint64>(job.fileOffset) - static_cast<qint64>(buffer->rawStart);
     const qint64 localEnd = localStart + static_cast<qint64>(job.size);
     if (localStart >= 0 && localEnd >= localStart && localEnd <= buffer->rawBytes.size()) {
-        transformed = QByteArray::fromRawData(
-            buffer->rawBytes.constData() + static_cast<int>(localStart),
-            static_cast<int>(job.size));
+        data = buffer->rawBytes.constData() + static_cast<int>(localStart);
     } else {
         if (m_totalBytesScanned != nullptr) {
             m_totalBytesScanned->fetch_add(job.reportLimit, std::memory_order_relaxed);
@@ -105,24 +160,16 @@ void ScanWorker::processJob(const ScanJob& job) {
         return;
     }
 
-    int pos = 0;
-    while (true) {
-        pos = MatchUtils::indexOf(transformed, m_searchTerm, pos, m_mode, m_ignoreCase);
-        if (pos < 0) {
-            break;
-        }
-        if (static_cast<quint32>(pos) < job.reportLimit) {
-            MatchRecord match;
-            match.scanTargetIdx = buffer->scanTargetIdx;
-            match.threadId = m_workerId;
-            match.offset = job.fileOffset + static_cast<quint64>(pos);
-            match.searchTimeNs = static_cast<quint64>(
-                std::chrono::duration_cast<std::chrono::nanoseconds>(
-                    std::chrono::steady_clock::now() - m_scanStartTime)
-                    .count());
-            m_matches.push_back(match);
+    if (m_entropyGate == nullptr && !m_skipsConstantRuns) {
+        searchJobRange(job, data, localStart, 0, job.reportLimit);
+    } else {
+        collectSkippedRanges(job, data);
+        quint32 searched = 0;
+        for (const auto& [from, to] : m_skippedRanges) {
+            searchJobRange(job, data, localStart, searched, qMax(searched, from));
+            searched = qMax(searched, to);
         }
-        ++pos;
+        searchJobRange(job, data, localStart, searched, job.reportLimit);
     }
 
     if (m_totalBytesScanned != nullptr) {
@@ -130,4 +177,324 @@ void ScanWorker::processJob(const ScanJob& job) {
     }
 }
 
+void ScanWorker::collectSkippedRanges(const ScanJob& job, const char* data) {
+    m_skippedRanges.clear();
+    if (m_entropyGate != nullptr) {
+        // Windows end on EntropyMap block boundaries of the file.
+        for (quint32 pos = 0; pos < job.reportLimit;) {
+            const quint64 blockLeft =
+                EntropyMap::kBlockBytes - (job.fileOffset + pos) % EntropyMap::kBlockBytes;
+            const auto end = static_cast<quint32>(qMin<quint64>(job.reportLimit, pos + blockLeft));
+            if (EntropyMap::sampledEntropyBits(data + pos, static_cast<int>(end - pos)) >
+                m_entropyGate->maxBits) {
+                m_skippedRanges.push_back({pos, end});
+                m_entropyGate->skippedBytes.fetch_add(end - pos, std::memory_order_relaxed);
+            }
+            pos = end;
+        }
+    }
+    if (m_skipsConstantRuns) {
+        // A start is skipped only when its whole match and look-behind lie inside the run; the
+        // bytes around the job are not checked, so runs are trimmed at the job edges too.
+        const auto lead = static_cast<quint32>(m_searchPlan->lookBehind());
+        const auto tail = static_cast<quint32>(qMax(0, m_searchPlan->maxMatchSpan() - 1));
+        const int gatedRanges = m_skippedRanges.size();
+        quint32 runStart = 0;
+        quint32 runEnd = 0;
+        unsigned char runValue = 0;
+        const auto closeRun = [&]() {
+            if (runEnd - runStart > lead + tail) {
+                m_skippedRanges.push_back({runStart + lead, runEnd - tail});
+            }
+            runStart = runEnd = 0;
+        };
+        for (quint32 pos = 0; pos < job.reportLimit;) {
+            const quint64 sectorLeft =
+                kConstantSectorBytes - (job.fileOffset + pos) % kConstantSectorBytes;
+            const auto end =
+                static_cast<quint32>(qMin<quint64>(job.reportLimit, pos + sectorLeft));
+            const auto value = static_cast<unsigned char>(data[pos]);
+            const bool constant = !m_constantRunMatches[value] &&
+                                  ByteSearch::isConstant(data + pos, static_cast<int>(end - pos));
+            if (constant && runEnd == pos && runEnd > runStart && runValue == value) {
+                runEnd = end;
+            } else {
+                closeRun();
+                if (constant) {
+                    runStart = pos;
+                    runEnd = end;
+                    runValue = value;
+                }
+            }
+            pos = end;
+        }
+        closeRun();
+        if (gatedRanges > 0 && m_skippedRanges.size() > gatedRanges) {
+            std::sort(m_skippedRanges.begin(), m_skippedRanges.end());
+        }
+    }
+}
+
+void ScanWorker::searchJobRange(const ScanJob& job, const char* data, qint64 localStart,
+                                quint32 from, quint32 to) {
+    const std::shared_ptr<ReadBuffer>& buffer = job.buffer;
+    // Existence scans stop at the target's first match, also across the ranges of one job.
+    if (from >= to ||
+        (m_reportMode == ScanReportMode::Existence && m_targetMatched != nullptr &&
+         m_targetMatched[buffer->scanTargetIdx].load(std::memory_order_relaxed))) {
+        return;
+    }
+    // A range ending inside the job gets the overlap the reader gives a job, so matches starting
+    // before `to` are complete.
+    const quint32 end =
+        to == job.reportLimit
+            ? job.size
+            : qMin(job.size, to + static_cast<quint32>(qMax(0, m_searchPlan->maxMatchSpan() - 1)));
+    // Proximity plans also look at the bytes before the job that the reader loaded with it.
+    const int back =
+        static_cast<int>(qMin<qint64>(m_searchPlan->lookBehind(), localStart + from));
+    if (m_matchAlignment > 1) {
+        const auto misalignment = static_cast<int>((job.fileOffset + from) % m_matchAlignment);
+        const int first =
+            back + (misalignment == 0 ? 0 : static_cast<int>(m_matchAlignment) - misalignment);
+        m_searchPlan->findAligned(data + from - back, static_cast<int>(end - from) + back,
+                                  static_cast<int>(to - from) + back, first,
+                                  static_cast<int>(m_matchAlignment), &m_jobHits);
+    } else {
+        m_searchPlan->findAll(data + from - back, static_cast<int>(end - from) + back,
+                              static_cast<int>(to - from) + back, &m_jobHits);
+    }
+    if (m_carver != nullptr) {
+        m_carver->thinFooterHits(&m_jobHits);
+    }
+    const auto firstHit = std::find_if(m_jobHits.cbegin(), m_jobHits.cend(),
+                                       [back](const SearchHit& hit) { return hit.offset >= back; });
+    auto endHit = m_jobHits.cend();
+    if (m_reportMode == ScanReportMode::Matches) {
+        endHit = firstHit + claimMatchRecords(static_cast<int>(endHit - firstHit));
+        if (endHit != m_jobHits.cend()) {
+            dropMatchesFrom(buffer->scanTargetIdx,
+                            job.fileOffset + from + static_cast<quint64>(endHit->offset - back));
+        }
+    }
+    // Every match of the range shares one timestamp, so dense hits do not pay a clock read each.
+    const quint64 jobSearchTimeNs = firstHit != endHit ? searchTimeNs() : 0;
+    if (m_reportMode == ScanReportMode::Matches && firstHit != endHit) {
+        m_matches.beginBatch(jobSearchTimeNs);
+    }
+    for (auto it = firstHit; it != endHit; ++it) {
+        const SearchHit& hit = *it;
+        MatchRecord match;
+        match.scanTargetIdx = buffer->scanTargetIdx;
+        match.threadId = m_workerId;
+        match.offset = job.fileOffset + from + static_cast<quint64>(hit.offset - back);
+        match.searchTimeNs = jobSearchTimeNs;
+        match.termIdx = hit.termIdx;
+        match.bitOffset = hit.bitOffset;
+        match.encoding = hit.encoding;
+        match.distance = hit.distance;
+        match.xorKey = hit.xorKey;
+        match.numericFormat = hit.numericFormat;
+        match.matchLength = static_cast<quint64>(hit.length);
+        if (m_reportMode == ScanReportMode::Matches) {
+            m_matches.append(match);
+            continue;
+        }
+        recordTargetMatch(match);
+        if (m_reportMode == ScanReportMode::Existence) {
+            break;
+        }
+    }
+}
+
+// The histogram pass runs on the job's bytes while they are in memory for the search, also for
+// jobs the search skips, so the map needs no second read of the target.
+void ScanWorker::measureEntropy(const ScanJob& job) {
+    if (m_entropyMaps == nullptr || job.buffer == nullptr || job.buffer->scanTargetIdx < 0) {
+        return;
+    }
+    const ReadBuffer& buffer = *job.buffer;
+    m_entropyMaps[buffer.scanTargetIdx].measure(
+        buffer.rawBytes.constData(), buffer.rawStart, static_cast<quint64>(buffer.rawBytes.size()),
+        job.fileOffset, job.fileOffset + job.reportLimit);
+}
+
+void ScanWorker::processRegexJob(const ScanJob& job, const char* data) {
+    // A job whose data is unusable still takes part in the carry chain so later jobs continue.
+    const int size = data != nullptr ? static_cast<int>(job.size) : 0;
+    RegexContinuation self;
+    self.buffer = job.buffer;
+    self.scanTargetIdx = job.buffer != nullptr ? job.buffer->scanTargetIdx : -1;
+    self.data = data;
+    self.size = size;
+    self.startLimit = static_cast<int>(job.reportLimit);
+    self.fileOffset = job.fileOffset;
+    self.carryOut = job.carryOut;
+
+    // The job scans its own data right away; the matches wait for the carried state, which can
+    // still change the ones ending near the job start.
+    if (m_streamsNeedle) {
+        m_searchPlan->streamScan(data, size, self.startLimit, job.fileOffset, &self.matches,
+                                 &self.endRun);
+    } else {
+        m_regexScanner->scan(data, size, self.startLimit, job.fileOffset, &self.matches,
+                             &self.endRun);
+    }
+
+    RegexRun carried;
+    if (job.carryIn != nullptr) {
+        std::lock_guard<std::mutex> lock(job.carryIn->mutex);
+        if (!job.carryIn->published) {
+            job.carryIn->continuation = std::move(self);
+            job.carryIn->parked = true;
+            return;
+        }
+        carried = std::move(job.carryIn->run);
+    }
+    continueRegexChain(std::move(self), std::move(carried));
+}
+
+void ScanWorker::continueRegexChain(RegexContinuation job, RegexRun carried) {
+    for (;;) {
+        if (m_streamsNeedle) {
+            m_searchPlan->streamResume(carried, job.data, job.size, job.fileOffset, &job.matches,
+                                       &job.endRun);
+        } else {
+            m_regexScanner->resume(carried, job.data, job.size, job.startLimit, job.fileOffset,
+                                   &job.matches, &job.endRun);
+        }
+        m_regexMatches = std::move(job.matches);
+        recordRegexMatches(job.scanTargetIdx);
+        if (job.carryOut == nullptr) {
+            return;
+        }
+
+        std::shared_ptr<RegexCarry> carry = std::move(job.carryOut);
+        std::lock_guard<std::mutex> lock(carry->mutex);
+        if (!carry->parked) {
+            carry->run = std::move(job.endRun);
+            carry->published = true;
+            return;
+        }
+        carried = std::move(job.endRun);
+        job = std::move(carry->continuation);
+        carry->parked = false;
+    }
+}
+
+void ScanWorker::recordRegexMatches(int scanTargetIdx) {
+    // Runs cross jobs, so aligned regex and streamed-needle scans only drop unaligned matches.
+    if (m_matchAlignment > 1) {
+        const quint64 alignment = m_matchAlignment;
+        m_regexMatches.erase(std::remove_if(m_regexMatches.begin(), m_regexMatches.end(),
+                                            [alignment](const RegexMatch& match) {
+                                                return match.start % alignment != 0;
+                                            }),
+                             m_regexMatches.end());
+    }
+    if (m_regexMatches.isEmpty()) {
+        return;
+    }
+    std::sort(m_regexMatches.begin(), m_regexMatches.end(),
+              [](const RegexMatch& a, const RegexMatch& b) {
+                  return a.start != b.start ? a.start < b.start : a.patternIdx < b.patternIdx;
+              });
+    if (m_reportMode == ScanReportMode::Matches) {
+        const int kept = claimMatchRecords(m_regexMatches.size());
+        if (kept < m_regexMatches.size()) {
+            dropMatchesFrom(scanTargetIdx, m_regexMatches.at(kept).start);
+        }
+        m_regexMatches.resize(kept);
+        if (m_regexMatches.isEmpty()) {
+            return;
+        }
+    }
+
+    const quint64 jobSearchTimeNs = searchTimeNs();
+    m_jobMatches.clear();
+    for (const RegexMatch& regexMatch : m_regexMatches) {
+        MatchRecord match;
+        match.scanTargetIdx = scanTargetIdx;
+        match.threadId = m_workerId;
+        match.offset = regexMatch.start;
+        match.searchTimeNs = jobSearchTimeNs;
+        match.termIdx = m_searchPlan->patternTerm(regexMatch.patternIdx);
+        match.encoding = m_searchPlan->patternEncoding(regexMatch.patternIdx);
+        match.matchLength = regexMatch.length;
+        if (m_reportMode != ScanReportMode::Matches) {
+            recordTargetMatch(match);
+            continue;
+        }
+        m_jobMatches.push_back(match);
+    }
+    if (m_reportMode != ScanReportMode::Matches) {
+        return;
+    }
+
+    auto matchLess = [](const MatchRecord& lhs, const MatchRecord& rhs) {
+        if (lhs.scanTargetIdx != rhs.scanTargetIdx) {
+            return lhs.scanTargetIdx < rhs.scanTargetIdx;
+        }
+        if (lhs.offset != rhs.offset) {
+            return lhs.offset < rhs.offset;
+        }
+        if (lhs.termIdx != rhs.termIdx) {
+            return lhs.termIdx < rhs.termIdx;
+        }
+        return lhs.encoding < rhs.encoding;
+    };
+    m_matches.beginBatch(jobSearchTimeNs);
+    m_matches.mergeSorted(m_jobMatches, matchLess);
+}
+
+void ScanWorker::recordTargetMatch(const MatchRecord& match) {
+    auto it = std::lower_bound(m_targetMatches.begin(), m_targetMatches.end(), match.scanTargetIdx,
+                               [](const MatchRecord& record, int scanTargetIdx) {
+                                   return record.scanTargetIdx < scanTargetIdx;
+                               });
+    if (it == m_targetMatches.end() || it->scanTargetIdx != match.scanTargetIdx) {
+        it = m_targetMatches.insert(it, match);
+    } else if (match.offset < it->offset ||
+               (match.offset == it->offset && match.termIdx < it->termIdx)) {
+        const quint64 matchCount = it->matchCount;
+        *it = match;
+        it->matchCount = matchCount;
+    }
+    if (m_reportMode == ScanReportMode::Count) {
+        ++it->matchCount;
+    } else if (m_targetMatched != nullptr) {
+        m_targetMatched[match.scanTargetIdx].store(true, std::memory_order_relaxed);
+    }
+}
+
+quint64 ScanWorker::searchTimeNs() const {
+    return static_cast<quint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    std::chrono::steady_clock::now() - m_scanStartTime)
+                                    .count());
+}
+
+int ScanWorker::claimMatchRecords(int count) {
+    if (m_matchBudget == nullptr || count == 0) {
+        return count;
+    }
+    const quint64 claimed =
+        m_matchBudget->claimed.fetch_add(static_cast<quint64>(count), std::memory_order_relaxed);
+    if (claimed + static_cast<quint64>(count) <= m_matchBudget->maxRecords) {
+        return count;
+    }
+    m_matchBudget->exceeded.store(true, std::memory_order_release);
+    return claimed < m_matchBudget->maxRecords
+               ? static_cast<int>(m_matchBudget->maxRecords - claimed)
+               : 0;
+}
+
+void ScanWorker::dropMatchesFrom(int scanTargetIdx, quint64 offset) {
+    std::lock_guard<std::mutex> lock(m_matchBudget->cutoffMutex);
+    if (scanTargetIdx < m_matchBudget->cutoffTarget ||
+        (scanTargetIdx == m_matchBudget->cutoffTarget && offset < m_matchBudget->cutoffOffset)) {
+        m_matchBudget->cutoffTarget = scanTargetIdx;
+        m_matchBudget->cutoffOffset = offset;
+    }
+}
+
 }  // namespace breco
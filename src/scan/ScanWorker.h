@@ -1,8 +1,8 @@
 #pragma once
 
-#include <QByteArray>
 #include <QVector>
 #include <atomic>
+#include <bitset>
 #include <chrono>
 #include <functional>
 #include <memory>
@@ -11,7 +11,11 @@
 #include <thread>
 
 #include "model/ResultTypes.h"
+#include "scan/EntropyMap.h"
+#include "scan/FileCarver.h"
+#include "scan/MatchStore.h"
 #include "scan/ScanTypes.h"
+#include "scan/SearchPlan.h"
 
 namespace breco {
 
@@ -19,10 +23,13 @@ class ScanWorker {
 public:
     using JobCompleteCallback = std::function<void(int workerId, quint64 bufferToken)>;
 
-    ScanWorker(int workerId, QByteArray searchTerm, TextInterpretationMode mode, bool ignoreCase,
+    ScanWorker(int workerId, std::shared_ptr<const SearchPlan> searchPlan,
                std::atomic<quint64>* totalBytesScanned,
                std::chrono::steady_clock::time_point scanStartTime,
-               JobCompleteCallback onJobComplete);
+               JobCompleteCallback onJobComplete, ScanReportMode reportMode,
+               std::atomic<bool>* targetMatched, MatchBudget* matchBudget,
+               EntropyMap* entropyMaps, EntropyGate* entropyGate, quint32 matchAlignment,
+               const FileCarver* carver, const std::bitset<256>& constantRunMatches);
 
     ~ScanWorker();
 
@@ -32,27 +39,82 @@ public:
     void requestStop();
     void wakeForStop();
     bool isBusy() const;
-    const QVector<MatchRecord>& matches() const;
+    // All-matches scans, ordered by target and offset.
+    const MatchStore& matches() const;
+    // Count and existence scans: at most one record per target, ordered by target.
+    const QVector<MatchRecord>& targetMatches() const;
+    // Frees the records once the scan has merged them.
+    void releaseMatches();
 
 private:
     void runLoop();
     void processJob(const ScanJob& job);
+    void processRegexJob(const ScanJob& job, const char* data);
+    // Fills m_skippedRanges with the job's report bytes no match can start in or that the
+    // entropy gate drops, ordered by start; they may overlap.
+    void collectSkippedRanges(const ScanJob& job, const char* data);
+    // Searches the job's report bytes [from, to); `data` is the job's first byte, `localStart` its
+    // index in the read buffer.
+    void searchJobRange(const ScanJob& job, const char* data, qint64 localStart, quint32 from,
+                        quint32 to);
+    // Entropy map scans: measures the entropy blocks that start in the job's own bytes.
+    void measureEntropy(const ScanJob& job);
+    // Corrects `job`'s own scan for the state carried into it, records its matches and hands its
+    // end state to the next job, finishing any continuations parked further down the chain on
+    // this thread.
+    void continueRegexChain(RegexContinuation job, RegexRun carried);
+    // Adds m_regexMatches to m_matches, keeping the stream sorted: a job finished on behalf of
+    // another can record matches that start before ones already recorded.
+    void recordRegexMatches(int scanTargetIdx);
+    // Count and existence scans: folds `match` into its target's record and, for existence
+    // scans, marks the target as matched.
+    void recordTargetMatch(const MatchRecord& match);
+    // Nanoseconds since the scan started; taken once per job that records matches.
+    quint64 searchTimeNs() const;
+    // All-matches scans: claims room for `count` more records and returns how many fit.
+    int claimMatchRecords(int count);
+    // Lowers the budget's cutoff to a match this worker could not record (or a skipped job).
+    void dropMatchesFrom(int scanTargetIdx, quint64 offset);
 
     int m_workerId = 0;
     std::atomic<bool> m_stopRequested{false};
     std::atomic<bool> m_busy{false};
     std::atomic<quint64>* m_totalBytesScanned = nullptr;
-    QByteArray m_searchTerm;
-    TextInterpretationMode m_mode = TextInterpretationMode::Ascii;
-    bool m_ignoreCase = false;
+    std::shared_ptr<const SearchPlan> m_searchPlan;
     std::chrono::steady_clock::time_point m_scanStartTime{};
     JobCompleteCallback m_onJobComplete;
+    ScanReportMode m_reportMode = ScanReportMode::Matches;
+    // One flag per scan target, shared with the reader (existence scans).
+    std::atomic<bool>* m_targetMatched = nullptr;
+    MatchBudget* m_matchBudget = nullptr;
+    // One map per scan target, shared with the controller; nullptr unless the scan measures
+    // entropy.
+    EntropyMap* m_entropyMaps = nullptr;
+    // Shared with the controller; nullptr unless the scan skips high-entropy windows.
+    EntropyGate* m_entropyGate = nullptr;
+    // Sector-aligned scans: matches must start at a file offset that is a multiple of this; 1
+    // reports every offset.
+    quint32 m_matchAlignment = 1;
+    // Carving scans: thins the footer hits of each searched range; nullptr for other scans.
+    const FileCarver* m_carver = nullptr;
+    // Byte values whose runs the plan can match (SearchPlan::constantRunMatches(), taken once per
+    // scan by the controller); the inside of runs of the other values is not searched.
+    std::bitset<256> m_constantRunMatches;
+    bool m_skipsConstantRuns = false;
+    QVector<std::pair<quint32, quint32>> m_skippedRanges;
 
     std::binary_semaphore m_workProvided{0};
     mutable std::mutex m_jobMutex;
     ScanJob m_pendingJob;
     bool m_hasPendingJob = false;
-    QVector<MatchRecord> m_matches;
+    MatchStore m_matches;
+    QVector<MatchRecord> m_targetMatches;
+    QVector<MatchRecord> m_jobMatches;
+    QVector<SearchHit> m_jobHits;
+    std::unique_ptr<ByteRegexScanner> m_regexScanner;
+    // Long single needles use the regex carry chain through the plan's stream functions.
+    bool m_streamsNeedle = false;
+    QVector<RegexMatch> m_regexMatches;
     std::thread m_thread;
 };
 
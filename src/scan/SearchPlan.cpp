@@ -0,0 +1,1395 @@
+#include "scan/SearchPlan.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "scan/ByteSearch.h"
+#include "scan/MatchUtils.h"
+
+namespace breco {
+
+namespace {
+constexpr int kShortNeedleMax = 32;
+constexpr int kHorspoolNeedleMax = 256;
+constexpr int kRareAnchorCommonnessMax = 80;
+constexpr int kBitsPerByte = 8;
+// Regex scanners each thread keeps: the anchor and near plans of a proximity query take turns.
+constexpr size_t kThreadRegexScanners = 4;
+
+// Rough commonness of a byte in mixed disk/text data (higher = more frequent). Only the relative
+// order matters: it decides which needle byte is handed to memchr as the anchor.
+int byteCommonness(unsigned char b) {
+    if (b == 0x00) {
+        return 255;
+    }
+    if (b == 0xFF) {
+        return 220;
+    }
+    if (b == ' ') {
+        return 200;
+    }
+    if (b == 'e' || b == 't' || b == 'a' || b == 'o' || b == 'i' || b == 'n' || b == 's' ||
+        b == 'r' || b == 'h' || b == 'l') {
+        return 180;
+    }
+    if (b >= 'a' && b <= 'z') {
+        return 150;
+    }
+    if (b == '\n' || b == '\r' || b == '\t') {
+        return 140;
+    }
+    if (b >= '0' && b <= '9') {
+        return 130;
+    }
+    if (b >= 'A' && b <= 'Z') {
+        return 110;
+    }
+    if (b < 0x20) {
+        return 90;
+    }
+    if (b < 0x7F) {
+        return 80;
+    }
+    return 60;
+}
+
+bool isAsciiLetter(unsigned char b) { return (b >= 'a' && b <= 'z') || (b >= 'A' && b <= 'Z'); }
+
+template <bool kFoldCase>
+inline unsigned char foldByte(unsigned char b) {
+    if constexpr (kFoldCase) {
+        return ByteSearch::asciiLower(b);
+    } else {
+        return b;
+    }
+}
+
+template <bool kFoldCase>
+inline bool bytesEqual(const unsigned char* candidate, const unsigned char* needle, int size) {
+    if constexpr (!kFoldCase) {
+        return std::memcmp(candidate, needle, static_cast<size_t>(size)) == 0;
+    } else {
+        for (int i = 0; i < size; ++i) {
+            if (ByteSearch::asciiLower(candidate[i]) != needle[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool maskedEqual(const unsigned char* haystack, int haystackSize, int start,
+                 const MaskedVariant& variant) {
+    const int size = static_cast<int>(variant.bytes.size());
+    if (size > haystackSize - start) {
+        return false;
+    }
+    const auto* bytes = reinterpret_cast<const unsigned char*>(variant.bytes.constData());
+    const auto* mask = reinterpret_cast<const unsigned char*>(variant.mask.constData());
+    for (int i = 0; i < size; ++i) {
+        if ((haystack[start + i] & mask[i]) != bytes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Maximal suffix of `x` under the byte order (or its reverse); returns the position before the
+// suffix and stores the suffix period. Crochemore-Perrin critical factorization building block.
+int maximalSuffix(const unsigned char* x, int m, bool reversedOrder, int* period) {
+    int ms = -1;
+    int j = 0;
+    int k = 1;
+    int p = 1;
+    while (j + k < m) {
+        const unsigned char a = x[j + k];
+        const unsigned char b = x[ms + k];
+        const bool advances = reversedOrder ? (a > b) : (a < b);
+        if (advances) {
+            j += k;
+            k = 1;
+            p = j - ms;
+        } else if (a == b) {
+            if (k != p) {
+                ++k;
+            } else {
+                j += p;
+                k = 1;
+            }
+        } else {
+            ms = j;
+            j = ms + 1;
+            k = 1;
+            p = 1;
+        }
+    }
+    *period = p;
+    return ms;
+}
+
+struct TermForm {
+    TermEncoding encoding = TermEncoding::Utf8;
+    QByteArray bytes;
+};
+
+// The forms of term `termIdx` a query searches, in TermEncoding order: the term itself, then for
+// text terms its UTF-16 forms (encoding variants) and its encoded forms. Forms that come out
+// empty or repeat an earlier form of the term are left out.
+QVector<TermForm> termForms(const SearchQuery& query, int termIdx) {
+    const QByteArray& term = query.terms.at(termIdx);
+    QVector<TermForm> forms = {TermForm{TermEncoding::Utf8, term}};
+    if (!query.masks.isEmpty()) {
+        return forms;
+    }
+    QVector<TermEncoding> encodings;
+    if (query.encodingVariants) {
+        encodings += {TermEncoding::Utf16Le, TermEncoding::Utf16Be};
+    }
+    if (query.encodedForms) {
+        encodings += {TermEncoding::Base64,       TermEncoding::Base64Shift1,
+                      TermEncoding::Base64Shift2, TermEncoding::HexLower,
+                      TermEncoding::HexUpper,     TermEncoding::Percent};
+    }
+    for (const TermEncoding encoding : encodings) {
+        const QByteArray bytes = MatchUtils::encodeTerm(term, encoding);
+        const bool repeated =
+            std::any_of(forms.cbegin(), forms.cend(),
+                        [&bytes](const TermForm& form) { return form.bytes == bytes; });
+        if (!bytes.isEmpty() && !repeated) {
+            forms.push_back(TermForm{encoding, bytes});
+        }
+    }
+    return forms;
+}
+
+// Longest byte form of a term of `query`: UTF-16 doubles a term, percent-encoding at most triples
+// it, and bit phases touch one byte more.
+qint64 longestTermForm(const SearchQuery& query) {
+    qint64 longest = 0;
+    for (const QByteArray& term : query.terms) {
+        longest = qMax<qint64>(longest, term.size());
+    }
+    const bool textForms = query.masks.isEmpty();
+    const int growth = textForms && query.encodedForms       ? 3
+                       : textForms && query.encodingVariants ? 2
+                                                             : 1;
+    return longest * growth + (query.bitPhases ? 1 : 0);
+}
+
+// False, with the error set, when a term form of a plan that cannot stream is too long to
+// build tables for and to overlap jobs by.
+bool termFormsFit(const SearchQuery& query, QString* error) {
+    const qint64 longestForm = longestTermForm(query);
+    if (longestForm <= SearchPlan::kMaxTermFormSize) {
+        return true;
+    }
+    if (error != nullptr) {
+        *error = QStringLiteral("Terms longer than %1 bytes in any searched form (here %2) need a "
+                                "single term without bit phases, UTF-16 or encoded forms, XOR "
+                                "keys, wildcards or a near term")
+                     .arg(SearchPlan::kMaxTermFormSize)
+                     .arg(longestForm);
+    }
+    return false;
+}
+}  // namespace
+
+std::shared_ptr<const SearchPlan> SearchPlan::compile(const SearchQuery& query,
+                                                      QString* error) {
+    if (!query.nearTerms.isEmpty()) {
+        return compileProximity(query, error);
+    }
+    if (query.regex) {
+        std::shared_ptr<SearchPlan> plan(new SearchPlan());
+        plan->m_foldCase = query.ignoreCase && query.mode != TextInterpretationMode::Utf16;
+        plan->m_regex = ByteRegex::compile(query.terms, plan->m_foldCase, error);
+        if (plan->m_regex == nullptr) {
+            return nullptr;
+        }
+        plan->m_terms = query.terms;
+        for (int termIdx = 0; termIdx < query.terms.size(); ++termIdx) {
+            plan->m_patternTerms.push_back(termIdx);
+            plan->m_patternEncodings.push_back(TermEncoding::Utf8);
+        }
+        plan->m_algorithm = SearchAlgorithm::LazyDfa;
+        return plan;
+    }
+    if (query.numeric) {
+        return compileNumeric(query, error);
+    }
+    const bool approximate = query.approximate != ApproximateMetric::None && query.maxDistance > 0;
+    const bool hexPatterns = !query.masks.isEmpty();
+    const bool wildcards =
+        std::any_of(query.masks.cbegin(), query.masks.cend(), [](const QByteArray& mask) {
+            return mask.count(static_cast<char>(0xFF)) != mask.size();
+        });
+    const bool encodingVariants = query.encodingVariants && !hexPatterns;
+    const bool extraForms = encodingVariants || (query.encodedForms && !hexPatterns);
+    // Only a single exact needle streams across jobs; every other plan builds its tables from
+    // every form of every term and overlaps its jobs by the longest one.
+    const bool streamable = query.terms.size() == 1 && !query.xorKeys && !approximate &&
+                            !query.bitPhases && !wildcards && !extraForms;
+    if (!streamable && !approximate && !termFormsFit(query, error)) {
+        return nullptr;
+    }
+    if (query.xorKeys) {
+        return compileXorKeys(query, error);
+    }
+    if (approximate) {
+        return compileApproximate(query, error);
+    }
+    // Non-ASCII terms and UTF-16 forms need Unicode case folding, which byte folding cannot do.
+    // ASCII-only UTF-8 queries keep the faster byte-folding kernels; so do needles too long for
+    // a fold automaton, which stream instead.
+    const bool unicodeFold =
+        query.ignoreCase && !hexPatterns && !query.bitPhases &&
+        longestTermForm(query) <= kMaxTermFormSize &&
+        query.mode != TextInterpretationMode::Utf16 &&
+        (encodingVariants || !std::all_of(query.terms.cbegin(), query.terms.cend(),
+                                          [](const QByteArray& term) {
+                                              return MatchUtils::isAscii(term);
+                                          }));
+    if (unicodeFold) {
+        if (auto plan = compileCaseFold(query)) {
+            return plan;
+        }
+    }
+    if (!query.bitPhases && !wildcards && !extraForms) {
+        if (query.terms.size() == 1 && query.terms.first().size() >= kMinStreamedNeedleSize) {
+            std::shared_ptr<SearchPlan> plan =
+                prepare(query.terms.first(), query.mode, query.ignoreCase && !hexPatterns);
+            plan->selectAlgorithm(plan->chooseAlgorithm());
+            plan->prepareStreaming();
+            return plan;
+        }
+        return compile(query.terms, query.mode, query.ignoreCase && !hexPatterns);
+    }
+    if (!query.bitPhases && !extraForms && query.terms.size() == 1) {
+        std::shared_ptr<SearchPlan> plan(new SearchPlan());
+        plan->m_needleMask = query.masks.first();
+        plan->m_needle = query.terms.first();
+        for (int i = 0; i < plan->m_needle.size(); ++i) {
+            plan->m_needle[i] = static_cast<char>(plan->m_needle.at(i) & plan->m_needleMask.at(i));
+        }
+        plan->m_terms = {plan->m_needle};
+        plan->m_algorithm = SearchAlgorithm::Masked;
+        plan->prepareAlignedPatterns();
+        return plan;
+    }
+
+    std::shared_ptr<SearchPlan> plan(new SearchPlan());
+    plan->m_foldCase =
+        query.ignoreCase && !hexPatterns && query.mode != TextInterpretationMode::Utf16;
+    plan->m_terms.reserve(query.terms.size());
+    for (const QByteArray& term : query.terms) {
+        plan->m_terms.push_back(plan->m_foldCase ? MatchUtils::foldAsciiCase(term) : term);
+    }
+    // Folding only makes sense on whole bytes: with ignore-case the byte-aligned phase keeps its
+    // folded multi-pattern pass and the shifted phases match the term bits exactly.
+    if (plan->m_foldCase) {
+        plan->m_multiPattern = std::make_unique<MultiPatternSearch>(plan->m_terms, true);
+    }
+    for (int termIdx = 0; termIdx < query.terms.size(); ++termIdx) {
+        plan->addTermVariants(termIdx, query.terms.at(termIdx), query.masks.value(termIdx),
+                              !plan->m_foldCase, query.bitPhases, TermEncoding::Utf8);
+        // Ignore-case reaches this path with UTF-16 forms only for bit-phase scans (or a fold
+        // automaton too large to build); the other forms then stay exact.
+        const QVector<TermForm> forms = termForms(query, termIdx);
+        for (int formIdx = 1; formIdx < forms.size(); ++formIdx) {
+            plan->addTermVariants(termIdx, forms.at(formIdx).bytes, QByteArray(), true,
+                                  query.bitPhases, forms.at(formIdx).encoding);
+        }
+    }
+    plan->prepareMaskedVariants();
+    plan->prepareAlignedPatterns();
+
+    const MultiPatternSearch* engine =
+        plan->m_coreSearch != nullptr ? plan->m_coreSearch.get() : plan->m_multiPattern.get();
+    plan->m_algorithm = engine != nullptr && engine->engine() == MultiPatternEngine::Teddy
+                            ? SearchAlgorithm::Teddy
+                            : SearchAlgorithm::AhoCorasick;
+    return plan;
+}
+
+std::shared_ptr<SearchPlan> SearchPlan::compileApproximate(const SearchQuery& query,
+                                                           QString* error) {
+    const bool hexPatterns = !query.masks.isEmpty();
+    const int maxDistance = qMin(query.maxDistance, ApproximateSearch::kMaxDistance);
+    std::shared_ptr<SearchPlan> plan(new SearchPlan());
+    QVector<QByteArray> patterns;
+    QVector<QByteArray> masks;
+    for (int termIdx = 0; termIdx < query.terms.size(); ++termIdx) {
+        for (const TermForm& form : termForms(query, termIdx)) {
+            const TermEncoding encoding = form.encoding;
+            const QByteArray& pattern = form.bytes;
+            if (pattern.size() <= maxDistance ||
+                pattern.size() > ApproximateSearch::kMaxPatternSize) {
+                if (error != nullptr) {
+                    *error = QStringLiteral("Approximate search needs terms of %1..%2 bytes")
+                                 .arg(maxDistance + 1)
+                                 .arg(ApproximateSearch::kMaxPatternSize);
+                }
+                return nullptr;
+            }
+            patterns.push_back(pattern);
+            masks.push_back(encoding == TermEncoding::Utf8 ? query.masks.value(termIdx)
+                                                           : QByteArray());
+            plan->m_patternTerms.push_back(termIdx);
+            plan->m_patternEncodings.push_back(encoding);
+        }
+    }
+    plan->m_foldCase =
+        query.ignoreCase && !hexPatterns && query.mode != TextInterpretationMode::Utf16;
+    plan->m_terms = query.terms;
+    plan->m_approximate = std::make_unique<ApproximateSearch>(
+        patterns, masks, plan->m_foldCase, query.approximate, maxDistance);
+    plan->m_algorithm = query.approximate == ApproximateMetric::Edit ? SearchAlgorithm::Myers
+                                                                     : SearchAlgorithm::ShiftOr;
+    return plan;
+}
+
+std::shared_ptr<SearchPlan> SearchPlan::compileXorKeys(const SearchQuery& query, QString* error) {
+    std::shared_ptr<SearchPlan> plan(new SearchPlan());
+    QVector<QByteArray> signatures;
+    for (int termIdx = 0; termIdx < query.terms.size(); ++termIdx) {
+        const QByteArray mask = query.masks.value(termIdx);
+        if (mask.count(static_cast<char>(0xFF)) != mask.size()) {
+            if (error != nullptr) {
+                *error = QStringLiteral("XOR-key search does not support hex wildcards");
+            }
+            return nullptr;
+        }
+        for (const TermForm& form : termForms(query, termIdx)) {
+            const TermEncoding encoding = form.encoding;
+            const QByteArray& pattern = form.bytes;
+            if (pattern.size() < 2) {
+                if (error != nullptr) {
+                    *error = QStringLiteral("XOR-key search needs terms of at least 2 bytes");
+                }
+                return nullptr;
+            }
+            QByteArray signature(pattern.size() - 1, '\0');
+            ByteSearch::xorAdjacent(pattern.constData(), static_cast<int>(pattern.size()),
+                                    signature.data());
+            signatures.push_back(signature);
+            plan->m_xorFirstBytes.append(pattern.at(0));
+            plan->m_xorPatternSizes.push_back(static_cast<int>(pattern.size()));
+            plan->m_patternTerms.push_back(termIdx);
+            plan->m_patternEncodings.push_back(encoding);
+        }
+    }
+    plan->m_xorSignatures = compile(signatures, TextInterpretationMode::Ascii, false);
+    plan->m_terms = query.terms;
+    plan->m_algorithm = plan->m_xorSignatures->algorithm();
+    return plan;
+}
+
+std::shared_ptr<SearchPlan> SearchPlan::compileNumeric(const SearchQuery& query, QString* error) {
+    std::shared_ptr<SearchPlan> plan(new SearchPlan());
+    SearchQuery forms;
+    for (int termIdx = 0; termIdx < query.terms.size(); ++termIdx) {
+        QVector<NumericVariant> variants;
+        if (!MatchUtils::numericVariants(query.terms.at(termIdx), query.tolerance, &variants)) {
+            if (error != nullptr) {
+                *error = QStringLiteral("Invalid number: %1")
+                             .arg(QString::fromUtf8(query.terms.at(termIdx)));
+            }
+            return nullptr;
+        }
+        for (const NumericVariant& variant : variants) {
+            forms.terms.push_back(variant.bytes);
+            forms.masks.push_back(variant.mask);
+            plan->m_numericVariants.push_back(variant);
+            plan->m_patternTerms.push_back(termIdx);
+            plan->m_patternEncodings.push_back(TermEncoding::Utf8);
+        }
+    }
+    plan->m_numericForms = compile(forms, error);
+    if (plan->m_numericForms == nullptr) {
+        return nullptr;
+    }
+    plan->m_terms = query.terms;
+    plan->m_algorithm = plan->m_numericForms->algorithm();
+    return plan;
+}
+
+// Both plans run over the same data, so a job resolves its proximity windows itself: the overlap
+// covers near matches up to nearDistance bytes after a term match and lookBehind() those before.
+std::shared_ptr<SearchPlan> SearchPlan::compileProximity(const SearchQuery& query,
+                                                         QString* error) {
+    if (query.regex) {
+        if (error != nullptr) {
+            *error = QStringLiteral("Proximity search does not support regex");
+        }
+        return nullptr;
+    }
+    SearchQuery anchorQuery = query;
+    anchorQuery.nearTerms.clear();
+    anchorQuery.nearMasks.clear();
+    SearchQuery nearQuery = anchorQuery;
+    nearQuery.terms = query.nearTerms;
+    nearQuery.masks = query.nearMasks;
+    // Sub-plans do not stream: jobs overlap by the whole proximity window.
+    if (!termFormsFit(anchorQuery, error) || !termFormsFit(nearQuery, error)) {
+        return nullptr;
+    }
+    std::shared_ptr<SearchPlan> plan(new SearchPlan());
+    plan->m_proximityAnchor = compile(anchorQuery, error);
+    if (plan->m_proximityAnchor == nullptr) {
+        return nullptr;
+    }
+    plan->m_proximityNear = compile(nearQuery, error);
+    if (plan->m_proximityNear == nullptr) {
+        return nullptr;
+    }
+    plan->m_nearDistance = qBound(0, query.nearDistance, kMaxNearDistance);
+    plan->m_terms = query.terms;
+    plan->m_foldCase = plan->m_proximityAnchor->foldsCase();
+    plan->m_algorithm = plan->m_proximityAnchor->algorithm();
+    return plan;
+}
+
+// Every term (and, with encoding variants, its UTF-16 forms) becomes one case-fold alternation
+// pattern, and encoded forms a literal one, so the whole query is still one automaton and one
+// pass. Returns nullptr when the automaton would be too large; the caller then falls back to
+// ASCII folding.
+std::shared_ptr<SearchPlan> SearchPlan::compileCaseFold(const SearchQuery& query) {
+    const QVector<QByteArray>& terms = query.terms;
+    std::shared_ptr<SearchPlan> plan(new SearchPlan());
+    QVector<QByteArray> patterns;
+    for (int termIdx = 0; termIdx < terms.size(); ++termIdx) {
+        for (const TermForm& form : termForms(query, termIdx)) {
+            patterns.push_back(MatchUtils::caseFoldPattern(terms.at(termIdx), form.encoding));
+            plan->m_patternTerms.push_back(termIdx);
+            plan->m_patternEncodings.push_back(form.encoding);
+        }
+    }
+    plan->m_regex = ByteRegex::compile(patterns, false, nullptr);
+    if (plan->m_regex == nullptr) {
+        return nullptr;
+    }
+    // A code point folds to at most 4 bytes in UTF-8 or UTF-16 and takes at least one term byte.
+    for (int termIdx = 0; termIdx < terms.size(); ++termIdx) {
+        for (const TermForm& form : termForms(query, termIdx)) {
+            const int span = MatchUtils::isUnicodeEncoding(form.encoding)
+                                 ? 4 * static_cast<int>(terms.at(termIdx).size())
+                                 : static_cast<int>(form.bytes.size());
+            plan->m_foldMatchSpan = qMax(plan->m_foldMatchSpan, span);
+        }
+    }
+    plan->m_terms = terms;
+    plan->m_foldCase = true;
+    plan->m_algorithm = SearchAlgorithm::LazyDfa;
+    return plan;
+}
+
+std::shared_ptr<const SearchPlan> SearchPlan::compile(const QByteArray& term,
+                                                      TextInterpretationMode mode,
+                                                      bool ignoreCase) {
+    std::shared_ptr<SearchPlan> plan = prepare(term, mode, ignoreCase);
+    plan->selectAlgorithm(plan->chooseAlgorithm());
+    return plan;
+}
+
+std::shared_ptr<const SearchPlan> SearchPlan::compile(const QVector<QByteArray>& terms,
+                                                      TextInterpretationMode mode,
+                                                      bool ignoreCase) {
+    if (terms.size() == 1) {
+        return compile(terms.first(), mode, ignoreCase);
+    }
+
+    std::shared_ptr<SearchPlan> plan(new SearchPlan());
+    plan->m_foldCase = ignoreCase && mode != TextInterpretationMode::Utf16;
+    plan->m_terms.reserve(terms.size());
+    for (const QByteArray& term : terms) {
+        plan->m_terms.push_back(plan->m_foldCase ? MatchUtils::foldAsciiCase(term) : term);
+    }
+    plan->m_multiPattern = std::make_unique<MultiPatternSearch>(plan->m_terms, plan->m_foldCase);
+    plan->prepareAlignedPatterns();
+    plan->m_algorithm = plan->m_multiPattern->engine() == MultiPatternEngine::Teddy
+                            ? SearchAlgorithm::Teddy
+                            : SearchAlgorithm::AhoCorasick;
+    return plan;
+}
+
+std::shared_ptr<const SearchPlan> SearchPlan::compile(const QByteArray& term,
+                                                      TextInterpretationMode mode, bool ignoreCase,
+                                                      SearchAlgorithm algorithm) {
+    std::shared_ptr<SearchPlan> plan = prepare(term, mode, ignoreCase);
+    plan->selectAlgorithm(algorithm);
+    return plan;
+}
+
+const char* SearchPlan::algorithmName(SearchAlgorithm algorithm) {
+    switch (algorithm) {
+        case SearchAlgorithm::RareByteAnchor:
+            return "rare-byte";
+        case SearchAlgorithm::Horspool:
+            return "horspool";
+        case SearchAlgorithm::TwoWay:
+            return "two-way";
+        case SearchAlgorithm::Teddy:
+            return MultiPatternSearch::engineName(MultiPatternEngine::Teddy);
+        case SearchAlgorithm::AhoCorasick:
+            return MultiPatternSearch::engineName(MultiPatternEngine::AhoCorasick);
+        case SearchAlgorithm::Masked:
+            return "simd-masked";
+        case SearchAlgorithm::LazyDfa:
+            return "lazy-dfa";
+        case SearchAlgorithm::ShiftOr:
+            return "shift-or";
+        case SearchAlgorithm::Myers:
+            return "myers";
+        case SearchAlgorithm::SimdFirstLast:
+        default:
+            return "simd-first-last";
+    }
+}
+
+int SearchPlan::indexOf(const char* haystack, int haystackSize, int from) const {
+    const int start = qMax(0, from);
+    const int m = needleSize();
+    if (haystack == nullptr || m_multiPattern != nullptr || m == 0 || m > haystackSize - start) {
+        return -1;
+    }
+
+    const auto* bytes = reinterpret_cast<const unsigned char*>(haystack);
+    switch (m_algorithm) {
+        case SearchAlgorithm::RareByteAnchor:
+            return m_foldCase ? anchorIndexOf<true>(bytes, haystackSize, start)
+                              : anchorIndexOf<false>(bytes, haystackSize, start);
+        case SearchAlgorithm::Horspool:
+            return m_foldCase ? horspoolIndexOf<true>(bytes, haystackSize, start)
+                              : horspoolIndexOf<false>(bytes, haystackSize, start);
+        case SearchAlgorithm::TwoWay:
+            return m_foldCase ? twoWayIndexOf<true>(bytes, haystackSize, start, -1)
+                              : twoWayIndexOf<false>(bytes, haystackSize, start, -1);
+        case SearchAlgorithm::Masked:
+            return ByteSearch::indexOfMasked(haystack, haystackSize, m_needle.constData(),
+                                             m_needleMask.constData(), m, start);
+        case SearchAlgorithm::SimdFirstLast:
+        default:
+            if (m_foldCase) {
+                return ByteSearch::indexOfFolded(haystack, haystackSize, m_needle.constData(), m,
+                                                 start);
+            }
+            return ByteSearch::indexOf(haystack, haystackSize, m_needle.constData(), m, start);
+    }
+}
+
+void SearchPlan::findAll(const char* haystack, int haystackSize, int startLimit,
+                         QVector<SearchHit>* hits) const {
+    hits->clear();
+    if (m_proximityAnchor != nullptr) {
+        m_proximityAnchor->findAll(haystack, haystackSize, startLimit, hits);
+        if (hits->isEmpty()) {
+            return;
+        }
+        thread_local QVector<SearchHit> nearHits;
+        m_proximityNear->findAll(haystack, haystackSize, haystackSize, &nearHits);
+        // Both lists are ordered by offset: slide the first near match not too far behind.
+        int nearIdx = 0;
+        int kept = 0;
+        for (const SearchHit& hit : *hits) {
+            while (nearIdx < nearHits.size() &&
+                   nearHits.at(nearIdx).offset < hit.offset - m_nearDistance) {
+                ++nearIdx;
+            }
+            if (nearIdx < nearHits.size() &&
+                nearHits.at(nearIdx).offset <= hit.offset + m_nearDistance) {
+                (*hits)[kept++] = hit;
+            }
+        }
+        hits->resize(kept);
+        return;
+    }
+    if (m_numericForms != nullptr) {
+        thread_local QVector<SearchHit> formHits;
+        m_numericForms->findAll(haystack, haystackSize, startLimit, &formHits);
+        hits->reserve(formHits.size());
+        for (const SearchHit& hit : formHits) {
+            const NumericVariant& variant = m_numericVariants.at(hit.termIdx);
+            if (variant.low != variant.high &&
+                !MatchUtils::matchesNumeric(
+                    variant, reinterpret_cast<const unsigned char*>(haystack) + hit.offset)) {
+                continue;
+            }
+            hits->push_back(SearchHit{hit.offset, m_patternTerms.at(hit.termIdx), 0,
+                                      TermEncoding::Utf8, 0, static_cast<int>(variant.bytes.size()),
+                                      -1, variant.format});
+        }
+        return;
+    }
+    if (m_xorSignatures != nullptr) {
+        if (haystackSize < 2) {
+            return;
+        }
+        // A match of term t under key k has h[i] ^ h[i + 1] == t[i] ^ t[i + 1] for every i, and
+        // that signature fixes every byte once the first one is known: k = h[0] ^ t[0].
+        thread_local QByteArray diffs;
+        thread_local QVector<SearchHit> signatureHits;
+        diffs.resize(haystackSize - 1);
+        ByteSearch::xorAdjacent(haystack, haystackSize, diffs.data());
+        m_xorSignatures->findAll(diffs.constData(), haystackSize - 1,
+                                 qMin(startLimit, haystackSize - 1), &signatureHits);
+        hits->reserve(signatureHits.size());
+        for (const SearchHit& hit : signatureHits) {
+            const int patternIdx = hit.termIdx;
+            const int key = static_cast<unsigned char>(haystack[hit.offset]) ^
+                            static_cast<unsigned char>(m_xorFirstBytes.at(patternIdx));
+            hits->push_back(SearchHit{hit.offset, m_patternTerms.at(patternIdx), 0,
+                                      m_patternEncodings.at(patternIdx), 0, 0, key});
+        }
+        return;
+    }
+    if (m_approximate != nullptr) {
+        thread_local QVector<ApproximateHit> approximateHits;
+        m_approximate->findAll(haystack, haystackSize, startLimit, &approximateHits);
+        hits->reserve(approximateHits.size());
+        for (const ApproximateHit& hit : approximateHits) {
+            hits->push_back(SearchHit{hit.offset, m_patternTerms.at(hit.patternIdx), 0,
+                                      m_patternEncodings.at(hit.patternIdx), hit.distance,
+                                      hit.length});
+        }
+        return;
+    }
+    if (m_regex != nullptr) {
+        // The lazy DFA is built as it is used, so each thread keeps a scanner per plan, for the
+        // last few plans it ran; the oldest one makes room.
+        thread_local std::array<std::unique_ptr<ByteRegexScanner>, kThreadRegexScanners> scanners;
+        thread_local size_t nextScanner = 0;
+        thread_local QVector<RegexMatch> matches;
+        ByteRegexScanner* scanner = nullptr;
+        for (const std::unique_ptr<ByteRegexScanner>& cached : scanners) {
+            if (cached != nullptr && cached->regex() == m_regex) {
+                scanner = cached.get();
+                break;
+            }
+        }
+        if (scanner == nullptr) {
+            std::unique_ptr<ByteRegexScanner>& slot = scanners[nextScanner];
+            nextScanner = (nextScanner + 1) % kThreadRegexScanners;
+            slot = std::make_unique<ByteRegexScanner>(m_regex);
+            scanner = slot.get();
+        }
+        matches.clear();
+        RegexRun endRun;
+        scanner->scan(haystack, haystackSize, startLimit, 0, &matches, &endRun);
+        for (const RegexMatch& match : matches) {
+            hits->push_back(SearchHit{static_cast<int>(match.start),
+                                      m_patternTerms.at(match.patternIdx), 0,
+                                      m_patternEncodings.at(match.patternIdx)});
+        }
+        std::sort(hits->begin(), hits->end(), [](const SearchHit& a, const SearchHit& b) {
+            if (a.offset != b.offset) {
+                return a.offset < b.offset;
+            }
+            return a.termIdx != b.termIdx ? a.termIdx < b.termIdx : a.encoding < b.encoding;
+        });
+        return;
+    }
+    if (m_multiPattern != nullptr) {
+        thread_local QVector<PatternHit> patternHits;
+        m_multiPattern->findAll(haystack, haystackSize, startLimit, &patternHits);
+        hits->reserve(patternHits.size());
+        for (const PatternHit& hit : patternHits) {
+            hits->push_back(SearchHit{hit.offset, hit.patternIdx, 0});
+        }
+    } else if (m_fixedFindAll != nullptr) {
+        thread_local QVector<int> starts;
+        starts.clear();
+        m_fixedFindAll(haystack, haystackSize, startLimit, m_needle.constData(), &starts);
+        hits->reserve(starts.size());
+        for (const int start : starts) {
+            hits->push_back(SearchHit{start, 0, 0});
+        }
+    } else if (m_algorithm == SearchAlgorithm::TwoWay && haystack != nullptr) {
+        const auto* bytes = reinterpret_cast<const unsigned char*>(haystack);
+        if (m_foldCase) {
+            twoWayFindAll<true>(bytes, haystackSize, startLimit, hits);
+        } else {
+            twoWayFindAll<false>(bytes, haystackSize, startLimit, hits);
+        }
+    } else if (!m_needle.isEmpty()) {
+        int pos = 0;
+        while (pos < startLimit) {
+            pos = indexOf(haystack, haystackSize, pos);
+            if (pos < 0 || pos >= startLimit) {
+                break;
+            }
+            hits->push_back(SearchHit{pos, 0, 0});
+            ++pos;
+        }
+    }
+
+    if (m_maskedVariants.isEmpty()) {
+        return;
+    }
+    findMaskedVariants(reinterpret_cast<const unsigned char*>(haystack), haystackSize, startLimit,
+                       hits);
+    std::sort(hits->begin(), hits->end(), [](const SearchHit& a, const SearchHit& b) {
+        if (a.offset != b.offset) {
+            return a.offset < b.offset;
+        }
+        if (a.termIdx != b.termIdx) {
+            return a.termIdx < b.termIdx;
+        }
+        if (a.bitOffset != b.bitOffset) {
+            return a.bitOffset < b.bitOffset;
+        }
+        return a.encoding < b.encoding;
+    });
+}
+
+void SearchPlan::findAligned(const char* haystack, int haystackSize, int startLimit, int first,
+                             int stride, QVector<SearchHit>* hits) const {
+    if (stride <= 1) {
+        findAll(haystack, haystackSize, startLimit, hits);
+        hits->erase(std::remove_if(hits->begin(), hits->end(),
+                                   [first](const SearchHit& hit) { return hit.offset < first; }),
+                    hits->end());
+        return;
+    }
+    if (m_alignedPatterns.isEmpty()) {
+        findAll(haystack, haystackSize, startLimit, hits);
+        hits->erase(std::remove_if(hits->begin(), hits->end(),
+                                   [first, stride](const SearchHit& hit) {
+                                       return hit.offset < first ||
+                                              (hit.offset - first) % stride != 0;
+                                   }),
+                    hits->end());
+        return;
+    }
+
+    hits->clear();
+    if (haystack == nullptr) {
+        return;
+    }
+    const auto* bytes = reinterpret_cast<const unsigned char*>(haystack);
+    const int reportEnd = qMin(startLimit, haystackSize);
+    for (int pos = qMax(0, first); pos < reportEnd; pos += stride) {
+        const int left = haystackSize - pos;
+        // One load per position serves every pattern's head; only heads that match read on.
+        quint64 head = 0;
+        std::memcpy(&head, bytes + pos, static_cast<size_t>(qMin(left, 8)));
+        for (const AlignedPattern& pattern : m_alignedPatterns) {
+            const int size = static_cast<int>(pattern.bytes.size());
+            if (((head | pattern.headOr) & pattern.headMask) != pattern.headBytes ||
+                size > left) {
+                continue;
+            }
+            const auto* tail = reinterpret_cast<const unsigned char*>(pattern.bytes.constData());
+            const auto* mask = reinterpret_cast<const unsigned char*>(pattern.mask.constData());
+            const auto* orBits = reinterpret_cast<const unsigned char*>(pattern.orBits.constData());
+            bool equal = true;
+            for (int i = 8; i < size && equal; ++i) {
+                equal = ((bytes[pos + i] | orBits[i]) & mask[i]) == tail[i];
+            }
+            if (equal) {
+                hits->push_back(
+                    SearchHit{pos, pattern.termIdx, pattern.bitOffset, pattern.encoding});
+            }
+        }
+    }
+}
+
+SearchAlgorithm SearchPlan::algorithm() const { return m_algorithm; }
+
+bool SearchPlan::foldsCase() const { return m_foldCase; }
+
+const QByteArray& SearchPlan::needle() const { return m_needle; }
+
+int SearchPlan::needleSize() const { return static_cast<int>(m_needle.size()); }
+
+const std::shared_ptr<const ByteRegex>& SearchPlan::regex() const { return m_regex; }
+
+bool SearchPlan::streamsNeedle() const { return m_streamsNeedle; }
+
+void SearchPlan::prepareStreaming() {
+    const int m = needleSize();
+    m_streamsNeedle = true;
+    m_needleBorders.assign(static_cast<size_t>(m), 0);
+    for (int i = 1; i < m; ++i) {
+        int border = m_needleBorders[static_cast<size_t>(i - 1)];
+        while (border > 0 && m_needle.at(i) != m_needle.at(border)) {
+            border = m_needleBorders[static_cast<size_t>(border - 1)];
+        }
+        if (m_needle.at(i) == m_needle.at(border)) {
+            ++border;
+        }
+        m_needleBorders[static_cast<size_t>(i)] = border;
+    }
+}
+
+// The open run at the end of the data is the longest needle prefix that is a suffix of it (KMP
+// over the last m - 1 bytes); the shorter ones are its borders, which resuming the KMP state
+// visits again, so one state is carried however many prefixes are open.
+void SearchPlan::streamScan(const char* data, int size, int startLimit, quint64 baseOffset,
+                            QVector<RegexMatch>* matches, RegexRun* endRun) const {
+    const int m = needleSize();
+    *endRun = RegexRun();
+    if (data == nullptr || size <= 0) {
+        return;
+    }
+    thread_local QVector<SearchHit> hits;
+    findAll(data, size, startLimit, &hits);
+    for (const SearchHit& hit : hits) {
+        matches->push_back(RegexMatch{baseOffset + static_cast<quint64>(hit.offset),
+                                      static_cast<quint64>(m), 0});
+    }
+
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    const auto* needle = reinterpret_cast<const unsigned char*>(m_needle.constData());
+    int matched = 0;
+    for (int pos = qMax(0, size - (m - 1)); pos < size; ++pos) {
+        const unsigned char byte = m_foldCase ? ByteSearch::asciiLower(bytes[pos]) : bytes[pos];
+        while (matched > 0 && needle[matched] != byte) {
+            matched = m_needleBorders[static_cast<size_t>(matched - 1)];
+        }
+        if (needle[matched] == byte) {
+            ++matched;
+        }
+        if (matched == m) {
+            matched = m_needleBorders[static_cast<size_t>(m - 1)];
+        }
+    }
+    // Borders start later than the prefix they border, so none is open if it is not.
+    if (matched > 0 && size - matched < startLimit) {
+        endRun->states.push_back(matched);
+        endRun->starts.push_back(baseOffset + static_cast<quint64>(size - matched));
+    }
+}
+
+// KMP continues from the carried state only while the prefix it stands for started before the
+// data; later starts are streamScan()'s own, so this reads at most m - 1 bytes.
+void SearchPlan::streamResume(const RegexRun& carried, const char* data, int size,
+                              quint64 baseOffset, QVector<RegexMatch>* matches,
+                              RegexRun* endRun) const {
+    if (carried.isEmpty()) {
+        return;
+    }
+    const int m = needleSize();
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    const auto* needle = reinterpret_cast<const unsigned char*>(m_needle.constData());
+    int matched = carried.states.front();
+    int pos = 0;
+    for (; pos < qMax(0, size) && matched > pos; ++pos) {
+        const unsigned char byte = m_foldCase ? ByteSearch::asciiLower(bytes[pos]) : bytes[pos];
+        while (matched > 0 && needle[matched] != byte) {
+            matched = m_needleBorders[static_cast<size_t>(matched - 1)];
+        }
+        if (needle[matched] == byte) {
+            ++matched;
+        }
+        if (matched == m) {
+            matches->push_back(RegexMatch{baseOffset + static_cast<quint64>(pos + 1) -
+                                              static_cast<quint64>(m),
+                                          static_cast<quint64>(m), 0});
+            matched = m_needleBorders[static_cast<size_t>(m - 1)];
+        }
+    }
+    // A carried prefix still open at the end spans the whole data and is longer than any the
+    // data opened itself, which are its borders.
+    if (matched > pos) {
+        endRun->states.assign(1, matched);
+        endRun->starts.assign(1, baseOffset + static_cast<quint64>(pos) -
+                                     static_cast<quint64>(matched));
+    }
+}
+
+int SearchPlan::termCount() const { return m_terms.size(); }
+
+const ApproximateSearch* SearchPlan::approximate() const {
+    return m_proximityAnchor != nullptr ? m_proximityAnchor->approximate() : m_approximate.get();
+}
+
+int SearchPlan::patternTerm(int patternIdx) const {
+    return m_patternTerms.isEmpty() ? patternIdx : m_patternTerms.at(patternIdx);
+}
+
+TermEncoding SearchPlan::patternEncoding(int patternIdx) const {
+    return m_patternEncodings.isEmpty() ? TermEncoding::Utf8 : m_patternEncodings.at(patternIdx);
+}
+
+int SearchPlan::maxNeedleSize() const {
+    int maxSize = 0;
+    for (const QByteArray& term : m_terms) {
+        maxSize = qMax(maxSize, static_cast<int>(term.size()));
+    }
+    return maxSize;
+}
+
+int SearchPlan::maxMatchSpan() const {
+    if (m_proximityAnchor != nullptr) {
+        return m_nearDistance + qMax(m_proximityAnchor->boundedMatchSpan(),
+                                     m_proximityNear->boundedMatchSpan());
+    }
+    if (m_regex != nullptr || m_streamsNeedle) {
+        return 1;
+    }
+    if (m_approximate != nullptr) {
+        return m_approximate->maxMatchSpan();
+    }
+    if (m_numericForms != nullptr) {
+        return m_numericForms->maxMatchSpan();
+    }
+    if (m_xorSignatures != nullptr) {
+        int maxSpan = 0;
+        for (const int size : m_xorPatternSizes) {
+            maxSpan = qMax(maxSpan, size);
+        }
+        return maxSpan;
+    }
+    int maxSpan = maxNeedleSize();
+    for (const MaskedVariant& variant : m_maskedVariants) {
+        maxSpan = qMax(maxSpan, static_cast<int>(variant.bytes.size()));
+    }
+    return maxSpan;
+}
+
+int SearchPlan::boundedMatchSpan() const {
+    if (m_streamsNeedle) {
+        return needleSize();
+    }
+    return m_foldMatchSpan > 0 ? m_foldMatchSpan : maxMatchSpan();
+}
+
+int SearchPlan::lookBehind() const { return m_proximityAnchor != nullptr ? m_nearDistance : 0; }
+
+std::bitset<256> SearchPlan::constantRunMatches() const {
+    std::bitset<256> values;
+    if (m_regex != nullptr || m_streamsNeedle) {
+        return values.set();
+    }
+    const int size = 2 * (qMax(1, maxMatchSpan()) + lookBehind());
+    if (size > kMaxConstantRunProbe) {
+        return values.set();
+    }
+    QByteArray run(size, '\0');
+    QVector<SearchHit> hits;
+    for (int value = 0; value < 256; ++value) {
+        run.fill(static_cast<char>(value));
+        findAll(run.constData(), size, size, &hits);
+        values[static_cast<size_t>(value)] = !hits.isEmpty();
+    }
+    return values;
+}
+
+void SearchPlan::prepareAlignedPatterns() {
+    m_alignedPatterns.clear();
+    if (m_multiPattern == nullptr && m_maskedVariants.isEmpty()) {
+        addAlignedPattern(0, 0, TermEncoding::Utf8, m_needle, m_needleMask, m_foldCase);
+        return;
+    }
+    // Folded multi-pattern passes match the byte-aligned forms of the terms; the masked variants
+    // hold everything else (and every form of exact plans).
+    if (m_multiPattern != nullptr) {
+        for (int termIdx = 0; termIdx < m_terms.size(); ++termIdx) {
+            addAlignedPattern(termIdx, 0, TermEncoding::Utf8, m_terms.at(termIdx), QByteArray(),
+                              m_foldCase);
+        }
+    }
+    for (const MaskedVariant& variant : m_maskedVariants) {
+        addAlignedPattern(variant.termIdx, variant.bitOffset, variant.encoding, variant.bytes,
+                          variant.mask, false);
+    }
+    std::stable_sort(m_alignedPatterns.begin(), m_alignedPatterns.end(),
+                     [](const AlignedPattern& a, const AlignedPattern& b) {
+                         if (a.termIdx != b.termIdx) {
+                             return a.termIdx < b.termIdx;
+                         }
+                         if (a.bitOffset != b.bitOffset) {
+                             return a.bitOffset < b.bitOffset;
+                         }
+                         return a.encoding < b.encoding;
+                     });
+}
+
+void SearchPlan::addAlignedPattern(int termIdx, int bitOffset, TermEncoding encoding,
+                                   const QByteArray& bytes, const QByteArray& mask,
+                                   bool foldCase) {
+    const int size = static_cast<int>(bytes.size());
+    if (size == 0) {
+        return;
+    }
+    AlignedPattern pattern;
+    pattern.termIdx = termIdx;
+    pattern.bitOffset = bitOffset;
+    pattern.encoding = encoding;
+    pattern.mask = mask.isEmpty() ? QByteArray(size, static_cast<char>(0xFF)) : mask;
+    pattern.orBits = QByteArray(size, '\0');
+    pattern.bytes.resize(size);
+    for (int i = 0; i < size; ++i) {
+        const auto b = static_cast<unsigned char>(bytes.at(i));
+        if (foldCase && b >= 'a' && b <= 'z') {
+            pattern.orBits[i] = 0x20;
+        }
+        pattern.bytes[i] = static_cast<char>(b & static_cast<unsigned char>(pattern.mask.at(i)));
+    }
+    const int headSize = qMin(size, 8);
+    std::memcpy(&pattern.headBytes, pattern.bytes.constData(), static_cast<size_t>(headSize));
+    std::memcpy(&pattern.headMask, pattern.mask.constData(), static_cast<size_t>(headSize));
+    std::memcpy(&pattern.headOr, pattern.orBits.constData(), static_cast<size_t>(headSize));
+    m_alignedPatterns.push_back(pattern);
+}
+
+std::shared_ptr<SearchPlan> SearchPlan::prepare(const QByteArray& term,
+                                                TextInterpretationMode mode, bool ignoreCase) {
+    std::shared_ptr<SearchPlan> plan(new SearchPlan());
+    plan->m_foldCase = ignoreCase && mode != TextInterpretationMode::Utf16;
+    plan->m_needle = plan->m_foldCase ? MatchUtils::foldAsciiCase(term) : term;
+    plan->m_terms = {plan->m_needle};
+    plan->prepareAnchor();
+    plan->prepareAlignedPatterns();
+    return plan;
+}
+
+// Shifting the data left by `b` bits moves the term to where it starts `b` bits into a byte, so in
+// the raw bytes it covers one byte more: the low 8-b bits of the first byte, middle bytes
+// straddling two term bytes, and the high b bits of the last byte. Masks shift the same way.
+void SearchPlan::addTermVariants(int termIdx, const QByteArray& term, const QByteArray& mask,
+                                 bool byteAligned, bool bitPhases, TermEncoding encoding) {
+    const int m = static_cast<int>(term.size());
+    if (m == 0) {
+        return;
+    }
+    const QByteArray termMask = mask.isEmpty() ? QByteArray(m, static_cast<char>(0xFF)) : mask;
+    if (byteAligned) {
+        MaskedVariant variant;
+        variant.termIdx = termIdx;
+        variant.encoding = encoding;
+        variant.bytes = term;
+        variant.mask = termMask;
+        m_maskedVariants.push_back(variant);
+    }
+    if (!bitPhases) {
+        return;
+    }
+
+    const auto* n = reinterpret_cast<const unsigned char*>(term.constData());
+    const auto* k = reinterpret_cast<const unsigned char*>(termMask.constData());
+    auto shifted = [](const unsigned char* src, int count, int b, int j) {
+        const int high = j > 0 ? src[j - 1] << (kBitsPerByte - b) : 0;
+        const int low = j < count ? src[j] >> b : 0;
+        return static_cast<char>((high | low) & 0xFF);
+    };
+    for (int b = 1; b < kBitsPerByte; ++b) {
+        MaskedVariant variant;
+        variant.termIdx = termIdx;
+        variant.bitOffset = b;
+        variant.encoding = encoding;
+        variant.bytes.resize(m + 1);
+        variant.mask.resize(m + 1);
+        for (int j = 0; j <= m; ++j) {
+            variant.bytes[j] = shifted(n, m, b, j);
+            variant.mask[j] = shifted(k, m, b, j);
+        }
+        m_maskedVariants.push_back(variant);
+    }
+}
+
+void SearchPlan::prepareMaskedVariants() {
+    QVector<QByteArray> cores;
+    m_coreVariants.clear();
+    m_corelessVariants.clear();
+    m_corelessLeadByte.fill(false);
+    m_maxCoreOffset = 0;
+    for (int i = 0; i < m_maskedVariants.size(); ++i) {
+        MaskedVariant& variant = m_maskedVariants[i];
+        const int size = static_cast<int>(variant.mask.size());
+        const auto* mask = reinterpret_cast<const unsigned char*>(variant.mask.constData());
+        variant.coreOffset = 0;
+        variant.coreSize = 0;
+        int runStart = 0;
+        for (int j = 0; j <= size; ++j) {
+            if (j < size) {
+                variant.bytes[j] = static_cast<char>(variant.bytes.at(j) & variant.mask.at(j));
+                if (mask[j] == 0xFF) {
+                    continue;
+                }
+            }
+            if (j - runStart > variant.coreSize) {
+                variant.coreOffset = runStart;
+                variant.coreSize = j - runStart;
+            }
+            runStart = j + 1;
+        }
+
+        if (variant.coreSize > 0) {
+            cores.push_back(variant.bytes.mid(variant.coreOffset, variant.coreSize));
+            m_coreVariants.push_back(i);
+            m_maxCoreOffset = qMax(m_maxCoreOffset, variant.coreOffset);
+            continue;
+        }
+        m_corelessVariants.push_back(i);
+        const auto leadMask = static_cast<unsigned char>(variant.mask.at(0));
+        const auto leadByte = static_cast<unsigned char>(variant.bytes.at(0));
+        for (int b = 0; b < 256; ++b) {
+            if ((b & leadMask) == leadByte) {
+                m_corelessLeadByte[b] = true;
+            }
+        }
+    }
+    if (!cores.isEmpty()) {
+        m_coreSearch = std::make_unique<MultiPatternSearch>(cores, false);
+    }
+}
+
+void SearchPlan::findMaskedVariants(const unsigned char* haystack, int haystackSize,
+                                    int startLimit, QVector<SearchHit>* hits) const {
+    if (haystack == nullptr || haystackSize <= 0) {
+        return;
+    }
+    const int reportEnd = qMin(startLimit, haystackSize);
+    if (m_coreSearch != nullptr) {
+        thread_local QVector<PatternHit> coreHits;
+        m_coreSearch->findAll(reinterpret_cast<const char*>(haystack), haystackSize,
+                              qMin(haystackSize, reportEnd + m_maxCoreOffset), &coreHits);
+        for (const PatternHit& hit : coreHits) {
+            const MaskedVariant& variant = m_maskedVariants.at(m_coreVariants.at(hit.patternIdx));
+            const int start = hit.offset - variant.coreOffset;
+            if (start >= 0 && start < reportEnd &&
+                maskedEqual(haystack, haystackSize, start, variant)) {
+                hits->push_back(
+                    SearchHit{start, variant.termIdx, variant.bitOffset, variant.encoding});
+            }
+        }
+    }
+
+    if (m_corelessVariants.isEmpty()) {
+        return;
+    }
+    for (int pos = 0; pos < reportEnd; ++pos) {
+        if (!m_corelessLeadByte[haystack[pos]]) {
+            continue;
+        }
+        for (const int variantIdx : m_corelessVariants) {
+            const MaskedVariant& variant = m_maskedVariants.at(variantIdx);
+            if (maskedEqual(haystack, haystackSize, pos, variant)) {
+                hits->push_back(
+                    SearchHit{pos, variant.termIdx, variant.bitOffset, variant.encoding});
+            }
+        }
+    }
+}
+
+void SearchPlan::selectAlgorithm(SearchAlgorithm algorithm) {
+    if (algorithm == SearchAlgorithm::RareByteAnchor && !hasFoldSafeAnchor()) {
+        algorithm = SearchAlgorithm::SimdFirstLast;
+    }
+    m_algorithm = algorithm;
+    m_fixedFindAll = algorithm == SearchAlgorithm::SimdFirstLast
+                         ? ByteSearch::findAllFunction(needleSize(), m_foldCase)
+                         : nullptr;
+    if (algorithm == SearchAlgorithm::Horspool) {
+        prepareHorspool();
+    } else if (algorithm == SearchAlgorithm::TwoWay) {
+        prepareTwoWay();
+    }
+}
+
+void SearchPlan::prepareAnchor() {
+    m_anchorOffset = 0;
+    m_anchorByte = 0;
+    m_anchorRank = std::numeric_limits<int>::max();
+    const auto* n = reinterpret_cast<const unsigned char*>(m_needle.constData());
+    for (int i = 0; i < needleSize(); ++i) {
+        if (m_foldCase && isAsciiLetter(n[i])) {
+            continue;
+        }
+        const int rank = byteCommonness(n[i]);
+        if (rank < m_anchorRank) {
+            m_anchorRank = rank;
+            m_anchorOffset = i;
+            m_anchorByte = n[i];
+        }
+    }
+}
+
+void SearchPlan::prepareHorspool() {
+    const int m = needleSize();
+    const auto* n = reinterpret_cast<const unsigned char*>(m_needle.constData());
+    m_skip.fill(m);
+    for (int i = 0; i < m - 1; ++i) {
+        m_skip[n[i]] = m - 1 - i;
+        if (m_foldCase && n[i] >= 'a' && n[i] <= 'z') {
+            m_skip[n[i] - ('a' - 'A')] = m - 1 - i;
+        }
+    }
+}
+
+void SearchPlan::prepareTwoWay() {
+    const int m = needleSize();
+    const auto* n = reinterpret_cast<const unsigned char*>(m_needle.constData());
+    int forwardPeriod = 1;
+    int reversedPeriod = 1;
+    const int forwardPos = maximalSuffix(n, m, false, &forwardPeriod);
+    const int reversedPos = maximalSuffix(n, m, true, &reversedPeriod);
+    int period = forwardPeriod;
+    m_criticalPos = forwardPos;
+    if (reversedPos > forwardPos) {
+        m_criticalPos = reversedPos;
+        period = reversedPeriod;
+    }
+
+    m_periodic = std::memcmp(n, n + period, static_cast<size_t>(m_criticalPos + 1)) == 0;
+    m_period = m_periodic ? period : qMax(m_criticalPos + 1, m - m_criticalPos - 1) + 1;
+
+    // Bad-character shift on the window's last byte (0 when it is the needle's last byte), so
+    // long needles skip ahead instead of advancing one byte per mismatch.
+    m_skip.fill(m);
+    for (int i = 0; i < m; ++i) {
+        m_skip[n[i]] = m - 1 - i;
+        if (m_foldCase && n[i] >= 'a' && n[i] <= 'z') {
+            m_skip[n[i] - ('a' - 'A')] = m - 1 - i;
+        }
+    }
+}
+
+bool SearchPlan::hasFoldSafeAnchor() const {
+    return m_anchorRank != std::numeric_limits<int>::max();
+}
+
+SearchAlgorithm SearchPlan::chooseAlgorithm() const {
+    const int m = needleSize();
+    if (m > kHorspoolNeedleMax) {
+        return SearchAlgorithm::TwoWay;
+    }
+    if (m > kShortNeedleMax) {
+        return SearchAlgorithm::Horspool;
+    }
+    if (hasFoldSafeAnchor() && (m == 1 || m_anchorRank <= kRareAnchorCommonnessMax)) {
+        return SearchAlgorithm::RareByteAnchor;
+    }
+    return SearchAlgorithm::SimdFirstLast;
+}
+
+template <bool kFoldCase>
+int SearchPlan::anchorIndexOf(const unsigned char* haystack, int haystackSize, int from) const {
+    const int m = needleSize();
+    const auto* n = reinterpret_cast<const unsigned char*>(m_needle.constData());
+    const int lastAnchorPos = haystackSize - m + m_anchorOffset;
+    int anchorPos = from + m_anchorOffset;
+    while (anchorPos <= lastAnchorPos) {
+        const void* hit = std::memchr(haystack + anchorPos, m_anchorByte,
+                                      static_cast<size_t>(lastAnchorPos - anchorPos + 1));
+        if (hit == nullptr) {
+            return -1;
+        }
+        anchorPos = static_cast<int>(static_cast<const unsigned char*>(hit) - haystack);
+        const int candidate = anchorPos - m_anchorOffset;
+        if (bytesEqual<kFoldCase>(haystack + candidate, n, m)) {
+            return candidate;
+        }
+        ++anchorPos;
+    }
+    return -1;
+}
+
+template <bool kFoldCase>
+int SearchPlan::horspoolIndexOf(const unsigned char* haystack, int haystackSize, int from) const {
+    const int m = needleSize();
+    const auto* n = reinterpret_cast<const unsigned char*>(m_needle.constData());
+    const unsigned char lastByte = n[m - 1];
+    const int lastStart = haystackSize - m;
+    int j = from;
+    while (j <= lastStart) {
+        const unsigned char tail = haystack[j + m - 1];
+        if (foldByte<kFoldCase>(tail) == lastByte &&
+            bytesEqual<kFoldCase>(haystack + j, n, m - 1)) {
+            return j;
+        }
+        j += m_skip[tail];
+    }
+    return -1;
+}
+
+template <bool kFoldCase>
+int SearchPlan::twoWayIndexOf(const unsigned char* haystack, int haystackSize, int from,
+                              int knownPrefix) const {
+    const int m = needleSize();
+    const auto* n = reinterpret_cast<const unsigned char*>(m_needle.constData());
+    const int ell = m_criticalPos;
+    const int lastStart = haystackSize - m;
+    int j = from;
+
+    if (m_periodic) {
+        int memory = knownPrefix;
+        while (j <= lastStart) {
+            const int shift = m_skip[haystack[j + m - 1]];
+            if (shift > 0) {
+                // A remembered prefix only allows shifts that keep it aligned with the period.
+                j += memory >= 0 && shift < m_period ? m - m_period : shift;
+                memory = -1;
+                continue;
+            }
+            int i = qMax(ell, memory) + 1;
+            while (i < m && n[i] == foldByte<kFoldCase>(haystack[i + j])) {
+                ++i;
+            }
+            if (i >= m) {
+                i = ell;
+                while (i > memory && n[i] == foldByte<kFoldCase>(haystack[i + j])) {
+                    --i;
+                }
+                if (i <= memory) {
+                    return j;
+                }
+                j += m_period;
+                memory = m - m_period - 1;
+            } else {
+                j += i - ell;
+                memory = -1;
+            }
+        }
+        return -1;
+    }
+
+    while (j <= lastStart) {
+        const int shift = m_skip[haystack[j + m - 1]];
+        if (shift > 0) {
+            j += shift;
+            continue;
+        }
+        int i = ell + 1;
+        while (i < m && n[i] == foldByte<kFoldCase>(haystack[i + j])) {
+            ++i;
+        }
+        if (i >= m) {
+            i = ell;
+            while (i >= 0 && n[i] == foldByte<kFoldCase>(haystack[i + j])) {
+                --i;
+            }
+            if (i < 0) {
+                return j;
+            }
+            j += m_period;
+        } else {
+            j += i - ell;
+        }
+    }
+    return -1;
+}
+
+// A needle cannot start again within its period of a hit. When the needle is periodic, the
+// m - period bytes the hit shares with the next candidate are known to match, so a run of
+// overlapping matches costs O(period) per match instead of a fresh search from the next byte.
+template <bool kFoldCase>
+void SearchPlan::twoWayFindAll(const unsigned char* haystack, int haystackSize, int startLimit,
+                               QVector<SearchHit>* hits) const {
+    const int m = needleSize();
+    int memory = -1;
+    int pos = 0;
+    while (pos < startLimit) {
+        pos = twoWayIndexOf<kFoldCase>(haystack, haystackSize, pos, memory);
+        if (pos < 0 || pos >= startLimit) {
+            break;
+        }
+        hits->push_back(SearchHit{pos, 0, 0});
+        pos += m_period;
+        memory = m_periodic ? m - m_period - 1 : -1;
+    }
+}
+
+}  // namespace breco
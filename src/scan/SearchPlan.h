@@ -0,0 +1,315 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+#include <array>
+#include <bitset>
+#include <memory>
+#include <vector>
+
+#include "model/ResultTypes.h"
+#include "scan/ApproximateSearch.h"
+#include "scan/ByteRegex.h"
+#include "scan/ByteSearch.h"
+#include "scan/MatchUtils.h"
+#include "scan/MultiPatternSearch.h"
+
+namespace breco {
+
+enum class SearchAlgorithm {
+    SimdFirstLast = 0,
+    RareByteAnchor,
+    Horspool,
+    TwoWay,
+    Teddy,
+    AhoCorasick,
+    Masked,
+    LazyDfa,
+    ShiftOr,
+    Myers
+};
+
+// What the user asked to find. Compiled into a SearchPlan once per scan.
+struct SearchQuery {
+    QVector<QByteArray> terms;
+    TextInterpretationMode mode = TextInterpretationMode::Ascii;
+    // ASCII byte folding for ASCII-only terms; Unicode simple case folding for other terms and
+    // UTF-16 forms (not combined with bit phases, which fold ASCII on byte-aligned matches only).
+    bool ignoreCase = false;
+    // Per-term byte masks for hex patterns (0xFF = fixed byte, 0x00 = "??"). Either empty (plain
+    // text terms) or one entry of the term's size per term. Ignore-case never applies to them.
+    QVector<QByteArray> masks;
+    // Also match every term at bit offsets 1..7 (what Shift = Bits +N would reveal).
+    bool bitPhases = false;
+    // Terms are byte regular expressions (see ByteRegex); masks and bit phases do not apply.
+    bool regex = false;
+    // Also match the UTF-16LE and UTF-16BE forms of every text term in the same pass. Not used
+    // for hex patterns.
+    bool encodingVariants = false;
+    // Also match the Base64 (all three alignments), lower- and upper-case hex-ASCII and
+    // percent-encoded forms of every text term's UTF-8 bytes in the same pass. These forms are
+    // matched exactly, also with ignore-case. Not used for hex patterns.
+    bool encodedForms = false;
+    // Report matches with up to `maxDistance` substituted bytes (Hamming) or edited bytes (Edit).
+    // Terms must be longer than `maxDistance` and at most ApproximateSearch::kMaxPatternSize
+    // bytes; bit phases and regex do not apply, and ignore-case folds ASCII letters only.
+    ApproximateMetric approximate = ApproximateMetric::None;
+    int maxDistance = 1;
+    // Also match every term XORed with any single-byte key (key 0 is the plain term). Terms need
+    // at least 2 bytes and hex patterns no wildcards; ignore-case, bit phases and approximate
+    // matching do not apply.
+    bool xorKeys = false;
+    // Terms are numbers (MatchUtils::numericVariants): match their 16/32/64-bit integer and
+    // float/double forms, floats within `tolerance`. Hex, ignore-case, encoding variants, bit
+    // phases, XOR keys and approximate matching do not apply.
+    bool numeric = false;
+    double tolerance = 0.0;
+    // Proximity search: a match of `terms` is only reported when a match of one of `nearTerms`
+    // starts at most `nearDistance` bytes before or after it (start to start). Near terms are
+    // read and matched like `terms` (hex patterns take `nearMasks`); regex queries do not
+    // support it.
+    QVector<QByteArray> nearTerms;
+    QVector<QByteArray> nearMasks;
+    int nearDistance = 0;
+};
+
+struct SearchHit {
+    int offset = 0;
+    int termIdx = 0;
+    int bitOffset = 0;
+    TermEncoding encoding = TermEncoding::Utf8;
+    // Approximate plans only: errors in the match and its length in bytes.
+    int distance = 0;
+    int length = 0;
+    // XOR-key plans only: the key the matched bytes are XORed with.
+    int xorKey = -1;
+    // Numeric plans only: the binary form matched (`length` is its size).
+    NumericFormat numericFormat = NumericFormat::None;
+};
+
+// A term variant matched under a per-byte mask: (haystack[start + i] & mask[i]) == bytes[i]. The
+// exact run bytes[coreOffset, coreOffset + coreSize) is what the prefilter searches for; a
+// variant without any fully known byte has coreSize 0 and is checked position by position.
+struct MaskedVariant {
+    int termIdx = 0;
+    int bitOffset = 0;
+    TermEncoding encoding = TermEncoding::Utf8;
+    int coreOffset = 0;
+    int coreSize = 0;
+    QByteArray bytes;
+    QByteArray mask;
+};
+
+// Immutable, precompiled description of how to find the search terms. Built once per scan in
+// ScanController::startScan() and shared read-only by every ScanWorker, so per-call work is limited
+// to the search loop itself. A single term gets a single-needle algorithm; several terms share one
+// multi-pattern pass (Teddy or Aho-Corasick) and hits carry the index of the matching term.
+// A single hex pattern uses the SIMD masked kernel; other masked variants (several hex patterns,
+// bit phases) are found through the exact cores of all variants in one more multi-pattern pass,
+// then verified under their masks. Encoding variants (UTF-16LE/BE forms of the terms) and encoded
+// forms (Base64, hex-ASCII, URL) are exact masked variants of the same pass. Regex queries
+// compile to a ByteRegex that each worker runs through its own lazy DFA; so do ignore-case
+// queries that need Unicode case folding (non-ASCII terms or UTF-16 forms), with each character
+// compiled to the alternation of its case variants.
+// Approximate queries run an ApproximateSearch over every term and encoding instead. XOR-key
+// queries search the XOR of adjacent bytes, which a single-byte key cancels out of, for the same
+// transform of each term with an inner exact plan, then read the key off the first byte. Numeric
+// queries search every binary form of every number as a masked pattern in one pass, then check
+// the bytes a float tolerance leaves open against the form's value range. Proximity queries run
+// one plan for the terms and one for the near terms over the same job and keep the term matches
+// with a near match close enough; jobs also see `lookBehind()` bytes before their start.
+class SearchPlan {
+public:
+    static constexpr int kMaxNearDistance = 1 << 20;
+    // Single exact needles at least this long are streamed across jobs instead of overlapped.
+    static constexpr int kMinStreamedNeedleSize = 256;
+    // Longest term form (UTF-16, encoded, or bit phase) compile() accepts, except for a single
+    // exact needle, which streams across jobs instead of overlapping them.
+    static constexpr int kMaxTermFormSize = 1 << 16;
+    // Longest run constantRunMatches() probes; plans that need a longer one report every value.
+    static constexpr int kMaxConstantRunProbe = 1 << 16;
+
+    // Returns nullptr and sets `error` when a regex query does not compile, an approximate query
+    // has a term that is too short or too long, an XOR-key query has an unusable term, or a
+    // numeric query has a term that is not a number, a term form is longer than kMaxTermFormSize
+    // without streaming, or the terms or near terms of a proximity query do not compile.
+    static std::shared_ptr<const SearchPlan> compile(const SearchQuery& query,
+                                                     QString* error = nullptr);
+    static std::shared_ptr<const SearchPlan> compile(const QByteArray& term,
+                                                     TextInterpretationMode mode, bool ignoreCase);
+    static std::shared_ptr<const SearchPlan> compile(const QVector<QByteArray>& terms,
+                                                     TextInterpretationMode mode, bool ignoreCase);
+    // Forces a specific algorithm (tests/benchmarks). A rare-byte anchor needs a non-letter anchor
+    // when folding case and falls back to SimdFirstLast when the term has none.
+    static std::shared_ptr<const SearchPlan> compile(const QByteArray& term,
+                                                     TextInterpretationMode mode, bool ignoreCase,
+                                                     SearchAlgorithm algorithm);
+    static const char* algorithmName(SearchAlgorithm algorithm);
+
+    // Single-term plans only; multi-term plans always return -1.
+    int indexOf(const char* haystack, int haystackSize, int from) const;
+    // Replaces `hits` with every match of any term that starts before `startLimit`, ordered by
+    // offset, term index, bit offset and encoding. Regex matches must end within the haystack
+    // here (each calling thread keeps a ByteRegexScanner for each of the last few plans it ran);
+    // scan workers use their own scanner to carry the DFA state into the next job.
+    void findAll(const char* haystack, int haystackSize, int startLimit,
+                 QVector<SearchHit>* hits) const;
+    // Like findAll(), but only reports matches starting at `first`, `first + stride`, ... (sector
+    // aligned scans). Plans of exact and masked byte patterns compare every pattern at those
+    // positions only, from one 8-byte load per position; the others filter findAll().
+    void findAligned(const char* haystack, int haystackSize, int startLimit, int first,
+                     int stride, QVector<SearchHit>* hits) const;
+
+    SearchAlgorithm algorithm() const;
+    bool foldsCase() const;
+    const QByteArray& needle() const;
+    int needleSize() const;
+    int termCount() const;
+    int maxNeedleSize() const;
+    // Longest byte span a single match can cover; a bit-phase match touches one byte more than
+    // its term. Consecutive scan jobs must overlap by this minus one. Regex and streamed-needle
+    // plans report 1: their matches continue across jobs as carried runs, not through an overlap.
+    int maxMatchSpan() const;
+    // Bytes before a hit's start that decide whether it is reported; scan jobs hand findAll()
+    // that much of the preceding data too. Non-zero for proximity plans only.
+    int lookBehind() const;
+    // Byte values a run of which, as long as twice maxMatchSpan() plus lookBehind(), holds a
+    // match (e.g. 0x00 for a term of zeros, or for the number 0). Scans skip the inside of runs of
+    // the other values. Probes findAll() once per value, so call it once per scan; regex and
+    // streamed-needle plans, and plans whose run exceeds kMaxConstantRunProbe (wide proximity
+    // windows), report every value.
+    std::bitset<256> constantRunMatches() const;
+    // Non-null for regex plans, including Unicode case-fold plans.
+    const std::shared_ptr<const ByteRegex>& regex() const;
+    // True for a single exact needle of kMinStreamedNeedleSize bytes or more (SearchQuery compile
+    // only). Scan workers then use streamScan()/streamResume() like a ByteRegexScanner: the
+    // carried state is one KMP state, the longest needle prefix the data so far ends with, and
+    // the start it implies.
+    bool streamsNeedle() const;
+    // Appends the matches starting before `startLimit` that end within `data`; `endRun` gets
+    // the longest needle prefix `data` ends with, if it starts before `startLimit`.
+    void streamScan(const char* data, int size, int startLimit, quint64 baseOffset,
+                    QVector<RegexMatch>* matches, RegexRun* endRun) const;
+    // Continues the KMP state carried from the preceding data over `data` (starting at
+    // `baseOffset`) and reports the matches that started before it; if the carried prefix is
+    // still open, it replaces the one streamScan() put in `endRun`.
+    void streamResume(const RegexRun& carried, const char* data, int size, quint64 baseOffset,
+                      QVector<RegexMatch>* matches, RegexRun* endRun) const;
+    // Non-null for approximate plans (and proximity plans whose terms are approximate).
+    const ApproximateSearch* approximate() const;
+    // Term and encoding a ByteRegex, ApproximateSearch, XOR-key or numeric pattern stands for: one
+    // pattern per term for regex queries, one per binary form for numeric queries, one per term
+    // and encoding otherwise. Patterns are ordered by term, then encoding or form.
+    int patternTerm(int patternIdx) const;
+    TermEncoding patternEncoding(int patternIdx) const;
+
+private:
+    // A byte pattern findAligned() compares in place: (haystack[i] | orBits[i]) & mask[i] must
+    // equal bytes[i], where orBits folds ASCII case (0x20 on letters of folded terms). The head
+    // words hold the first 8 bytes of each, zero-padded.
+    struct AlignedPattern {
+        int termIdx = 0;
+        int bitOffset = 0;
+        TermEncoding encoding = TermEncoding::Utf8;
+        QByteArray bytes;
+        QByteArray mask;
+        QByteArray orBits;
+        quint64 headBytes = 0;
+        quint64 headMask = 0;
+        quint64 headOr = 0;
+    };
+
+    SearchPlan() = default;
+
+    static std::shared_ptr<SearchPlan> compileApproximate(const SearchQuery& query,
+                                                          QString* error);
+    static std::shared_ptr<SearchPlan> compileXorKeys(const SearchQuery& query, QString* error);
+    static std::shared_ptr<SearchPlan> compileNumeric(const SearchQuery& query, QString* error);
+    static std::shared_ptr<SearchPlan> compileProximity(const SearchQuery& query, QString* error);
+    // Longest byte span of a match, also for case-fold plans, whose maxMatchSpan() is 1.
+    int boundedMatchSpan() const;
+    static std::shared_ptr<SearchPlan> compileCaseFold(const SearchQuery& query);
+    static std::shared_ptr<SearchPlan> prepare(const QByteArray& term, TextInterpretationMode mode,
+                                               bool ignoreCase);
+    void addTermVariants(int termIdx, const QByteArray& term, const QByteArray& mask,
+                         bool byteAligned, bool bitPhases, TermEncoding encoding);
+    void prepareMaskedVariants();
+    void prepareStreaming();
+    // Fills m_alignedPatterns for plans that match byte patterns only; called by every compile
+    // path that builds one.
+    void prepareAlignedPatterns();
+    void addAlignedPattern(int termIdx, int bitOffset, TermEncoding encoding,
+                           const QByteArray& bytes, const QByteArray& mask, bool foldCase);
+    void findMaskedVariants(const unsigned char* haystack, int haystackSize, int startLimit,
+                            QVector<SearchHit>* hits) const;
+    void selectAlgorithm(SearchAlgorithm algorithm);
+    void prepareAnchor();
+    void prepareHorspool();
+    void prepareTwoWay();
+    bool hasFoldSafeAnchor() const;
+    SearchAlgorithm chooseAlgorithm() const;
+
+    template <bool kFoldCase>
+    int anchorIndexOf(const unsigned char* haystack, int haystackSize, int from) const;
+    template <bool kFoldCase>
+    int horspoolIndexOf(const unsigned char* haystack, int haystackSize, int from) const;
+    // `knownPrefix`: index of the last needle byte known to match at `from` (-1 for none); only
+    // periodic needles use it.
+    template <bool kFoldCase>
+    int twoWayIndexOf(const unsigned char* haystack, int haystackSize, int from,
+                      int knownPrefix) const;
+    template <bool kFoldCase>
+    void twoWayFindAll(const unsigned char* haystack, int haystackSize, int startLimit,
+                       QVector<SearchHit>* hits) const;
+
+    QByteArray m_needle;
+    QByteArray m_needleMask;
+    QVector<QByteArray> m_terms;
+    std::shared_ptr<const ByteRegex> m_regex;
+    std::unique_ptr<ApproximateSearch> m_approximate;
+    // XOR-key plans: exact plan over the adjacent-byte XOR of every pattern, plus the first byte
+    // and size of each pattern.
+    std::shared_ptr<const SearchPlan> m_xorSignatures;
+    QByteArray m_xorFirstBytes;
+    QVector<int> m_xorPatternSizes;
+    // Numeric plans: masked plan over the binary form of every number, one pattern per variant.
+    std::shared_ptr<const SearchPlan> m_numericForms;
+    QVector<NumericVariant> m_numericVariants;
+    // Proximity plans: plans for the terms and the near terms.
+    std::shared_ptr<const SearchPlan> m_proximityAnchor;
+    std::shared_ptr<const SearchPlan> m_proximityNear;
+    int m_nearDistance = 0;
+    // Case-fold plans: longest byte span of a match.
+    int m_foldMatchSpan = 0;
+    // Streamed-needle plans: longest proper border of each needle prefix (KMP prefix function).
+    bool m_streamsNeedle = false;
+    std::vector<int> m_needleBorders;
+    QVector<int> m_patternTerms;
+    QVector<TermEncoding> m_patternEncodings;
+    std::unique_ptr<MultiPatternSearch> m_multiPattern;
+    QVector<MaskedVariant> m_maskedVariants;
+    std::unique_ptr<MultiPatternSearch> m_coreSearch;
+    QVector<int> m_coreVariants;
+    QVector<int> m_corelessVariants;
+    std::array<bool, 256> m_corelessLeadByte{};
+    // Ordered by term, bit offset and encoding, like findAll() hits at one offset.
+    QVector<AlignedPattern> m_alignedPatterns;
+    int m_maxCoreOffset = 0;
+    bool m_foldCase = false;
+    SearchAlgorithm m_algorithm = SearchAlgorithm::SimdFirstLast;
+
+    int m_anchorOffset = 0;
+    unsigned char m_anchorByte = 0;
+    int m_anchorRank = 0;
+
+    std::array<int, 256> m_skip{};
+    // simd-first-last needles of up to ByteSearch::kMaxFixedNeedleSize bytes: findAll() runs
+    // this kernel, instantiated for the needle size and case mode, instead of indexOf().
+    ByteSearch::FindAllFn m_fixedFindAll = nullptr;
+
+    int m_criticalPos = -1;
+    int m_period = 1;
+    bool m_periodic = false;
+};
+
+}  // namespace breco
@@ -11,6 +11,7 @@ constexpr const char* kApp = "breco";
 constexpr const char* kLastFilePathKey = "ui/lastFileDialogPath";
 constexpr const char* kLastDirPathKey = "ui/lastDirectoryDialogPath";
 constexpr const char* kRememberedSingleFilePathKey = "ui/rememberedSingleFilePath";
+constexpr const char* kLastTermsFilePathKey = "ui/lastTermsFileDialogPath";
 constexpr const char* kTextByteModeKey = "ui/textByteModeEnabled";
 constexpr const char* kTextWrapModeKey = "ui/textWrapModeEnabled";
 constexpr const char* kTextCollapseKey = "ui/textCollapseEnabled";
@@ -21,6 +22,12 @@ constexpr const char* kTextByteLineModeIndexKey = "ui/textByteLineModeIndex";
 constexpr const char* kPrefillOnMergeEnabledKey = "ui/prefillOnMergeEnabled";
 constexpr const char* kScanBlockSizeValueKey = "ui/scanBlockSizeValue";
 constexpr const char* kScanBlockSizeUnitIndexKey = "ui/scanBlockSizeUnitIndex";
+constexpr const char* kScanAlignmentIndexKey = "ui/scanAlignmentIndex";
+constexpr const char* kScanMatchLimitKey = "ui/scanMatchLimit";
+constexpr const char* kScanMatchMemoryMiBKey = "ui/scanMatchMemoryMiB";
+constexpr const char* kScanEntropyMapEnabledKey = "ui/scanEntropyMapEnabled";
+constexpr const char* kScanEntropySkipEnabledKey = "ui/scanEntropySkipEnabled";
+constexpr const char* kScanEntropySkipBitsKey = "ui/scanEntropySkipBits";
 constexpr const char* kContentSplitterSizesKey = "ui/contentSplitterSizes";
 constexpr const char* kMainSplitterSizesKey = "ui/mainSplitterSizes";
 constexpr const char* kTextGutterFormatIndexKey = "ui/textGutterFormatIndex";
@@ -47,6 +54,11 @@ QString AppSettings::rememberedSingleFilePath() {
     return settings.value(kRememberedSingleFilePathKey, QString()).toString();
 }
 
+QString AppSettings::lastTermsFileDialogPath() {
+    QSettings settings(kOrg, kApp);
+    return settings.value(kLastTermsFilePathKey, QDir::homePath()).toString();
+}
+
 void AppSettings::setLastFileDialogPath(const QString& path) {
     QSettings settings(kOrg, kApp);
     settings.setValue(kLastFilePathKey, path);
@@ -57,6 +69,11 @@ void AppSettings::setLastDirectoryDialogPath(const QString& path) {
     settings.setValue(kLastDirPathKey, path);
 }
 
+void AppSettings::setLastTermsFileDialogPath(const QString& path) {
+    QSettings settings(kOrg, kApp);
+    settings.setValue(kLastTermsFilePathKey, path);
+}
+
 void AppSettings::setRememberedSingleFilePath(const QString& path) {
     QSettings settings(kOrg, kApp);
     settings.setValue(kRememberedSingleFilePathKey, path);
@@ -117,6 +134,36 @@ int AppSettings::scanBlockSizeUnitIndex() {
     return settings.value(kScanBlockSizeUnitIndexKey, 2).toInt();
 }
 
+int AppSettings::scanAlignmentIndex() {
+    QSettings settings(kOrg, kApp);
+    return settings.value(kScanAlignmentIndexKey, 0).toInt();
+}
+
+int AppSettings::scanMatchLimit(int defaultValue) {
+    QSettings settings(kOrg, kApp);
+    return settings.value(kScanMatchLimitKey, defaultValue).toInt();
+}
+
+int AppSettings::scanMatchMemoryMiB(int defaultValue) {
+    QSettings settings(kOrg, kApp);
+    return settings.value(kScanMatchMemoryMiBKey, defaultValue).toInt();
+}
+
+bool AppSettings::scanEntropyMapEnabled() {
+    QSettings settings(kOrg, kApp);
+    return settings.value(kScanEntropyMapEnabledKey, false).toBool();
+}
+
+bool AppSettings::scanEntropySkipEnabled() {
+    QSettings settings(kOrg, kApp);
+    return settings.value(kScanEntropySkipEnabledKey, false).toBool();
+}
+
+double AppSettings::scanEntropySkipBits(double defaultValue) {
+    QSettings settings(kOrg, kApp);
+    return settings.value(kScanEntropySkipBitsKey, defaultValue).toDouble();
+}
+
 QList<int> AppSettings::contentSplitterSizes() {
     QSettings settings(kOrg, kApp);
     const QVariantList raw = settings.value(kContentSplitterSizesKey).toList();
@@ -224,6 +271,36 @@ void AppSettings::setScanBlockSizeUnitIndex(int index) {
     settings.setValue(kScanBlockSizeUnitIndexKey, index);
 }
 
+void AppSettings::setScanAlignmentIndex(int index) {
+    QSettings settings(kOrg, kApp);
+    settings.setValue(kScanAlignmentIndexKey, index);
+}
+
+void AppSettings::setScanMatchLimit(int value) {
+    QSettings settings(kOrg, kApp);
+    settings.setValue(kScanMatchLimitKey, value);
+}
+
+void AppSettings::setScanMatchMemoryMiB(int value) {
+    QSettings settings(kOrg, kApp);
+    settings.setValue(kScanMatchMemoryMiBKey, value);
+}
+
+void AppSettings::setScanEntropyMapEnabled(bool enabled) {
+    QSettings settings(kOrg, kApp);
+    settings.setValue(kScanEntropyMapEnabledKey, enabled);
+}
+
+void AppSettings::setScanEntropySkipEnabled(bool enabled) {
+    QSettings settings(kOrg, kApp);
+    settings.setValue(kScanEntropySkipEnabledKey, enabled);
+}
+
+void AppSettings::setScanEntropySkipBits(double value) {
+    QSettings settings(kOrg, kApp);
+    settings.setValue(kScanEntropySkipBitsKey, value);
+}
+
 void AppSettings::setContentSplitterSizes(const QList<int>& sizes) {
     QSettings settings(kOrg, kApp);
     QVariantList raw;
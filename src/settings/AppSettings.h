@@ -10,8 +10,10 @@ public:
     static QString lastFileDialogPath();
     static QString lastDirectoryDialogPath();
     static QString rememberedSingleFilePath();
+    static QString lastTermsFileDialogPath();
     static void setLastFileDialogPath(const QString& path);
     static void setLastDirectoryDialogPath(const QString& path);
+    static void setLastTermsFileDialogPath(const QString& path);
     static void setRememberedSingleFilePath(const QString& path);
     static void clearRememberedSingleFilePath();
     static bool textByteModeEnabled();
@@ -24,6 +26,12 @@ public:
     static bool prefillOnMergeEnabled();
     static int scanBlockSizeValue(int defaultValue);
     static int scanBlockSizeUnitIndex();
+    static int scanAlignmentIndex();
+    static int scanMatchLimit(int defaultValue);
+    static int scanMatchMemoryMiB(int defaultValue);
+    static bool scanEntropyMapEnabled();
+    static bool scanEntropySkipEnabled();
+    static double scanEntropySkipBits(double defaultValue);
     static QList<int> contentSplitterSizes();
     static QList<int> mainSplitterSizes();
     static int textGutterFormatIndex();
@@ -43,6 +51,12 @@ public:
     static void setPrefillOnMergeEnabled(bool enabled);
     static void setScanBlockSizeValue(int value);
     static void setScanBlockSizeUnitIndex(int index);
+    static void setScanAlignmentIndex(int index);
+    static void setScanMatchLimit(int value);
+    static void setScanMatchMemoryMiB(int value);
+    static void setScanEntropyMapEnabled(bool enabled);
+    static void setScanEntropySkipEnabled(bool enabled);
+    static void setScanEntropySkipBits(double value);
     static void setContentSplitterSizes(const QList<int>& sizes);
     static void setMainSplitterSizes(const QList<int>& sizes);
     static void setTextGutterFormatIndex(int index);
@@ -0,0 +1,125 @@
+#include "view/EntropyStripWidget.h"
+
+#include <QPainter>
+#include <QToolTip>
+
+namespace breco {
+
+namespace {
+constexpr int kStripWidth = 18;
+}
+
+EntropyStripWidget::EntropyStripWidget(QWidget* parent) : QWidget(parent) {
+    setFixedWidth(kStripWidth);
+    setMouseTracking(true);
+    setVisible(false);
+}
+
+void EntropyStripWidget::setEntropyMap(const EntropyMap* map) {
+    const EntropyMap* usable = map != nullptr && !map->isEmpty() ? map : nullptr;
+    if (m_map == usable) {
+        return;
+    }
+    m_map = usable;
+    setVisible(m_map != nullptr);
+    update();
+}
+
+void EntropyStripWidget::setVisibleRange(quint64 start, quint64 size) {
+    if (m_visibleStart == start && m_visibleSize == size) {
+        return;
+    }
+    m_visibleStart = start;
+    m_visibleSize = size;
+    update();
+}
+
+QSize EntropyStripWidget::sizeHint() const { return QSize(kStripWidth, 220); }
+
+QColor EntropyStripWidget::colorForLevel(quint8 level) {
+    if (level == EntropyMap::kUnmeasured) {
+        return QColor(96, 96, 96);
+    }
+    const double t = qBound(0.0, EntropyMap::bitsForLevel(level) / 8.0, 1.0);
+    // Hue 240 (blue) down to 0 (red); low-entropy rows are also darker.
+    return QColor::fromHsv(static_cast<int>(240.0 * (1.0 - t)), 255,
+                           static_cast<int>(90.0 + 165.0 * t));
+}
+
+void EntropyStripWidget::paintEvent(QPaintEvent* event) {
+    Q_UNUSED(event);
+    QPainter painter(this);
+    if (m_map == nullptr || height() <= 0) {
+        return;
+    }
+    const int blocks = m_map->blockCount();
+    const int rows = height();
+    for (int y = 0; y < rows; ++y) {
+        const int first = static_cast<int>(static_cast<qint64>(y) * blocks / rows);
+        const int last =
+            qMax(first + 1, static_cast<int>(static_cast<qint64>(y + 1) * blocks / rows));
+        quint8 level = EntropyMap::kUnmeasured;
+        for (int block = first; block < last; ++block) {
+            const quint8 blockLevel = m_map->level(block);
+            if (blockLevel != EntropyMap::kUnmeasured &&
+                (level == EntropyMap::kUnmeasured || blockLevel > level)) {
+                level = blockLevel;
+            }
+        }
+        painter.setPen(colorForLevel(level));
+        painter.drawLine(0, y, width() - 1, y);
+    }
+
+    const quint64 fileSize = m_map->fileSize();
+    if (m_visibleSize > 0 && fileSize > 0) {
+        const auto toY = [rows, fileSize](quint64 offset) {
+            return static_cast<int>(static_cast<long double>(qMin(offset, fileSize)) * rows /
+                                    fileSize);
+        };
+        const int top = toY(m_visibleStart);
+        const int bottom = qMax(top + 2, toY(m_visibleStart + m_visibleSize));
+        painter.setPen(Qt::white);
+        painter.drawRect(0, top, width() - 1, qMin(bottom, rows) - top - 1);
+    }
+}
+
+void EntropyStripWidget::mousePressEvent(QMouseEvent* event) {
+    const std::optional<int> block = blockAtY(event->pos().y());
+    if (event->button() != Qt::LeftButton || !block.has_value()) {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+    emit offsetClicked(static_cast<quint64>(block.value()) * EntropyMap::kBlockBytes);
+}
+
+void EntropyStripWidget::mouseMoveEvent(QMouseEvent* event) {
+    const std::optional<int> block = blockAtY(event->pos().y());
+    if (!block.has_value()) {
+        QToolTip::hideText();
+        return;
+    }
+    const quint64 start = static_cast<quint64>(block.value()) * EntropyMap::kBlockBytes;
+    const quint64 end = qMin(start + EntropyMap::kBlockBytes, m_map->fileSize());
+    const quint8 level = m_map->level(block.value());
+    const QString entropy =
+        level == EntropyMap::kUnmeasured
+            ? QStringLiteral("not measured")
+            : QStringLiteral("%1 bits/byte")
+                  .arg(QString::number(EntropyMap::bitsForLevel(level), 'f', 2));
+    QToolTip::showText(event->globalPosition().toPoint(),
+                       QStringLiteral("0x%1 - 0x%2: %3")
+                           .arg(QString::number(start, 16).toUpper())
+                           .arg(QString::number(end - 1, 16).toUpper())
+                           .arg(entropy),
+                       this);
+}
+
+std::optional<int> EntropyStripWidget::blockAtY(int y) const {
+    if (m_map == nullptr || y < 0 || y >= height()) {
+        return std::nullopt;
+    }
+    return qMin(m_map->blockCount() - 1,
+                static_cast<int>(static_cast<qint64>(y) * m_map->blockCount() / height()));
+}
+
+}  // namespace breco
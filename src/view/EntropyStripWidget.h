@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QColor>
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QWidget>
+#include <optional>
+
+#include "scan/EntropyMap.h"
+
+namespace breco {
+
+// A vertical strip beside the bitmap view showing the entropy map of the previewed target: the top
+// edge is offset 0, the bottom edge the end of the file, and each pixel row takes the highest
+// level of the blocks it covers so small encrypted or compressed regions stay visible. The
+// previewed window is outlined. Hovering shows a block's range and entropy; clicking emits the
+// block's first offset.
+class EntropyStripWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit EntropyStripWidget(QWidget* parent = nullptr);
+
+    // The map is not copied; it must outlive the strip or be replaced first. nullptr hides the
+    // strip.
+    void setEntropyMap(const EntropyMap* map);
+    void setVisibleRange(quint64 start, quint64 size);
+    QSize sizeHint() const override;
+
+    // Dark blue for uniform bytes through green and yellow to red for random-looking ones; grey for
+    // unmeasured blocks.
+    static QColor colorForLevel(quint8 level);
+
+signals:
+    void offsetClicked(quint64 offset);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+
+private:
+    std::optional<int> blockAtY(int y) const;
+
+    const EntropyMap* m_map = nullptr;
+    quint64 m_visibleStart = 0;
+    quint64 m_visibleSize = 0;
+};
+
+}  // namespace breco
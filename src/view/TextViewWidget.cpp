@@ -1816,9 +1816,12 @@ void TextViewWidget::showSelectionContextMenu(const QPoint& localPos) {
     QAction* copyHex = copyMenu->addAction(QStringLiteral("Hex"));
     QAction* copyCHeader = copyMenu->addAction(QStringLiteral("C Header"));
     QAction* copyBinary = copyMenu->addAction(QStringLiteral("Binary"));
+    QAction* searchSelection = menu.addAction(QStringLiteral("Search for selected bytes"));
 
     QAction* selected = menu.exec(m_contentWidget->mapToGlobal(localPos));
-    if (selected == copyText) {
+    if (selected == searchSelection) {
+        emit selectionSearchRequested(selectedBytes());
+    } else if (selected == copyText) {
         copySelectionToClipboard(CopyFormat::TextOnly);
     } else if (selected == copyOffsetHex) {
         copySelectionToClipboard(CopyFormat::OffsetHex);
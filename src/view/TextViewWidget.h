@@ -80,6 +80,7 @@ signals:
     void hoverAbsoluteOffsetChanged(quint64 offset);
     void hoverLeft();
     void selectionRangeChanged(bool hasRange, quint64 start, quint64 end);
+    void selectionSearchRequested(const QByteArray& bytes);
     void backingScrollRequested(int wheelSteps, int bytesPerStepHint, int visibleBytesHint);
     void pageNavigationRequested(int direction, quint64 edgeOffset);
     void fileEdgeNavigationRequested(int edge);
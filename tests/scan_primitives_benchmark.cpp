@@ -1,9 +1,14 @@
 #include <QCoreApplication>
 #include <QElapsedTimer>
 #include <QRandomGenerator>
+#include <QStringList>
 #include <QDebug>
 
+#include "scan/ByteRegex.h"
+#include "scan/ByteSearch.h"
 #include "scan/MatchUtils.h"
+#include "scan/MultiPatternSearch.h"
+#include "scan/SearchPlan.h"
 #include "scan/ShiftTransform.h"
 
 namespace {
@@ -35,10 +40,14 @@ void benchmarkMatchUtils(const QByteArray& haystack, const QByteArray& needle,
     QElapsedTimer timer;
     timer.start();
 
+    // Fold the needle once, as SearchPlan does, instead of on every call.
+    const bool folded = ignoreCase && mode != breco::TextInterpretationMode::Utf16;
+    const QByteArray foldedNeedle = folded ? breco::MatchUtils::foldAsciiCase(needle) : needle;
     int matches = 0;
     int from = 0;
     while (true) {
-        const int pos = breco::MatchUtils::indexOf(haystack, needle, from, mode, ignoreCase);
+        const int pos = folded ? breco::MatchUtils::indexOfFolded(haystack, foldedNeedle, from)
+                               : breco::MatchUtils::indexOf(haystack, needle, from, mode, false);
         if (pos < 0) {
             break;
         }
@@ -59,6 +68,333 @@ void benchmarkMatchUtils(const QByteArray& haystack, const QByteArray& needle,
                              .arg(matches);
 }
 
+void benchmarkSearchKernel(const QByteArray& haystack, const QByteArray& needle,
+                           breco::SearchKernel kernel, bool foldCase) {
+    if (!breco::ByteSearch::kernelSupported(kernel)) {
+        qInfo().noquote() << QStringLiteral("ByteSearch %1: not supported by this CPU")
+                                 .arg(QString::fromLatin1(breco::ByteSearch::kernelName(kernel)));
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int matches = 0;
+    int from = 0;
+    while (true) {
+        const int pos =
+            foldCase ? breco::ByteSearch::indexOfFolded(haystack.constData(), haystack.size(),
+                                                        needle.constData(), needle.size(), from,
+                                                        kernel)
+                     : breco::ByteSearch::indexOf(haystack.constData(), haystack.size(),
+                                                  needle.constData(), needle.size(), from, kernel);
+        if (pos < 0) {
+            break;
+        }
+        ++matches;
+        from = pos + 1;
+    }
+
+    const qint64 ns = timer.nsecsElapsed();
+    const double sec = static_cast<double>(ns) / 1e9;
+    const double gib = static_cast<double>(haystack.size()) / (1024.0 * 1024.0 * 1024.0);
+    const double gibPerSec = (sec > 0.0) ? (gib / sec) : 0.0;
+
+    QString label = QStringLiteral("ByteSearch %1 %2")
+                        .arg(QString::fromLatin1(breco::ByteSearch::kernelName(kernel)),
+                             foldCase ? QStringLiteral("ignore-case") : QStringLiteral("exact"));
+    if (kernel == breco::ByteSearch::bestKernel()) {
+        label += QStringLiteral(" (selected)");
+    }
+
+    qInfo().noquote() << QStringLiteral("%1: needle=%2 B time=%3 ms throughput=%4 GiB/s matches=%5")
+                             .arg(label)
+                             .arg(needle.size())
+                             .arg(QString::number(sec * 1000.0, 'f', 2))
+                             .arg(QString::number(gibPerSec, 'f', 2))
+                             .arg(matches);
+}
+
+void benchmarkSearchPlan(const QByteArray& haystack, const QByteArray& needle) {
+    const std::shared_ptr<const breco::SearchPlan> plan =
+        breco::SearchPlan::compile(needle, breco::TextInterpretationMode::Ascii, false);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int matches = 0;
+    int from = 0;
+    while (true) {
+        const int pos = plan->indexOf(haystack.constData(), haystack.size(), from);
+        if (pos < 0) {
+            break;
+        }
+        ++matches;
+        from = pos + 1;
+    }
+
+    const qint64 ns = timer.nsecsElapsed();
+    const double sec = static_cast<double>(ns) / 1e9;
+    const double gib = static_cast<double>(haystack.size()) / (1024.0 * 1024.0 * 1024.0);
+    const double gibPerSec = (sec > 0.0) ? (gib / sec) : 0.0;
+
+    qInfo().noquote() << QStringLiteral("SearchPlan %1: needle=%2 B time=%3 ms throughput=%4 "
+                                        "GiB/s matches=%5")
+                             .arg(QString::fromLatin1(
+                                 breco::SearchPlan::algorithmName(plan->algorithm())))
+                             .arg(needle.size())
+                             .arg(QString::number(sec * 1000.0, 'f', 2))
+                             .arg(QString::number(gibPerSec, 'f', 2))
+                             .arg(matches);
+}
+
+void benchmarkMultiPattern(const QByteArray& haystack, const QVector<QByteArray>& terms) {
+    const std::shared_ptr<const breco::SearchPlan> plan =
+        breco::SearchPlan::compile(terms, breco::TextInterpretationMode::Ascii, false);
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<breco::SearchHit> hits;
+    plan->findAll(haystack.constData(), haystack.size(), haystack.size(), &hits);
+    const qint64 onePassNs = timer.nsecsElapsed();
+
+    timer.restart();
+    int separateMatches = 0;
+    for (const QByteArray& term : terms) {
+        const std::shared_ptr<const breco::SearchPlan> single =
+            breco::SearchPlan::compile(term, breco::TextInterpretationMode::Ascii, false);
+        QVector<breco::SearchHit> singleHits;
+        single->findAll(haystack.constData(), haystack.size(), haystack.size(), &singleHits);
+        separateMatches += singleHits.size();
+    }
+    const qint64 separateNs = timer.nsecsElapsed();
+
+    const double gib = static_cast<double>(haystack.size()) / (1024.0 * 1024.0 * 1024.0);
+    const double onePassSec = static_cast<double>(onePassNs) / 1e9;
+    const double separateSec = static_cast<double>(separateNs) / 1e9;
+    qInfo().noquote() << QStringLiteral("SearchPlan %1: terms=%2 one-pass=%3 ms (%4 GiB/s) "
+                                        "separate-passes=%5 ms matches=%6/%7")
+                             .arg(QString::fromLatin1(
+                                 breco::SearchPlan::algorithmName(plan->algorithm())))
+                             .arg(terms.size())
+                             .arg(QString::number(onePassSec * 1000.0, 'f', 2))
+                             .arg(QString::number(onePassSec > 0.0 ? gib / onePassSec : 0.0, 'f',
+                                                  2))
+                             .arg(QString::number(separateSec * 1000.0, 'f', 2))
+                             .arg(hits.size())
+                             .arg(separateMatches);
+}
+
+void benchmarkHexPatterns(const QByteArray& haystack, const QStringList& patterns) {
+    breco::SearchQuery query;
+    for (const QString& pattern : patterns) {
+        QByteArray bytes;
+        QByteArray mask;
+        breco::MatchUtils::parseHexPattern(pattern, &bytes, &mask);
+        query.terms.push_back(bytes);
+        query.masks.push_back(mask);
+    }
+    const std::shared_ptr<const breco::SearchPlan> plan = breco::SearchPlan::compile(query);
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<breco::SearchHit> hits;
+    plan->findAll(haystack.constData(), haystack.size(), haystack.size(), &hits);
+    const qint64 ns = timer.nsecsElapsed();
+
+    const double sec = static_cast<double>(ns) / 1e9;
+    const double gib = static_cast<double>(haystack.size()) / (1024.0 * 1024.0 * 1024.0);
+    qInfo().noquote() << QStringLiteral("SearchPlan %1: hex patterns=%2 time=%3 ms "
+                                        "throughput=%4 GiB/s matches=%5")
+                             .arg(QString::fromLatin1(
+                                 breco::SearchPlan::algorithmName(plan->algorithm())))
+                             .arg(patterns.size())
+                             .arg(QString::number(sec * 1000.0, 'f', 2))
+                             .arg(QString::number(sec > 0.0 ? gib / sec : 0.0, 'f', 2))
+                             .arg(hits.size());
+}
+
+// Lazy-DFA regex scan in 64 KiB blocks, with the DFA state carried from block to block.
+void benchmarkRegex(const QByteArray& haystack, const QByteArray& pattern) {
+    QString error;
+    const std::shared_ptr<const breco::ByteRegex> regex =
+        breco::ByteRegex::compile({pattern}, false, &error);
+    if (regex == nullptr) {
+        qWarning().noquote() << QStringLiteral("Regex %1: %2")
+                                    .arg(QString::fromLatin1(pattern), error);
+        return;
+    }
+    breco::ByteRegexScanner scanner(regex);
+    constexpr int kBlockSize = 64 * 1024;
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<breco::RegexMatch> matches;
+    QVector<breco::RegexMatch> blockMatches;
+    breco::RegexRun carried;
+    for (int start = 0; start < haystack.size(); start += kBlockSize) {
+        const int size = qMin(kBlockSize, static_cast<int>(haystack.size()) - start);
+        const char* data = haystack.constData() + start;
+        blockMatches.clear();
+        breco::RegexRun endRun;
+        scanner.scan(data, size, size, static_cast<quint64>(start), &blockMatches, &endRun);
+        scanner.resume(carried, data, size, size, static_cast<quint64>(start), &blockMatches,
+                       &endRun);
+        matches += blockMatches;
+        carried = std::move(endRun);
+    }
+    const qint64 ns = timer.nsecsElapsed();
+
+    const double sec = static_cast<double>(ns) / 1e9;
+    const double gib = static_cast<double>(haystack.size()) / (1024.0 * 1024.0 * 1024.0);
+    qInfo().noquote() << QStringLiteral("Regex %1: time=%2 ms throughput=%3 GiB/s matches=%4 "
+                                        "dfaStates=%5")
+                             .arg(QString::fromLatin1(pattern))
+                             .arg(QString::number(sec * 1000.0, 'f', 2))
+                             .arg(QString::number(sec > 0.0 ? gib / sec : 0.0, 'f', 2))
+                             .arg(matches.size())
+                             .arg(scanner.cachedStateCount());
+}
+
+void benchmarkApproximate(const QByteArray& haystack, const QByteArray& term,
+                          breco::ApproximateMetric metric, int maxDistance) {
+    breco::SearchQuery query;
+    query.terms = {term};
+    query.approximate = metric;
+    query.maxDistance = maxDistance;
+    const std::shared_ptr<const breco::SearchPlan> plan = breco::SearchPlan::compile(query);
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<breco::SearchHit> hits;
+    plan->findAll(haystack.constData(), haystack.size(), haystack.size(), &hits);
+    const qint64 ns = timer.nsecsElapsed();
+
+    const double sec = static_cast<double>(ns) / 1e9;
+    const double gib = static_cast<double>(haystack.size()) / (1024.0 * 1024.0 * 1024.0);
+    qInfo().noquote() << QStringLiteral("SearchPlan %1: term=%2 B k=%3 time=%4 ms "
+                                        "throughput=%5 GiB/s matches=%6")
+                             .arg(QString::fromLatin1(breco::SearchPlan::algorithmName(
+                                 plan->algorithm())))
+                             .arg(term.size())
+                             .arg(maxDistance)
+                             .arg(QString::number(sec * 1000.0, 'f', 2))
+                             .arg(QString::number(sec > 0.0 ? gib / sec : 0.0, 'f', 2))
+                             .arg(hits.size());
+}
+
+// One pass over raw bytes with the term precomputed at all 8 bit phases, against shifting the
+// whole buffer 8 times and searching each shifted copy.
+void benchmarkXorKeys(const QByteArray& haystack, const QByteArray& term) {
+    breco::SearchQuery query;
+    query.terms = {term};
+    query.xorKeys = true;
+    const std::shared_ptr<const breco::SearchPlan> plan = breco::SearchPlan::compile(query);
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<breco::SearchHit> hits;
+    plan->findAll(haystack.constData(), haystack.size(), haystack.size(), &hits);
+    const qint64 ns = timer.nsecsElapsed();
+
+    const double sec = static_cast<double>(ns) / 1e9;
+    const double gib = static_cast<double>(haystack.size()) / (1024.0 * 1024.0 * 1024.0);
+    qInfo().noquote() << QStringLiteral("SearchPlan xor-keys %1: term=%2 B keys=256 time=%3 ms "
+                                        "throughput=%4 GiB/s matches=%5")
+                             .arg(QString::fromLatin1(breco::SearchPlan::algorithmName(
+                                 plan->algorithm())))
+                             .arg(term.size())
+                             .arg(QString::number(sec * 1000.0, 'f', 2))
+                             .arg(QString::number(sec > 0.0 ? gib / sec : 0.0, 'f', 2))
+                             .arg(hits.size());
+}
+
+void benchmarkNumeric(const QByteArray& haystack, const QByteArray& number) {
+    breco::SearchQuery query;
+    query.terms = {number};
+    query.numeric = true;
+    query.tolerance = 0.001;
+    const std::shared_ptr<const breco::SearchPlan> plan = breco::SearchPlan::compile(query);
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<breco::SearchHit> hits;
+    plan->findAll(haystack.constData(), haystack.size(), haystack.size(), &hits);
+    const qint64 ns = timer.nsecsElapsed();
+
+    const double sec = static_cast<double>(ns) / 1e9;
+    const double gib = static_cast<double>(haystack.size()) / (1024.0 * 1024.0 * 1024.0);
+    qInfo().noquote() << QStringLiteral("SearchPlan numeric %1: value=%2 time=%3 ms "
+                                        "throughput=%4 GiB/s matches=%5")
+                             .arg(QString::fromLatin1(breco::SearchPlan::algorithmName(
+                                 plan->algorithm())))
+                             .arg(QString::fromUtf8(number))
+                             .arg(QString::number(sec * 1000.0, 'f', 2))
+                             .arg(QString::number(sec > 0.0 ? gib / sec : 0.0, 'f', 2))
+                             .arg(hits.size());
+}
+
+void benchmarkProximity(const QByteArray& haystack, const QByteArray& term,
+                        const QByteArray& nearTerm, int nearDistance) {
+    breco::SearchQuery query;
+    query.terms = {term};
+    query.nearTerms = {nearTerm};
+    query.nearDistance = nearDistance;
+    const std::shared_ptr<const breco::SearchPlan> plan = breco::SearchPlan::compile(query);
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<breco::SearchHit> hits;
+    plan->findAll(haystack.constData(), haystack.size(), haystack.size(), &hits);
+    const qint64 ns = timer.nsecsElapsed();
+
+    const double sec = static_cast<double>(ns) / 1e9;
+    const double gib = static_cast<double>(haystack.size()) / (1024.0 * 1024.0 * 1024.0);
+    qInfo().noquote() << QStringLiteral("SearchPlan proximity %1: distance=%2 time=%3 ms "
+                                        "throughput=%4 GiB/s matches=%5")
+                             .arg(QString::fromLatin1(breco::SearchPlan::algorithmName(
+                                 plan->algorithm())))
+                             .arg(nearDistance)
+                             .arg(QString::number(sec * 1000.0, 'f', 2))
+                             .arg(QString::number(sec > 0.0 ? gib / sec : 0.0, 'f', 2))
+                             .arg(hits.size());
+}
+
+void benchmarkBitPhases(const QByteArray& raw, const QByteArray& term) {
+    breco::SearchQuery query;
+    query.terms = {term};
+    query.bitPhases = true;
+    const std::shared_ptr<const breco::SearchPlan> plan = breco::SearchPlan::compile(query);
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<breco::SearchHit> hits;
+    plan->findAll(raw.constData(), raw.size(), raw.size(), &hits);
+    const qint64 onePassNs = timer.nsecsElapsed();
+
+    timer.restart();
+    const std::shared_ptr<const breco::SearchPlan> single =
+        breco::SearchPlan::compile(term, breco::TextInterpretationMode::Ascii, false);
+    const auto size = static_cast<quint64>(raw.size());
+    int shiftedMatches = 0;
+    for (int b = 0; b < 8; ++b) {
+        const QByteArray shifted = breco::ShiftTransform::transformWindow(
+            raw, 0, 0, size, size, breco::ShiftSettings{b, breco::ShiftUnit::Bits});
+        QVector<breco::SearchHit> shiftedHits;
+        single->findAll(shifted.constData(), shifted.size(), shifted.size(), &shiftedHits);
+        shiftedMatches += shiftedHits.size();
+    }
+    const qint64 shiftedNs = timer.nsecsElapsed();
+
+    qInfo().noquote() << QStringLiteral("SearchPlan bit phases: term=%1 B one-pass=%2 ms "
+                                        "shift-and-search x8=%3 ms matches=%4/%5")
+                             .arg(term.size())
+                             .arg(QString::number(static_cast<double>(onePassNs) / 1e6, 'f', 2))
+                             .arg(QString::number(static_cast<double>(shiftedNs) / 1e6, 'f', 2))
+                             .arg(hits.size())
+                             .arg(shiftedMatches);
+}
+
 void benchmarkShiftTransform(const QByteArray& raw, const breco::ShiftSettings& shift,
                              const char* label) {
     QElapsedTimer timer;
@@ -104,6 +440,53 @@ int main(int argc, char** argv) {
     benchmarkMatchUtils(haystack, QByteArrayLiteral("abcdef"), breco::TextInterpretationMode::Ascii,
                         true, "MatchUtils ignore-case");
 
+    const QByteArray longNeedle = QByteArrayLiteral("AbCdEfGhIjKlMnOp");
+    for (const breco::SearchKernel kernel :
+         {breco::SearchKernel::Scalar, breco::SearchKernel::Sse2, breco::SearchKernel::Avx2,
+          breco::SearchKernel::Avx512}) {
+        benchmarkSearchKernel(haystack, needle, kernel, false);
+        benchmarkSearchKernel(haystack, longNeedle, kernel, false);
+        benchmarkSearchKernel(haystack, breco::MatchUtils::foldAsciiCase(needle), kernel, true);
+        benchmarkSearchKernel(haystack, breco::MatchUtils::foldAsciiCase(longNeedle), kernel,
+                              true);
+    }
+
+    QByteArray planHaystack = haystack;
+    const QByteArray rareNeedle = QByteArray("Ab\xC3\xA9" "f");
+    const QByteArray mediumNeedle = longNeedle.repeated(4);
+    const QByteArray hugeNeedle = longNeedle.repeated(32);
+    const QByteArray carvedNeedle = makeBinaryData(64 * 1024, 4242U);
+    for (const QByteArray& planted : {rareNeedle, mediumNeedle, hugeNeedle}) {
+        for (int pos = 65536; pos + planted.size() < planHaystack.size(); pos += 1048576) {
+            planHaystack.replace(pos, planted.size(), planted);
+        }
+    }
+    for (int pos = 524288; pos + carvedNeedle.size() < planHaystack.size(); pos += 1048576) {
+        planHaystack.replace(pos, carvedNeedle.size(), carvedNeedle);
+    }
+    benchmarkSearchPlan(planHaystack, needle);
+    benchmarkSearchPlan(planHaystack, rareNeedle);
+    benchmarkSearchPlan(planHaystack, mediumNeedle);
+    benchmarkSearchPlan(planHaystack, hugeNeedle);
+    benchmarkSearchPlan(planHaystack, carvedNeedle);
+
+    QVector<QByteArray> indicatorTerms;
+    QRandomGenerator termRng(77U);
+    for (int i = 0; i < 500; ++i) {
+        QByteArray term(8 + static_cast<int>(termRng.bounded(8U)), Qt::Uninitialized);
+        for (char& ch : term) {
+            ch = static_cast<char>('!' + termRng.bounded(94U));
+        }
+        indicatorTerms.push_back(term);
+    }
+    benchmarkMultiPattern(planHaystack, indicatorTerms.mid(0, 8));
+    benchmarkMultiPattern(planHaystack, indicatorTerms);
+    benchmarkApproximate(planHaystack, longNeedle, breco::ApproximateMetric::Hamming, 2);
+    benchmarkApproximate(planHaystack, longNeedle, breco::ApproximateMetric::Edit, 2);
+    benchmarkXorKeys(planHaystack, longNeedle);
+    benchmarkNumeric(planHaystack, QByteArray("1700000000"));
+    benchmarkProximity(planHaystack, needle, rareNeedle, 65536);
+
     constexpr int kShiftBytes = 24 * 1024 * 1024;
     const QByteArray raw = makeBinaryData(kShiftBytes, 9001U);
 
@@ -111,6 +494,14 @@ int main(int argc, char** argv) {
                             "ShiftTransform byte+1");
     benchmarkShiftTransform(raw, breco::ShiftSettings{-3, breco::ShiftUnit::Bits},
                             "ShiftTransform bit-3");
+    benchmarkHexPatterns(raw, {QStringLiteral("4D 5A ?? ?0")});
+    benchmarkHexPatterns(raw, {QStringLiteral("4D 5A ?? ?0"), QStringLiteral("50 4B 03 04"),
+                               QStringLiteral("FF D8 FF E?"), QStringLiteral("25 50 44 46 2D")});
+    benchmarkBitPhases(raw, QByteArrayLiteral("MZ\x90\x00"));
+    benchmarkBitPhases(raw, QByteArrayLiteral("-----BEGIN"));
+    benchmarkRegex(raw, QByteArrayLiteral("PK\\x03\\x04.{26}"));
+    benchmarkRegex(raw, QByteArrayLiteral("[\\x20-\\x7e]{16,}\\x00"));
+    benchmarkRegex(raw, QByteArrayLiteral("(GET|POST) /[\\w/.-]+ HTTP/1\\.[01]"));
 
     return 0;
 }
@@ -1,23 +1,39 @@
 #include <QApplication>
 #include <QDir>
 #include <QDebug>
+#include <QEventLoop>
 #include <QFile>
 #include <QFileInfo>
 #include <QMouseEvent>
 #include <QRegularExpression>
 #include <QTemporaryDir>
+#include <QTimer>
 #include <QToolTip>
 
+#include <algorithm>
 #include <array>
+#include <bitset>
+#include <cstring>
 #include <limits>
 #include <optional>
+#include <tuple>
 #include <utility>
 
+#include "io/ExtentExporter.h"
 #include "io/FileEnumerator.h"
 #include "io/OpenFilePool.h"
 #include "io/ShiftedWindowLoader.h"
 #include "model/ResultModel.h"
+#include "scan/ApproximateSearch.h"
+#include "scan/ByteRegex.h"
+#include "scan/ByteSearch.h"
+#include "scan/EntropyMap.h"
+#include "scan/FileCarver.h"
+#include "scan/MatchStore.h"
 #include "scan/MatchUtils.h"
+#include "scan/MultiPatternSearch.h"
+#include "scan/ScanController.h"
+#include "scan/SearchPlan.h"
 #include "scan/SpscQueue.h"
 #include "scan/ShiftTransform.h"
 #include "text/StringModeRules.h"
@@ -57,6 +73,20 @@ void expectEqQString(const QString& actual, const QString& expected, const QStri
     }
 }
 
+// Deterministic test data: `size` bytes picked from `alphabet` (any byte value when it is empty)
+// by a linear congruential generator that continues from `*state`.
+QByteArray pseudoRandomBytes(quint32* state, int size, const QByteArray& alphabet = QByteArray()) {
+    QByteArray bytes;
+    bytes.reserve(size);
+    for (int i = 0; i < size; ++i) {
+        *state = *state * 1664525U + 1013904223U;
+        const auto value = static_cast<unsigned char>(*state >> 24);
+        bytes.append(alphabet.isEmpty() ? static_cast<char>(value)
+                                        : alphabet.at(value % alphabet.size()));
+    }
+    return bytes;
+}
+
 void testMatchUtilsIndexOf() {
     const QByteArray haystack("abCDxy");
     const QByteArray needle("cd");
@@ -69,6 +99,13 @@ void testMatchUtilsIndexOf() {
                                            true),
                 2, QStringLiteral("MatchUtils ignoreCase should fold ASCII bytes"));
 
+    expectEqInt(breco::MatchUtils::indexOf(haystack, QByteArray("xCd"), 0,
+                                           breco::TextInterpretationMode::Ascii, true),
+                -1, QStringLiteral("MatchUtils ignoreCase should fold an uppercase needle"));
+    expectEqInt(breco::MatchUtils::indexOf(haystack, QByteArray("Cd"), 0,
+                                           breco::TextInterpretationMode::Ascii, true),
+                2, QStringLiteral("MatchUtils ignoreCase should fold an uppercase needle"));
+
     expectEqInt(breco::MatchUtils::indexOf(haystack, needle, 0, breco::TextInterpretationMode::Utf16,
                                            true),
                 -1, QStringLiteral("MatchUtils UTF-16 mode should bypass ignoreCase fold"));
@@ -76,6 +113,1965 @@ void testMatchUtilsIndexOf() {
     expectEqInt(breco::MatchUtils::indexOf(haystack, QByteArray(), 0,
                                            breco::TextInterpretationMode::Ascii, true),
                 -1, QStringLiteral("MatchUtils ignoreCase path should reject empty needle"));
+
+    expectEqInt(breco::MatchUtils::indexOf(QByteArray("@{`{"), QByteArray("`{"), 0,
+                                           breco::TextInterpretationMode::Ascii, true),
+                2, QStringLiteral("MatchUtils ignoreCase should not fold non-letter bytes"));
+}
+
+void testByteSearchKernelsAgree() {
+    QByteArray haystack;
+    for (int i = 0; i < 1000; ++i) {
+        haystack.append(static_cast<char>('a' + ((i * 7) % 3)));
+    }
+    const QByteArray tail("abcXYZabc");
+    haystack.append(tail);
+    const QByteArray upperHaystack = haystack.toUpper();
+
+    const QVector<QByteArray> needles = {QByteArray("a"), QByteArray("ab"), QByteArray("cab"),
+                                         QByteArray("XYZ"), QByteArray("abcXYZabc"),
+                                         QByteArray("zz")};
+    const std::array<breco::SearchKernel, 4> kernels = {
+        breco::SearchKernel::Scalar, breco::SearchKernel::Sse2, breco::SearchKernel::Avx2,
+        breco::SearchKernel::Avx512};
+
+    for (const breco::SearchKernel kernel : kernels) {
+        if (!breco::ByteSearch::kernelSupported(kernel)) {
+            continue;
+        }
+        const QString kernelName = QString::fromLatin1(breco::ByteSearch::kernelName(kernel));
+        for (const QByteArray& needle : needles) {
+            for (const int from : {0, 1, 17, 995, static_cast<int>(haystack.size()) - 3}) {
+                expectEqInt(breco::ByteSearch::indexOf(haystack.constData(),
+                                                       static_cast<int>(haystack.size()),
+                                                       needle.constData(),
+                                                       static_cast<int>(needle.size()), from,
+                                                       kernel),
+                            static_cast<int>(haystack.indexOf(needle, from)),
+                            QStringLiteral("ByteSearch %1 should agree with QByteArray::indexOf "
+                                           "(needle=%2 from=%3)")
+                                .arg(kernelName, QString::fromLatin1(needle))
+                                .arg(from));
+                const QByteArray upperNeedle = needle.toUpper();
+                expectEqInt(breco::ByteSearch::indexOfFolded(
+                                upperHaystack.constData(), static_cast<int>(upperHaystack.size()),
+                                breco::MatchUtils::foldAsciiCase(upperNeedle).constData(),
+                                static_cast<int>(upperNeedle.size()), from, kernel),
+                            static_cast<int>(haystack.indexOf(needle, from)),
+                            QStringLiteral("ByteSearch %1 folded search should ignore ASCII case "
+                                           "(needle=%2 from=%3)")
+                                .arg(kernelName, QString::fromLatin1(needle))
+                                .arg(from));
+            }
+        }
+    }
+
+    // Fixed-width kernels report every start before the limit, like repeated indexOf calls.
+    const int startLimit = static_cast<int>(haystack.size()) - 7;
+    for (const breco::SearchKernel kernel : kernels) {
+        if (!breco::ByteSearch::kernelSupported(kernel)) {
+            continue;
+        }
+        const QString kernelName = QString::fromLatin1(breco::ByteSearch::kernelName(kernel));
+        for (int size = 1; size <= breco::ByteSearch::kMaxFixedNeedleSize; ++size) {
+            const QByteArray needle = haystack.mid(993, size);
+            QVector<int> expected;
+            for (int pos = static_cast<int>(haystack.indexOf(needle)); pos >= 0 && pos < startLimit;
+                 pos = static_cast<int>(haystack.indexOf(needle, pos + 1))) {
+                expected.push_back(pos);
+            }
+            QVector<int> exact;
+            breco::ByteSearch::findAllFunction(size, false, kernel)(
+                haystack.constData(), static_cast<int>(haystack.size()), startLimit,
+                needle.constData(), &exact);
+            QVector<int> folded;
+            breco::ByteSearch::findAllFunction(size, true, kernel)(
+                upperHaystack.constData(), static_cast<int>(upperHaystack.size()), startLimit,
+                breco::MatchUtils::foldAsciiCase(needle).constData(), &folded);
+            expectTrue(!expected.isEmpty() && exact == expected && folded == expected,
+                       QStringLiteral("ByteSearch %1 fixed-width kernels should find every start "
+                                      "(size=%2)")
+                           .arg(kernelName)
+                           .arg(size));
+        }
+    }
+    expectTrue(breco::ByteSearch::findAllFunction(breco::ByteSearch::kMaxFixedNeedleSize + 1,
+                                                  false) == nullptr,
+               QStringLiteral("ByteSearch should only specialise short needles"));
+
+    // Constant checks: a differing byte anywhere, including the lane tails, breaks the run.
+    for (const breco::SearchKernel kernel : kernels) {
+        if (!breco::ByteSearch::kernelSupported(kernel)) {
+            continue;
+        }
+        const QString kernelName = QString::fromLatin1(breco::ByteSearch::kernelName(kernel));
+        for (const int size : {1, 63, 64, 300, 4096}) {
+            QByteArray run(size, static_cast<char>(0xFF));
+            bool detected = breco::ByteSearch::isConstant(run.constData(), size, kernel);
+            for (const int at : {size - 1, size / 2, 0}) {
+                QByteArray broken = run;
+                broken[at] = 0x7F;
+                detected = detected && (size == 1 || !breco::ByteSearch::isConstant(
+                                                         broken.constData(), size, kernel));
+            }
+            expectTrue(detected, QStringLiteral("ByteSearch %1 should detect constant runs "
+                                                "(size=%2)")
+                                     .arg(kernelName)
+                                     .arg(size));
+        }
+    }
+    expectTrue(!breco::ByteSearch::isConstant(haystack.constData(), 0),
+               QStringLiteral("ByteSearch empty data should not be a constant run"));
+
+    expectTrue(breco::ByteSearch::kernelSupported(breco::ByteSearch::bestKernel()),
+               QStringLiteral("ByteSearch best kernel should be supported"));
+}
+
+void testSearchPlanAlgorithms() {
+    using breco::SearchAlgorithm;
+    using breco::SearchPlan;
+    using breco::TextInterpretationMode;
+
+    expectTrue(SearchPlan::compile("the", TextInterpretationMode::Ascii, false)->algorithm() ==
+                   SearchAlgorithm::SimdFirstLast,
+               QStringLiteral("SearchPlan should use SIMD first/last for common short needles"));
+    expectTrue(SearchPlan::compile("x\xE9y", TextInterpretationMode::Ascii, false)->algorithm() ==
+                   SearchAlgorithm::RareByteAnchor,
+               QStringLiteral("SearchPlan should anchor on a rare byte when one exists"));
+    expectTrue(SearchPlan::compile("a", TextInterpretationMode::Ascii, false)->algorithm() ==
+                   SearchAlgorithm::RareByteAnchor,
+               QStringLiteral("SearchPlan should use memchr for single-byte needles"));
+    expectTrue(SearchPlan::compile(QByteArray(64, 'q'), TextInterpretationMode::Ascii, false)
+                       ->algorithm() == SearchAlgorithm::Horspool,
+               QStringLiteral("SearchPlan should use Horspool for medium needles"));
+    expectTrue(SearchPlan::compile(QByteArray(300, 'q'), TextInterpretationMode::Ascii, false)
+                       ->algorithm() == SearchAlgorithm::TwoWay,
+               QStringLiteral("SearchPlan should use Two-Way for long needles"));
+    expectTrue(SearchPlan::compile("abc", TextInterpretationMode::Ascii, true,
+                                   SearchAlgorithm::RareByteAnchor)
+                       ->algorithm() == SearchAlgorithm::SimdFirstLast,
+               QStringLiteral("SearchPlan should not anchor on a letter when folding case"));
+    expectTrue(!SearchPlan::compile("ab", TextInterpretationMode::Utf16, true)->foldsCase(),
+               QStringLiteral("SearchPlan should keep UTF-16 ignore-case searches exact"));
+
+    QByteArray haystack;
+    for (int i = 0; i < 4000; ++i) {
+        haystack.append(static_cast<char>("abab-\0"[(i * 5 + i / 7) % 6]));
+    }
+    const QByteArray periodic = QByteArray("ab").repeated(160);
+    const QByteArray longTerm = QByteArray("abab-").repeated(70) + QByteArray("Z");
+    haystack.append(periodic);
+    haystack.append(longTerm);
+    haystack.append(QByteArray("x\xE9y"));
+    const QByteArray upperHaystack = haystack.toUpper();
+
+    const QVector<QByteArray> needles = {QByteArray("b"),     QByteArray("ab-"),
+                                         QByteArray("-ab"),   QByteArray("x\xE9y"),
+                                         periodic.left(40),   periodic,
+                                         longTerm,            QByteArray("zzzz")};
+    const std::array<SearchAlgorithm, 4> algorithms = {
+        SearchAlgorithm::SimdFirstLast, SearchAlgorithm::RareByteAnchor,
+        SearchAlgorithm::Horspool, SearchAlgorithm::TwoWay};
+    for (const SearchAlgorithm algorithm : algorithms) {
+        const QString name = QString::fromLatin1(SearchPlan::algorithmName(algorithm));
+        for (const QByteArray& needle : needles) {
+            const auto exact =
+                SearchPlan::compile(needle, TextInterpretationMode::Ascii, false, algorithm);
+            const auto folded = SearchPlan::compile(needle.toUpper(),
+                                                    TextInterpretationMode::Ascii, true, algorithm);
+            for (const int from : {0, 3, 1001, static_cast<int>(haystack.size()) - 5}) {
+                const int expected = static_cast<int>(haystack.indexOf(needle, from));
+                expectEqInt(exact->indexOf(haystack.constData(),
+                                           static_cast<int>(haystack.size()), from),
+                            expected,
+                            QStringLiteral("SearchPlan %1 should agree with QByteArray::indexOf "
+                                           "(needle size=%2 from=%3)")
+                                .arg(name)
+                                .arg(needle.size())
+                                .arg(from));
+                expectEqInt(folded->indexOf(upperHaystack.constData(),
+                                            static_cast<int>(upperHaystack.size()), from),
+                            expected,
+                            QStringLiteral("SearchPlan %1 should ignore ASCII case "
+                                           "(needle size=%2 from=%3)")
+                                .arg(name)
+                                .arg(needle.size())
+                                .arg(from));
+            }
+        }
+    }
+    // Two-Way findAll continues after a hit by the needle's period, trusting the bytes the hit
+    // shares with the next window. Runs broken by one wrong byte within a period end that trust
+    // exactly where it must stop; a startLimit inside a run cuts the matches short.
+    QByteArray runs;
+    const std::array<const char*, 4> breaks = {"x123456", "0123x56", "01234", "x"};
+    for (int i = 0; i < 12; ++i) {
+        runs.append(QByteArray("0123456").repeated(150 + 37 * i));
+        runs.append(breaks.at(static_cast<size_t>(i) % breaks.size()));
+    }
+    const QByteArray upperRuns = runs.toUpper();
+    const int runsSize = static_cast<int>(runs.size());
+    const QVector<QByteArray> runNeedles = {QByteArray("0123456").repeated(100),
+                                            QByteArray("0123456").repeated(60) + "x",
+                                            QByteArray("x") + QByteArray("0123456").repeated(60)};
+    for (const QByteArray& needle : runNeedles) {
+        const auto exact = SearchPlan::compile(needle, TextInterpretationMode::Ascii, false,
+                                               SearchAlgorithm::TwoWay);
+        const auto folded = SearchPlan::compile(needle.toUpper(), TextInterpretationMode::Ascii,
+                                                true, SearchAlgorithm::TwoWay);
+        for (const int startLimit : {runsSize, runsSize / 2}) {
+            QVector<int> expected;
+            for (int pos = 0; pos < startLimit && pos + needle.size() <= runsSize; ++pos) {
+                if (std::memcmp(runs.constData() + pos, needle.constData(),
+                                static_cast<size_t>(needle.size())) == 0) {
+                    expected.push_back(pos);
+                }
+            }
+            QVector<breco::SearchHit> exactHits;
+            QVector<breco::SearchHit> foldedHits;
+            exact->findAll(runs.constData(), runsSize, startLimit, &exactHits);
+            folded->findAll(upperRuns.constData(), runsSize, startLimit, &foldedHits);
+            QVector<int> exactStarts;
+            QVector<int> foldedStarts;
+            for (const breco::SearchHit& hit : exactHits) {
+                exactStarts.push_back(hit.offset);
+            }
+            for (const breco::SearchHit& hit : foldedHits) {
+                foldedStarts.push_back(hit.offset);
+            }
+            expectTrue(!expected.isEmpty() && exactStarts == expected &&
+                           foldedStarts == expected,
+                       QStringLiteral("Two-Way findAll should find every overlapping match "
+                                      "(needle size=%1 startLimit=%2 matches=%3)")
+                           .arg(needle.size())
+                           .arg(startLimit)
+                           .arg(expected.size()));
+        }
+    }
+
+    // Scans skip the inside of constant runs the plan cannot match.
+    breco::SearchQuery zeroTerm;
+    zeroTerm.terms = {QByteArray(2, '\0')};
+    zeroTerm.masks = {QByteArray(2, static_cast<char>(0xFF))};
+    breco::SearchQuery ignoreCase;
+    ignoreCase.terms = {QByteArray("aA")};
+    ignoreCase.ignoreCase = true;
+    breco::SearchQuery regex;
+    regex.terms = {QByteArray("x+")};
+    regex.regex = true;
+    breco::SearchQuery wideProximity;
+    wideProximity.terms = {QByteArray("alpha")};
+    wideProximity.nearTerms = {QByteArray("beta")};
+    wideProximity.nearDistance = SearchPlan::kMaxNearDistance;
+    const std::bitset<256> zeroRuns = SearchPlan::compile(zeroTerm)->constantRunMatches();
+    const std::bitset<256> letterRuns = SearchPlan::compile(ignoreCase)->constantRunMatches();
+    expectTrue(zeroRuns.count() == 1 && zeroRuns[0] && letterRuns.count() == 2 &&
+                   letterRuns['a'] && letterRuns['A'] &&
+                   SearchPlan::compile("ab", TextInterpretationMode::Ascii, false)
+                       ->constantRunMatches()
+                       .none() &&
+                   SearchPlan::compile(regex)->constantRunMatches().all(),
+               QStringLiteral("SearchPlan should report the constant runs it can match"));
+    expectTrue(SearchPlan::compile(wideProximity)->constantRunMatches().all(),
+               QStringLiteral("SearchPlan should not probe runs longer than "
+                              "kMaxConstantRunProbe"));
+}
+
+void testMultiPatternSearchEnginesAgree() {
+    using breco::MultiPatternEngine;
+    using breco::MultiPatternSearch;
+    using breco::PatternHit;
+
+    QByteArray haystack;
+    for (int i = 0; i < 3000; ++i) {
+        haystack.append(static_cast<char>("abcab-AB"[(i * 7 + i / 5) % 8]));
+    }
+    haystack.append("needle HAYSTACK needle");
+    const QVector<QByteArray> patterns = {QByteArray("abc"),      QByteArray("cab"),
+                                          QByteArray("bca"),      QByteArray("needle"),
+                                          QByteArray("haystack"), QByteArray("ab-ab"),
+                                          QByteArray("zzz"),      QByteArray("abc")};
+    const int startLimit = static_cast<int>(haystack.size()) - 10;
+
+    auto naiveHits = [&](bool foldCase) {
+        const QByteArray searched =
+            foldCase ? breco::MatchUtils::foldAsciiCase(haystack) : haystack;
+        QVector<PatternHit> hits;
+        for (int pos = 0; pos < startLimit; ++pos) {
+            for (int p = 0; p < patterns.size(); ++p) {
+                if (searched.mid(pos, patterns.at(p).size()) == patterns.at(p)) {
+                    hits.push_back(PatternHit{pos, p});
+                }
+            }
+        }
+        return hits;
+    };
+
+    for (const bool foldCase : {false, true}) {
+        const QVector<PatternHit> expected = naiveHits(foldCase);
+        for (const MultiPatternEngine engine :
+             {MultiPatternEngine::Teddy, MultiPatternEngine::AhoCorasick}) {
+            const QString name = QStringLiteral("%1%2").arg(
+                QString::fromLatin1(MultiPatternSearch::engineName(engine)),
+                foldCase ? QStringLiteral(" ignore-case") : QString());
+            const MultiPatternSearch search(patterns, foldCase, engine);
+            QVector<PatternHit> hits;
+            search.findAll(haystack.constData(), static_cast<int>(haystack.size()), startLimit,
+                           &hits);
+            expectEqInt(static_cast<int>(hits.size()), static_cast<int>(expected.size()),
+                        QStringLiteral("MultiPatternSearch %1 hit count").arg(name));
+            bool sameHits = hits.size() == expected.size();
+            for (int i = 0; sameHits && i < hits.size(); ++i) {
+                sameHits = hits.at(i).offset == expected.at(i).offset &&
+                           hits.at(i).patternIdx == expected.at(i).patternIdx;
+            }
+            expectTrue(sameHits, QStringLiteral("MultiPatternSearch %1 should report every "
+                                                "(offset, pattern) in order")
+                                     .arg(name));
+        }
+    }
+
+    // Pairs of every byte value: 256 byte classes besides the one of unused bytes.
+    QVector<QByteArray> allBytePatterns;
+    for (int b = 0; b < 256; b += 2) {
+        QByteArray pair(2, static_cast<char>(b));
+        pair[1] = static_cast<char>(b + 1);
+        allBytePatterns.push_back(pair);
+    }
+    quint32 state = 0x2468ACE1U;
+    const QByteArray binary = pseudoRandomBytes(&state, 20000);
+    for (const bool foldCase : {false, true}) {
+        const QByteArray searched = foldCase ? breco::MatchUtils::foldAsciiCase(binary) : binary;
+        QVector<QByteArray> searchedPatterns = allBytePatterns;
+        if (foldCase) {
+            for (QByteArray& pattern : searchedPatterns) {
+                pattern = breco::MatchUtils::foldAsciiCase(pattern);
+            }
+        }
+        QVector<PatternHit> expected;
+        for (int pos = 0; pos + 1 < searched.size(); ++pos) {
+            for (int p = 0; p < searchedPatterns.size(); ++p) {
+                if (searched.mid(pos, 2) == searchedPatterns.at(p)) {
+                    expected.push_back(PatternHit{pos, p});
+                }
+            }
+        }
+        for (const MultiPatternEngine engine :
+             {MultiPatternEngine::Teddy, MultiPatternEngine::AhoCorasick}) {
+            const QString name = QStringLiteral("%1%2").arg(
+                QString::fromLatin1(MultiPatternSearch::engineName(engine)),
+                foldCase ? QStringLiteral(" ignore-case") : QString());
+            const MultiPatternSearch search(searchedPatterns, foldCase, engine);
+            QVector<PatternHit> hits;
+            search.findAll(binary.constData(), static_cast<int>(binary.size()),
+                           static_cast<int>(binary.size()), &hits);
+            bool sameHits = hits.size() == expected.size() && !expected.isEmpty();
+            for (int i = 0; sameHits && i < hits.size(); ++i) {
+                sameHits = hits.at(i).offset == expected.at(i).offset &&
+                           hits.at(i).patternIdx == expected.at(i).patternIdx;
+            }
+            expectTrue(sameHits, QStringLiteral("MultiPatternSearch %1 should find patterns "
+                                                "using every byte value")
+                                     .arg(name));
+        }
+    }
+
+    const auto plan = breco::SearchPlan::compile(QVector<QByteArray>{"needle", "HAYSTACK"},
+                                                 breco::TextInterpretationMode::Ascii, false);
+    expectEqInt(plan->termCount(), 2, QStringLiteral("SearchPlan should keep every term"));
+    expectEqInt(plan->maxNeedleSize(), 8,
+                QStringLiteral("SearchPlan max needle size should be the longest term"));
+    QVector<breco::SearchHit> planHits;
+    plan->findAll(haystack.constData(), static_cast<int>(haystack.size()),
+                  static_cast<int>(haystack.size()), &planHits);
+    expectEqInt(static_cast<int>(planHits.size()), 3, QStringLiteral("SearchPlan multi-term should find all terms"));
+    if (planHits.size() == 3) {
+        expectEqInt(planHits.at(1).termIdx, 1,
+                    QStringLiteral("SearchPlan multi-term hits should carry the term index"));
+    }
+}
+
+void testHexPatternSearch() {
+    QByteArray bytes;
+    QByteArray mask;
+    expectTrue(breco::MatchUtils::parseHexPattern(QStringLiteral("4D 5a ?? ?0"), &bytes, &mask),
+               QStringLiteral("Hex pattern with byte and nibble wildcards should parse"));
+    expectTrue(bytes == QByteArray("\x4D\x5A\x00\x00", 4) &&
+                   mask == QByteArray("\xFF\xFF\x00\x0F", 4),
+               QStringLiteral("Hex pattern should compile to value + mask bytes"));
+    expectEqQString(breco::MatchUtils::formatHexPattern(bytes, mask),
+                    QStringLiteral("4D 5A ?? ?0"),
+                    QStringLiteral("Hex pattern should format back with wildcards"));
+    for (const QString& invalid : {QStringLiteral("4G"), QStringLiteral("4D 5"),
+                                   QStringLiteral("?? ??"), QStringLiteral("  ")}) {
+        QByteArray ignoredBytes;
+        QByteArray ignoredMask;
+        expectTrue(!breco::MatchUtils::parseHexPattern(invalid, &ignoredBytes, &ignoredMask),
+                   QStringLiteral("Invalid hex pattern should be rejected: %1").arg(invalid));
+    }
+
+    quint32 state = 0x13579BDFU;
+    QByteArray haystack = pseudoRandomBytes(&state, 5000, QByteArray("MZPE\x00\x10\x90\xFF", 8));
+    const QVector<QString> patterns = {QStringLiteral("4D 5A ?? ?0"), QStringLiteral("?? 50 45"),
+                                       QStringLiteral("0? 1?"), QStringLiteral("4D5A9000")};
+    QVector<QByteArray> terms;
+    QVector<QByteArray> masks;
+    for (const QString& pattern : patterns) {
+        breco::MatchUtils::parseHexPattern(pattern, &bytes, &mask);
+        terms.push_back(bytes);
+        masks.push_back(mask);
+    }
+    auto maskedAt = [&](int pos, int t) {
+        if (pos + terms.at(t).size() > haystack.size()) {
+            return false;
+        }
+        for (int j = 0; j < terms.at(t).size(); ++j) {
+            if ((haystack.at(pos + j) & masks.at(t).at(j)) != terms.at(t).at(j)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    const std::array<breco::SearchKernel, 4> kernels = {
+        breco::SearchKernel::Scalar, breco::SearchKernel::Sse2, breco::SearchKernel::Avx2,
+        breco::SearchKernel::Avx512};
+    for (const breco::SearchKernel kernel : kernels) {
+        if (!breco::ByteSearch::kernelSupported(kernel)) {
+            continue;
+        }
+        for (int t = 0; t < terms.size(); ++t) {
+            int expected = -1;
+            for (int pos = 7; pos < haystack.size() && expected < 0; ++pos) {
+                expected = maskedAt(pos, t) ? pos : -1;
+            }
+            expectEqInt(breco::ByteSearch::indexOfMasked(
+                            haystack.constData(), static_cast<int>(haystack.size()),
+                            terms.at(t).constData(), masks.at(t).constData(),
+                            static_cast<int>(terms.at(t).size()), 7, kernel),
+                        expected,
+                        QStringLiteral("ByteSearch %1 masked search should find %2")
+                            .arg(QString::fromLatin1(breco::ByteSearch::kernelName(kernel)),
+                                 patterns.at(t)));
+        }
+    }
+
+    const int startLimit = static_cast<int>(haystack.size()) - 2;
+    for (const int termCount : {1, static_cast<int>(terms.size())}) {
+        breco::SearchQuery query;
+        query.terms = terms.mid(0, termCount);
+        query.masks = masks.mid(0, termCount);
+        query.ignoreCase = true;
+        const auto plan = breco::SearchPlan::compile(query);
+        expectEqInt(plan->maxMatchSpan(), 10,
+                    QStringLiteral("Encoding-variant plan should overlap jobs by the longest form"));
+        QVector<breco::SearchHit> hits;
+        plan->findAll(haystack.constData(), static_cast<int>(haystack.size()), startLimit, &hits);
+        QVector<breco::SearchHit> expected;
+        for (int pos = 0; pos < startLimit; ++pos) {
+            for (int t = 0; t < termCount; ++t) {
+                if (maskedAt(pos, t)) {
+                    expected.push_back(breco::SearchHit{pos, t, 0});
+                }
+            }
+        }
+        bool sameHits = hits.size() == expected.size() && !expected.isEmpty();
+        for (int i = 0; sameHits && i < hits.size(); ++i) {
+            sameHits = hits.at(i).offset == expected.at(i).offset &&
+                       hits.at(i).termIdx == expected.at(i).termIdx;
+        }
+        expectTrue(sameHits, QStringLiteral("SearchPlan %1 should report every hex pattern match")
+                                 .arg(QString::fromLatin1(
+                                     breco::SearchPlan::algorithmName(plan->algorithm()))));
+    }
+}
+
+void testSearchPlanBitPhases() {
+    quint32 state = 0x2468ACE1U;
+    QByteArray haystack = pseudoRandomBytes(&state, 4096);
+    const QVector<QByteArray> terms = {QByteArray("MZ"), QByteArray("Key"), QByteArray("\x7F")};
+    // Plant every term at every bit phase by writing it into a shifted view and shifting back.
+    for (int b = 0; b < 8; ++b) {
+        for (int t = 0; t < terms.size(); ++t) {
+            const int pos = 100 + (b * terms.size() + t) * 97;
+            const QByteArray& term = terms.at(t);
+            for (int i = 0; i < term.size() * 8; ++i) {
+                const int bit = (pos * 8) + b + i;
+                const bool set =
+                    ((static_cast<unsigned char>(term.at(i / 8)) >> (7 - i % 8)) & 1) != 0;
+                const auto mask = static_cast<char>(0x80 >> (bit % 8));
+                haystack[bit / 8] = set ? static_cast<char>(haystack.at(bit / 8) | mask)
+                                        : static_cast<char>(haystack.at(bit / 8) & ~mask);
+            }
+        }
+    }
+    const int startLimit = static_cast<int>(haystack.size()) - 40;
+    const auto size = static_cast<quint64>(haystack.size());
+
+    QVector<breco::SearchHit> expected;
+    for (int b = 0; b < 8; ++b) {
+        const QByteArray shifted = breco::ShiftTransform::transformWindow(
+            haystack, 0, 0, size, size, breco::ShiftSettings{b, breco::ShiftUnit::Bits});
+        for (int t = 0; t < terms.size(); ++t) {
+            const int termSize = static_cast<int>(terms.at(t).size());
+            for (int pos = shifted.indexOf(terms.at(t)); pos >= 0 && pos < startLimit;
+                 pos = shifted.indexOf(terms.at(t), pos + 1)) {
+                if (b == 0 || pos + termSize < haystack.size()) {
+                    expected.push_back(breco::SearchHit{pos, t, b});
+                }
+            }
+        }
+    }
+    std::sort(expected.begin(), expected.end(),
+              [](const breco::SearchHit& lhs, const breco::SearchHit& rhs) {
+                  if (lhs.offset != rhs.offset) {
+                      return lhs.offset < rhs.offset;
+                  }
+                  return lhs.termIdx != rhs.termIdx ? lhs.termIdx < rhs.termIdx
+                                                    : lhs.bitOffset < rhs.bitOffset;
+              });
+    expectTrue(expected.size() >= 8 * terms.size(),
+               QStringLiteral("Bit phase test should plant every term at every phase"));
+
+    breco::SearchQuery query;
+    query.terms = terms;
+    query.bitPhases = true;
+    const auto plan = breco::SearchPlan::compile(query);
+    expectEqInt(plan->maxMatchSpan(), 4,
+                QStringLiteral("Bit phase plan should span one byte more than the longest term"));
+    QVector<breco::SearchHit> hits;
+    plan->findAll(haystack.constData(), static_cast<int>(haystack.size()), startLimit, &hits);
+    expectEqInt(static_cast<int>(hits.size()), static_cast<int>(expected.size()),
+                QStringLiteral("Bit phase plan hit count should match shifted views"));
+    bool sameHits = hits.size() == expected.size();
+    for (int i = 0; sameHits && i < hits.size(); ++i) {
+        sameHits = hits.at(i).offset == expected.at(i).offset &&
+                   hits.at(i).termIdx == expected.at(i).termIdx &&
+                   hits.at(i).bitOffset == expected.at(i).bitOffset;
+    }
+    expectTrue(sameHits, QStringLiteral("Bit phase plan should report every (offset, term, bit) "
+                                        "seen with Shift = Bits +N"));
+}
+
+void testByteRegex() {
+    for (const char* invalid : {"", "a*", "x?|y*", "(ab", "ab)", "*a", "a{3,1}", "a{2000}",
+                                "\\q", "\\x4", "^ab", "[ab"}) {
+        QString error;
+        expectTrue(breco::ByteRegex::compile({QByteArray(invalid)}, false, &error) == nullptr &&
+                       !error.isEmpty(),
+                   QStringLiteral("Invalid regex should be rejected: %1").arg(invalid));
+    }
+
+    quint32 state = 0x0BADF00DU;
+    QByteArray haystack = pseudoRandomBytes(&state, 6000, QByteArray("abx0\x00", 5));
+    const int size = static_cast<int>(haystack.size());
+
+    // A fixed-length regex finds exactly what its literal expansions find.
+    breco::SearchQuery query;
+    query.regex = true;
+    query.terms = {QByteArray("a[bx]0|\\x00\\x00b")};
+    const auto regexPlan = breco::SearchPlan::compile(query);
+    expectTrue(regexPlan != nullptr && regexPlan->algorithm() == breco::SearchAlgorithm::LazyDfa,
+               QStringLiteral("Regex query should compile to the lazy DFA plan"));
+    expectEqInt(regexPlan->maxMatchSpan(), 1,
+                QStringLiteral("Regex plan should not ask the reader for an overlap"));
+    const auto literalPlan = breco::SearchPlan::compile(
+        QVector<QByteArray>{QByteArray("ab0"), QByteArray("ax0"), QByteArray("\x00\x00" "b", 3)},
+        breco::TextInterpretationMode::Ascii, false);
+    QVector<breco::SearchHit> regexHits;
+    QVector<breco::SearchHit> literalHits;
+    regexPlan->findAll(haystack.constData(), size, size, &regexHits);
+    literalPlan->findAll(haystack.constData(), size, size, &literalHits);
+    bool sameStarts = !regexHits.isEmpty() && regexHits.size() == literalHits.size();
+    for (int i = 0; sameStarts && i < regexHits.size(); ++i) {
+        sameStarts = regexHits.at(i).offset == literalHits.at(i).offset;
+    }
+    expectTrue(sameStarts, QStringLiteral("Regex alternation should match its literal expansion"));
+    breco::SearchQuery otherQuery = query;
+    otherQuery.terms = {QByteArray("x0+")};
+    QVector<breco::SearchHit> otherHits;
+    breco::SearchPlan::compile(otherQuery)->findAll(haystack.constData(), size, size, &otherHits);
+    QVector<breco::SearchHit> repeatedHits;
+    regexPlan->findAll(haystack.constData(), size, size, &repeatedHits);
+    bool sameRepeated = !otherHits.isEmpty() && repeatedHits.size() == regexHits.size();
+    for (int i = 0; sameRepeated && i < repeatedHits.size(); ++i) {
+        sameRepeated = repeatedHits.at(i).offset == regexHits.at(i).offset;
+    }
+    expectTrue(sameRepeated,
+               QStringLiteral("Regex plans should keep their matches when a thread switches plans"));
+
+    // Variable-length matches report the shortest match per start, also when a match spans the
+    // boundary between two blocks and continues as a carried run.
+    QString error;
+    const auto regex = breco::ByteRegex::compile({QByteArray("0x+a"), QByteArray("b[^0]{2}")},
+                                                 false, &error);
+    QVector<std::pair<quint64, quint64>> expected;
+    for (int p = 0; p < size; ++p) {
+        if (haystack.at(p) == '0') {
+            int end = p + 1;
+            while (end < size && haystack.at(end) == 'x') {
+                ++end;
+            }
+            if (end > p + 1 && end < size && haystack.at(end) == 'a') {
+                expected.push_back({static_cast<quint64>(p), static_cast<quint64>(end + 1 - p)});
+            }
+        } else if (haystack.at(p) == 'b' && p + 2 < size && haystack.at(p + 1) != '0' &&
+                   haystack.at(p + 2) != '0') {
+            expected.push_back({static_cast<quint64>(p), 3});
+        }
+    }
+    for (const int blockSize : {size, 7, 1}) {
+        breco::ByteRegexScanner scanner(regex);
+        QVector<breco::RegexMatch> matches;
+        breco::RegexRun carried;
+        for (int start = 0; start < size; start += blockSize) {
+            const int length = qMin(blockSize, size - start);
+            QVector<breco::RegexMatch> blockMatches;
+            breco::RegexRun endRun;
+            scanner.scan(haystack.constData() + start, length, length, start, &blockMatches,
+                         &endRun);
+            scanner.resume(carried, haystack.constData() + start, length, length, start,
+                           &blockMatches, &endRun);
+            matches += blockMatches;
+            carried = std::move(endRun);
+        }
+        std::sort(matches.begin(), matches.end(),
+                  [](const breco::RegexMatch& lhs, const breco::RegexMatch& rhs) {
+                      return lhs.start < rhs.start;
+                  });
+        bool sameMatches = !expected.isEmpty() && matches.size() == expected.size();
+        for (int i = 0; sameMatches && i < matches.size(); ++i) {
+            sameMatches = matches.at(i).start == expected.at(i).first &&
+                          matches.at(i).length == expected.at(i).second;
+        }
+        expectTrue(sameMatches, QStringLiteral("Regex matches should not depend on block size %1")
+                                    .arg(blockSize));
+    }
+
+    const auto folded = breco::ByteRegex::compile({QByteArray("pk\\x03[\\x04-\\x08]")}, true,
+                                                  &error);
+    breco::ByteRegexScanner foldedScanner(folded);
+    QVector<breco::RegexMatch> foldedMatches;
+    breco::RegexRun open;
+    const QByteArray zip("..PK\x03\x04..pK\x03\x09", 12);
+    foldedScanner.scan(zip.constData(), static_cast<int>(zip.size()),
+                       static_cast<int>(zip.size()), 0, &foldedMatches, &open);
+    expectTrue(foldedMatches.size() == 1 && foldedMatches.first().start == 2 &&
+                   foldedMatches.first().length == 4,
+               QStringLiteral("Ignore-case regex should fold letters but not byte ranges"));
+
+    // A start whose run is in the same DFA state as an older start's run is shadowed by it: only
+    // the oldest open BEGIN reports, and the carried state stays small whatever the data.
+    const auto spanning = breco::ByteRegex::compile({QByteArray("BEGIN[^\\x00]*END")}, false,
+                                                    &error);
+    QByteArray records;
+    while (records.size() < 200000) {
+        records.append("BEGIN record ");
+    }
+    records.append("END");
+    records.append('\0');
+    records.append("BEGIN tail END");
+    const int recordsSize = static_cast<int>(records.size());
+    for (const int blockSize : {recordsSize, 4096, 13}) {
+        breco::ByteRegexScanner scanner(spanning);
+        QVector<breco::RegexMatch> matches;
+        breco::RegexRun carried;
+        size_t largestCarry = 0;
+        for (int start = 0; start < recordsSize; start += blockSize) {
+            const int length = qMin(blockSize, recordsSize - start);
+            breco::RegexRun endRun;
+            scanner.scan(records.constData() + start, length, length, start, &matches, &endRun);
+            scanner.resume(carried, records.constData() + start, length, length, start, &matches,
+                           &endRun);
+            carried = std::move(endRun);
+            largestCarry = std::max(largestCarry, carried.starts.size());
+        }
+        std::sort(matches.begin(), matches.end(),
+                  [](const breco::RegexMatch& lhs, const breco::RegexMatch& rhs) {
+                      return lhs.start < rhs.start;
+                  });
+        expectTrue(matches.size() == 2 && matches.at(0).start == 0 &&
+                       matches.at(0).length == static_cast<quint64>(recordsSize - 15) &&
+                       matches.at(1).start == static_cast<quint64>(recordsSize - 14) &&
+                       largestCarry <= 2,
+                   QStringLiteral("Shadowed regex starts should not be carried (block size %1)")
+                       .arg(blockSize));
+    }
+}
+
+void testEncodingVariants() {
+    const QByteArray eAcute("A\xC3\xA9");
+    expectTrue(breco::MatchUtils::encodeTerm(eAcute, breco::TermEncoding::Utf16Le) ==
+                       QByteArray("A\x00\xE9\x00", 4) &&
+                   breco::MatchUtils::encodeTerm(eAcute, breco::TermEncoding::Utf16Be) ==
+                       QByteArray("\x00" "A\x00\xE9", 4),
+               QStringLiteral("UTF-8 terms should re-encode as UTF-16LE/BE code units"));
+
+    const QVector<QByteArray> terms = {QByteArray("Gr\xC3\xBC\xC3\x9F" "e"), QByteArray("key")};
+    const std::array<breco::TermEncoding, 3> encodings = {breco::TermEncoding::Utf8,
+                                                          breco::TermEncoding::Utf16Le,
+                                                          breco::TermEncoding::Utf16Be};
+    quint32 state = 0x31415926U;
+    QByteArray haystack = pseudoRandomBytes(&state, 3000, QByteArray("keyKEY\x00Gr", 9));
+    for (int i = 0; i < 12; ++i) {
+        const QByteArray term = terms.at(i % terms.size());
+        const QByteArray bytes = breco::MatchUtils::encodeTerm(term, encodings.at(i % 3));
+        haystack.replace(150 + i * 211, bytes.size(), bytes);
+    }
+    haystack.replace(2900, 6, breco::MatchUtils::encodeTerm("KEY", breco::TermEncoding::Utf16Le));
+
+    for (const bool ignoreCase : {false, true}) {
+        QVector<breco::SearchHit> expected;
+        for (int pos = 0; pos < haystack.size(); ++pos) {
+            for (int t = 0; t < terms.size(); ++t) {
+                for (const breco::TermEncoding encoding : encodings) {
+                    // Only ASCII letters vary in case here, so byte folding is the reference.
+                    const bool fold = ignoreCase;
+                    const QByteArray bytes = breco::MatchUtils::encodeTerm(terms.at(t), encoding);
+                    const QByteArray window = haystack.mid(pos, bytes.size());
+                    if (window.size() == bytes.size() &&
+                        (fold ? breco::MatchUtils::foldAsciiCase(window) ==
+                                    breco::MatchUtils::foldAsciiCase(bytes)
+                              : window == bytes)) {
+                        expected.push_back(breco::SearchHit{pos, t, 0, encoding});
+                    }
+                }
+            }
+        }
+
+        breco::SearchQuery query;
+        query.terms = terms;
+        query.ignoreCase = ignoreCase;
+        query.encodingVariants = true;
+        const auto plan = breco::SearchPlan::compile(query);
+        expectEqInt(plan->maxMatchSpan(), ignoreCase ? 1 : 10,
+                    QStringLiteral("Encoding-variant plan should report its match span"));
+        QVector<breco::SearchHit> hits;
+        plan->findAll(haystack.constData(), static_cast<int>(haystack.size()),
+                      static_cast<int>(haystack.size()), &hits);
+        bool sameHits = expected.size() >= 12 && hits.size() == expected.size();
+        for (int i = 0; sameHits && i < hits.size(); ++i) {
+            sameHits = hits.at(i).offset == expected.at(i).offset &&
+                       hits.at(i).termIdx == expected.at(i).termIdx &&
+                       hits.at(i).encoding == expected.at(i).encoding;
+        }
+        expectTrue(sameHits, QStringLiteral("Encoding-variant plan should find every term in "
+                                            "UTF-8, UTF-16LE and UTF-16BE (ignoreCase=%1)")
+                                 .arg(ignoreCase ? 1 : 0));
+    }
+
+    breco::SearchQuery single;
+    single.terms = {QByteArray("key")};
+    single.encodingVariants = true;
+    QVector<breco::SearchHit> singleHits;
+    breco::SearchPlan::compile(single)->findAll(haystack.constData(),
+                                                static_cast<int>(haystack.size()),
+                                                static_cast<int>(haystack.size()), &singleHits);
+    auto hasHit = [&singleHits](int offset, breco::TermEncoding encoding) {
+        return std::any_of(singleHits.cbegin(), singleHits.cend(),
+                           [offset, encoding](const breco::SearchHit& hit) {
+                               return hit.offset == offset && hit.encoding == encoding;
+                           });
+    };
+    expectTrue(hasHit(150 + 211, breco::TermEncoding::Utf16Le) &&
+                   hasHit(150 + 5 * 211, breco::TermEncoding::Utf16Be),
+               QStringLiteral("A single term should also be found in its UTF-16 forms"));
+}
+
+void testUnicodeCaseFold() {
+    using breco::TermEncoding;
+    const QVector<QByteArray> terms = {QByteArray("\xC3\xA4rger"),
+                                       QByteArray("\xCF\x83\xCE\xBF\xCF\x86\xCE\xBF\xCF\x82"),
+                                       QByteArray("k\xC3\x96")};
+    struct Planted {
+        int offset;
+        QByteArray text;
+        int termIdx;
+        TermEncoding encoding;
+    };
+    // Each planted text differs from its term in case only (Kelvin sign for "k", final sigma).
+    const QVector<Planted> planted = {
+        {10, QByteArray("\xC3\x84RGER"), 0, TermEncoding::Utf8},
+        {40, QByteArray("\xC3\xA4RgEr"), 0, TermEncoding::Utf16Le},
+        {80, QByteArray("\xCE\xA3\xCE\x9F\xCE\xA6\xCE\x9F\xCE\xA3"), 1, TermEncoding::Utf16Be},
+        {120, QByteArray("\xCF\x83\xCE\xBF\xCF\x86\xCE\xBF\xCF\x83"), 1, TermEncoding::Utf8},
+        {160, QByteArray("arger"), -1, TermEncoding::Utf8},
+        {200, QByteArray("\xE2\x84\xAA\xC3\xB6"), 2, TermEncoding::Utf8},
+    };
+    QByteArray haystack(260, 'x');
+    for (const Planted& item : planted) {
+        const QByteArray bytes = breco::MatchUtils::encodeTerm(item.text, item.encoding);
+        haystack.replace(item.offset, bytes.size(), bytes);
+    }
+
+    for (const bool encodingVariants : {false, true}) {
+        breco::SearchQuery query;
+        query.terms = terms;
+        query.ignoreCase = true;
+        query.encodingVariants = encodingVariants;
+        const auto plan = breco::SearchPlan::compile(query);
+        expectTrue(plan->algorithm() == breco::SearchAlgorithm::LazyDfa && plan->foldsCase(),
+                   QStringLiteral("Non-ASCII ignore-case terms should compile to a fold DFA"));
+        QVector<breco::SearchHit> hits;
+        plan->findAll(haystack.constData(), static_cast<int>(haystack.size()),
+                      static_cast<int>(haystack.size()), &hits);
+        QVector<breco::SearchHit> expected;
+        for (const Planted& item : planted) {
+            if (item.termIdx >= 0 && (encodingVariants || item.encoding == TermEncoding::Utf8)) {
+                expected.push_back(breco::SearchHit{item.offset, item.termIdx, 0, item.encoding});
+            }
+        }
+        bool sameHits = hits.size() == expected.size();
+        for (int i = 0; sameHits && i < hits.size(); ++i) {
+            sameHits = hits.at(i).offset == expected.at(i).offset &&
+                       hits.at(i).termIdx == expected.at(i).termIdx &&
+                       hits.at(i).encoding == expected.at(i).encoding;
+        }
+        expectTrue(sameHits, QStringLiteral("Unicode case folding should match every case variant "
+                                            "(encodingVariants=%1)")
+                                 .arg(encodingVariants ? 1 : 0));
+    }
+
+    breco::SearchQuery asciiQuery;
+    asciiQuery.terms = {QByteArray("rger")};
+    asciiQuery.ignoreCase = true;
+    expectTrue(breco::SearchPlan::compile(asciiQuery)->regex() == nullptr,
+               QStringLiteral("ASCII-only ignore-case terms should keep byte folding"));
+}
+
+void testApproximateSearch() {
+    quint32 state = 0x2545F491U;
+    QByteArray haystack = pseudoRandomBytes(&state, 4000, QByteArray("acgt"));
+    const QByteArray longTerm =
+        pseudoRandomBytes(&state, breco::ApproximateSearch::kMaxPatternSize, QByteArray("acgt"));
+    // A substitution, a deletion and an insertion of the short term, two edits of the long one.
+    haystack.replace(100, 7, "gatcaca");
+    haystack.replace(300, 6, "gttaca");
+    haystack.replace(500, 8, "gattacca");
+    QByteArray editedLong = longTerm;
+    editedLong[10] = 'x';
+    editedLong.remove(40, 1);
+    haystack.replace(1000, editedLong.size(), editedLong);
+    const QVector<QByteArray> terms = {QByteArray("gattaca"), longTerm};
+    const int size = static_cast<int>(haystack.size());
+    const int startLimit = size - 100;
+
+    // Reference distances: mismatches over the term's length, or the smallest edit distance to
+    // any run starting at `start` (and the shortest such run).
+    auto hamming = [&haystack, size](const QByteArray& term, int start) {
+        const int m = static_cast<int>(term.size());
+        if (start + m > size) {
+            return m;
+        }
+        int distance = 0;
+        for (int i = 0; i < m; ++i) {
+            distance += haystack.at(start + i) != term.at(i) ? 1 : 0;
+        }
+        return distance;
+    };
+    auto edit = [&haystack, size](const QByteArray& term, int start, int maxLength,
+                                  int* bestLength) {
+        const int m = static_cast<int>(term.size());
+        QVector<int> column(m + 1);
+        for (int i = 0; i <= m; ++i) {
+            column[i] = i;
+        }
+        int best = m;
+        *bestLength = 0;
+        for (int length = 1; length <= qMin(maxLength, size - start); ++length) {
+            int diagonal = column[0];
+            column[0] = length;
+            for (int i = 1; i <= m; ++i) {
+                const int above = column[i];
+                const int cost = haystack.at(start + length - 1) == term.at(i - 1) ? 0 : 1;
+                column[i] = std::min({diagonal + cost, above + 1, column[i - 1] + 1});
+                diagonal = above;
+            }
+            if (column[m] < best) {
+                best = column[m];
+                *bestLength = length;
+            }
+        }
+        return best;
+    };
+
+    for (const breco::ApproximateMetric metric :
+         {breco::ApproximateMetric::Hamming, breco::ApproximateMetric::Edit}) {
+        for (const int maxDistance : {1, 2}) {
+            const bool isEdit = metric == breco::ApproximateMetric::Edit;
+            QVector<breco::SearchHit> expected;
+            for (int start = 0; start < startLimit; ++start) {
+                for (int termIdx = 0; termIdx < terms.size(); ++termIdx) {
+                    const QByteArray& term = terms.at(termIdx);
+                    int length = static_cast<int>(term.size());
+                    const int distance =
+                        isEdit ? edit(term, start, length + maxDistance, &length)
+                               : hamming(term, start);
+                    if (distance <= maxDistance) {
+                        expected.push_back(breco::SearchHit{start, termIdx, 0,
+                                                            breco::TermEncoding::Utf8, distance,
+                                                            length});
+                    }
+                }
+            }
+
+            breco::SearchQuery query;
+            query.terms = terms;
+            query.approximate = metric;
+            query.maxDistance = maxDistance;
+            const auto plan = breco::SearchPlan::compile(query);
+            expectTrue(plan != nullptr &&
+                           plan->algorithm() == (isEdit ? breco::SearchAlgorithm::Myers
+                                                        : breco::SearchAlgorithm::ShiftOr) &&
+                           plan->maxMatchSpan() == 64 + (isEdit ? maxDistance : 0),
+                       QStringLiteral("Approximate query should compile to Shift-Or or Myers"));
+            QVector<breco::SearchHit> hits;
+            plan->findAll(haystack.constData(), size, startLimit, &hits);
+            bool sameHits = expected.size() >= 4 && hits.size() == expected.size();
+            for (int i = 0; sameHits && i < hits.size(); ++i) {
+                sameHits = hits.at(i).offset == expected.at(i).offset &&
+                           hits.at(i).termIdx == expected.at(i).termIdx &&
+                           hits.at(i).distance == expected.at(i).distance &&
+                           hits.at(i).length == expected.at(i).length;
+            }
+            expectTrue(sameHits, QStringLiteral("Approximate %1 k=%2 should match the reference")
+                                     .arg(QString::fromLatin1(
+                                         breco::ApproximateSearch::metricName(metric)))
+                                     .arg(maxDistance));
+        }
+    }
+
+    breco::SearchQuery folded;
+    folded.terms = {QByteArray("GATTACA")};
+    folded.ignoreCase = true;
+    folded.approximate = breco::ApproximateMetric::Hamming;
+    QVector<breco::SearchHit> foldedHits;
+    breco::SearchPlan::compile(folded)->findAll(haystack.constData(), size, startLimit,
+                                                &foldedHits);
+    expectTrue(!foldedHits.isEmpty() && foldedHits.first().offset == 100 &&
+                   foldedHits.first().distance == 1,
+               QStringLiteral("Approximate ignore-case should fold ASCII letters"));
+
+    QString error;
+    breco::SearchQuery tooShort;
+    tooShort.terms = {QByteArray("ab")};
+    tooShort.approximate = breco::ApproximateMetric::Edit;
+    tooShort.maxDistance = 2;
+    expectTrue(breco::SearchPlan::compile(tooShort, &error) == nullptr && !error.isEmpty(),
+               QStringLiteral("Approximate terms must be longer than the distance"));
+    tooShort.terms = {longTerm + "a"};
+    expectTrue(breco::SearchPlan::compile(tooShort) == nullptr,
+               QStringLiteral("Approximate terms must fit one state word"));
+
+    QVector<breco::MatchRecord> records;
+    for (const auto& [offset, distance] :
+         std::initializer_list<std::pair<int, int>>{{9, 1}, {10, 0}, {11, 1}, {20, 1}, {21, 1}}) {
+        breco::MatchRecord record;
+        record.scanTargetIdx = 0;
+        record.offset = static_cast<quint64>(offset);
+        record.distance = distance;
+        records.push_back(record);
+    }
+    breco::ApproximateSearch::dropShadowedMatches(1, &records);
+    expectTrue(records.size() == 2 && records.at(0).offset == 10 && records.at(1).offset == 20,
+               QStringLiteral("Edit-distance neighbours of a better match should be dropped"));
+}
+
+void testXorKeySearch() {
+    using breco::TermEncoding;
+    quint32 state = 0x9E3779B9U;
+    QByteArray haystack = pseudoRandomBytes(&state, 3000);
+    auto plant = [&haystack](int offset, const QByteArray& bytes, int key) {
+        for (int i = 0; i < bytes.size(); ++i) {
+            haystack[offset + i] = static_cast<char>(bytes.at(i) ^ key);
+        }
+    };
+    const QVector<QByteArray> terms = {QByteArray("secret"), QByteArray("MZ\x90", 3)};
+    plant(100, terms.at(0), 0x5A);
+    plant(400, terms.at(0), 0x00);
+    plant(800, terms.at(0), 0xFF);
+    plant(1200, terms.at(1), 0x13);
+    plant(1500, breco::MatchUtils::encodeTerm(terms.at(0), TermEncoding::Utf16Le), 0x77);
+    plant(2990, terms.at(0), 0x01);
+    const int size = static_cast<int>(haystack.size());
+    const int startLimit = size - 20;
+
+    for (const bool encodingVariants : {false, true}) {
+        QVector<breco::SearchHit> expected;
+        for (int start = 0; start < startLimit; ++start) {
+            for (int termIdx = 0; termIdx < terms.size(); ++termIdx) {
+                for (const TermEncoding encoding :
+                     {TermEncoding::Utf8, TermEncoding::Utf16Le, TermEncoding::Utf16Be}) {
+                    if (encoding != TermEncoding::Utf8 && !encodingVariants) {
+                        continue;
+                    }
+                    const QByteArray bytes = breco::MatchUtils::encodeTerm(terms.at(termIdx),
+                                                                           encoding);
+                    if (start + bytes.size() > size) {
+                        continue;
+                    }
+                    const int key = static_cast<unsigned char>(haystack.at(start) ^ bytes.at(0));
+                    bool matches = true;
+                    for (int i = 1; matches && i < bytes.size(); ++i) {
+                        matches = static_cast<char>(haystack.at(start + i) ^ key) == bytes.at(i);
+                    }
+                    if (matches) {
+                        expected.push_back(
+                            breco::SearchHit{start, termIdx, 0, encoding, 0, 0, key});
+                    }
+                }
+            }
+        }
+
+        breco::SearchQuery query;
+        query.terms = terms;
+        query.xorKeys = true;
+        query.encodingVariants = encodingVariants;
+        const auto plan = breco::SearchPlan::compile(query);
+        QVector<breco::SearchHit> hits;
+        plan->findAll(haystack.constData(), size, startLimit, &hits);
+        bool sameHits = expected.size() >= (encodingVariants ? 5 : 4) &&
+                        hits.size() == expected.size() && plan->maxMatchSpan() ==
+                        (encodingVariants ? 12 : 6);
+        for (int i = 0; sameHits && i < hits.size(); ++i) {
+            sameHits = hits.at(i).offset == expected.at(i).offset &&
+                       hits.at(i).termIdx == expected.at(i).termIdx &&
+                       hits.at(i).encoding == expected.at(i).encoding &&
+                       hits.at(i).xorKey == expected.at(i).xorKey;
+        }
+        expectTrue(sameHits, QStringLiteral("XOR-key search should find every key in one pass "
+                                            "(encodingVariants=%1)")
+                                 .arg(encodingVariants ? 1 : 0));
+    }
+
+    QString error;
+    breco::SearchQuery invalid;
+    invalid.xorKeys = true;
+    invalid.terms = {QByteArray("s")};
+    expectTrue(breco::SearchPlan::compile(invalid, &error) == nullptr && !error.isEmpty(),
+               QStringLiteral("XOR-key search should reject single-byte terms"));
+    invalid.terms = {QByteArray("\x4D\x50", 2)};
+    invalid.masks = {QByteArray("\xFF\xF0", 2)};
+    expectTrue(breco::SearchPlan::compile(invalid) == nullptr,
+               QStringLiteral("XOR-key search should reject hex wildcards"));
+}
+
+void testNumericSearch() {
+    using breco::NumericFormat;
+    QByteArray haystack(1024, static_cast<char>(0xAA));
+    auto plant = [&haystack](int offset, const QByteArray& bytes) {
+        haystack.replace(offset, bytes.size(), bytes);
+    };
+    auto floatBytes = [](float value, bool bigEndian) {
+        quint32 bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        QByteArray bytes;
+        for (int i = 0; i < 4; ++i) {
+            bytes.append(static_cast<char>(bits >> (bigEndian ? 24 - 8 * i : 8 * i)));
+        }
+        return bytes;
+    };
+    auto doubleBytes = [](double value, bool bigEndian) {
+        quint64 bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        QByteArray bytes;
+        for (int i = 0; i < 8; ++i) {
+            bytes.append(static_cast<char>(bits >> (bigEndian ? 56 - 8 * i : 8 * i)));
+        }
+        return bytes;
+    };
+    plant(100, QByteArray("\x87\xD6\x12\x00", 4));
+    plant(200, QByteArray("\x12\x34", 2));
+    plant(300, QByteArray("\xFF\xFB\x6C\x20", 4));
+    plant(400, doubleBytes(3.14159, true));
+    plant(500, floatBytes(2.5001F, false));
+    plant(600, doubleBytes(2.4995, false));
+    plant(700, floatBytes(2.5F, true));
+    plant(800, floatBytes(2.6F, false));
+
+    breco::SearchQuery query;
+    query.terms = {QByteArray("1234567"), QByteArray("0x1234"), QByteArray("-300000"),
+                   QByteArray("3.14159"), QByteArray(" 2.5 ")};
+    query.numeric = true;
+    query.tolerance = 0.001;
+    const auto plan = breco::SearchPlan::compile(query);
+    QVector<breco::SearchHit> hits;
+    if (plan != nullptr) {
+        plan->findAll(haystack.constData(), static_cast<int>(haystack.size()),
+                      static_cast<int>(haystack.size()), &hits);
+    }
+    const QVector<breco::SearchHit> expected = {
+        {100, 0, 0, breco::TermEncoding::Utf8, 0, 4, -1, NumericFormat::U32Le},
+        {200, 1, 0, breco::TermEncoding::Utf8, 0, 2, -1, NumericFormat::U16Be},
+        {300, 2, 0, breco::TermEncoding::Utf8, 0, 4, -1, NumericFormat::S32Be},
+        {400, 3, 0, breco::TermEncoding::Utf8, 0, 8, -1, NumericFormat::F64Be},
+        {500, 4, 0, breco::TermEncoding::Utf8, 0, 4, -1, NumericFormat::F32Le},
+        {600, 4, 0, breco::TermEncoding::Utf8, 0, 8, -1, NumericFormat::F64Le},
+        {700, 4, 0, breco::TermEncoding::Utf8, 0, 4, -1, NumericFormat::F32Be}};
+    bool sameHits = plan != nullptr && plan->maxMatchSpan() == 8 && hits.size() == expected.size();
+    for (int i = 0; sameHits && i < hits.size(); ++i) {
+        sameHits = hits.at(i).offset == expected.at(i).offset &&
+                   hits.at(i).termIdx == expected.at(i).termIdx &&
+                   hits.at(i).length == expected.at(i).length &&
+                   hits.at(i).numericFormat == expected.at(i).numericFormat;
+    }
+    expectTrue(sameHits, QStringLiteral("Numeric search should find every width, byte order and "
+                                        "float within tolerance in one pass"));
+
+    QVector<breco::NumericVariant> variants;
+    expectTrue(breco::MatchUtils::numericVariants(QByteArray("0"), 0.0, &variants) &&
+                   variants.size() == 5,
+               QStringLiteral("Numeric forms that read the same in both byte orders should be "
+                              "listed once"));
+    expectEqQString(breco::MatchUtils::numericFormatName(NumericFormat::S32Be),
+                    QStringLiteral("s32 BE"),
+                    QStringLiteral("Numeric format names should match the Current Byte panel"));
+
+    QString error;
+    breco::SearchQuery invalid;
+    invalid.numeric = true;
+    invalid.terms = {QByteArray("12abc")};
+    expectTrue(breco::SearchPlan::compile(invalid, &error) == nullptr && !error.isEmpty(),
+               QStringLiteral("Numeric search should reject terms that are not numbers"));
+}
+
+void testEncodedForms() {
+    using breco::TermEncoding;
+    expectEqQString(QString::fromLatin1(breco::MatchUtils::encodeTerm(QByteArray("p@ss word"),
+                                                                      TermEncoding::Base64Shift1)),
+                    QStringLiteral("BAc3Mgd29yZ"),
+                    QStringLiteral("Base64 forms should keep only characters fixed by the term"));
+
+    const QByteArray haystack = QByteArray("cfg=") + QByteArray("abp@ss wordyz").toBase64() +
+                                QByteArray(";k=7040737320776F7264;u=p%40ss%20word;");
+    const QVector<breco::SearchHit> expected = {
+        {static_cast<int>(haystack.indexOf("wQHNzIHdvcm")), 0, 0, TermEncoding::Base64Shift2},
+        {static_cast<int>(haystack.indexOf("7040737320776F7264")), 0, 0, TermEncoding::HexUpper},
+        {static_cast<int>(haystack.indexOf("p%40ss%20word")), 0, 0, TermEncoding::Percent}};
+    for (const bool ignoreCase : {false, true}) {
+        breco::SearchQuery query;
+        query.terms = {QByteArray("p@ss word")};
+        query.encodedForms = true;
+        query.ignoreCase = ignoreCase;
+        query.encodingVariants = ignoreCase;
+        const auto plan = breco::SearchPlan::compile(query);
+        QVector<breco::SearchHit> hits;
+        plan->findAll(haystack.constData(), static_cast<int>(haystack.size()),
+                      static_cast<int>(haystack.size()), &hits);
+        bool sameHits = hits.size() == expected.size();
+        for (int i = 0; sameHits && i < hits.size(); ++i) {
+            sameHits = hits.at(i).offset == expected.at(i).offset &&
+                       hits.at(i).encoding == expected.at(i).encoding;
+        }
+        expectTrue(sameHits, QStringLiteral("Encoded forms should be found in the term's pass "
+                                            "(ignoreCase=%1)")
+                                 .arg(ignoreCase ? 1 : 0));
+    }
+}
+
+void testProximitySearch() {
+    QByteArray haystack(4096, '.');
+    auto plant = [&haystack](int offset, const char* bytes) {
+        haystack.replace(offset, static_cast<int>(std::strlen(bytes)), QByteArray(bytes));
+    };
+    plant(100, "alpha");
+    plant(150, "Beta");
+    plant(1000, "alpha");
+    plant(900, "beta");
+    plant(2000, "alpha");
+    plant(2200, "beta");
+    plant(2560, "alpha");
+    plant(2500, "beta");
+    plant(3000, "alpha");
+    plant(3500, "ALPHA");
+    plant(3628, "beta");
+
+    // With UTF-16 forms both sub-plans are Unicode case-fold regex plans, run in turn.
+    for (const int variant : {0, 1, 2}) {
+        const bool ignoreCase = variant > 0;
+        breco::SearchQuery query;
+        query.terms = {QByteArray("alpha")};
+        query.nearTerms = {QByteArray("beta")};
+        query.nearDistance = 128;
+        query.ignoreCase = ignoreCase;
+        query.encodingVariants = variant == 2;
+        const auto plan = breco::SearchPlan::compile(query);
+        const QVector<int> expected =
+            ignoreCase ? QVector<int>{100, 1000, 2560, 3500} : QVector<int>{1000, 2560};
+        // Jobs of 512 bytes with the overlap and look-behind the reader gives them.
+        QVector<int> found;
+        const int overlap = plan->maxMatchSpan() - 1;
+        QVector<breco::SearchHit> hits;
+        for (int start = 0; start < haystack.size(); start += 512) {
+            const int back = qMin(plan->lookBehind(), start);
+            const int size = qMin(512 + overlap, static_cast<int>(haystack.size()) - start);
+            plan->findAll(haystack.constData() + start - back, size + back, 512 + back, &hits);
+            for (const breco::SearchHit& hit : hits) {
+                if (hit.offset >= back) {
+                    found.push_back(start + hit.offset - back);
+                }
+            }
+        }
+        // A Unicode-folded UTF-16 form spans up to 4 bytes per term byte.
+        expectTrue(plan->lookBehind() == 128 &&
+                       plan->maxMatchSpan() == 128 + (variant == 2 ? 4 * 5 : 5) &&
+                       found == expected,
+                   QStringLiteral("Proximity search should keep matches with a near term on "
+                                  "either side across jobs (variant=%1)")
+                       .arg(variant));
+    }
+
+    breco::SearchQuery invalid;
+    invalid.terms = {QByteArray("al.ha")};
+    invalid.regex = true;
+    invalid.nearTerms = {QByteArray("beta")};
+    expectTrue(breco::SearchPlan::compile(invalid) == nullptr,
+               QStringLiteral("Proximity search should reject regex queries"));
+}
+
+void testStreamedNeedle() {
+    const QByteArray needle = QByteArray("ab").repeated(150);
+    QByteArray haystack(8192, '.');
+    haystack.replace(1000, 700, needle.repeated(3).left(700));
+    haystack.replace(5000, needle.size(), needle.toUpper());
+    haystack.replace(7000, needle.size() - 1, needle.left(needle.size() - 1));
+
+    for (const bool ignoreCase : {false, true}) {
+        breco::SearchQuery query;
+        query.terms = {needle};
+        query.ignoreCase = ignoreCase;
+        const auto plan = breco::SearchPlan::compile(query);
+        QVector<breco::SearchHit> hits;
+        plan->findAll(haystack.constData(), haystack.size(), haystack.size(), &hits);
+        QVector<quint64> expected;
+        for (const breco::SearchHit& hit : hits) {
+            expected.push_back(static_cast<quint64>(hit.offset));
+        }
+        // Jobs smaller than the needle, no overlap: matches complete through carried runs.
+        for (const int jobSize : {97, 256, 1024}) {
+            QVector<breco::RegexMatch> matches;
+            breco::RegexRun carried;
+            for (int start = 0; start < haystack.size(); start += jobSize) {
+                const int size = qMin(jobSize, static_cast<int>(haystack.size()) - start);
+                breco::RegexRun endRun;
+                plan->streamScan(haystack.constData() + start, size, size,
+                                 static_cast<quint64>(start), &matches, &endRun);
+                plan->streamResume(carried, haystack.constData() + start, size,
+                                   static_cast<quint64>(start), &matches, &endRun);
+                carried = std::move(endRun);
+            }
+            QVector<quint64> found;
+            for (const breco::RegexMatch& match : matches) {
+                found.push_back(match.start);
+            }
+            std::sort(found.begin(), found.end());
+            expectTrue(plan->streamsNeedle() && plan->maxMatchSpan() == 1 && carried.isEmpty() &&
+                           found == expected && expected.size() == (ignoreCase ? 202 : 201),
+                       QStringLiteral("Streamed needle jobs should find the whole-file matches "
+                                      "(ignoreCase=%1 jobSize=%2)")
+                           .arg(ignoreCase ? 1 : 0)
+                           .arg(jobSize));
+        }
+    }
+
+    // Every job of a zero run opens a prefix at each of its bytes; the carry stays one state.
+    QByteArray zeros(300000, '\0');
+    zeros[70000] = 1;
+    zeros[200000] = 1;
+    breco::SearchQuery zeroQuery;
+    zeroQuery.terms = {QByteArray(65536, '\0')};
+    const auto zeroPlan = breco::SearchPlan::compile(zeroQuery);
+    QVector<breco::SearchHit> zeroHits;
+    zeroPlan->findAll(zeros.constData(), zeros.size(), zeros.size(), &zeroHits);
+    for (const int jobSize : {4096, 65535, 100000}) {
+        QVector<breco::RegexMatch> matches;
+        breco::RegexRun carried;
+        size_t largestCarry = 0;
+        for (int start = 0; start < zeros.size(); start += jobSize) {
+            const int size = qMin(jobSize, static_cast<int>(zeros.size()) - start);
+            breco::RegexRun endRun;
+            zeroPlan->streamScan(zeros.constData() + start, size, size,
+                                 static_cast<quint64>(start), &matches, &endRun);
+            zeroPlan->streamResume(carried, zeros.constData() + start, size,
+                                   static_cast<quint64>(start), &matches, &endRun);
+            carried = std::move(endRun);
+            largestCarry = qMax(largestCarry, carried.states.size());
+        }
+        QVector<quint64> found;
+        for (const breco::RegexMatch& match : matches) {
+            found.push_back(match.start);
+        }
+        std::sort(found.begin(), found.end());
+        QVector<quint64> expected;
+        for (const breco::SearchHit& hit : zeroHits) {
+            expected.push_back(static_cast<quint64>(hit.offset));
+        }
+        expectTrue(zeroPlan->streamsNeedle() && largestCarry == 1 && found == expected &&
+                       expected.size() == (70000 - 65536 + 1) +
+                                              (200000 - 70001 - 65536 + 1) +
+                                              (300000 - 200001 - 65536 + 1),
+                   QStringLiteral("A zero needle should carry one KMP state (jobSize=%1)")
+                       .arg(jobSize));
+    }
+
+    breco::SearchQuery shortQuery;
+    shortQuery.terms = {needle.left(breco::SearchPlan::kMinStreamedNeedleSize - 1)};
+    expectTrue(!breco::SearchPlan::compile(shortQuery)->streamsNeedle(),
+               QStringLiteral("Needles below the streaming size should keep the job overlap"));
+
+    // Terms longer than kMaxTermFormSize only compile where they stream.
+    breco::SearchQuery longQuery;
+    longQuery.terms = {QByteArray("\xC3\xA9x").repeated(40000)};
+    longQuery.ignoreCase = true;
+    const auto longPlan = breco::SearchPlan::compile(longQuery);
+    QVector<breco::SearchQuery> expanded(4, longQuery);
+    expanded[0].bitPhases = true;
+    expanded[1].encodingVariants = true;
+    expanded[2].terms.push_back(QByteArray("short"));
+    expanded[3].nearTerms = {QByteArray("near")};
+    bool longRejected = true;
+    for (const breco::SearchQuery& query : expanded) {
+        QString error;
+        const bool rejected = breco::SearchPlan::compile(query, &error) == nullptr;
+        longRejected = longRejected && rejected && !error.isEmpty();
+    }
+    expectTrue(longPlan != nullptr && longPlan->streamsNeedle() && longRejected,
+               QStringLiteral("Long terms should stream alone and be rejected with options that "
+                              "expand them"));
+}
+
+void testMatchStore() {
+    breco::MatchStore store(3);
+    const int count = breco::MatchStore::kChunkRecords + 100;
+    for (int i = 0; i < count; ++i) {
+        if (i % 1000 == 0) {
+            store.beginBatch(static_cast<quint64>(i));
+        }
+        breco::MatchRecord match;
+        match.scanTargetIdx = i / 50000;
+        match.offset = static_cast<quint64>(i) * 2;
+        match.termIdx = i % 7;
+        match.bitOffset = i % 8;
+        match.encoding = breco::TermEncoding::Percent;
+        match.distance = 8;
+        match.xorKey = i % 3 == 0 ? -1 : 255;
+        match.numericFormat = breco::NumericFormat::F64Be;
+        match.matchLength = i % 5 == 0 ? 4000000000ULL : static_cast<quint64>(i % 300);
+        if (i == count - 50) {
+            match.matchLength = quint64{1} << 40;
+        }
+        store.append(match);
+    }
+    bool roundTrips = store.size() == count;
+    for (int i = 0; i < count && roundTrips; ++i) {
+        const breco::MatchRecord match = store.at(i);
+        roundTrips = match.threadId == 3 && match.scanTargetIdx == i / 50000 &&
+                     store.scanTargetIdx(i) == i / 50000 && store.offset(i) == match.offset &&
+                     match.offset == static_cast<quint64>(i) * 2 && match.termIdx == i % 7 &&
+                     match.bitOffset == i % 8 && match.encoding == breco::TermEncoding::Percent &&
+                     match.distance == 8 && match.xorKey == (i % 3 == 0 ? -1 : 255) &&
+                     match.numericFormat == breco::NumericFormat::F64Be &&
+                     match.searchTimeNs == static_cast<quint64>(i / 1000 * 1000) &&
+                     match.matchLength == (i == count - 50 ? quint64{1} << 40
+                                           : i % 5 == 0   ? 4000000000ULL
+                                                          : static_cast<quint64>(i % 300));
+    }
+    expectTrue(roundTrips, QStringLiteral("MatchStore should give back the records appended "
+                                          "across chunks, one time per batch"));
+
+    // Merged results copy records from several stores and keep each one's worker and time, and
+    // per-target counts in full.
+    breco::MatchStore other(5);
+    other.beginBatch(77);
+    breco::MatchRecord counted;
+    counted.scanTargetIdx = 2;
+    counted.offset = 40;
+    counted.matchCount = 12;
+    other.append(counted);
+    breco::MatchStore merged;
+    const int storeBase = merged.adoptBatches(store);
+    const int otherBase = merged.adoptBatches(other);
+    merged.appendFrom(store, 1, storeBase);
+    merged.appendFrom(other, 0, otherBase);
+    merged.appendFrom(store, count - 50, storeBase);
+    merged.appendStore(other);
+    breco::MatchStore rebuilt;
+    rebuilt.appendRecords(merged.toRecords());
+    auto sameRecord = [](const breco::MatchRecord& lhs, const breco::MatchRecord& rhs) {
+        return lhs.scanTargetIdx == rhs.scanTargetIdx && lhs.threadId == rhs.threadId &&
+               lhs.offset == rhs.offset && lhs.searchTimeNs == rhs.searchTimeNs &&
+               lhs.termIdx == rhs.termIdx && lhs.xorKey == rhs.xorKey &&
+               lhs.matchLength == rhs.matchLength && lhs.matchCount == rhs.matchCount;
+    };
+    bool mergedKeeps = merged.size() == 4 && rebuilt.size() == 4 &&
+                       sameRecord(merged.at(0), store.at(1)) &&
+                       sameRecord(merged.at(1), other.at(0)) &&
+                       sameRecord(merged.at(2), store.at(count - 50)) &&
+                       sameRecord(merged.at(3), other.at(0)) && merged.at(1).threadId == 5 &&
+                       merged.at(1).searchTimeNs == 77 && merged.at(1).matchCount == 12 &&
+                       merged.at(2).matchLength == quint64{1} << 40;
+    for (int i = 0; i < rebuilt.size() && mergedKeeps; ++i) {
+        mergedKeeps = sameRecord(rebuilt.at(i), merged.at(i));
+    }
+    expectTrue(mergedKeeps, QStringLiteral("MatchStore should copy records between stores with "
+                                           "their worker, time, count and full length"));
+
+    // Later matches that sort before stored ones are merged in; moved records keep their time.
+    store.truncate(breco::MatchStore::kChunkRecords + 2);
+    auto offsetLess = [](const breco::MatchRecord& lhs, const breco::MatchRecord& rhs) {
+        return lhs.scanTargetIdx != rhs.scanTargetIdx ? lhs.scanTargetIdx < rhs.scanTargetIdx
+                                                      : lhs.offset < rhs.offset;
+    };
+    QVector<breco::MatchRecord> late(2);
+    late[0].scanTargetIdx = 1;
+    late[0].offset = static_cast<quint64>(breco::MatchStore::kChunkRecords) * 2 - 3;
+    late[1].scanTargetIdx = 1;
+    late[1].offset = static_cast<quint64>(breco::MatchStore::kChunkRecords) * 2 + 5;
+    store.beginBatch(999999);
+    store.mergeSorted(late, offsetLess);
+    const int first = breco::MatchStore::kChunkRecords - 2;
+    QVector<quint64> offsets;
+    QVector<quint64> times;
+    for (int i = first; i < store.size(); ++i) {
+        offsets.push_back(store.offset(i));
+        times.push_back(store.at(i).searchTimeNs);
+    }
+    const quint64 base = static_cast<quint64>(first) * 2;
+    expectTrue(store.size() == breco::MatchStore::kChunkRecords + 4 &&
+                   offsets == QVector<quint64>{base, base + 1, base + 2, base + 4, base + 6,
+                                               base + 9} &&
+                   times == QVector<quint64>{65000, 999999, 65000, 65000, 65000, 999999},
+               QStringLiteral("MatchStore merge should keep the store sorted"));
+
+    store.clear();
+    expectTrue(store.isEmpty(), QStringLiteral("MatchStore clear should drop every record"));
+}
+
+void testEntropyMap() {
+    const QByteArray uniform(4096, 'A');
+    QByteArray cycling;
+    QByteArray twoValues;
+    for (int i = 0; i < 4096; ++i) {
+        cycling.push_back(static_cast<char>(i & 0xFF));
+        twoValues.push_back((i & 1) != 0 ? 'x' : 'y');
+    }
+    expectEqInt(breco::EntropyMap::levelFor(
+                    breco::EntropyMap::entropyBits(uniform.constData(), uniform.size())),
+                0, QStringLiteral("EntropyMap uniform data should have no entropy"));
+    expectEqInt(breco::EntropyMap::levelFor(
+                    breco::EntropyMap::entropyBits(cycling.constData(), cycling.size())),
+                8 * breco::EntropyMap::kLevelsPerBit,
+                QStringLiteral("EntropyMap evenly spread bytes should have 8 bits"));
+    expectEqInt(breco::EntropyMap::levelFor(
+                    breco::EntropyMap::entropyBits(twoValues.constData(), twoValues.size())),
+                breco::EntropyMap::kLevelsPerBit,
+                QStringLiteral("EntropyMap two even values should have 1 bit"));
+
+    const quint64 block = breco::EntropyMap::kBlockBytes;
+    breco::EntropyMap map(3 * block + 100);
+    expectEqInt(map.blockCount(), 4, QStringLiteral("EntropyMap should round the last block up"));
+    QByteArray data(static_cast<int>(2 * block), '\0');
+    for (int i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i < static_cast<int>(block) ? 0 : i & 0xFF);
+    }
+    // The data covers blocks 1 and 2, but the range only owns block 2's first byte.
+    map.measure(data.constData(), block, static_cast<quint64>(data.size()), block + 1,
+                 3 * block);
+    expectTrue(map.level(0) == breco::EntropyMap::kUnmeasured &&
+                   map.level(1) == breco::EntropyMap::kUnmeasured &&
+                   map.level(2) == 8 * breco::EntropyMap::kLevelsPerBit &&
+                   map.level(3) == breco::EntropyMap::kUnmeasured,
+               QStringLiteral("EntropyMap measure should only fill blocks starting in range"));
+    map.measure(data.constData(), block, static_cast<quint64>(data.size()), block, block + 1);
+    expectEqInt(map.level(1), 0, QStringLiteral("EntropyMap measure should fill an owned block"));
+
+    quint32 state = 12345;
+    const QByteArray noise = pseudoRandomBytes(&state, 65536);
+    QByteArray text;
+    while (text.size() < 65536) {
+        text.append("The quick brown fox jumps over the lazy dog. ");
+    }
+    expectTrue(breco::EntropyMap::sampledEntropyBits(noise.constData(), noise.size()) > 7.9 &&
+                   breco::EntropyMap::sampledEntropyBits(text.constData(), text.size()) < 5.0,
+               QStringLiteral("EntropyMap sampled entropy should tell noise from text"));
+    expectTrue(breco::EntropyMap::sampledEntropyBits(cycling.constData(), cycling.size()) ==
+                   breco::EntropyMap::entropyBits(cycling.constData(), cycling.size()),
+               QStringLiteral("EntropyMap sampled entropy should be exact on small data"));
+}
+
+void testAlignedSearch() {
+    quint32 state = 0x13579BDFU;
+    QByteArray haystack = pseudoRandomBytes(&state, 16384);
+    const QByteArray png("\x89PNG\r\n\x1a\n\0\0\0\rIHDR", 16);
+    // Plant the terms at sector starts, one byte after them and across the end of the data.
+    for (int sector = 0; sector < 32; ++sector) {
+        const QByteArray term = sector % 3 == 0   ? png
+                                : sector % 3 == 1 ? QByteArray("pk\x03\x04")
+                                                  : QByteArray("JFIF");
+        haystack.replace(sector * 512 + (sector % 4 == 3 ? 1 : 0), term.size(), term);
+    }
+    haystack.replace(haystack.size() - 2, 2, QByteArray("PK"));
+    const int size = static_cast<int>(haystack.size());
+
+    QVector<breco::SearchQuery> queries(6);
+    queries[0].terms = {QByteArray("JFIF")};
+    queries[1].terms = {QByteArray("PK\x03\x04"), QByteArray("JFIF"), png};
+    queries[1].ignoreCase = true;
+    queries[2].terms = {png};
+    queries[2].masks = {QByteArray(16, static_cast<char>(0xFF))};
+    queries[2].masks[0][9] = '\0';
+    queries[3].terms = {QByteArray("PK"), QByteArray("JF")};
+    queries[3].bitPhases = true;
+    queries[4].terms = {QByteArray("JFIF")};
+    queries[4].encodingVariants = true;
+    queries[5].terms = {QByteArray("JFIF")};
+    queries[5].xorKeys = true;
+    for (int q = 0; q < queries.size(); ++q) {
+        const auto plan = breco::SearchPlan::compile(queries.at(q));
+        for (const int first : {0, 7, 512}) {
+            QVector<breco::SearchHit> expected;
+            plan->findAll(haystack.constData(), size, size, &expected);
+            expected.erase(std::remove_if(expected.begin(), expected.end(),
+                                          [first](const breco::SearchHit& hit) {
+                                              return hit.offset < first ||
+                                                     (hit.offset - first) % 512 != 0;
+                                          }),
+                           expected.end());
+            QVector<breco::SearchHit> hits;
+            plan->findAligned(haystack.constData(), size, size, first, 512, &hits);
+            bool sameHits = hits.size() == expected.size() && (first != 0 || !hits.isEmpty());
+            for (int i = 0; sameHits && i < hits.size(); ++i) {
+                sameHits = hits.at(i).offset == expected.at(i).offset &&
+                           hits.at(i).termIdx == expected.at(i).termIdx &&
+                           hits.at(i).bitOffset == expected.at(i).bitOffset &&
+                           hits.at(i).encoding == expected.at(i).encoding &&
+                           hits.at(i).xorKey == expected.at(i).xorKey;
+            }
+            expectTrue(sameHits, QStringLiteral("Aligned search should report the findAll() hits "
+                                                "at aligned starts (query %1, first %2)")
+                                     .arg(q)
+                                     .arg(first));
+        }
+    }
+}
+
+void testFileCarver() {
+    QByteArray image(65536, static_cast<char>(0x11));
+    const auto put = [&image](int offset, const QByteArray& bytes) {
+        image.replace(offset, bytes.size(), bytes);
+    };
+    // JPEG with an EXIF thumbnail, whose footer comes first.
+    put(1000, QByteArray("\xFF\xD8\xFF\xE1"));
+    put(1200, QByteArray("\xFF\xD8\xFF\xDB"));
+    put(1500, QByteArray("\xFF\xD9"));
+    put(3000, QByteArray("\xFF\xD9"));
+    put(4096, QByteArray("\x89PNG\r\n\x1A\n"));
+    put(5000, QByteArray("IEND\xAE\x42\x60\x82"));
+    // PDF with an incremental update: the last footer ends it.
+    put(6000, QByteArray("%PDF-1.4"));
+    put(7000, QByteArray("%%EOF"));
+    put(8000, QByteArray("%%EOF"));
+    // ZIP with two members and a 22-byte end of central directory record.
+    put(9000, QByteArray("PK\x03\x04"));
+    put(9100, QByteArray("PK\x03\x04"));
+    put(9500, QByteArray("PK\x05\x06"));
+    put(12288, QByteArray("RIFF\xE0\x03\0\0WAVE", 12));
+    // SQLite: 2 pages of 4096 bytes, change counter equal to version-valid-for.
+    put(16384, QByteArray("SQLite format 3\0\x10\0", 18));
+    put(16384 + 24, QByteArray("\0\0\0\x05\0\0\0\x02", 8));
+    put(16384 + 92, QByteArray("\0\0\0\x05", 4));
+    // GIF without its trailer is dropped.
+    put(30000, QByteArray("GIF89a"));
+    // 7z: next header 100 bytes after the 32-byte signature header, 20 bytes long.
+    put(40000, QByteArray("7z\xBC\xAF\x27\x1C"));
+    put(40012, QByteArray("\x64\0\0\0\0\0\0\0\x14\0\0\0\0\0\0\0", 16));
+    // JPEG without a footer is dropped; a WAV running past the end is clipped.
+    put(60000, QByteArray("\xFF\xD8\xFF\xE0"));
+    put(65000, QByteArray("RIFF\x08\x27\0\0WAVE", 12));
+
+    const breco::FileCarver carver;
+    const auto plan = breco::SearchPlan::compile(carver.searchQuery());
+    expectTrue(plan != nullptr, QStringLiteral("Carving query should compile"));
+    if (plan == nullptr) {
+        return;
+    }
+    const int size = static_cast<int>(image.size());
+    QVector<breco::SearchHit> hits;
+    plan->findAll(image.constData(), size, size, &hits);
+    QVector<breco::MatchRecord> matches;
+    for (const breco::SearchHit& hit : hits) {
+        breco::MatchRecord match;
+        match.scanTargetIdx = 0;
+        match.offset = static_cast<quint64>(hit.offset);
+        match.termIdx = hit.termIdx;
+        matches.push_back(match);
+    }
+    const auto read = [&image](int, quint64 offset, quint64 bytes) {
+        return image.mid(static_cast<int>(offset), static_cast<int>(bytes));
+    };
+    const auto describe = [&carver](const QVector<breco::MatchRecord>& files) {
+        QStringList parts;
+        for (const breco::MatchRecord& file : files) {
+            const breco::CarveSignature* signature = carver.signatureForTerm(file.termIdx);
+            parts.push_back(QStringLiteral("%1@%2+%3")
+                                .arg(signature != nullptr ? signature->name : QStringLiteral("?"))
+                                .arg(file.offset)
+                                .arg(file.matchLength));
+        }
+        return parts.join(QLatin1Char(' '));
+    };
+
+    expectEqQString(describe(carver.carve(matches, {65536}, 1, read)),
+                    QStringLiteral("JPEG@1000+2002 PNG@4096+912 PDF@6000+2005 ZIP@9000+522 "
+                                   "WAV@12288+1000 SQLite@16384+8192 7z@40000+152 WAV@65000+536"),
+                    QStringLiteral("Carving should pair headers with footers and size fields"));
+    expectEqQString(describe(carver.carve(matches, {65536}, 4096, read)),
+                    QStringLiteral("PNG@4096+912 WAV@12288+1000 SQLite@16384+8192"),
+                    QStringLiteral("Aligned carving should only start files at aligned headers"));
+
+    // Ten JPEG footers, a header, ten more: the first four after the range start or the header
+    // and the last before the header or the range end stay.
+    const int jpegHeader = 0;
+    const int jpegFooter = carver.searchQuery().terms.indexOf(QByteArray("\xFF\xD9"));
+    QVector<breco::SearchHit> rangeHits;
+    for (int i = 0; i < 21; ++i) {
+        rangeHits.push_back(breco::SearchHit{i * 10, i == 10 ? jpegHeader : jpegFooter});
+    }
+    carver.thinFooterHits(&rangeHits);
+    QStringList kept;
+    for (const breco::SearchHit& hit : rangeHits) {
+        kept.push_back(QString::number(hit.offset));
+    }
+    expectEqQString(kept.join(QLatin1Char(' ')),
+                    QStringLiteral("0 10 20 30 90 100 110 120 130 140 200"),
+                    QStringLiteral("Footer thinning should keep the footers carving can use"));
+}
+
+void testExtentExporter() {
+    QTemporaryDir tempDir;
+    expectTrue(tempDir.isValid(), QStringLiteral("ExtentExporter temp dir should be valid"));
+    if (!tempDir.isValid()) {
+        return;
+    }
+    const QString sourcePath = tempDir.filePath(QStringLiteral("image.bin"));
+    {
+        QFile f(sourcePath);
+        expectTrue(f.open(QIODevice::WriteOnly), QStringLiteral("ExtentExporter create source"));
+        f.write("0123456789abcdef", 16);
+    }
+
+    const QString extentPath = tempDir.filePath(QStringLiteral("extent.bin"));
+    quint64 reported = 0;
+    QString error;
+    const bool copied = breco::ExtentExporter::copyExtent(
+        sourcePath, 3, 9, extentPath,
+        [&reported](quint64 copiedBytes) {
+            reported = copiedBytes;
+            return true;
+        },
+        &error);
+    expectTrue(copied, QStringLiteral("ExtentExporter should copy an extent: %1").arg(error));
+    expectEqInt(static_cast<int>(reported), 9,
+                QStringLiteral("ExtentExporter should report the copied bytes"));
+    {
+        QFile f(extentPath);
+        expectTrue(f.open(QIODevice::ReadOnly), QStringLiteral("ExtentExporter open extent"));
+        expectEqQString(QString::fromLatin1(f.readAll()), QStringLiteral("3456789ab"),
+                        QStringLiteral("ExtentExporter extent bytes"));
+    }
+
+    expectTrue(!breco::ExtentExporter::copyExtent(sourcePath, 0, 4, extentPath, {}, &error),
+               QStringLiteral("ExtentExporter should not overwrite an existing file"));
+    const QString truncatedPath = tempDir.filePath(QStringLiteral("truncated.bin"));
+    expectTrue(!breco::ExtentExporter::copyExtent(sourcePath, 10, 20, truncatedPath, {}, &error),
+               QStringLiteral("ExtentExporter should fail on extents past the source end"));
+    expectTrue(!QFileInfo::exists(truncatedPath),
+               QStringLiteral("ExtentExporter should remove the file of a failed copy"));
+}
+
+struct ControllerScanResult {
+    bool finished = false;
+    bool limitExceeded = false;
+    QVector<breco::MatchRecord> matches;
+};
+
+breco::ScanTarget writeScanTarget(const QTemporaryDir& dir, const QString& name,
+                                  const QByteArray& bytes) {
+    const QString path = dir.filePath(name);
+    QFile file(path);
+    expectTrue(file.open(QIODevice::WriteOnly) && file.write(bytes) == bytes.size(),
+               QStringLiteral("Create scan target %1").arg(name));
+    return breco::ScanTarget{path, static_cast<quint64>(bytes.size())};
+}
+
+// Runs one scan on 4 workers and waits on the event loop for its final results. Small blocks
+// give every target many jobs, so matches are claimed, carried and merged across workers.
+ControllerScanResult runControllerScan(
+    breco::ScanController* controller, const QVector<breco::ScanTarget>& targets,
+    const breco::SearchQuery& query, quint32 blockSize,
+    breco::ScanReportMode reportMode = breco::ScanReportMode::Matches) {
+    ControllerScanResult result;
+    QEventLoop loop;
+    const QMetaObject::Connection batchConnection = QObject::connect(
+        controller, &breco::ScanController::resultsBatchReady,
+        [&result](const breco::MatchStore& matches, int) {
+            result.matches = matches.toRecords();
+        });
+    const QMetaObject::Connection finishedConnection = QObject::connect(
+        controller, &breco::ScanController::scanFinished,
+        [&result, &loop](bool, bool limitExceeded) {
+            result.finished = true;
+            result.limitExceeded = limitExceeded;
+            loop.quit();
+        });
+    const QMetaObject::Connection errorConnection = QObject::connect(
+        controller, &breco::ScanController::scanError, &loop, &QEventLoop::quit);
+    QTimer::singleShot(60000, &loop, &QEventLoop::quit);
+    controller->startScan(targets, query, blockSize, 4, false, reportMode);
+    if (controller->isRunning()) {
+        loop.exec();
+    }
+    QObject::disconnect(batchConnection);
+    QObject::disconnect(finishedConnection);
+    QObject::disconnect(errorConnection);
+    return result;
+}
+
+QVector<quint64> matchOffsets(const QVector<breco::MatchRecord>& matches) {
+    QVector<quint64> offsets;
+    for (const breco::MatchRecord& match : matches) {
+        offsets.push_back(match.offset);
+    }
+    return offsets;
+}
+
+void testScanControllerMatchBudget() {
+    QTemporaryDir tempDir;
+    expectTrue(tempDir.isValid(), QStringLiteral("Match budget temp dir should be valid"));
+    if (!tempDir.isValid()) {
+        return;
+    }
+    quint32 state = 0x5EED0016U;
+    const QByteArray alphabet("abcd01");
+    QByteArray bytes = pseudoRandomBytes(&state, 1 << 20, alphabet);
+    QVector<quint64> expected;
+    for (int offset = 1000; offset + 6 <= bytes.size(); offset += 997) {
+        bytes.replace(offset, 6, "needle");
+        expected.push_back(static_cast<quint64>(offset));
+    }
+    const QVector<breco::ScanTarget> targets = {
+        writeScanTarget(tempDir, QStringLiteral("matches.bin"), bytes),
+        writeScanTarget(tempDir, QStringLiteral("none.bin"),
+                        pseudoRandomBytes(&state, 64 * 1024, alphabet))};
+    breco::SearchQuery query;
+    query.terms = {QByteArray("needle")};
+    breco::ScanController controller;
+
+    const ControllerScanResult all = runControllerScan(&controller, targets, query, 4096);
+    expectTrue(all.finished && !all.limitExceeded && matchOffsets(all.matches) == expected,
+               QStringLiteral("A scan within the budget should find every match"));
+
+    // Workers race for the budget, yet the kept matches are always the lowest ones.
+    for (const auto& [maxMatches, memoryBytes] :
+         {std::pair<quint64, quint64>{100, breco::ScanController::kDefaultMatchMemoryBytes},
+          std::pair<quint64, quint64>{breco::ScanController::kDefaultMaxMatches,
+                                      50 * breco::MatchStore::kRecordBytes}}) {
+        controller.setMatchLimits(maxMatches, memoryBytes);
+        const ControllerScanResult capped = runControllerScan(&controller, targets, query, 4096);
+        const QVector<quint64> offsets = matchOffsets(capped.matches);
+        expectTrue(capped.finished && capped.limitExceeded &&
+                       static_cast<quint64>(offsets.size()) <=
+                           qMin(maxMatches, memoryBytes / breco::MatchStore::kRecordBytes) &&
+                       offsets == expected.mid(0, offsets.size()),
+                   QStringLiteral("A capped scan should keep the lowest matches (max %1, %2 B)")
+                       .arg(maxMatches)
+                       .arg(memoryBytes));
+    }
+    controller.setMatchLimits(breco::ScanController::kDefaultMaxMatches,
+                              breco::ScanController::kDefaultMatchMemoryBytes);
+
+    const ControllerScanResult counted =
+        runControllerScan(&controller, targets, query, 4096, breco::ScanReportMode::Count);
+    expectTrue(counted.finished && counted.matches.size() == 1 &&
+                   counted.matches.first().scanTargetIdx == 0 &&
+                   counted.matches.first().matchCount == static_cast<quint64>(expected.size()),
+               QStringLiteral("A count scan should report one record per matching target"));
+    const ControllerScanResult existing =
+        runControllerScan(&controller, targets, query, 4096, breco::ScanReportMode::Existence);
+    expectTrue(existing.finished && existing.matches.size() == 1 &&
+                   existing.matches.first().scanTargetIdx == 0 &&
+                   expected.contains(existing.matches.first().offset),
+               QStringLiteral("An existence scan should report one match per matching target"));
+}
+
+void testScanControllerCarriedRuns() {
+    QTemporaryDir tempDir;
+    expectTrue(tempDir.isValid(), QStringLiteral("Carried runs temp dir should be valid"));
+    if (!tempDir.isValid()) {
+        return;
+    }
+    // Regex matches many jobs long, with several K before one Z, and short fixed-length ones.
+    quint32 state = 0x5EED0021U;
+    QByteArray bytes = pseudoRandomBytes(&state, 8 * 65536 + 100, QByteArray("ab01"));
+    for (const int offset : {5000, 9000, 30000, 70000, 200000, 260000, 500000}) {
+        bytes[offset] = 'K';
+    }
+    for (const int offset : {40000, 70100, 330000}) {
+        bytes[offset] = 'Z';
+    }
+    const QVector<breco::ScanTarget> targets = {
+        writeScanTarget(tempDir, QStringLiteral("runs.bin"), bytes)};
+    breco::SearchQuery query;
+    query.regex = true;
+    query.terms = {QByteArray("K[^Z]*Z"), QByteArray("a0{3}1")};
+    const auto plan = breco::SearchPlan::compile(query);
+    breco::ByteRegexScanner scanner(plan->regex());
+    QVector<breco::RegexMatch> wholeMatches;
+    breco::RegexRun endRun;
+    scanner.scan(bytes.constData(), bytes.size(), bytes.size(), 0, &wholeMatches, &endRun);
+    QVector<std::tuple<quint64, int, quint64>> expected;
+    for (const breco::RegexMatch& match : wholeMatches) {
+        expected.push_back({match.start, plan->patternTerm(match.patternIdx), match.length});
+    }
+    std::sort(expected.begin(), expected.end());
+
+    breco::ScanController controller;
+    controller.setEntropyMapEnabled(true);
+    const quint32 blockSize = static_cast<quint32>(breco::EntropyMap::kBlockBytes);
+    const ControllerScanResult regexScan = runControllerScan(&controller, targets, query, blockSize);
+    QVector<std::tuple<quint64, int, quint64>> found;
+    for (const breco::MatchRecord& match : regexScan.matches) {
+        found.push_back({match.offset, match.termIdx, match.matchLength});
+    }
+    expectTrue(regexScan.finished && found == expected && expected.size() > 100 &&
+                   std::count_if(expected.cbegin(), expected.cend(),
+                                 [](const auto& match) { return std::get<1>(match) == 0; }) == 3,
+               QStringLiteral("Regex matches carried across jobs should equal one whole-file pass"));
+
+    // Parked and carried jobs measure their share of the map too.
+    bool mapComplete = controller.entropyMaps().size() == 1;
+    const breco::EntropyMap& map = controller.entropyMaps().first();
+    for (int block = 0; mapComplete && block < map.blockCount(); ++block) {
+        const int start = block * static_cast<int>(breco::EntropyMap::kBlockBytes);
+        const int size = qMin(static_cast<int>(breco::EntropyMap::kBlockBytes),
+                              static_cast<int>(bytes.size()) - start);
+        mapComplete = map.level(block) == breco::EntropyMap::levelFor(
+                                               breco::EntropyMap::entropyBits(
+                                                   bytes.constData() + start, size));
+    }
+    expectTrue(mapComplete, QStringLiteral("A regex scan should measure the whole entropy map"));
+    controller.setEntropyMapEnabled(false);
+
+    // A streamed needle longer than the jobs, across job and read-block boundaries.
+    const QByteArray needle = pseudoRandomBytes(&state, 700, QByteArray("xyz"));
+    QVector<quint64> needleOffsets;
+    for (const int offset : {700, 4000, 65530, 131072 - 350, 400001}) {
+        bytes.replace(offset, needle.size(), needle);
+        needleOffsets.push_back(static_cast<quint64>(offset));
+    }
+    const QVector<breco::ScanTarget> needleTargets = {
+        writeScanTarget(tempDir, QStringLiteral("needle.bin"), bytes)};
+    breco::SearchQuery needleQuery;
+    needleQuery.terms = {needle};
+    expectTrue(breco::SearchPlan::compile(needleQuery)->streamsNeedle(),
+               QStringLiteral("A 700-byte needle should be streamed"));
+    const ControllerScanResult needleScan =
+        runControllerScan(&controller, needleTargets, needleQuery, 4096);
+    expectTrue(needleScan.finished && matchOffsets(needleScan.matches) == needleOffsets,
+               QStringLiteral("A streamed needle should be found across 512-byte jobs"));
+}
+
+void testScanControllerEntropyGate() {
+    QTemporaryDir tempDir;
+    expectTrue(tempDir.isValid(), QStringLiteral("Entropy gate temp dir should be valid"));
+    if (!tempDir.isValid()) {
+        return;
+    }
+    // 64 KiB blocks alternate between random bytes and text, with the term in every block.
+    const int block = static_cast<int>(breco::EntropyMap::kBlockBytes);
+    quint32 state = 0x5EED0022U;
+    QByteArray bytes;
+    QVector<quint64> all;
+    QVector<quint64> inText;
+    for (int b = 0; b < 8; ++b) {
+        const bool random = b % 2 == 0;
+        QByteArray blockBytes =
+            random ? pseudoRandomBytes(&state, block)
+                   : pseudoRandomBytes(&state, block, QByteArray("etaoin shrdlu"));
+        for (int offset = 3000; offset + 6 <= block; offset += 20000) {
+            blockBytes.replace(offset, 6, "needle");
+            all.push_back(static_cast<quint64>(b * block + offset));
+            if (!random) {
+                inText.push_back(all.last());
+            }
+        }
+        bytes.append(blockBytes);
+    }
+    const QVector<breco::ScanTarget> targets = {
+        writeScanTarget(tempDir, QStringLiteral("mixed.bin"), bytes)};
+    breco::SearchQuery query;
+    query.terms = {QByteArray("needle")};
+    breco::ScanController controller;
+
+    const ControllerScanResult ungated =
+        runControllerScan(&controller, targets, query, static_cast<quint32>(block));
+    expectTrue(ungated.finished && matchOffsets(ungated.matches) == all &&
+                   controller.entropySkippedBytes() == 0,
+               QStringLiteral("An ungated scan should search every block"));
+
+    controller.setEntropySkipThreshold(7.5);
+    const ControllerScanResult gated =
+        runControllerScan(&controller, targets, query, static_cast<quint32>(block));
+    expectTrue(gated.finished && matchOffsets(gated.matches) == inText &&
+                   controller.entropySkippedBytes() == 4 * breco::EntropyMap::kBlockBytes,
+               QStringLiteral("A gated scan should skip exactly the random blocks"));
+    controller.setEntropySkipThreshold(0.0);
+}
+
+void testScanControllerAlignedScan() {
+    QTemporaryDir tempDir;
+    expectTrue(tempDir.isValid(), QStringLiteral("Aligned scan temp dir should be valid"));
+    if (!tempDir.isValid()) {
+        return;
+    }
+    // Terms on every third sector start (every ninth in upper case) and between sectors. Blocks
+    // of 10000 bytes give 1250-byte jobs, so sector starts and job edges do not line up.
+    quint32 state = 0x5EED0024U;
+    QByteArray bytes = pseudoRandomBytes(&state, 400000, QByteArray("abcd01"));
+    QVector<quint64> aligned;
+    QVector<quint64> lowerAligned;
+    for (int offset = 0; offset + 512 <= bytes.size(); offset += 512) {
+        const int sector = offset / 512;
+        if (sector % 3 == 0) {
+            bytes.replace(offset, 6, sector % 9 == 0 ? "NEEDLE" : "needle");
+            aligned.push_back(static_cast<quint64>(offset));
+            if (sector % 9 != 0) {
+                lowerAligned.push_back(static_cast<quint64>(offset));
+            }
+        } else {
+            bytes.replace(offset + 1 + sector % 500, 6, "needle");
+        }
+    }
+    const QVector<breco::ScanTarget> targets = {
+        writeScanTarget(tempDir, QStringLiteral("sectors.bin"), bytes)};
+    breco::ScanController controller;
+    controller.setMatchAlignment(512);
+
+    breco::SearchQuery query;
+    query.terms = {QByteArray("needle")};
+    const ControllerScanResult exact = runControllerScan(&controller, targets, query, 10000);
+    expectTrue(exact.finished && matchOffsets(exact.matches) == lowerAligned,
+               QStringLiteral("An aligned scan should report exactly the sector-start matches"));
+    query.ignoreCase = true;
+    const ControllerScanResult folded = runControllerScan(&controller, targets, query, 10000);
+    expectTrue(folded.finished && matchOffsets(folded.matches) == aligned,
+               QStringLiteral("An aligned ignore-case scan should fold at sector starts"));
+    query.ignoreCase = false;
+    query.regex = true;
+    query.terms = {QByteArray("[nN][eE]+[dD][lL][eE]")};
+    const ControllerScanResult regex = runControllerScan(&controller, targets, query, 10000);
+    expectTrue(regex.finished && matchOffsets(regex.matches) == aligned,
+               QStringLiteral("An aligned regex scan should drop the unaligned matches"));
 }
 
 void testShiftReadPlan() {
@@ -386,6 +2382,72 @@ void testResultModelColumnOrder() {
     expectEqQString(model.data(model.index(0, 3), Qt::DisplayRole).toString(),
                     QStringLiteral("2 ms"),
                     QStringLiteral("ResultModel column 3 should show search time in ms"));
+
+    const QVector<QByteArray> searchTerms = {QByteArray("alpha"), QByteArray("beta")};
+    breco::MatchRecord second = m;
+    second.termIdx = 1;
+    model.appendBatch({second});
+    model.setSearchTerms(&searchTerms);
+    breco::MatchRecord shifted = m;
+    shifted.bitOffset = 3;
+    model.appendBatch({shifted});
+    expectEqQString(model.data(model.index(2, 2), Qt::DisplayRole).toString(),
+                    QStringLiteral("2 MiB +3 bit"),
+                    QStringLiteral("ResultModel column 2 should show the bit offset of a match"));
+    expectEqQString(model.headerData(4, Qt::Horizontal, Qt::DisplayRole).toString(),
+                    QStringLiteral("Term"),
+                    QStringLiteral("ResultModel column 4 header should be Term"));
+    expectEqQString(model.data(model.index(1, 4), Qt::DisplayRole).toString(),
+                    QStringLiteral("beta"),
+                    QStringLiteral("ResultModel column 4 should show the matched term"));
+    const QVector<QByteArray> termMasks = {QByteArray("\xFF\xFF\xFF\xFF\xFF", 5),
+                                           QByteArray("\xFF\x00\xF0\xFF", 4)};
+    model.setTermMasks(&termMasks);
+    expectEqQString(model.data(model.index(1, 4), Qt::DisplayRole).toString(),
+                    QStringLiteral("62 ?? 7? 61"),
+                    QStringLiteral("ResultModel column 4 should show hex pattern terms as hex"));
+    model.setTermMasks(nullptr);
+    breco::MatchRecord utf16 = m;
+    utf16.encoding = breco::TermEncoding::Utf16Be;
+    model.appendBatch({utf16});
+    expectEqQString(model.data(model.index(3, 4), Qt::DisplayRole).toString(),
+                    QStringLiteral("alpha (UTF-16BE)"),
+                    QStringLiteral("ResultModel column 4 should name the UTF-16 encoding"));
+    breco::MatchRecord approximate = m;
+    approximate.distance = 2;
+    model.appendBatch({approximate});
+    expectEqQString(model.data(model.index(4, 4), Qt::DisplayRole).toString(),
+                    QStringLiteral("alpha ~2"),
+                    QStringLiteral("ResultModel column 4 should show approximate match errors"));
+    breco::MatchRecord xorMatch = m;
+    xorMatch.xorKey = 0x5A;
+    model.appendBatch({xorMatch});
+    expectEqQString(model.data(model.index(5, 4), Qt::DisplayRole).toString(),
+                    QStringLiteral("alpha (XOR 0x5A)"),
+                    QStringLiteral("ResultModel column 4 should show the XOR key"));
+    breco::MatchRecord numericMatch = m;
+    numericMatch.numericFormat = breco::NumericFormat::U32Le;
+    model.appendBatch({numericMatch});
+    expectEqQString(model.data(model.index(6, 4), Qt::DisplayRole).toString(),
+                    QStringLiteral("alpha (u32 LE)"),
+                    QStringLiteral("ResultModel column 4 should show the numeric form"));
+    breco::MatchRecord encodedMatch = m;
+    encodedMatch.encoding = breco::TermEncoding::Base64Shift1;
+    model.appendBatch({encodedMatch});
+    expectEqQString(model.data(model.index(7, 4), Qt::DisplayRole).toString(),
+                    QStringLiteral("alpha (Base64)"),
+                    QStringLiteral("ResultModel column 4 should show the encoded form"));
+    breco::MatchRecord countedMatch = m;
+    countedMatch.matchCount = 12;
+    model.appendBatch({countedMatch});
+    expectEqQString(model.data(model.index(8, 4), Qt::DisplayRole).toString(),
+                    QStringLiteral("alpha (12 in file)"),
+                    QStringLiteral("ResultModel column 4 should show the per-file match count"));
+    const QVector<QByteArray> longTerms = {QByteArray(300, '\x41')};
+    model.setSearchTerms(&longTerms);
+    expectEqQString(model.data(model.index(0, 4), Qt::DisplayRole).toString(),
+                    QStringLiteral("41 41 41 41 41 41 41 41 41 41 41 41 41 41 41 41 … (300 B)"),
+                    QStringLiteral("ResultModel column 4 should shorten long needles"));
 }
 
 void testSpscQueueMechanics() {
@@ -500,6 +2562,29 @@ int main(int argc, char** argv) {
     QApplication app(argc, argv);
 
     testMatchUtilsIndexOf();
+    testByteSearchKernelsAgree();
+    testSearchPlanAlgorithms();
+    testMultiPatternSearchEnginesAgree();
+    testHexPatternSearch();
+    testSearchPlanBitPhases();
+    testByteRegex();
+    testEncodingVariants();
+    testUnicodeCaseFold();
+    testApproximateSearch();
+    testXorKeySearch();
+    testNumericSearch();
+    testEncodedForms();
+    testProximitySearch();
+    testStreamedNeedle();
+    testMatchStore();
+    testEntropyMap();
+    testAlignedSearch();
+    testFileCarver();
+    testExtentExporter();
+    testScanControllerMatchBudget();
+    testScanControllerCarriedRuns();
+    testScanControllerEntropyGate();
+    testScanControllerAlignedScan();
     testShiftReadPlan();
     testShiftTransformWindow();
     testTextSequenceAnalyzer();